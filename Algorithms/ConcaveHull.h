@@ -0,0 +1,218 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef CONCAVEHULL_H_
+#define CONCAVEHULL_H_
+
+#include "../DataStructures/Coordinate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+//Input points are thinned out to one per cell of a grid this wide and high
+static const unsigned CONCAVE_HULL_GRID_SIZE = 48;
+//An edge is only dug into if it is this many times longer than the distance
+//to the point that would replace it. Larger values give smoother hulls.
+static const double CONCAVE_HULL_CONCAVITY = 2.;
+
+/*
+ * Computes a concave hull around a set of coordinates by digging into the
+ * convex hull: each hull edge is replaced by two edges through the closest
+ * inner point as long as the edge is long compared to that distance and the
+ * new edges do not cross the hull (Park and Oh, 2012).
+ */
+class ConcaveHull {
+    struct Point {
+        Point() : x(0.), y(0.), index(0), on_hull(false) { }
+        double x;
+        double y;
+        unsigned index;
+        bool on_hull;
+        bool operator<(const Point & other) const {
+            return (x != other.x) ? (x < other.x) : (y < other.y);
+        }
+    };
+
+public:
+    void Run(
+        const std::vector<FixedPointCoordinate> & input,
+        std::vector<FixedPointCoordinate> & hull
+    ) {
+        hull.clear();
+        if(input.empty()) {
+            return;
+        }
+        ThinOut(input);
+        std::vector<unsigned> ring;
+        ConvexHull(ring);
+        if(3 < points.size() && 3 <= ring.size()) {
+            DigIntoHull(ring);
+        }
+        for(unsigned i = 0; i < ring.size(); ++i) {
+            hull.push_back(input[points[ring[i]].index]);
+        }
+        //closed ring
+        if(!ring.empty()) {
+            hull.push_back(hull.front());
+        }
+    }
+
+private:
+    std::vector<Point> points;
+
+    //Keeps one coordinate per grid cell, projected to locally equidistant x/y
+    void ThinOut(const std::vector<FixedPointCoordinate> & input) {
+        int min_lat = input[0].lat, max_lat = input[0].lat;
+        int min_lon = input[0].lon, max_lon = input[0].lon;
+        for(unsigned i = 1; i < input.size(); ++i) {
+            min_lat = std::min(min_lat, input[i].lat);
+            max_lat = std::max(max_lat, input[i].lat);
+            min_lon = std::min(min_lon, input[i].lon);
+            max_lon = std::max(max_lon, input[i].lon);
+        }
+        const double lon_scale = cos(((min_lat + max_lat)/2.)/COORDINATE_PRECISION*M_PI/180.);
+        const double cell_height = std::max(1., (max_lat - (double)min_lat)/CONCAVE_HULL_GRID_SIZE);
+        const double cell_width  = std::max(1., (max_lon - (double)min_lon)/CONCAVE_HULL_GRID_SIZE);
+
+        std::vector<int> cells((CONCAVE_HULL_GRID_SIZE+1)*(CONCAVE_HULL_GRID_SIZE+1), -1);
+        points.clear();
+        for(unsigned i = 0; i < input.size(); ++i) {
+            const unsigned row    = (input[i].lat - min_lat)/cell_height;
+            const unsigned column = (input[i].lon - min_lon)/cell_width;
+            int & cell = cells[row*(CONCAVE_HULL_GRID_SIZE+1) + column];
+            if(-1 != cell) {
+                continue;
+            }
+            cell = points.size();
+            Point p;
+            p.x = (input[i].lon - min_lon)*lon_scale;
+            p.y = input[i].lat - min_lat;
+            p.index = i;
+            points.push_back(p);
+        }
+    }
+
+    static double Cross(const Point & o, const Point & a, const Point & b) {
+        return (a.x - o.x)*(b.y - o.y) - (a.y - o.y)*(b.x - o.x);
+    }
+
+    //Andrew's monotone chain, counter-clockwise
+    void ConvexHull(std::vector<unsigned> & ring) {
+        std::sort(points.begin(), points.end());
+        const int n = points.size();
+        if(3 > n) {
+            for(int i = 0; i < n; ++i) {
+                ring.push_back(i);
+            }
+            return;
+        }
+        std::vector<unsigned> chain(2*n);
+        int k = 0;
+        for(int i = 0; i < n; ++i) {
+            while(k >= 2 && 0 >= Cross(points[chain[k-2]], points[chain[k-1]], points[i])) {
+                --k;
+            }
+            chain[k++] = i;
+        }
+        for(int i = n-2, t = k+1; i >= 0; --i) {
+            while(k >= t && 0 >= Cross(points[chain[k-2]], points[chain[k-1]], points[i])) {
+                --k;
+            }
+            chain[k++] = i;
+        }
+        ring.assign(chain.begin(), chain.begin() + (k-1));
+        for(unsigned i = 0; i < ring.size(); ++i) {
+            points[ring[i]].on_hull = true;
+        }
+    }
+
+    static double SquaredDistanceToSegment(const Point & p, const Point & a, const Point & b) {
+        const double dx = b.x - a.x;
+        const double dy = b.y - a.y;
+        const double length = dx*dx + dy*dy;
+        double u = (0. == length) ? 0. : ((p.x - a.x)*dx + (p.y - a.y)*dy)/length;
+        u = std::max(0., std::min(1., u));
+        const double x = a.x + u*dx - p.x;
+        const double y = a.y + u*dy - p.y;
+        return x*x + y*y;
+    }
+
+    static bool SegmentsCross(const Point & a, const Point & b, const Point & c, const Point & d) {
+        const double d1 = Cross(c, d, a);
+        const double d2 = Cross(c, d, b);
+        const double d3 = Cross(a, b, c);
+        const double d4 = Cross(a, b, d);
+        return ((0 < d1 && 0 > d2) || (0 > d1 && 0 < d2)) &&
+               ((0 < d3 && 0 > d4) || (0 > d3 && 0 < d4));
+    }
+
+    bool CrossesRing(const std::vector<unsigned> & ring, const Point & a, const Point & b) const {
+        for(unsigned i = 0; i < ring.size(); ++i) {
+            const Point & c = points[ring[i]];
+            const Point & d = points[ring[(i+1) % ring.size()]];
+            if(SegmentsCross(a, b, c, d)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void DigIntoHull(std::vector<unsigned> & ring) {
+        unsigned i = 0;
+        while(i < ring.size()) {
+            const Point & a = points[ring[i]];
+            const Point & b = points[ring[(i+1) % ring.size()]];
+            const double edge_length = sqrt((b.x - a.x)*(b.x - a.x) + (b.y - a.y)*(b.y - a.y));
+
+            int candidate = -1;
+            double candidate_distance = 0.;
+            for(unsigned j = 0; j < points.size(); ++j) {
+                if(points[j].on_hull) {
+                    continue;
+                }
+                const double distance = SquaredDistanceToSegment(points[j], a, b);
+                if(-1 == candidate || distance < candidate_distance) {
+                    candidate = j;
+                    candidate_distance = distance;
+                }
+            }
+            if(-1 == candidate) {
+                return;
+            }
+            const Point & p = points[candidate];
+            const double depth = sqrt(candidate_distance);
+            if(
+                0. < depth &&
+                edge_length/depth > CONCAVE_HULL_CONCAVITY &&
+                !CrossesRing(ring, a, p) &&
+                !CrossesRing(ring, p, b)
+            ) {
+                points[candidate].on_hull = true;
+                ring.insert(ring.begin() + i + 1, candidate);
+                //look at the first of the two new edges again
+                continue;
+            }
+            ++i;
+        }
+    }
+};
+
+#endif /* CONCAVEHULL_H_ */
@@ -0,0 +1,244 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef TRAVELINGSALESMANSOLVER_H_
+#define TRAVELINGSALESMANSOLVER_H_
+
+#include <boost/assert.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+//Instances up to this size are solved exactly by dynamic programming
+static const unsigned TSP_MAX_EXACT_SIZE = 12;
+//Upper bound on improvement rounds of the local search
+static const unsigned TSP_MAX_IMPROVEMENT_ROUNDS = 100;
+
+/*
+ * Computes a short round trip through all locations of an asymmetric
+ * distance matrix, starting and ending at location 0. Small instances are
+ * solved exactly with the Held-Karp algorithm, larger ones by nearest
+ * insertion followed by 2-opt and Or-opt moves until no move improves the
+ * trip any more. The matrix is row major, entry i*n+j is the cost of i->j.
+ */
+class TravelingSalesmanSolver {
+public:
+    TravelingSalesmanSolver(const std::vector<int> & m, const unsigned n) :
+        matrix(m),
+        number_of_locations(n)
+    {
+        BOOST_ASSERT_MSG(m.size() == n*n, "matrix has wrong size");
+    }
+
+    //Fills the visiting order, which starts with location 0
+    void Run(std::vector<unsigned> & trip) const {
+        trip.clear();
+        if(3 >= number_of_locations) {
+            for(unsigned i = 0; i < number_of_locations; ++i) {
+                trip.push_back(i);
+            }
+            if(3 == number_of_locations && GetTripCost(trip) > Cost(0, 2) + Cost(2, 1) + Cost(1, 0)) {
+                std::swap(trip[1], trip[2]);
+            }
+            return;
+        }
+        if(TSP_MAX_EXACT_SIZE >= number_of_locations) {
+            SolveExactly(trip);
+            return;
+        }
+        NearestInsertion(trip);
+        for(unsigned round = 0; round < TSP_MAX_IMPROVEMENT_ROUNDS; ++round) {
+            const bool improved_by_2opt = TwoOpt(trip);
+            const bool improved_by_oropt = OrOpt(trip);
+            if(!improved_by_2opt && !improved_by_oropt) {
+                break;
+            }
+        }
+    }
+
+    long long GetTripCost(const std::vector<unsigned> & trip) const {
+        long long cost = 0;
+        for(unsigned i = 0; i < trip.size(); ++i) {
+            cost += Cost(trip[i], trip[(i+1) % trip.size()]);
+        }
+        return cost;
+    }
+
+private:
+    const std::vector<int> & matrix;
+    const unsigned number_of_locations;
+
+    inline long long Cost(const unsigned from, const unsigned to) const {
+        return matrix[from*number_of_locations + to];
+    }
+
+    //Held-Karp over subsets of the locations other than 0
+    void SolveExactly(std::vector<unsigned> & trip) const {
+        const unsigned n = number_of_locations - 1;
+        const unsigned number_of_subsets = 1u << n;
+        const long long infinity = LLONG_MAX/4;
+        //best cost of a path from 0 through the subset, ending at location j+1
+        std::vector<long long> cost(number_of_subsets*n, infinity);
+        std::vector<unsigned char> parent(number_of_subsets*n, UCHAR_MAX);
+        for(unsigned j = 0; j < n; ++j) {
+            cost[(1u << j)*n + j] = Cost(0, j+1);
+        }
+        for(unsigned subset = 1; subset < number_of_subsets; ++subset) {
+            for(unsigned j = 0; j < n; ++j) {
+                const long long current = cost[subset*n + j];
+                if(!(subset & (1u << j)) || infinity == current) {
+                    continue;
+                }
+                for(unsigned k = 0; k < n; ++k) {
+                    if(subset & (1u << k)) {
+                        continue;
+                    }
+                    const unsigned next_subset = subset | (1u << k);
+                    const long long next = current + Cost(j+1, k+1);
+                    if(next < cost[next_subset*n + k]) {
+                        cost[next_subset*n + k] = next;
+                        parent[next_subset*n + k] = j;
+                    }
+                }
+            }
+        }
+        const unsigned all = number_of_subsets - 1;
+        unsigned last = 0;
+        long long best = infinity;
+        for(unsigned j = 0; j < n; ++j) {
+            const long long total = cost[all*n + j] + Cost(j+1, 0);
+            if(total < best) {
+                best = total;
+                last = j;
+            }
+        }
+        unsigned subset = all;
+        while(UCHAR_MAX != last) {
+            trip.push_back(last+1);
+            const unsigned previous = parent[subset*n + last];
+            subset &= ~(1u << last);
+            last = previous;
+        }
+        trip.push_back(0);
+        std::reverse(trip.begin(), trip.end());
+    }
+
+    //Grows the trip by the location nearest to it, inserted where it adds
+    //the least. Distances to the trip are kept up to date as it grows, in
+    //either direction since the matrix need not be symmetric.
+    void NearestInsertion(std::vector<unsigned> & trip) const {
+        std::vector<bool> is_in_trip(number_of_locations, false);
+        std::vector<long long> distance_to_trip(number_of_locations, LLONG_MAX);
+        trip.push_back(0);
+        is_in_trip[0] = true;
+        unsigned added = 0;
+        while(trip.size() < number_of_locations) {
+            unsigned nearest = UINT_MAX;
+            for(unsigned location = 0; location < number_of_locations; ++location) {
+                if(is_in_trip[location]) {
+                    continue;
+                }
+                distance_to_trip[location] = std::min(
+                    distance_to_trip[location],
+                    std::min(Cost(added, location), Cost(location, added))
+                );
+                if(UINT_MAX == nearest || distance_to_trip[location] < distance_to_trip[nearest]) {
+                    nearest = location;
+                }
+            }
+            long long best_increase = LLONG_MAX;
+            unsigned best_position = trip.size();
+            for(unsigned i = 0; i < trip.size(); ++i) {
+                const unsigned from = trip[i];
+                const unsigned to = trip[(i+1) % trip.size()];
+                const long long increase = Cost(from, nearest) + Cost(nearest, to) - Cost(from, to);
+                if(increase < best_increase) {
+                    best_increase = increase;
+                    best_position = i+1;
+                }
+            }
+            trip.insert(trip.begin() + best_position, nearest);
+            is_in_trip[nearest] = true;
+            added = nearest;
+        }
+    }
+
+    //Reverses the section between positions i and j. The cost of the reversed
+    //section has to be recomputed, the matrix need not be symmetric.
+    bool TwoOpt(std::vector<unsigned> & trip) const {
+        const unsigned n = trip.size();
+        bool improved = false;
+        for(unsigned i = 1; i + 1 < n; ++i) {
+            for(unsigned j = i + 1; j < n; ++j) {
+                const unsigned before = trip[i-1];
+                const unsigned after = trip[(j+1) % n];
+                long long old_cost = Cost(before, trip[i]) + Cost(trip[j], after);
+                long long new_cost = Cost(before, trip[j]) + Cost(trip[i], after);
+                for(unsigned k = i; k < j; ++k) {
+                    old_cost += Cost(trip[k], trip[k+1]);
+                    new_cost += Cost(trip[k+1], trip[k]);
+                }
+                if(new_cost < old_cost) {
+                    std::reverse(trip.begin() + i, trip.begin() + j + 1);
+                    improved = true;
+                }
+            }
+        }
+        return improved;
+    }
+
+    //Moves sections of one to three consecutive locations elsewhere
+    bool OrOpt(std::vector<unsigned> & trip) const {
+        const unsigned n = trip.size();
+        bool improved = false;
+        for(unsigned length = 1; length <= 3; ++length) {
+            for(unsigned i = 1; i + length <= n; ++i) {
+                const unsigned first = trip[i];
+                const unsigned last = trip[i + length - 1];
+                const unsigned before = trip[i-1];
+                const unsigned after = trip[(i + length) % n];
+                const long long removal_gain = Cost(before, first) + Cost(last, after) - Cost(before, after);
+
+                std::vector<unsigned> rest(trip.begin(), trip.begin() + i);
+                rest.insert(rest.end(), trip.begin() + i + length, trip.end());
+                long long best_increase = removal_gain;
+                unsigned best_position = UINT_MAX;
+                for(unsigned p = 0; p < rest.size(); ++p) {
+                    const unsigned from = rest[p];
+                    const unsigned to = rest[(p+1) % rest.size()];
+                    const long long increase = Cost(from, first) + Cost(last, to) - Cost(from, to);
+                    if(increase < best_increase) {
+                        best_increase = increase;
+                        best_position = p+1;
+                    }
+                }
+                if(UINT_MAX != best_position) {
+                    rest.insert(rest.begin() + best_position, trip.begin() + i, trip.begin() + i + length);
+                    trip.swap(rest);
+                    improved = true;
+                }
+            }
+        }
+        return improved;
+    }
+};
+
+#endif /* TRAVELINGSALESMANSOLVER_H_ */
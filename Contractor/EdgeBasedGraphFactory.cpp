@@ -29,35 +29,9 @@ EdgeBasedGraphFactory::EdgeBasedGraphFactory(
     std::vector<NodeInfo> & m_node_info_list,
     SpeedProfileProperties speed_profile
 ) : speed_profile(speed_profile),
-    m_turn_restrictions_count(0),
-    m_node_info_list(m_node_info_list)
+    m_node_info_list(m_node_info_list),
+    m_restriction_index(number_of_nodes, input_restrictions_list)
 {
-	BOOST_FOREACH(const TurnRestriction & restriction, input_restrictions_list) {
-        std::pair<NodeID, NodeID> restriction_source =
-            std::make_pair(restriction.fromNode, restriction.viaNode);
-        unsigned index;
-        RestrictionMap::iterator restriction_iter = m_restriction_map.find(restriction_source);
-        if(restriction_iter == m_restriction_map.end()) {
-            index = m_restriction_bucket_list.size();
-            m_restriction_bucket_list.resize(index+1);
-            m_restriction_map[restriction_source] = index;
-        } else {
-            index = restriction_iter->second;
-            //Map already contains an is_only_*-restriction
-            if(m_restriction_bucket_list.at(index).begin()->second) {
-                continue;
-            } else if(restriction.flags.isOnly) {
-                //We are going to insert an is_only_*-restriction. There can be only one.
-                m_turn_restrictions_count -= m_restriction_bucket_list.at(index).size();
-                m_restriction_bucket_list.at(index).clear();
-            }
-        }
-        ++m_turn_restrictions_count;
-        m_restriction_bucket_list.at(index).push_back(
-            std::make_pair( restriction.toNode, restriction.flags.isOnly)
-        );
-    }
-
 	m_barrier_nodes.insert(
         barrier_node_list.begin(),
         barrier_node_list.end()
@@ -135,20 +109,7 @@ NodeID EdgeBasedGraphFactory::CheckForEmanatingIsOnlyTurn(
     const NodeID u,
     const NodeID v
 ) const {
-    const std::pair < NodeID, NodeID > restriction_source = std::make_pair(u, v);
-    RestrictionMap::const_iterator restriction_iter = m_restriction_map.find(restriction_source);
-    if (restriction_iter != m_restriction_map.end()) {
-        const unsigned index = restriction_iter->second;
-        BOOST_FOREACH(
-            const RestrictionSource & restriction_target,
-            m_restriction_bucket_list.at(index)
-        ) {
-            if(restriction_target.second) {
-                return restriction_target.first;
-            }
-        }
-    }
-    return UINT_MAX;
+    return m_restriction_index.GetOnlyTarget(u, v);
 }
 
 bool EdgeBasedGraphFactory::CheckIfTurnIsRestricted(
@@ -156,21 +117,7 @@ bool EdgeBasedGraphFactory::CheckIfTurnIsRestricted(
     const NodeID v,
     const NodeID w
 ) const {
-    //only add an edge if turn is not a U-turn except it is the end of dead-end street.
-    const std::pair < NodeID, NodeID > restriction_source = std::make_pair(u, v);
-    RestrictionMap::const_iterator restriction_iter = m_restriction_map.find(restriction_source);
-    if (restriction_iter != m_restriction_map.end()) {
-        const unsigned index = restriction_iter->second;
-        BOOST_FOREACH(
-            const RestrictionTarget & restriction_target,
-            m_restriction_bucket_list.at(index)
-        ) {
-            if(w == restriction_target.first) {
-                return true;
-            }
-        }
-    }
-    return false;
+    return m_restriction_index.IsRestricted(u, v, w);
 }
 
 void EdgeBasedGraphFactory::InsertEdgeBasedNode(
@@ -179,26 +126,430 @@ void EdgeBasedGraphFactory::InsertEdgeBasedNode(
         NodeIterator v,
         bool belongsToTinyComponent) {
     EdgeData & data = m_node_based_graph->GetEdgeData(e1);
-    EdgeBasedNode currentNode;
-    currentNode.nameID = data.nameID;
-    currentNode.lat1 = m_node_info_list[u].lat;
-    currentNode.lon1 = m_node_info_list[u].lon;
-    currentNode.lat2 = m_node_info_list[v].lat;
-    currentNode.lon2 = m_node_info_list[v].lon;
-    currentNode.belongsToTinyComponent = belongsToTinyComponent;
-    currentNode.id = data.edgeBasedNodeID;
-    currentNode.ignoreInGrid = data.ignoreInGrid;
-    currentNode.weight = data.distance;
-    m_edge_based_node_list.push_back(currentNode);
+    //compressed edges are indexed segment by segment
+    const CompressedChainMap::const_iterator chain = m_compressed_chains.find(data.edgeBasedNodeID);
+    const unsigned number_of_segments = (m_compressed_chains.end() == chain ? 1 : chain->second.segment_weights.size());
+    NodeID segment_start = u;
+    unsigned offset = 0;
+    for(unsigned segment = 0; segment < number_of_segments; ++segment) {
+        const bool is_last_segment = (segment+1 == number_of_segments);
+        const NodeID segment_end = (is_last_segment ? v : chain->second.intermediate_nodes[segment]);
+        const int segment_weight = (1 == number_of_segments ? data.distance : chain->second.segment_weights[segment]);
+        EdgeBasedNode currentNode;
+        currentNode.nameID = data.nameID;
+        currentNode.lat1 = m_node_info_list[segment_start].lat;
+        currentNode.lon1 = m_node_info_list[segment_start].lon;
+        currentNode.lat2 = m_node_info_list[segment_end].lat;
+        currentNode.lon2 = m_node_info_list[segment_end].lon;
+        currentNode.belongsToTinyComponent = belongsToTinyComponent;
+        currentNode.id = data.edgeBasedNodeID;
+        currentNode.ignoreInGrid = data.ignoreInGrid;
+        currentNode.weight = segment_weight;
+        currentNode.offset = offset;
+        currentNode.segmentPosition = segment;
+        m_edge_based_node_list.push_back(currentNode);
+        offset += segment_weight;
+        segment_start = segment_end;
+    }
+}
+
+/*
+ * Merges chains of node-based edges through nodes that only continue the
+ * road, i.e. nodes with exactly two neighbors whose edges agree in name,
+ * direction and all other attributes. Barriers, traffic lights and nodes of
+ * turn restrictions are kept. Both directions of a two-way road keep the
+ * consecutive edge-based node ids the nearest neighbor search relies on.
+ */
+void EdgeBasedGraphFactory::CompressGeometry() {
+    SimpleLogger().Write() << "Compressing geometry of the road network";
+    const unsigned number_of_nodes = m_node_based_graph->GetNumberOfNodes();
+    const unsigned number_of_edges = m_node_based_graph->GetNumberOfEdges();
+
+    std::vector<NodeID> restricted_node_list;
+    m_restriction_index.GetRestrictedNodes(restricted_node_list);
+    const boost::unordered_set<NodeID> restricted_nodes(
+        restricted_node_list.begin(),
+        restricted_node_list.end()
+    );
+
+    //the graph only stores outgoing edges
+    std::vector<unsigned> in_degree(number_of_nodes, 0);
+    std::vector<NodeID> in_neighbor(number_of_nodes, UINT_MAX);
+    for(NodeIterator u = 0; u < number_of_nodes; ++u) {
+        for(
+            EdgeIterator e = m_node_based_graph->BeginEdges(u),
+                last_edge = m_node_based_graph->EndEdges(u);
+            e < last_edge;
+            ++e
+        ) {
+            const NodeIterator v = m_node_based_graph->GetTarget(e);
+            ++in_degree[v];
+            in_neighbor[v] = u;
+        }
+    }
+
+    m_compressed_node_count.resize(number_of_nodes, 0);
+    unsigned removed_nodes = 0;
+    for(NodeIterator v = 0; v < number_of_nodes; ++v) {
+        NodeID u = UINT_MAX, w = UINT_MAX;
+        if(!IsCompressible(v, in_degree, in_neighbor, restricted_nodes, u, w)) {
+            continue;
+        }
+        const EdgeData & forward_data =
+            m_node_based_graph->GetEdgeData(m_node_based_graph->FindEdge(u, v));
+        const unsigned forward_edge_based_node = forward_data.edgeBasedNodeID;
+        const bool is_two_way = forward_data.backward;
+        const unsigned reverse_edge_based_node = (is_two_way ?
+            m_node_based_graph->GetEdgeData(m_node_based_graph->FindEdge(v, u)).edgeBasedNodeID :
+            UINT_MAX
+        );
+        MergeEdges(u, v, w, forward_edge_based_node);
+        if(is_two_way) {
+            MergeEdges(w, v, u, reverse_edge_based_node);
+        }
+        if(v == in_neighbor[u]) {
+            in_neighbor[u] = w;
+        }
+        if(v == in_neighbor[w]) {
+            in_neighbor[w] = u;
+        }
+        in_degree[v] = 0;
+        m_compressed_node_count[u] += 1 + m_compressed_node_count[v];
+        m_compressed_node_count[v] = 0;
+        ++removed_nodes;
+    }
+    RenumberEdgeBasedNodes();
+
+    SimpleLogger().Write() <<
+        "removed " << removed_nodes << " nodes, node-based edges reduced from " <<
+        number_of_edges << " to " << m_node_based_graph->GetNumberOfEdges();
+}
+
+bool EdgeBasedGraphFactory::IsCompressible(
+    const NodeID v,
+    const std::vector<unsigned> & in_degree,
+    const std::vector<NodeID> & in_neighbor,
+    const boost::unordered_set<NodeID> & restricted_nodes,
+    NodeID & u,
+    NodeID & w
+) const {
+    if(
+        m_barrier_nodes.find(v) != m_barrier_nodes.end() ||
+        m_traffic_lights.find(v) != m_traffic_lights.end() ||
+        restricted_nodes.find(v) != restricted_nodes.end()
+    ) {
+        return false;
+    }
+
+    const unsigned out_degree = m_node_based_graph->GetOutDegree(v);
+    if(2 == out_degree && 2 == in_degree[v]) {
+        //two-way road, all four edges have to be present
+        const EdgeIterator to_u = m_node_based_graph->BeginEdges(v);
+        const EdgeIterator to_w = to_u + 1;
+        u = m_node_based_graph->GetTarget(to_u);
+        w = m_node_based_graph->GetTarget(to_w);
+        if(u == w) {
+            return false;
+        }
+        const EdgeIterator from_u = m_node_based_graph->FindEdge(u, v);
+        const EdgeIterator from_w = m_node_based_graph->FindEdge(w, v);
+        if(
+            m_node_based_graph->EndEdges(u) == from_u ||
+            m_node_based_graph->EndEdges(w) == from_w
+        ) {
+            return false;
+        }
+        const EdgeData & data_uv = m_node_based_graph->GetEdgeData(from_u);
+        const EdgeData & data_vw = m_node_based_graph->GetEdgeData(to_w);
+        const EdgeData & data_wv = m_node_based_graph->GetEdgeData(from_w);
+        const EdgeData & data_vu = m_node_based_graph->GetEdgeData(to_u);
+        if(
+            !data_uv.forward || !data_uv.backward ||
+            data_uv.roundabout ||
+            !data_uv.IsCompatibleTo(data_vw) ||
+            !data_wv.IsCompatibleTo(data_vu) ||
+            !data_uv.IsCompatibleTo(data_wv)
+        ) {
+            return false;
+        }
+        //both directions of each edge have to be a pair of edge-based nodes
+        if(
+            1 != std::max(data_uv.edgeBasedNodeID, data_vu.edgeBasedNodeID) -
+                std::min(data_uv.edgeBasedNodeID, data_vu.edgeBasedNodeID) ||
+            1 != std::max(data_vw.edgeBasedNodeID, data_wv.edgeBasedNodeID) -
+                std::min(data_vw.edgeBasedNodeID, data_wv.edgeBasedNodeID)
+        ) {
+            return false;
+        }
+    } else if(1 == out_degree && 1 == in_degree[v]) {
+        //one-way road
+        const EdgeIterator to_w = m_node_based_graph->BeginEdges(v);
+        u = in_neighbor[v];
+        w = m_node_based_graph->GetTarget(to_w);
+        if(u == w) {
+            return false;
+        }
+        const EdgeIterator from_u = m_node_based_graph->FindEdge(u, v);
+        if(m_node_based_graph->EndEdges(u) == from_u) {
+            return false;
+        }
+        const EdgeData & data_uv = m_node_based_graph->GetEdgeData(from_u);
+        const EdgeData & data_vw = m_node_based_graph->GetEdgeData(to_w);
+        if(data_uv.backward || !data_uv.IsCompatibleTo(data_vw)) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    //merging must not create parallel edges
+    return
+        m_node_based_graph->EndEdges(u) == m_node_based_graph->FindEdge(u, w) &&
+        m_node_based_graph->EndEdges(w) == m_node_based_graph->FindEdge(w, u);
+}
+
+//Replaces the edges (u,v) and (v,w) by a single edge (u,w)
+void EdgeBasedGraphFactory::MergeEdges(
+    const NodeID u,
+    const NodeID v,
+    const NodeID w,
+    const unsigned merged_edge_based_node
+) {
+    const EdgeIterator first_edge = m_node_based_graph->FindEdge(u, v);
+    const EdgeIterator second_edge = m_node_based_graph->FindEdge(v, w);
+    EdgeData merged_data = m_node_based_graph->GetEdgeData(first_edge);
+    const EdgeData & second_data = m_node_based_graph->GetEdgeData(second_edge);
+
+    CompressedChain merged_chain;
+    const EdgeData * parts[2] = { &merged_data, &second_data };
+    for(unsigned i = 0; i < 2; ++i) {
+        if(1 == i) {
+            merged_chain.intermediate_nodes.push_back(v);
+        }
+        CompressedChainMap::iterator chain = m_compressed_chains.find(parts[i]->edgeBasedNodeID);
+        if(m_compressed_chains.end() == chain) {
+            merged_chain.segment_weights.push_back(parts[i]->distance);
+            continue;
+        }
+        merged_chain.intermediate_nodes.insert(
+            merged_chain.intermediate_nodes.end(),
+            chain->second.intermediate_nodes.begin(),
+            chain->second.intermediate_nodes.end()
+        );
+        merged_chain.segment_weights.insert(
+            merged_chain.segment_weights.end(),
+            chain->second.segment_weights.begin(),
+            chain->second.segment_weights.end()
+        );
+        m_compressed_chains.erase(chain);
+    }
+    merged_data.distance += second_data.distance;
+    merged_data.edgeBasedNodeID = merged_edge_based_node;
+    m_compressed_chains[merged_edge_based_node] = merged_chain;
+
+    m_node_based_graph->DeleteEdge(v, second_edge);
+    m_node_based_graph->DeleteEdge(u, first_edge);
+    m_node_based_graph->InsertEdge(u, w, merged_data);
+}
+
+//Closes the gaps that merged edges left in the edge-based node ids
+void EdgeBasedGraphFactory::RenumberEdgeBasedNodes() {
+    const unsigned number_of_nodes = m_node_based_graph->GetNumberOfNodes();
+    std::vector<unsigned> used_ids;
+    used_ids.reserve(m_node_based_graph->GetNumberOfEdges());
+    for(NodeIterator u = 0; u < number_of_nodes; ++u) {
+        for(
+            EdgeIterator e = m_node_based_graph->BeginEdges(u),
+                last_edge = m_node_based_graph->EndEdges(u);
+            e < last_edge;
+            ++e
+        ) {
+            used_ids.push_back(m_node_based_graph->GetEdgeData(e).edgeBasedNodeID);
+        }
+    }
+    std::sort(used_ids.begin(), used_ids.end());
+    for(NodeIterator u = 0; u < number_of_nodes; ++u) {
+        for(
+            EdgeIterator e = m_node_based_graph->BeginEdges(u),
+                last_edge = m_node_based_graph->EndEdges(u);
+            e < last_edge;
+            ++e
+        ) {
+            unsigned & id = m_node_based_graph->GetEdgeData(e).edgeBasedNodeID;
+            id = std::lower_bound(used_ids.begin(), used_ids.end(), id) - used_ids.begin();
+        }
+    }
+    CompressedChainMap renumbered_chains;
+    BOOST_FOREACH(CompressedChainMap::value_type & chain, m_compressed_chains) {
+        const unsigned id = std::lower_bound(used_ids.begin(), used_ids.end(), chain.first) - used_ids.begin();
+        renumbered_chains[id].intermediate_nodes.swap(chain.second.intermediate_nodes);
+        renumbered_chains[id].segment_weights.swap(chain.second.segment_weights);
+    }
+    m_compressed_chains.swap(renumbered_chains);
+}
+
+void EdgeBasedGraphFactory::WriteCompressedGeometry(const char * geometry_filename) const {
+    const unsigned number_of_nodes = m_node_based_graph->GetNumberOfNodes();
+    std::vector<std::pair<NodeID, NodeID> > end_nodes(GetNumberOfNodes(), std::make_pair(UINT_MAX, UINT_MAX));
+    for(NodeIterator u = 0; u < number_of_nodes; ++u) {
+        for(
+            EdgeIterator e = m_node_based_graph->BeginEdges(u),
+                last_edge = m_node_based_graph->EndEdges(u);
+            e < last_edge;
+            ++e
+        ) {
+            end_nodes[m_node_based_graph->GetEdgeData(e).edgeBasedNodeID] =
+                std::make_pair(u, m_node_based_graph->GetTarget(e));
+        }
+    }
+    CompressedGeometry geometry;
+    std::vector<NodeID> geometry_nodes;
+    for(unsigned edge_based_node = 0; edge_based_node < end_nodes.size(); ++edge_based_node) {
+        geometry_nodes.clear();
+        const CompressedChainMap::const_iterator chain = m_compressed_chains.find(edge_based_node);
+        if(m_compressed_chains.end() != chain) {
+            geometry_nodes.push_back(end_nodes[edge_based_node].first);
+            geometry_nodes.insert(
+                geometry_nodes.end(),
+                chain->second.intermediate_nodes.begin(),
+                chain->second.intermediate_nodes.end()
+            );
+            geometry_nodes.push_back(end_nodes[edge_based_node].second);
+        }
+        geometry.Append(geometry_nodes);
+    }
+    geometry.Write(geometry_filename);
+    SimpleLogger().Write() << "wrote geometry of " << m_compressed_chains.size() << " compressed edge-based nodes";
+}
+
+//Turns are measured at the nodes next to the intersection, even if these
+//were merged into the edges
+double EdgeBasedGraphFactory::GetTurnAngle(
+    const NodeID u,
+    const NodeID v,
+    const NodeID w
+) const {
+    NodeID before = u;
+    NodeID after = w;
+    if(!m_compressed_chains.empty()) {
+        const CompressedChainMap::const_iterator incoming = m_compressed_chains.find(
+            m_node_based_graph->GetEdgeData(m_node_based_graph->FindEdge(u, v)).edgeBasedNodeID
+        );
+        if(m_compressed_chains.end() != incoming) {
+            before = incoming->second.intermediate_nodes.back();
+        }
+        const CompressedChainMap::const_iterator outgoing = m_compressed_chains.find(
+            m_node_based_graph->GetEdgeData(m_node_based_graph->FindEdge(v, w)).edgeBasedNodeID
+        );
+        if(m_compressed_chains.end() != outgoing) {
+            after = outgoing->second.intermediate_nodes.front();
+        }
+    }
+    return GetAngleBetweenThreeFixedPointCoordinates (
+        m_node_info_list[before],
+        m_node_info_list[v],
+        m_node_info_list[after]
+    );
+}
+
+/*
+ * Labels the components of the node-based graph with a union-find over all
+ * edges that do not leave a barrier. Barrier nodes end the search, so each
+ * is counted in the component of the smallest node that reaches it, or on
+ * its own if it is smaller than that. Components are identified by their
+ * smallest node and sizes include the nodes removed by CompressGeometry.
+ */
+void EdgeBasedGraphFactory::IdentifyComponents(
+    std::vector<NodeID> & component_index_list,
+    std::vector<unsigned> & component_size_list
+) const {
+    SimpleLogger().Write() << "Identifying components of the road network";
+    const int number_of_nodes = m_node_based_graph->GetNumberOfNodes();
+    ConcurrentUnionFind components(number_of_nodes);
+
+#pragma omp parallel for schedule(guided)
+    for(int v = 0; v < number_of_nodes; ++v) {
+        if(m_barrier_nodes.find(v) != m_barrier_nodes.end()) {
+            continue;
+        }
+        for(
+            EdgeIterator e = m_node_based_graph->BeginEdges(v),
+                last_edge = m_node_based_graph->EndEdges(v);
+            e < last_edge;
+            ++e
+        ) {
+            const NodeIterator w = m_node_based_graph->GetTarget(e);
+            if(m_barrier_nodes.find(w) == m_barrier_nodes.end()) {
+                components.Union(v, w);
+            }
+        }
+    }
+
+    //all unions are done, barrier nodes may be attached now
+#pragma omp parallel for schedule(guided)
+    for(int v = 0; v < number_of_nodes; ++v) {
+        if(m_barrier_nodes.find(v) != m_barrier_nodes.end()) {
+            continue;
+        }
+        for(
+            EdgeIterator e = m_node_based_graph->BeginEdges(v),
+                last_edge = m_node_based_graph->EndEdges(v);
+            e < last_edge;
+            ++e
+        ) {
+            const NodeIterator w = m_node_based_graph->GetTarget(e);
+            if(m_barrier_nodes.find(w) != m_barrier_nodes.end()) {
+                components.AttachToSmallest(w, components.Find(v));
+            }
+        }
+    }
+
+    component_index_list.resize(number_of_nodes);
+    component_size_list.resize(number_of_nodes, 0);
+    unsigned number_of_components = 0;
+#pragma omp parallel for schedule(guided) reduction(+:number_of_components)
+    for(int v = 0; v < number_of_nodes; ++v) {
+        const NodeID root = components.Find(v);
+        component_index_list[v] = root;
+        const unsigned size = 1 + (m_compressed_node_count.empty() ? 0 : m_compressed_node_count[v]);
+        #pragma omp atomic
+        component_size_list[root] += size;
+        if(NodeID(v) == root) {
+            ++number_of_components;
+        }
+    }
+    SimpleLogger().Write() <<
+        "identified: " << number_of_components << " many components";
+}
+
+//Adds the penalties of a batch of turns and appends them to the edge list
+void EdgeBasedGraphFactory::AppendPendingTurns(std::vector<PendingTurn> & pending_turns) {
+    std::vector<double> turn_angles(pending_turns.size());
+    for(unsigned i = 0; i < pending_turns.size(); ++i) {
+        turn_angles[i] = pending_turns[i].turn_angle;
+    }
+    std::vector<int> penalties;
+    m_turn_penalty_evaluator->GetPenalties(turn_angles, penalties);
+    for(unsigned i = 0; i < pending_turns.size(); ++i) {
+        const unsigned penalty = penalties[i];
+        m_edge_based_edge_list.push_back(
+            EdgeBasedEdge(
+                pending_turns[i].source,
+                pending_turns[i].target,
+                m_edge_based_edge_list.size(),
+                pending_turns[i].distance + penalty,
+                true,
+                false
+            )
+        );
+    }
+    pending_turns.clear();
 }
 
 void EdgeBasedGraphFactory::Run(
     const char * original_edge_data_filename,
     lua_State *lua_state
 ) {
-    SimpleLogger().Write() << "Identifying components of the road network";
-
-    Percent p(m_node_based_graph->GetNumberOfNodes());
     unsigned skipped_turns_counter   = 0;
     unsigned node_based_edge_counter = 0;
     unsigned original_edges_counter  = 0;
@@ -214,127 +565,31 @@ void EdgeBasedGraphFactory::Run(
         sizeof(unsigned)
     );
 
-    unsigned current_component = 0, current_component_size = 0;
-    //Run a BFS on the undirected graph and identify small components
-    std::queue<std::pair<NodeID, NodeID> > bfs_queue;
-    std::vector<unsigned> component_index_list(
-        m_node_based_graph->GetNumberOfNodes(),
-        UINT_MAX
+    //components are only needed for the edge-based nodes, label them in
+    //the background while the turns are expanded
+    std::vector<NodeID> component_index_list;
+    std::vector<unsigned> component_size_list;
+    boost::thread component_thread(
+        boost::bind(
+            &EdgeBasedGraphFactory::IdentifyComponents,
+            this,
+            boost::ref(component_index_list),
+            boost::ref(component_size_list)
+        )
     );
 
-    std::vector<NodeID> component_size_list;
-    //put unexplorered node with parent pointer into queue
-    for(
-        NodeID node = 0,
-            last_node = m_node_based_graph->GetNumberOfNodes();
-        node < last_node;
-        ++node
-    ) {
-        if(UINT_MAX == component_index_list[node]) {
-            bfs_queue.push(std::make_pair(node, node));
-            //mark node as read
-            component_index_list[node] = current_component;
-            p.printIncrement();
-            while(!bfs_queue.empty()) {
-                //fetch element from BFS queue
-                std::pair<NodeID, NodeID> current_queue_item = bfs_queue.front();
-                bfs_queue.pop();
-                // SimpleLogger().Write() << "sizeof queue: " << bfs_queue.size() <<
-                //  ", current_component_sizes: " <<  current_component_size <<
-                //", settled nodes: " << settledNodes++ << ", max: " << endNodes;
-                const NodeID v = current_queue_item.first;  //current node
-                const NodeID u = current_queue_item.second; //parent
-                //increment size counter of current component
-                ++current_component_size;
-                const bool is_barrier_node = (m_barrier_nodes.find(v) != m_barrier_nodes.end());
-                if(!is_barrier_node) {
-                    const NodeID to_node_of_only_restriction = CheckForEmanatingIsOnlyTurn(u, v);
-
-                    //relaxieren edge outgoing edge like below where edge-expanded graph
-                    for(
-                        EdgeIterator e2 = m_node_based_graph->BeginEdges(v);
-                        e2 < m_node_based_graph->EndEdges(v);
-                        ++e2
-                    ) {
-                        NodeIterator w = m_node_based_graph->GetTarget(e2);
-
-                        if(
-                            to_node_of_only_restriction != UINT_MAX &&
-                            w != to_node_of_only_restriction
-                        ) {
-                            //We are at an only_-restriction but not at the right turn.
-                            continue;
-                        }
-                        if( u != w ) {
-                            //only add an edge if turn is not a U-turn except
-                            //when it is at the end of a dead-end street.
-                            if (!CheckIfTurnIsRestricted(u, v, w) ) {
-                                //only add an edge if turn is not prohibited
-                                if(UINT_MAX == component_index_list[w]) {
-                                    //insert next (node, parent) only if w has
-                                    //not yet been explored
-                                    //mark node as read
-                                    component_index_list[w] = current_component;
-                                    bfs_queue.push(std::make_pair(w,v));
-                                    p.printIncrement();
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-            //push size into vector
-            component_size_list.push_back(current_component_size);
-            //reset counters;
-            current_component_size = 0;
-            ++current_component;
-        }
-    }
-    SimpleLogger().Write() <<
-        "identified: " << component_size_list.size() << " many components";
-
-    p.reinit(m_node_based_graph->GetNumberOfNodes());
-    //loop over all edges and generate new set of nodes.
-    for(
-        NodeIterator u = 0,
-            number_of_nodes = m_node_based_graph->GetNumberOfNodes();
-        u < number_of_nodes;
-        ++u
-     ) {
-        for(
-            EdgeIterator e1 = m_node_based_graph->BeginEdges(u),
-                last_edge = m_node_based_graph->EndEdges(u);
-            e1 < last_edge;
-            ++e1
-        ) {
-            NodeIterator v = m_node_based_graph->GetTarget(e1);
-
-            if(m_node_based_graph->GetEdgeData(e1).type != SHRT_MAX) {
-                BOOST_ASSERT_MSG(e1 != UINT_MAX, "edge id invalid");
-                BOOST_ASSERT_MSG(u != UINT_MAX,  "souce node invalid");
-                BOOST_ASSERT_MSG(v != UINT_MAX,  "target node invalid");
-            //Note: edges that end on barrier nodes or on a turn restriction
-            //may actually be in two distinct components. We choose the smallest
-                const unsigned size_of_component = std::min(
-                    component_size_list[component_index_list[u]],
-                    component_size_list[component_index_list[v]]
-                );
-
-                InsertEdgeBasedNode( e1, u, v, size_of_component < 1000 );
-            }
-        }
+    if(speed_profile.has_turn_penalty_function) {
+        m_turn_penalty_evaluator.reset(
+            new TurnPenaltyEvaluator(lua_state, speed_profile.turn_penalty_evaluation)
+        );
     }
-
-    std::vector<NodeID>().swap(component_size_list);
-    BOOST_ASSERT_MSG(
-        0 == component_size_list.capacity(),
-        "component size vector not deallocated"
-    );
-    std::vector<NodeID>().swap(component_index_list);
-    BOOST_ASSERT_MSG(
-        0 == component_index_list.capacity(),
-        "component index vector not deallocated"
+    const bool batch_turn_penalties = (
+        m_turn_penalty_evaluator &&
+        TurnPenaltyEvaluator::BATCH == m_turn_penalty_evaluator->GetMode()
     );
+    std::vector<PendingTurn> pending_turns;
+
+    Percent p(m_node_based_graph->GetNumberOfNodes());
     std::vector<OriginalEdgeData> original_edge_data_vector;
     original_edge_data_vector.reserve(10000);
 
@@ -397,8 +652,10 @@ void EdgeBasedGraphFactory::Run(
                         if(m_traffic_lights.find(v) != m_traffic_lights.end()) {
                             distance += speed_profile.trafficSignalPenalty;
                         }
-                        const unsigned penalty =
-                            GetTurnPenalty(u, v, w, lua_state);
+                        //batched penalties are added once the batch is full
+                        const unsigned penalty = (
+                            batch_turn_penalties ? 0 : GetTurnPenalty(u, v, w, lua_state)
+                        );
                         TurnInstruction turnInstruction = AnalyzeTurn(u, v, w);
                         if(turnInstruction == TurnInstructions.UTurn){
                             distance += speed_profile.uTurnPenalty;
@@ -423,6 +680,21 @@ void EdgeBasedGraphFactory::Run(
                             original_edge_data_vector.clear();
                         }
 
+                        if(batch_turn_penalties) {
+                            pending_turns.push_back(
+                                PendingTurn(
+                                    edge_data1.edgeBasedNodeID,
+                                    edge_data2.edgeBasedNodeID,
+                                    distance,
+                                    180.-GetTurnAngle(u, v, w)
+                                )
+                            );
+                            if(pending_turns.size() >= TURN_PENALTY_BATCH_SIZE) {
+                                AppendPendingTurns(pending_turns);
+                            }
+                            continue;
+                        }
+
                         m_edge_based_edge_list.push_back(
                             EdgeBasedEdge(
                                 edge_data1.edgeBasedNodeID,
@@ -441,6 +713,9 @@ void EdgeBasedGraphFactory::Run(
         }
         p.printIncrement();
     }
+    if(batch_turn_penalties) {
+        AppendPendingTurns(pending_turns);
+    }
     edge_data_file.write(
         (char*)&(original_edge_data_vector[0]),
         original_edge_data_vector.size()*sizeof(OriginalEdgeData)
@@ -452,6 +727,51 @@ void EdgeBasedGraphFactory::Run(
     );
     edge_data_file.close();
 
+    component_thread.join();
+
+    p.reinit(m_node_based_graph->GetNumberOfNodes());
+    //loop over all edges and generate new set of nodes.
+    for(
+        NodeIterator u = 0,
+            number_of_nodes = m_node_based_graph->GetNumberOfNodes();
+        u < number_of_nodes;
+        ++u
+     ) {
+        for(
+            EdgeIterator e1 = m_node_based_graph->BeginEdges(u),
+                last_edge = m_node_based_graph->EndEdges(u);
+            e1 < last_edge;
+            ++e1
+        ) {
+            NodeIterator v = m_node_based_graph->GetTarget(e1);
+
+            if(m_node_based_graph->GetEdgeData(e1).type != SHRT_MAX) {
+                BOOST_ASSERT_MSG(e1 != UINT_MAX, "edge id invalid");
+                BOOST_ASSERT_MSG(u != UINT_MAX,  "souce node invalid");
+                BOOST_ASSERT_MSG(v != UINT_MAX,  "target node invalid");
+            //Note: edges that end on barrier nodes or on a turn restriction
+            //may actually be in two distinct components. We choose the smallest
+                const unsigned size_of_component = std::min(
+                    component_size_list[component_index_list[u]],
+                    component_size_list[component_index_list[v]]
+                );
+
+                InsertEdgeBasedNode( e1, u, v, size_of_component < 1000 );
+            }
+        }
+    }
+
+    std::vector<unsigned>().swap(component_size_list);
+    BOOST_ASSERT_MSG(
+        0 == component_size_list.capacity(),
+        "component size vector not deallocated"
+    );
+    std::vector<NodeID>().swap(component_index_list);
+    BOOST_ASSERT_MSG(
+        0 == component_index_list.capacity(),
+        "component index vector not deallocated"
+    );
+
     SimpleLogger().Write() <<
         "Generated " << m_edge_based_node_list.size() << " edge based nodes";
     SimpleLogger().Write() <<
@@ -462,7 +782,7 @@ void EdgeBasedGraphFactory::Run(
         "  contains " << m_edge_based_edge_list.size() << " edges";
     SimpleLogger().Write() <<
         "  skips "  << skipped_turns_counter << " turns, "
-        "defined by " << m_turn_restrictions_count << " restrictions";
+        "defined by " << m_restriction_index.GetNumberOfRestrictions() << " restrictions";
 }
 
 int EdgeBasedGraphFactory::GetTurnPenalty(
@@ -471,23 +791,9 @@ int EdgeBasedGraphFactory::GetTurnPenalty(
     const NodeID w,
     lua_State *lua_state
 ) const {
-    const double angle = GetAngleBetweenThreeFixedPointCoordinates (
-        m_node_info_list[u],
-        m_node_info_list[v],
-        m_node_info_list[w]
-    );
-
-    if( speed_profile.has_turn_penalty_function ) {
-        try {
-            //call lua profile to compute turn penalty
-            return luabind::call_function<int>(
-                lua_state,
-                "turn_function",
-                180.-angle
-            );
-        } catch (const luabind::error &er) {
-            SimpleLogger().Write(logWARNING) << er.what();
-        }
+    if( m_turn_penalty_evaluator ) {
+        const double angle = GetTurnAngle(u, v, w);
+        return m_turn_penalty_evaluator->GetPenalty(180.-angle);
     }
     return 0;
 }
@@ -547,11 +853,7 @@ TurnInstruction EdgeBasedGraphFactory::AnalyzeTurn(
         }
     }
 
-    const double angle = GetAngleBetweenThreeFixedPointCoordinates (
-        m_node_info_list[u],
-        m_node_info_list[v],
-        m_node_info_list[w]
-    );
+    const double angle = GetTurnAngle(u, v, w);
 
     return TurnInstructions.GetTurnDirectionOfInstruction(angle);
 }
@@ -559,3 +861,115 @@ TurnInstruction EdgeBasedGraphFactory::AnalyzeTurn(
 unsigned EdgeBasedGraphFactory::GetNumberOfNodes() const {
     return m_node_based_graph->GetNumberOfEdges();
 }
+
+/*
+ * Reads weekly travel time profiles of road segments and writes them by
+ * edge-based node. The source is a text file with one record per line:
+ *   profile,<factor monday 00:00>,...,<factor sunday 23:00>
+ *   segment,<OSM node id from>,<OSM node id to>,<profile index>
+ * Factors are in percent of the free flow travel time, profiles are
+ * numbered in the order they appear. Lines starting with # are ignored.
+ */
+void EdgeBasedGraphFactory::WriteTravelTimeProfiles(
+    const char * profile_source_filename,
+    const char * profile_output_filename
+) const {
+    std::ifstream profile_source(profile_source_filename);
+    if(!profile_source) {
+        throw OSRMException("cannot open travel time profile source");
+    }
+    boost::unordered_map<NodeID, NodeID> external_to_internal_node;
+    for(NodeID node = 0; node < m_node_info_list.size(); ++node) {
+        external_to_internal_node[m_node_info_list[node].id] = node;
+    }
+
+    //segments merged into compressed edges are not in the graph anymore
+    boost::unordered_map<std::pair<NodeID, NodeID>, unsigned> compressed_segments;
+    for(NodeIterator u = 0; u < m_node_based_graph->GetNumberOfNodes() && !m_compressed_chains.empty(); ++u) {
+        for(
+            EdgeIterator e = m_node_based_graph->BeginEdges(u),
+                last_edge = m_node_based_graph->EndEdges(u);
+            e < last_edge;
+            ++e
+        ) {
+            const EdgeData & data = m_node_based_graph->GetEdgeData(e);
+            const CompressedChainMap::const_iterator chain = m_compressed_chains.find(data.edgeBasedNodeID);
+            if(m_compressed_chains.end() == chain) {
+                continue;
+            }
+            NodeID segment_start = u;
+            BOOST_FOREACH(const NodeID segment_end, chain->second.intermediate_nodes) {
+                compressed_segments[std::make_pair(segment_start, segment_end)] = data.edgeBasedNodeID;
+                segment_start = segment_end;
+            }
+            compressed_segments[std::make_pair(segment_start, m_node_based_graph->GetTarget(e))] = data.edgeBasedNodeID;
+        }
+    }
+
+    TravelTimeProfiles profiles;
+    profiles.SetNumberOfNodes(GetNumberOfNodes());
+    unsigned assigned_segments = 0;
+    unsigned skipped_lines = 0;
+    std::string line;
+    std::vector<std::string> tokens;
+    while(std::getline(profile_source, line)) {
+        if(line.empty() || '#' == line[0]) {
+            continue;
+        }
+        stringSplit(line, ',', tokens);
+        if("profile" == tokens[0] && 1+TRAVEL_TIME_PROFILE_SAMPLES == tokens.size()) {
+            std::vector<unsigned short> factors(TRAVEL_TIME_PROFILE_SAMPLES);
+            for(unsigned i = 0; i < TRAVEL_TIME_PROFILE_SAMPLES; ++i) {
+                factors[i] = std::min(std::max(stringToInt(tokens[i+1]), 1), USHRT_MAX-1);
+            }
+            if(TRAVEL_TIME_NO_PROFILE-1 <= profiles.GetNumberOfProfiles()) {
+                throw OSRMException("too many travel time profiles");
+            }
+            profiles.AddProfile(factors);
+            continue;
+        }
+        if("segment" != tokens[0] || 4 != tokens.size()) {
+            ++skipped_lines;
+            continue;
+        }
+        const boost::unordered_map<NodeID, NodeID>::const_iterator from =
+            external_to_internal_node.find((NodeID)stringToInt64(tokens[1]));
+        const boost::unordered_map<NodeID, NodeID>::const_iterator to =
+            external_to_internal_node.find((NodeID)stringToInt64(tokens[2]));
+        const unsigned profile = stringToInt(tokens[3]);
+        if(
+            external_to_internal_node.end() == from ||
+            external_to_internal_node.end() == to ||
+            profile >= profiles.GetNumberOfProfiles()
+        ) {
+            ++skipped_lines;
+            continue;
+        }
+        //a compressed edge takes the profile of the last of its segments given
+        const boost::unordered_map<std::pair<NodeID, NodeID>, unsigned>::const_iterator compressed_segment =
+            compressed_segments.find(std::make_pair(from->second, to->second));
+        if(compressed_segments.end() != compressed_segment) {
+            profiles.AssignProfile(compressed_segment->second, profile);
+            ++assigned_segments;
+            continue;
+        }
+        const EdgeIterator edge = m_node_based_graph->FindEdge(from->second, to->second);
+        if(
+            m_node_based_graph->EndEdges(from->second) == edge ||
+            !m_node_based_graph->GetEdgeData(edge).forward
+        ) {
+            ++skipped_lines;
+            continue;
+        }
+        profiles.AssignProfile(m_node_based_graph->GetEdgeData(edge).edgeBasedNodeID, profile);
+        ++assigned_segments;
+    }
+    if(0 < skipped_lines) {
+        SimpleLogger().Write(logWARNING) <<
+            skipped_lines << " travel time profile lines were malformed or did not match the road network";
+    }
+    SimpleLogger().Write() <<
+        "assigned " << profiles.GetNumberOfProfiles() << " travel time profiles to " <<
+        assigned_segments << " segments";
+    profiles.Write(profile_output_filename);
+}
@@ -26,25 +26,36 @@
 #include "../typedefs.h"
 #include "../DataStructures/DeallocatingVector.h"
 #include "../DataStructures/DynamicGraph.h"
+#include "../DataStructures/CompressedGeometry.h"
+#include "../DataStructures/ConcurrentUnionFind.h"
 #include "../Extractor/ExtractorStructs.h"
 #include "../DataStructures/HashTable.h"
 #include "../DataStructures/ImportEdge.h"
 #include "../DataStructures/QueryEdge.h"
 #include "../DataStructures/Percent.h"
+#include "../DataStructures/RestrictionIndex.h"
+#include "../DataStructures/TravelTimeProfiles.h"
 #include "../DataStructures/TurnInstructions.h"
+#include "TurnPenaltyEvaluator.h"
 #include "../Util/LuaUtil.h"
+#include "../Util/OSRMException.h"
 #include "../Util/SimpleLogger.h"
+#include "../Util/StringUtil.h"
 
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/ref.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
 #include <boost/unordered_map.hpp>
 #include <boost/unordered_set.hpp>
 
 #include <algorithm>
 #include <fstream>
-#include <queue>
+#include <string>
 #include <vector>
 
 class EdgeBasedGraphFactory : boost::noncopyable {
@@ -59,7 +70,9 @@ public:
             belongsToTinyComponent(false),
             nameID(UINT_MAX),
             weight(UINT_MAX >> 1),
-            ignoreInGrid(false)
+            ignoreInGrid(false),
+            offset(0),
+            segmentPosition(0)
         { }
 
         bool operator<(const EdgeBasedNode & other) const {
@@ -90,20 +103,26 @@ public:
         int lon2:31;
         bool belongsToTinyComponent:1;
         NodeID nameID;
+        //weight of this segment, compressed nodes consist of several
         unsigned weight:31;
         bool ignoreInGrid:1;
+        //weight of the segments before this one in direction of travel
+        unsigned offset;
+        unsigned segmentPosition;
     };
 
     struct SpeedProfileProperties{
         SpeedProfileProperties() :
             trafficSignalPenalty(0),
             uTurnPenalty(0),
-            has_turn_penalty_function(false)
+            has_turn_penalty_function(false),
+            turn_penalty_evaluation(TurnPenaltyEvaluator::PER_TURN)
         { }
 
         int trafficSignalPenalty;
         int uTurnPenalty;
         bool has_turn_penalty_function;
+        TurnPenaltyEvaluator::Mode turn_penalty_evaluation;
     } speed_profile;
 
     explicit EdgeBasedGraphFactory(
@@ -116,10 +135,16 @@ public:
         SpeedProfileProperties speed_profile
     );
 
+    void CompressGeometry();
     void Run(const char * originalEdgeDataFilename, lua_State *myLuaState);
     void GetEdgeBasedEdges( DeallocatingVector< EdgeBasedEdge >& edges );
     void GetEdgeBasedNodes( std::vector< EdgeBasedNode> & nodes);
     void GetOriginalEdgeData( std::vector<OriginalEdgeData> & originalEdgeData);
+    void WriteCompressedGeometry(const char * geometry_filename) const;
+    void WriteTravelTimeProfiles(
+        const char * profile_source_filename,
+        const char * profile_output_filename
+    ) const;
     TurnInstruction AnalyzeTurn(
         const NodeID u,
         const NodeID v,
@@ -147,6 +172,18 @@ private:
         bool roundabout:1;
         bool ignoreInGrid:1;
         bool contraFlow:1;
+
+        //Edges that may be merged into one when they meet at a node
+        bool IsCompatibleTo(const NodeBasedEdgeData & other) const {
+            return (nameID == other.nameID) &&
+                (type == other.type) &&
+                (isAccessRestricted == other.isAccessRestricted) &&
+                (forward == other.forward) &&
+                (backward == other.backward) &&
+                (roundabout == other.roundabout) &&
+                (ignoreInGrid == other.ignoreInGrid) &&
+                (contraFlow == other.contraFlow);
+        }
     };
 
     struct _EdgeBasedEdgeData {
@@ -158,20 +195,31 @@ private:
         TurnInstruction turnInstruction;
     };
 
-    unsigned m_turn_restrictions_count;
+    //Turn whose penalty is still to be computed by a batched profile call
+    struct PendingTurn {
+        PendingTurn(const NodeID source, const NodeID target, const unsigned distance, const double turn_angle) :
+            source(source), target(target), distance(distance), turn_angle(turn_angle)
+        { }
+        NodeID source;
+        NodeID target;
+        unsigned distance;
+        double turn_angle;
+    };
+
+    //Nodes and segment weights of a chain of merged node-based edges
+    struct CompressedChain {
+        std::vector<NodeID> intermediate_nodes;
+        std::vector<int> segment_weights;
+    };
 
     typedef DynamicGraph<NodeBasedEdgeData>     NodeBasedDynamicGraph;
     typedef NodeBasedDynamicGraph::InputEdge    NodeBasedEdge;
     typedef NodeBasedDynamicGraph::NodeIterator NodeIterator;
     typedef NodeBasedDynamicGraph::EdgeIterator EdgeIterator;
     typedef NodeBasedDynamicGraph::EdgeData     EdgeData;
-    typedef std::pair<NodeID, NodeID>           RestrictionSource;
-    typedef std::pair<NodeID, bool>             RestrictionTarget;
-    typedef std::vector<RestrictionTarget>      EmanatingRestrictionsVector;
-    typedef boost::unordered_map<RestrictionSource, unsigned > RestrictionMap;
+    typedef boost::unordered_map<unsigned, CompressedChain> CompressedChainMap;
 
     std::vector<NodeInfo>                       m_node_info_list;
-    std::vector<EmanatingRestrictionsVector>    m_restriction_bucket_list;
     std::vector<EdgeBasedNode>                  m_edge_based_node_list;
     DeallocatingVector<EdgeBasedEdge>           m_edge_based_edge_list;
 
@@ -179,20 +227,58 @@ private:
     boost::unordered_set<NodeID>                m_barrier_nodes;
     boost::unordered_set<NodeID>                m_traffic_lights;
 
-    RestrictionMap                              m_restriction_map;
+    RestrictionIndex                            m_restriction_index;
 
+    //keyed by the edge-based node id of the merged edge
+    CompressedChainMap                          m_compressed_chains;
+    //removed nodes still count towards the size of their component
+    std::vector<unsigned>                       m_compressed_node_count;
+
+    //set up by Run() if the profile has a turn_function
+    boost::scoped_ptr<TurnPenaltyEvaluator>     m_turn_penalty_evaluator;
 
     NodeID CheckForEmanatingIsOnlyTurn(
         const NodeID u,
         const NodeID v
     ) const;
 
+    void AppendPendingTurns(std::vector<PendingTurn> & pending_turns);
+
+    void IdentifyComponents(
+        std::vector<NodeID> & component_index_list,
+        std::vector<unsigned> & component_size_list
+    ) const;
+
     bool CheckIfTurnIsRestricted(
         const NodeID u,
         const NodeID v,
         const NodeID w
     ) const;
 
+    bool IsCompressible(
+        const NodeID v,
+        const std::vector<unsigned> & in_degree,
+        const std::vector<NodeID> & in_neighbor,
+        const boost::unordered_set<NodeID> & restricted_nodes,
+        NodeID & u,
+        NodeID & w
+    ) const;
+
+    void MergeEdges(
+        const NodeID u,
+        const NodeID v,
+        const NodeID w,
+        const unsigned merged_edge_based_node
+    );
+
+    void RenumberEdgeBasedNodes();
+
+    double GetTurnAngle(
+        const NodeID u,
+        const NodeID v,
+        const NodeID w
+    ) const;
+
     void InsertEdgeBasedNode(
             NodeBasedDynamicGraph::EdgeIterator e1,
             NodeBasedDynamicGraph::NodeIterator u,
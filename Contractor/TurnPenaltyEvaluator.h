@@ -0,0 +1,189 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef TURNPENALTYEVALUATOR_H_
+#define TURNPENALTYEVALUATOR_H_
+
+#include "../Util/LuaUtil.h"
+#include "../Util/SimpleLogger.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+//Samples per degree of the turn penalty table
+static const unsigned TURN_PENALTY_TABLE_RESOLUTION = 10;
+//Number of turns handed to the profile in one batched call
+static const unsigned TURN_PENALTY_BATCH_SIZE = 65536;
+
+//Applies turn_function to every element of a table of turn angles
+static const char * TURN_FUNCTION_BATCH_CODE =
+    "function osrm_turn_function_batch (angles)\n"
+    "    local penalties = {}\n"
+    "    for i = 1, #angles do\n"
+    "        penalties[i] = turn_function(angles[i])\n"
+    "    end\n"
+    "    return penalties\n"
+    "end\n";
+
+/*
+ * Evaluates turn_function of the profile. A profile chooses how by setting
+ * turn_penalty_evaluation:
+ *  - unset:   one Lua call per turn
+ *  - "batch": many turns per Lua call, same results as one call per turn
+ *  - "table": turn_function is sampled once every 1/10 degree and turns
+ *             are answered from the table, only fit for smooth functions
+ */
+class TurnPenaltyEvaluator : boost::noncopyable {
+public:
+    enum Mode {
+        PER_TURN = 0,
+        BATCH,
+        TABLE
+    };
+
+    static Mode GetModeFromProfile(const std::string & evaluation) {
+        if("batch" == evaluation) {
+            return BATCH;
+        }
+        if("table" == evaluation) {
+            return TABLE;
+        }
+        if(!evaluation.empty()) {
+            SimpleLogger().Write(logWARNING) <<
+                "unknown turn_penalty_evaluation '" << evaluation << "', calling turn_function per turn";
+        }
+        return PER_TURN;
+    }
+
+    TurnPenaltyEvaluator(lua_State * lua_state, const Mode mode) :
+        lua_state(lua_state),
+        mode(mode)
+    {
+        if(PER_TURN == mode) {
+            return;
+        }
+        if(0 != luaL_dostring(lua_state, TURN_FUNCTION_BATCH_CODE)) {
+            SimpleLogger().Write(logWARNING) << lua_tostring(lua_state, -1) <<
+                " occured in scripting block, calling turn_function per turn";
+            lua_pop(lua_state, 1);
+            this->mode = PER_TURN;
+            return;
+        }
+        if(TABLE == mode) {
+            std::vector<double> angles(360*TURN_PENALTY_TABLE_RESOLUTION+1);
+            for(unsigned i = 0; i < angles.size(); ++i) {
+                angles[i] = double(i)/TURN_PENALTY_TABLE_RESOLUTION - 180.;
+            }
+            GetPenalties(angles, penalty_table);
+            SimpleLogger().Write() <<
+                "sampled turn_function at " << penalty_table.size() << " angles";
+        }
+    }
+
+    inline Mode GetMode() const {
+        return mode;
+    }
+
+    //turn_angle is the argument of turn_function, i.e. in [-180,180]
+    inline int GetPenalty(const double turn_angle) const {
+        if(TABLE == mode) {
+            const int index = int(std::floor((turn_angle+180.)*TURN_PENALTY_TABLE_RESOLUTION + 0.5));
+            const int last_index = penalty_table.size()-1;
+            return penalty_table[std::max(0, std::min(index, last_index))];
+        }
+        return CallTurnFunction(turn_angle);
+    }
+
+    //Exact penalties of many turns with a single call into the profile. If
+    //the batch fails, its turns are evaluated one by one, so that an error
+    //only affects the turns it occurs for, just as with one call per turn.
+    void GetPenalties(
+        const std::vector<double> & turn_angles,
+        std::vector<int> & penalties
+    ) const {
+        penalties.assign(turn_angles.size(), 0);
+        lua_getglobal(lua_state, "osrm_turn_function_batch");
+        lua_createtable(lua_state, turn_angles.size(), 0);
+        for(unsigned i = 0; i < turn_angles.size(); ++i) {
+            lua_pushnumber(lua_state, turn_angles[i]);
+            lua_rawseti(lua_state, -2, i+1);
+        }
+        if(0 != lua_pcall(lua_state, 1, 1, 0)) {
+            SimpleLogger().Write(logWARNING) << lua_tostring(lua_state, -1) <<
+                " occured in batched turn_function, evaluating the batch per turn";
+            lua_pop(lua_state, 1);
+            GetPenaltiesPerTurn(turn_angles, penalties);
+            return;
+        }
+        if(!lua_istable(lua_state, -1)) {
+            SimpleLogger().Write(logWARNING) <<
+                "batched turn_function did not return a table, evaluating the batch per turn";
+            lua_pop(lua_state, 1);
+            GetPenaltiesPerTurn(turn_angles, penalties);
+            return;
+        }
+        for(unsigned i = 0; i < turn_angles.size(); ++i) {
+            lua_rawgeti(lua_state, -1, i+1);
+            //same conversion as luabind uses for int results, anything but
+            //a number is left to a single call that reports the error
+            if(lua_isnumber(lua_state, -1)) {
+                penalties[i] = lua_tointeger(lua_state, -1);
+            } else {
+                penalties[i] = CallTurnFunction(turn_angles[i]);
+            }
+            lua_pop(lua_state, 1);
+        }
+        lua_pop(lua_state, 1);
+    }
+
+private:
+    inline int CallTurnFunction(const double turn_angle) const {
+        try {
+            //call lua profile to compute turn penalty
+            return luabind::call_function<int>(
+                lua_state,
+                "turn_function",
+                turn_angle
+            );
+        } catch (const luabind::error &er) {
+            SimpleLogger().Write(logWARNING) << er.what();
+        }
+        return 0;
+    }
+
+    void GetPenaltiesPerTurn(
+        const std::vector<double> & turn_angles,
+        std::vector<int> & penalties
+    ) const {
+        for(unsigned i = 0; i < turn_angles.size(); ++i) {
+            penalties[i] = CallTurnFunction(turn_angles[i]);
+        }
+    }
+
+    lua_State * lua_state;
+    Mode mode;
+    std::vector<int> penalty_table;
+};
+
+#endif /* TURNPENALTYEVALUATOR_H_ */
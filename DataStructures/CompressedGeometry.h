@@ -0,0 +1,122 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+
+#ifndef COMPRESSEDGEOMETRY_H_
+#define COMPRESSEDGEOMETRY_H_
+
+#include "../Util/OSRMException.h"
+#include "../Util/SimpleLogger.h"
+#include "../typedefs.h"
+
+#include <boost/assert.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <string>
+#include <vector>
+
+/*
+ * Node-based nodes of the road segments that were merged into a single
+ * edge-based node because they only continued the road. The geometry of an
+ * edge-based node lists its start node, the merged nodes and its end node in
+ * the direction of travel. Segments that were not compressed have none.
+ *
+ * File layout (all values in host byte order):
+ *   unsigned  number of edge-based nodes
+ *   unsigned  offsets into the geometry nodes, one more than edge-based nodes
+ *   unsigned  number of geometry nodes, followed by the node ids
+ */
+class CompressedGeometry : boost::noncopyable {
+public:
+    CompressedGeometry() : geometry_offsets(1, 0) { }
+
+    explicit CompressedGeometry(const std::string & filename) {
+        boost::filesystem::path geometry_file(filename);
+        if(!boost::filesystem::exists(geometry_file)) {
+            throw OSRMException("geometry file does not exist");
+        }
+        boost::filesystem::ifstream input(geometry_file, std::ios::binary);
+        unsigned number_of_nodes = 0;
+        input.read((char *)&number_of_nodes, sizeof(unsigned));
+        geometry_offsets.resize(number_of_nodes+1);
+        input.read((char *)&geometry_offsets[0], geometry_offsets.size()*sizeof(unsigned));
+        unsigned number_of_geometry_nodes = 0;
+        input.read((char *)&number_of_geometry_nodes, sizeof(unsigned));
+        geometry_nodes.resize(number_of_geometry_nodes);
+        if(!geometry_nodes.empty()) {
+            input.read((char *)&geometry_nodes[0], geometry_nodes.size()*sizeof(NodeID));
+        }
+        if(!input || geometry_offsets.back() != geometry_nodes.size()) {
+            throw OSRMException("geometry file is corrupt");
+        }
+        SimpleLogger().Write() << "loaded " << number_of_geometry_nodes << " geometry nodes for " <<
+            number_of_nodes << " edge-based nodes";
+    }
+
+    void Write(const std::string & filename) const {
+        boost::filesystem::ofstream output(boost::filesystem::path(filename), std::ios::binary);
+        const unsigned number_of_nodes = GetNumberOfNodes();
+        output.write((char *)&number_of_nodes, sizeof(unsigned));
+        output.write((char *)&geometry_offsets[0], geometry_offsets.size()*sizeof(unsigned));
+        const unsigned number_of_geometry_nodes = geometry_nodes.size();
+        output.write((char *)&number_of_geometry_nodes, sizeof(unsigned));
+        if(!geometry_nodes.empty()) {
+            output.write((char *)&geometry_nodes[0], geometry_nodes.size()*sizeof(NodeID));
+        }
+    }
+
+    //Geometries are appended in the order of the edge-based nodes
+    void Append(const std::vector<NodeID> & nodes) {
+        BOOST_ASSERT_MSG(1 != nodes.size(), "geometry without end node");
+        geometry_nodes.insert(geometry_nodes.end(), nodes.begin(), nodes.end());
+        geometry_offsets.push_back(geometry_nodes.size());
+    }
+
+    inline unsigned GetNumberOfNodes() const {
+        return geometry_offsets.size()-1;
+    }
+
+    //Returns false for edge-based nodes that were not compressed
+    inline bool GetGeometry(
+        const NodeID edge_based_node,
+        const NodeID * & begin,
+        const NodeID * & end
+    ) const {
+        if(edge_based_node >= GetNumberOfNodes()) {
+            return false;
+        }
+        const unsigned first = geometry_offsets[edge_based_node];
+        const unsigned last = geometry_offsets[edge_based_node+1];
+        if(first == last) {
+            return false;
+        }
+        begin = &geometry_nodes[0] + first;
+        end = &geometry_nodes[0] + last;
+        return true;
+    }
+
+private:
+    std::vector<unsigned> geometry_offsets;
+    std::vector<NodeID> geometry_nodes;
+};
+
+#endif /* COMPRESSEDGEOMETRY_H_ */
@@ -0,0 +1,96 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef CONCURRENTBITMAP_H_
+#define CONCURRENTBITMAP_H_
+
+#include <boost/noncopyable.hpp>
+
+#include <cstring>
+#include <vector>
+
+//Each page covers 2^16 ids and takes 8 KB
+static const unsigned CONCURRENT_BITMAP_PAGE_SHIFT = 16;
+static const unsigned CONCURRENT_BITMAP_PAGE_SIZE = 1 << CONCURRENT_BITMAP_PAGE_SHIFT;
+static const unsigned CONCURRENT_BITMAP_WORDS_PER_PAGE = CONCURRENT_BITMAP_PAGE_SIZE/32;
+static const unsigned CONCURRENT_BITMAP_NUMBER_OF_PAGES = 1 << (32 - CONCURRENT_BITMAP_PAGE_SHIFT);
+
+/*
+ * Set of 32 bit ids that any number of threads may add to. The id space is
+ * split into pages that are only allocated once an id in their range is
+ * set, so sparse sets stay small and the whole space takes 512 MB at most.
+ * Pages are installed and bits set with atomic operations, no locks needed.
+ * Reading while other threads still write is safe, but may miss their ids.
+ */
+class ConcurrentBitmap : boost::noncopyable {
+public:
+    ConcurrentBitmap() : pages(CONCURRENT_BITMAP_NUMBER_OF_PAGES, (unsigned *)NULL) { }
+
+    ~ConcurrentBitmap() {
+        Clear();
+    }
+
+    inline void Set(const unsigned id) {
+        unsigned * page = GetOrAllocatePage(id >> CONCURRENT_BITMAP_PAGE_SHIFT);
+        unsigned & word = page[(id % CONCURRENT_BITMAP_PAGE_SIZE) >> 5];
+        const unsigned mask = 1u << (id & 31);
+        //ids are set many times, skip the locked write if the bit is there
+        if(0 == (word & mask)) {
+            __sync_fetch_and_or(&word, mask);
+        }
+    }
+
+    inline bool IsSet(const unsigned id) const {
+        const unsigned * page = pages[id >> CONCURRENT_BITMAP_PAGE_SHIFT];
+        if(NULL == page) {
+            return false;
+        }
+        return 0 != (page[(id % CONCURRENT_BITMAP_PAGE_SIZE) >> 5] & (1u << (id & 31)));
+    }
+
+    //Not thread safe
+    void Clear() {
+        for(unsigned i = 0; i < pages.size(); ++i) {
+            delete[] pages[i];
+            pages[i] = NULL;
+        }
+    }
+
+private:
+    unsigned * GetOrAllocatePage(const unsigned page_id) {
+        unsigned * page = pages[page_id];
+        if(NULL != page) {
+            return page;
+        }
+        unsigned * new_page = new unsigned[CONCURRENT_BITMAP_WORDS_PER_PAGE];
+        memset(new_page, 0, CONCURRENT_BITMAP_WORDS_PER_PAGE*sizeof(unsigned));
+        page = __sync_val_compare_and_swap(&pages[page_id], (unsigned *)NULL, new_page);
+        if(NULL != page) {
+            //another thread was faster
+            delete[] new_page;
+            return page;
+        }
+        return new_page;
+    }
+
+    std::vector<unsigned *> pages;
+};
+
+#endif /* CONCURRENTBITMAP_H_ */
@@ -21,63 +21,254 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #ifndef CONCURRENTQUEUE_H_INCLUDED
 #define CONCURRENTQUEUE_H_INCLUDED
 
-#include <boost/bind.hpp>
-#include <boost/circular_buffer.hpp>
-#include <boost/thread/condition.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
 
 #include "../typedefs.h"
 
-template<typename Data>
-class ConcurrentQueue {
+#include <cstddef>
+#include <vector>
 
-    typedef typename boost::circular_buffer<Data>::size_type size_t;
+//Failed attempts to push or pop before a thread goes to sleep
+static const unsigned CONCURRENT_QUEUE_SPIN_ROUNDS = 64;
 
+/*
+ * Bounded multi-producer/multi-consumer queue on a ring buffer without
+ * locks, after Dmitry Vyukov's design. Every cell carries a sequence
+ * number that tells producers and consumers whether it is theirs in the
+ * current round; claiming cells is a single CAS on the enqueue or dequeue
+ * position, also for a whole batch of them. Blocked threads spin for a
+ * while and then sleep on a condition variable, which is only touched if
+ * somebody actually sleeps.
+ *
+ * Besides the number of items the queue may be bounded by memory. Each
+ * item is pushed with a weight, e.g. its size in bytes, and pushing blocks
+ * while the weight of the queued items reaches max_weight. A single item
+ * is always accepted, so the bound may be exceeded by its weight.
+ */
+template<typename Data>
+class ConcurrentQueue : boost::noncopyable {
 public:
-    ConcurrentQueue(const size_t max_size) : internal_queue(max_size) { }
-
-    inline void push(Data const& data) {
-        boost::mutex::scoped_lock lock(m_mutex);
-        m_not_full.wait(lock, boost::bind(&ConcurrentQueue<Data>::is_not_full, this));
-        internal_queue.push_back(data);
-        lock.unlock();
-        m_not_empty.notify_one();
+    //max_size is rounded up to a power of two, 0 == max_weight is unbounded
+    explicit ConcurrentQueue(const size_t max_size, const size_t max_weight = 0) :
+        max_weight(max_weight),
+        queued_weight(0),
+        sleeping_producers(0),
+        sleeping_consumers(0),
+        enqueue_position(0),
+        dequeue_position(0)
+    {
+        size_t capacity = 2;
+        while(capacity < max_size) {
+            capacity *= 2;
+        }
+        cells.resize(capacity);
+        mask = capacity - 1;
+        for(size_t i = 0; i < capacity; ++i) {
+            cells[i].sequence = i;
+        }
     }
 
-    inline bool empty() const {
-        return internal_queue.empty();
+    inline void push(Data const& data, const size_t weight = 0) {
+        push(&data, 1, &weight);
+    }
+
+    //Blocks until all count items are queued, weights may be NULL
+    void push(const Data * data, size_t count, const size_t * weights = NULL) {
+        while(0 < count) {
+            const size_t pushed = try_push(data, count, weights);
+            if(0 == pushed) {
+                Wait(sleeping_producers, not_full, &ConcurrentQueue<Data>::is_not_full);
+                continue;
+            }
+            data += pushed;
+            count -= pushed;
+            if(NULL != weights) {
+                weights += pushed;
+            }
+        }
+    }
+
+    inline bool try_push(Data const& data, const size_t weight = 0) {
+        return 1 == try_push(&data, 1, &weight);
+    }
+
+    //Queues a prefix of the items and returns its length
+    size_t try_push(const Data * data, const size_t count, const size_t * weights = NULL) {
+        size_t position = enqueue_position;
+        size_t claimed = 0;
+        while(0 < count) {
+            if(!is_within_weight()) {
+                return 0;
+            }
+            while(claimed < count && cells[(position + claimed) & mask].sequence == position + claimed) {
+                ++claimed;
+            }
+            if(0 == claimed) {
+                if(static_cast<std::ptrdiff_t>(cells[position & mask].sequence - position) < 0) {
+                    //the consumers are a full round behind
+                    return 0;
+                }
+                position = enqueue_position;
+                continue;
+            }
+            if(__sync_bool_compare_and_swap(&enqueue_position, position, position + claimed)) {
+                break;
+            }
+            position = enqueue_position;
+            claimed = 0;
+        }
+
+        size_t weight = 0;
+        for(size_t i = 0; i < claimed; ++i) {
+            Cell & cell = cells[(position + i) & mask];
+            cell.data = data[i];
+            cell.weight = (NULL == weights ? 0 : weights[i]);
+            weight += cell.weight;
+        }
+        if(0 < weight) {
+            __sync_fetch_and_add(&queued_weight, weight);
+        }
+        //publish the items only after they are written
+        __sync_synchronize();
+        for(size_t i = 0; i < claimed; ++i) {
+            cells[(position + i) & mask].sequence = position + i + 1;
+        }
+        Notify(sleeping_consumers, not_empty);
+        return claimed;
     }
 
     inline void wait_and_pop(Data& popped_value) {
-        boost::mutex::scoped_lock lock(m_mutex);
-        m_not_empty.wait(lock, boost::bind(&ConcurrentQueue<Data>::is_not_empty, this));
-        popped_value=internal_queue.front();
-        internal_queue.pop_front();
-        lock.unlock();
-        m_not_full.notify_one();
+        wait_and_pop(&popped_value, 1);
+    }
+
+    //Blocks until at least one item is there, returns the number popped
+    size_t wait_and_pop(Data * popped_values, const size_t max_count) {
+        while(true) {
+            const size_t popped = try_pop(popped_values, max_count);
+            if(0 < popped) {
+                return popped;
+            }
+            Wait(sleeping_consumers, not_empty, &ConcurrentQueue<Data>::is_not_empty);
+        }
     }
 
     inline bool try_pop(Data& popped_value) {
-        boost::mutex::scoped_lock lock(m_mutex);
-        if(internal_queue.empty()) {
-            return false;
+        return 1 == try_pop(&popped_value, 1);
+    }
+
+    size_t try_pop(Data * popped_values, const size_t max_count) {
+        size_t position = dequeue_position;
+        size_t claimed = 0;
+        while(0 < max_count) {
+            while(claimed < max_count && cells[(position + claimed) & mask].sequence == position + claimed + 1) {
+                ++claimed;
+            }
+            if(0 == claimed) {
+                if(static_cast<std::ptrdiff_t>(cells[position & mask].sequence - (position + 1)) < 0) {
+                    return 0;
+                }
+                position = dequeue_position;
+                continue;
+            }
+            if(__sync_bool_compare_and_swap(&dequeue_position, position, position + claimed)) {
+                break;
+            }
+            position = dequeue_position;
+            claimed = 0;
+        }
+
+        size_t weight = 0;
+        for(size_t i = 0; i < claimed; ++i) {
+            Cell & cell = cells[(position + i) & mask];
+            popped_values[i] = cell.data;
+            //do not keep shared resources alive in the ring
+            cell.data = Data();
+            weight += cell.weight;
+        }
+        if(0 < weight) {
+            __sync_fetch_and_sub(&queued_weight, weight);
+        }
+        __sync_synchronize();
+        for(size_t i = 0; i < claimed; ++i) {
+            cells[(position + i) & mask].sequence = position + i + mask + 1;
         }
-        popped_value=internal_queue.front();
-        internal_queue.pop_front();
-        lock.unlock();
-        m_not_full.notify_one();
-        return true;
+        Notify(sleeping_producers, not_full);
+        return claimed;
+    }
+
+    inline bool empty() const {
+        return !is_not_empty();
     }
 
 private:
-    boost::circular_buffer<Data> internal_queue;
-    boost::mutex m_mutex;
-    boost::condition m_not_empty;
-    boost::condition m_not_full;
+    struct Cell {
+        Cell() : sequence(0), weight(0) { }
+        volatile size_t sequence;
+        Data data;
+        size_t weight;
+    };
+
+    inline bool is_within_weight() const {
+        return 0 == max_weight || queued_weight < max_weight;
+    }
+
+    inline bool is_not_full() const {
+        const size_t position = enqueue_position;
+        return is_within_weight() && cells[position & mask].sequence == position;
+    }
+
+    inline bool is_not_empty() const {
+        const size_t position = dequeue_position;
+        return cells[position & mask].sequence == position + 1;
+    }
+
+    void Wait(
+        volatile int & sleeping_threads,
+        boost::condition_variable & condition,
+        bool (ConcurrentQueue<Data>::*is_ready)() const
+    ) {
+        for(unsigned i = 0; i < CONCURRENT_QUEUE_SPIN_ROUNDS; ++i) {
+            if((this->*is_ready)()) {
+                return;
+            }
+            boost::this_thread::yield();
+        }
+        boost::unique_lock<boost::mutex> lock(wait_mutex);
+        //announce first, then check, so that no notification is missed
+        __sync_fetch_and_add(&sleeping_threads, 1);
+        while(!(this->*is_ready)()) {
+            condition.wait(lock);
+        }
+        __sync_fetch_and_sub(&sleeping_threads, 1);
+    }
+
+    inline void Notify(volatile int & sleeping_threads, boost::condition_variable & condition) {
+        __sync_synchronize();
+        if(0 < sleeping_threads) {
+            boost::lock_guard<boost::mutex> lock(wait_mutex);
+            condition.notify_all();
+        }
+    }
 
-    inline bool is_not_empty() const { return internal_queue.size() > 0; }
-    inline bool is_not_full() const { return internal_queue.size() < internal_queue.capacity(); }
+    std::vector<Cell> cells;
+    size_t mask;
+    const size_t max_weight;
+    volatile size_t queued_weight;
+    volatile int sleeping_producers;
+    volatile int sleeping_consumers;
+    boost::mutex wait_mutex;
+    boost::condition_variable not_full;
+    boost::condition_variable not_empty;
+    //producers and consumers should not share a cache line
+    char padding_before[64];
+    volatile size_t enqueue_position;
+    char padding_between[64];
+    volatile size_t dequeue_position;
+    char padding_after[64];
 };
 
 #endif //#ifndef CONCURRENTQUEUE_H_INCLUDED
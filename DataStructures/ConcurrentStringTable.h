@@ -0,0 +1,92 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef CONCURRENTSTRINGTABLE_H_
+#define CONCURRENTSTRINGTABLE_H_
+
+#include <boost/functional/hash.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <string>
+
+//Independently locked parts of the table
+static const unsigned CONCURRENT_STRING_TABLE_STRIPES = 64;
+
+/*
+ * Interns strings, i.e. hands out consecutive ids for distinct strings,
+ * from any number of threads. The table is split into stripes by hash,
+ * each with a lock of its own, so threads rarely wait for each other.
+ * Ids of strings inserted concurrently depend on timing; who needs them
+ * reproducible looks strings up concurrently and inserts in a fixed order.
+ */
+class ConcurrentStringTable : boost::noncopyable {
+public:
+    ConcurrentStringTable() : number_of_strings(0) { }
+
+    bool Find(const std::string & string, unsigned & id) const {
+        const Stripe & stripe = GetStripe(string);
+        boost::lock_guard<boost::mutex> lock(stripe.mutex);
+        const boost::unordered_map<std::string, unsigned>::const_iterator entry = stripe.ids.find(string);
+        if(stripe.ids.end() == entry) {
+            return false;
+        }
+        id = entry->second;
+        return true;
+    }
+
+    //Id of the string, a new one if the string was not known before
+    unsigned Insert(const std::string & string) {
+        Stripe & stripe = GetStripe(string);
+        boost::lock_guard<boost::mutex> lock(stripe.mutex);
+        const boost::unordered_map<std::string, unsigned>::const_iterator entry = stripe.ids.find(string);
+        if(stripe.ids.end() != entry) {
+            return entry->second;
+        }
+        const unsigned id = __sync_fetch_and_add(&number_of_strings, 1);
+        stripe.ids.insert(std::make_pair(string, id));
+        return id;
+    }
+
+    inline unsigned GetNumberOfStrings() const {
+        return number_of_strings;
+    }
+
+private:
+    struct Stripe {
+        mutable boost::mutex mutex;
+        boost::unordered_map<std::string, unsigned> ids;
+    };
+
+    inline Stripe & GetStripe(const std::string & string) {
+        return stripes[boost::hash<std::string>()(string) % CONCURRENT_STRING_TABLE_STRIPES];
+    }
+
+    inline const Stripe & GetStripe(const std::string & string) const {
+        return stripes[boost::hash<std::string>()(string) % CONCURRENT_STRING_TABLE_STRIPES];
+    }
+
+    Stripe stripes[CONCURRENT_STRING_TABLE_STRIPES];
+    volatile unsigned number_of_strings;
+};
+
+#endif /* CONCURRENTSTRINGTABLE_H_ */
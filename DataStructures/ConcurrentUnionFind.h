@@ -0,0 +1,98 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef CONCURRENTUNIONFIND_H_
+#define CONCURRENTUNIONFIND_H_
+
+#include "../typedefs.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <algorithm>
+#include <vector>
+
+/*
+ * Disjoint sets that may be united from several threads at once without
+ * locks. A root is always linked below a smaller root, so parent pointers
+ * only ever decrease and the representative of each set is its smallest
+ * element, no matter in which order the unions happened.
+ */
+class ConcurrentUnionFind : boost::noncopyable {
+public:
+    explicit ConcurrentUnionFind(const unsigned number_of_elements) :
+        parent(number_of_elements)
+    {
+        for(unsigned i = 0; i < number_of_elements; ++i) {
+            parent[i] = i;
+        }
+    }
+
+    inline NodeID Find(NodeID element) {
+        NodeID current_parent = parent[element];
+        while(current_parent != element) {
+            //path halving, losing the race only means less compression
+            const NodeID grand_parent = parent[current_parent];
+            if(grand_parent != current_parent) {
+                __sync_bool_compare_and_swap(&parent[element], current_parent, grand_parent);
+            }
+            element = current_parent;
+            current_parent = parent[element];
+        }
+        return element;
+    }
+
+    inline void Union(NodeID first, NodeID second) {
+        while(true) {
+            first = Find(first);
+            second = Find(second);
+            if(first == second) {
+                return;
+            }
+            if(first < second) {
+                std::swap(first, second);
+            }
+            //another thread may have linked first in the meantime, retry
+            if(__sync_bool_compare_and_swap(&parent[first], first, second)) {
+                return;
+            }
+        }
+    }
+
+    //Attaches a singleton to the set of root if root is smaller than all
+    //candidates so far. Only valid once no more unions are going on.
+    inline void AttachToSmallest(const NodeID element, const NodeID root) {
+        NodeID current_parent = parent[element];
+        while(root < current_parent) {
+            if(__sync_bool_compare_and_swap(&parent[element], current_parent, root)) {
+                return;
+            }
+            current_parent = parent[element];
+        }
+    }
+
+    inline unsigned GetNumberOfElements() const {
+        return parent.size();
+    }
+
+private:
+    std::vector<NodeID> parent;
+};
+
+#endif /* CONCURRENTUNIONFIND_H_ */
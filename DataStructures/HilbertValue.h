@@ -26,65 +26,160 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include <boost/integer.hpp>
 #include <boost/noncopyable.hpp>
 
-// computes a 64 bit value that corresponds to the hilbert space filling curve
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__GNUC__) && defined(__x86_64__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define HILBERT_CODE_HAS_BMI2
+#include <immintrin.h>
+#endif
+
+// computes a 64 bit value that corresponds to the hilbert space filling curve.
+// Bits of latitude and longitude are mapped to curve positions by a state
+// machine that handles four bits of each coordinate per table lookup. CPUs
+// with BMI2 use a branch-free prefix scan and pdep instead. Both give the
+// same values as the transposition of Skilling's algorithm.
 
 class HilbertCode : boost::noncopyable {
 public:
 	static uint64_t GetHilbertNumberForCoordinate(
 		const FixedPointCoordinate & current_coordinate
 	) {
-		unsigned location[2];
-		location[0] = current_coordinate.lat+( 90*COORDINATE_PRECISION);
-		location[1] = current_coordinate.lon+(180*COORDINATE_PRECISION);
+		return GetEncoder()(ShiftLatitude(current_coordinate), ShiftLongitude(current_coordinate));
+	}
 
-		TransposeCoordinate(location);
-		const uint64_t result = BitInterleaving(location[0], location[1]);
-		return result;
+	//Encodes count coordinates at once, dispatching only once
+	static void GetHilbertNumbersForCoordinates(
+		const FixedPointCoordinate * coordinates,
+		const std::size_t count,
+		uint64_t * result
+	) {
+		const EncoderT encoder = GetEncoder();
+		for(std::size_t i = 0; i < count; ++i) {
+			result[i] = encoder(ShiftLatitude(coordinates[i]), ShiftLongitude(coordinates[i]));
+		}
 	}
+
 private:
-	static inline uint64_t BitInterleaving(const uint32_t a, const uint32_t b) {
-		uint64_t result = 0;
-		for(int8_t index = 31; index >= 0; --index){
-			result |= (a >> index) & 1;
-			result <<= 1;
-			result |= (b >> index) & 1;
-			if(0 != index){
-				result <<= 1;
+	typedef uint64_t (*EncoderT)(const uint32_t, const uint32_t);
+
+	//state of the table-driven encoder, i.e. the orientation of the sub-curve
+	static const unsigned SWAP_AXES = 1;
+	static const unsigned COMPLEMENT_AXES = 2;
+
+	//entry of the table-driven encoder: eight bits of the hilbert value,
+	//followed by the state for the next four bits of each coordinate
+	struct EncodingTable {
+		EncodingTable() {
+			for(unsigned state = 0; state < 4; ++state) {
+				for(unsigned nibbles = 0; nibbles < 256; ++nibbles) {
+					unsigned next_state = state;
+					unsigned value = 0;
+					for(int bit = 3; bit >= 0; --bit) {
+						unsigned x = (nibbles >> (4 + bit)) & 1;
+						unsigned y = (nibbles >> bit) & 1;
+						if(next_state & SWAP_AXES) {
+							std::swap(x, y);
+						}
+						if(next_state & COMPLEMENT_AXES) {
+							x ^= 1;
+							y ^= 1;
+						}
+						value = (value << 2) | ((3*x) ^ y);
+						if(0 == y) {
+							if(1 == x) {
+								next_state ^= COMPLEMENT_AXES;
+							}
+							next_state ^= SWAP_AXES;
+						}
+					}
+					entries[state][nibbles] = value | (next_state << 8);
+				}
 			}
 		}
-		return result;
+		uint16_t entries[4][256];
+	};
+
+	static inline uint32_t ShiftLatitude(const FixedPointCoordinate & coordinate) {
+		return coordinate.lat+( 90*COORDINATE_PRECISION);
 	}
 
-	static inline void TransposeCoordinate( uint32_t * X) {
-		uint32_t M = 1 << (32-1), P, Q, t;
-		int i;
-		// Inverse undo
-		for( Q = M; Q > 1; Q >>= 1 ) {
-			P=Q-1;
-			for( i = 0; i < 2; ++i ) {
-				if( X[i] & Q ) {
-					X[0] ^= P; // invert
-				} else {
-					t = (X[0]^X[i]) & P;
-					X[0] ^= t;
-					X[i] ^= t;
-				}
-			} // exchange
+	static inline uint32_t ShiftLongitude(const FixedPointCoordinate & coordinate) {
+		return coordinate.lon+(180*COORDINATE_PRECISION);
+	}
+
+	static EncoderT GetEncoder() {
+		static const EncoderT encoder = SelectEncoder();
+		return encoder;
+	}
+
+	static EncoderT SelectEncoder() {
+#ifdef HILBERT_CODE_HAS_BMI2
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("bmi2")) {
+			return EncodeWithBMI2;
 		}
-		// Gray encode
-		for( i = 1; i < 2; ++i ) {
-			X[i] ^= X[i-1];
+#endif
+		GetEncodingTable();
+		return EncodeWithTable;
+	}
+
+	static const EncodingTable & GetEncodingTable() {
+		static const EncodingTable table;
+		return table;
+	}
+
+	static uint64_t EncodeWithTable(const uint32_t lat, const uint32_t lon) {
+		const EncodingTable & table = GetEncodingTable();
+		uint64_t result = 0;
+		unsigned state = 0;
+		for(int shift = 28; shift >= 0; shift -= 4) {
+			const unsigned nibbles = (((lat >> shift) & 0xF) << 4) | ((lon >> shift) & 0xF);
+			const uint16_t entry = table.entries[state][nibbles];
+			result = (result << 8) | (entry & 0xFF);
+			state = entry >> 8;
+		}
+		return result;
+	}
+
+#ifdef HILBERT_CODE_HAS_BMI2
+	//Prefix scan over the orientations of all levels at once, see
+	//"2D Hilbert curves in O(1)", threadlocalmutex.com, 2015
+	__attribute__((target("bmi2")))
+	static uint64_t EncodeWithBMI2(const uint32_t lat, const uint32_t lon) {
+		const uint64_t x = lat;
+		const uint64_t y = lon;
+		const uint64_t mask = 0xFFFFFFFF;
+		uint64_t A, B, C, D;
+		{
+			const uint64_t a = x ^ y;
+			const uint64_t b = mask ^ a;
+			const uint64_t c = mask ^ (x | y);
+			const uint64_t d = x & (y ^ mask);
+			A = a | (b >> 1);
+			B = (a >> 1) ^ a;
+			C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+			D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
 		}
-		t=0;
-		for( Q = M; Q > 1; Q >>= 1 ) {
-			if( X[2-1] & Q ) {
-				t ^= Q-1;
+		for(unsigned shift = 2; shift < 32; shift <<= 1) {
+			const uint64_t a = A;
+			const uint64_t b = B;
+			const uint64_t c = C;
+			const uint64_t d = D;
+			if(16 != shift) {
+				A = ((a & (a >> shift)) ^ (b & (b >> shift)));
+				B = ((a & (b >> shift)) ^ (b & ((a ^ b) >> shift)));
 			}
-		} //check if this for loop is wrong
-		for( i = 0; i < 2; ++i ) {
-			X[i] ^= t;
+			C ^= ((a & (c >> shift)) ^ (b & (d >> shift)));
+			D ^= ((b & (c >> shift)) ^ ((a ^ b) & (d >> shift)));
 		}
+		const uint64_t a = C ^ (C >> 1);
+		const uint64_t b = D ^ (D >> 1);
+		const uint64_t i0 = x ^ y;
+		const uint64_t i1 = b | (mask ^ (i0 | a));
+		return _pdep_u64(i1, 0xAAAAAAAAAAAAAAAAULL) | _pdep_u64(i0, 0x5555555555555555ULL);
 	}
+#endif
 };
 
 #endif /* HILBERTVALUE_H_ */
@@ -21,74 +21,60 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #ifndef INPUTREADERFACTORY_H
 #define INPUTREADERFACTORY_H
 
-#include <bzlib.h>
-#include <libxml/xmlreader.h>
-
-struct BZ2Context {
-    FILE* file;
-    BZFILE* bz2;
-    int error;
-    int nUnused;
-    char unused[BZ_MAX_UNUSED];
+#include "ParallelBZ2Reader.h"
+#include "../Util/OSRMException.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <cstdio>
+#include <string>
+
+//Sequential source of the bytes of an input file
+class InputReader : boost::noncopyable {
+public:
+    virtual ~InputReader() { }
+    //Reads up to length bytes, returns 0 at the end of the input
+    virtual int Read(char * buffer, const int length) = 0;
 };
 
-int readFromBz2Stream( void* pointer, char* buffer, int len ) {
-    void *unusedTmpVoid=NULL;
-    char *unusedTmp=NULL;
-    BZ2Context* context = (BZ2Context*) pointer;
-    int read = 0;
-    while(0 == read && !(BZ_STREAM_END == context->error && 0 == context->nUnused && feof(context->file))) {
-        read = BZ2_bzRead(&context->error, context->bz2, buffer, len);
-        if(BZ_OK == context->error) {
-            return read;
-        } else if(BZ_STREAM_END == context->error) {
-            BZ2_bzReadGetUnused(&context->error, context->bz2, &unusedTmpVoid, &context->nUnused);
-            if(BZ_OK != context->error) {std::cerr << "Could not BZ2_bzReadGetUnused" <<std::endl; exit(-1);};
-            unusedTmp = (char*)unusedTmpVoid;
-            for(int i=0;i<context->nUnused;i++) {
-                context->unused[i] = unusedTmp[i];
-            }
-            BZ2_bzReadClose(&context->error, context->bz2);
-            if(BZ_OK != context->error) {std::cerr << "Could not BZ2_bzReadClose" <<std::endl; exit(-1);};
-            context->error = BZ_STREAM_END; // set to the stream end for next call to this function
-            if(0 == context->nUnused && feof(context->file)) {
-                return read;
-            } else {
-                context->bz2 = BZ2_bzReadOpen(&context->error, context->file, 0, 0, context->unused, context->nUnused);
-                if(NULL == context->bz2){std::cerr << "Could not open file" <<std::endl; exit(-1);};
-            }
-        } else { std::cerr << "Could not read bz2 file" << std::endl; exit(-1); }
+class PlainInputReader : public InputReader {
+public:
+    explicit PlainInputReader(const char * filename) : input_file(fopen(filename, "rb")) {
+        if(NULL == input_file) {
+            throw OSRMException("Could not open input file");
+        }
     }
-    return read;
-}
 
-int closeBz2Stream( void *pointer )
-{
-    BZ2Context* context = (BZ2Context*) pointer;
-    fclose( context->file );
-    delete context;
-    return 0;
-}
+    ~PlainInputReader() {
+        fclose(input_file);
+    }
 
-xmlTextReaderPtr inputReaderFactory( const char* name )
-{
-    std::string inputName(name);
-
-    if(inputName.find(".osm.bz2")!=std::string::npos)
-    {
-        BZ2Context* context = new BZ2Context();
-        context->error = false;
-        context->file = fopen( name, "r" );
-        int error;
-        context->bz2 = BZ2_bzReadOpen( &error, context->file, 0, 0, context->unused, context->nUnused );
-        if ( context->bz2 == NULL || context->file == NULL ) {
-            delete context;
-            return NULL;
-        }
-        return xmlReaderForIO( readFromBz2Stream, closeBz2Stream, (void*) context, NULL, NULL, 0 );
-    } else {
-        return xmlNewTextReaderFilename(name);
+    int Read(char * buffer, const int length) {
+        return fread(buffer, 1, length, input_file);
+    }
+
+private:
+    FILE * input_file;
+};
+
+class BZ2InputReader : public InputReader {
+public:
+    explicit BZ2InputReader(const char * filename) : bz2_reader(filename) { }
+
+    int Read(char * buffer, const int length) {
+        return bz2_reader.Read(buffer, length);
+    }
+
+private:
+    ParallelBZ2Reader bz2_reader;
+};
+
+inline InputReader * inputReaderFactory( const char* name ) {
+    const std::string inputName(name);
+    if(inputName.find(".osm.bz2")!=std::string::npos || inputName.find(".osc.bz2")!=std::string::npos) {
+        return new BZ2InputReader(name);
     }
+    return new PlainInputReader(name);
 }
 
 #endif // INPUTREADERFACTORY_H
@@ -45,38 +45,35 @@ public:
         return false;
     }
 
-    void Insert(const KeyT key, ValueT &value) {
-        itemsInCache.push_front(CacheEntry(key, value));
-        positionMap.insert(std::make_pair(key, itemsInCache.begin()));
-        if(itemsInCache.size() > capacity) {
-            positionMap.erase(itemsInCache.back().key);
-            itemsInCache.pop_back();
+    void Insert(const KeyT key, const ValueT & value) {
+        typename boost::unordered_map<KeyT, typename std::list<CacheEntry>::iterator >::iterator position = positionMap.find(key);
+        if(position != positionMap.end()) {
+            //concurrent misses may insert the same key twice
+            position->second->value = value;
+            itemsInCache.splice(itemsInCache.begin(), itemsInCache, position->second);
+            return;
         }
-    }
-
-    void Insert(const KeyT key, ValueT value) {
         itemsInCache.push_front(CacheEntry(key, value));
         positionMap.insert(std::make_pair(key, itemsInCache.begin()));
-        if(itemsInCache.size() > capacity) {
+        if(positionMap.size() > capacity) {
             positionMap.erase(itemsInCache.back().key);
             itemsInCache.pop_back();
         }
     }
 
     bool Fetch(const KeyT key, ValueT& result) {
-        if(Holds(key)) {
-            CacheEntry e = *(positionMap.find(key)->second);
-            result = e.value;
-
-            //move to front
-            itemsInCache.splice(positionMap.find(key)->second, itemsInCache, itemsInCache.begin());
-            positionMap.find(key)->second = itemsInCache.begin();
-            return true;
+        typename boost::unordered_map<KeyT, typename std::list<CacheEntry>::iterator >::iterator position = positionMap.find(key);
+        if(position == positionMap.end()) {
+            return false;
         }
-        return false;
+        result = position->second->value;
+        //move to front, list iterators stay valid
+        itemsInCache.splice(itemsInCache.begin(), itemsInCache, position->second);
+        return true;
     }
+
     unsigned Size() const {
-        return itemsInCache.size();
+        return positionMap.size();
     }
 };
 #endif //LRUCACHE_H
@@ -21,7 +21,9 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #ifndef NODEINFORMATIONHELPDESK_H_
 #define NODEINFORMATIONHELPDESK_H_
 
+#include "CompressedGeometry.h"
 #include "QueryNode.h"
+#include "PhantomNodeCache.h"
 #include "PhantomNodes.h"
 #include "StaticRTree.h"
 #include "../Contractor/EdgeBasedGraphFactory.h"
@@ -32,6 +34,8 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <iostream>
 #include <string>
@@ -44,11 +48,13 @@ public:
     NodeInformationHelpDesk(
         const std::string & ramIndexInput,
         const std::string & fileIndexInput,
-        const std::string & nodes_filename,
+        const std::string & gridIndexInput,
+        const std::string & geometryInput,
+        const boost::shared_ptr<const std::vector<FixedPointCoordinate> > & coordinates,
         const std::string & edges_filename,
         const unsigned number_of_nodes,
         const unsigned check_sum
-    ) : number_of_nodes(number_of_nodes), check_sum(check_sum)
+    ) : coordinateVector(coordinates), number_of_nodes(number_of_nodes), check_sum(check_sum)
     {
         if ( ramIndexInput.empty() ) {
             throw OSRMException("no ram index file name in server ini");
@@ -56,23 +62,23 @@ public:
         if ( fileIndexInput.empty() ) {
             throw OSRMException("no mem index file name in server ini");
         }
-        if ( nodes_filename.empty() ) {
-            throw OSRMException("no nodes file name in server ini");
-        }
         if ( edges_filename.empty() ) {
             throw OSRMException("no edges file name in server ini");
         }
 
+        BOOST_ASSERT_MSG(coordinateVector, "no node coordinates given");
+
         read_only_rtree = new StaticRTree<RTreeLeaf>(
             ramIndexInput,
-            fileIndexInput
-        );
-        BOOST_ASSERT_MSG(
-            0 == coordinateVector.size(),
-            "Coordinate vector not empty"
+            fileIndexInput,
+            gridIndexInput
         );
 
-        LoadNodesAndEdges(nodes_filename, edges_filename);
+        LoadEdges(edges_filename);
+
+        if( !geometryInput.empty() ) {
+            compressed_geometry.reset(new CompressedGeometry(geometryInput));
+        }
     }
 
     //Todo: Shared memory mechanism
@@ -82,12 +88,12 @@ public:
 
 	inline int getLatitudeOfNode(const unsigned id) const {
 	    const NodeID node = origEdgeData_viaNode.at(id);
-	    return coordinateVector.at(node).lat;
+	    return coordinateVector->at(node).lat;
 	}
 
 	inline int getLongitudeOfNode(const unsigned id) const {
         const NodeID node = origEdgeData_viaNode.at(id);
-	    return coordinateVector.at(node).lon;
+	    return coordinateVector->at(node).lon;
 	}
 
 	inline unsigned getNameIndexFromEdgeID(const unsigned id) const {
@@ -103,7 +109,7 @@ public:
     }
 
 	inline NodeID getNumberOfNodes2() const {
-        return coordinateVector.size();
+        return coordinateVector->size();
     }
 
     inline bool FindNearestNodeCoordForLatLon(
@@ -125,30 +131,63 @@ public:
             PhantomNode & resulting_phantom_node,
             const unsigned zoom_level
     ) const {
-        return read_only_rtree->FindPhantomNodeForCoordinate(
+        if(phantom_node_cache.Find(input_coordinate, zoom_level, resulting_phantom_node)) {
+            return true;
+        }
+        const bool found_node = read_only_rtree->FindPhantomNodeForCoordinate(
                 input_coordinate,
                 resulting_phantom_node,
                 zoom_level
         );
+        if(found_node) {
+            phantom_node_cache.Insert(input_coordinate, zoom_level, resulting_phantom_node);
+        }
+        return found_node;
+    }
+
+    inline void FindKNearestPhantomNodesForCoordinate(
+            const FixedPointCoordinate & input_coordinate,
+            const unsigned zoom_level,
+            const unsigned candidate_count,
+            const double max_distance,
+            std::vector<std::pair<PhantomNode, double> > & result_vector
+    ) const {
+        read_only_rtree->FindKNearestPhantomNodesForCoordinate(
+                input_coordinate,
+                zoom_level,
+                candidate_count,
+                max_distance,
+                result_vector
+        );
     }
 
 	inline unsigned GetCheckSum() const {
 	    return check_sum;
 	}
 
-private:
-    void LoadNodesAndEdges(
-        const std::string & nodes_filename,
-        const std::string & edges_filename
-    ) {
-        boost::filesystem::path nodes_file(nodes_filename);
-        if ( !boost::filesystem::exists( nodes_file ) ) {
-            throw OSRMException("nodes file does not exist");
+    //Coordinates along a compressed edge-based node in direction of travel,
+    //including its start and end. Empty if the node was not compressed.
+    inline void GetCompressedGeometry(
+            const NodeID edge_based_node,
+            std::vector<FixedPointCoordinate> & result
+    ) const {
+        result.clear();
+        const NodeID * begin = NULL;
+        const NodeID * end = NULL;
+        if( !compressed_geometry || !compressed_geometry->GetGeometry(edge_based_node, begin, end) ) {
+            return;
         }
-        if ( 0 == boost::filesystem::file_size( nodes_file ) ) {
-            throw OSRMException("nodes file is empty");
+        for( ; begin != end; ++begin) {
+            result.push_back(coordinateVector->at(*begin));
         }
+    }
 
+    inline PhantomNodeCache & GetPhantomNodeCache() const {
+        return phantom_node_cache;
+    }
+
+private:
+    void LoadEdges(const std::string & edges_filename) {
         boost::filesystem::path edges_file(edges_filename);
         if ( !boost::filesystem::exists( edges_file ) ) {
             throw OSRMException("edges file does not exist");
@@ -157,18 +196,8 @@ private:
             throw OSRMException("edges file is empty");
         }
 
-        boost::filesystem::ifstream nodes_input_stream(nodes_file, std::ios::binary);
         boost::filesystem::ifstream edges_input_stream(edges_file, std::ios::binary);
 
-        SimpleLogger().Write(logDEBUG) << "Loading node data";
-        NodeInfo b;
-        while(!nodes_input_stream.eof()) {
-            nodes_input_stream.read((char *)&b, sizeof(NodeInfo));
-            coordinateVector.push_back(FixedPointCoordinate(b.lat, b.lon));
-        }
-        std::vector<FixedPointCoordinate>(coordinateVector).swap(coordinateVector);
-        nodes_input_stream.close();
-
         SimpleLogger().Write(logDEBUG) << "Loading edge data";
         unsigned numberOfOrigEdges(0);
         edges_input_stream.read((char*)&numberOfOrigEdges, sizeof(unsigned));
@@ -191,14 +220,19 @@ private:
         SimpleLogger().Write(logDEBUG) << "Opening NN indices";
     }
 
-	std::vector<FixedPointCoordinate> coordinateVector;
+	//may be shared with the datasets of other profiles
+	boost::shared_ptr<const std::vector<FixedPointCoordinate> > coordinateVector;
 	std::vector<NodeID> origEdgeData_viaNode;
 	std::vector<unsigned> origEdgeData_nameID;
 	std::vector<TurnInstruction> origEdgeData_turnInstruction;
 
 	StaticRTree<EdgeBasedGraphFactory::EdgeBasedNode> * read_only_rtree;
+	//NULL unless the dataset was built with compressed geometry
+	boost::scoped_ptr<CompressedGeometry> compressed_geometry;
 	const unsigned number_of_nodes;
 	const unsigned check_sum;
+	//snapping is deterministic per dataset, repeated coordinates are answered from here
+	mutable PhantomNodeCache phantom_node_cache;
 };
 
 #endif /*NODEINFORMATIONHELPDESK_H_*/
@@ -0,0 +1,358 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef PARALLELBZ2READER_H_
+#define PARALLELBZ2READER_H_
+
+#include "ConcurrentQueue.h"
+#include "../Util/OpenMPWrapper.h"
+#include "../Util/OSRMException.h"
+
+#include <bzlib.h>
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//48 bit magic numbers that start a compressed block and end a stream
+static const boost::uint64_t BZ2_BLOCK_MAGIC = 0x314159265359ULL;
+static const boost::uint64_t BZ2_END_OF_STREAM_MAGIC = 0x177245385090ULL;
+static const boost::uint64_t BZ2_MAGIC_MASK = 0xFFFFFFFFFFFFULL;
+//Compressed bytes read from the file at once
+static const unsigned BZ2_READ_CHUNK_SIZE = 8*1024*1024;
+//Decompressed blocks and bytes waiting for the consumer
+static const unsigned BZ2_DECOMPRESSED_QUEUE_SIZE = 1024;
+static const size_t BZ2_DECOMPRESSED_QUEUE_MEMORY = 256*1024*1024;
+
+/*
+ * Decompresses a bzip2 file with all cores, in the way of pbzip2 and
+ * lbzip2. bzip2 compresses independent blocks of at most 900k that start
+ * with a magic number at an arbitrary bit offset. The blocks are located
+ * by searching the magic, each one is wrapped into a stream of its own and
+ * a batch of blocks is decompressed in parallel. A background thread
+ * keeps decompressing while the consumer reads, output stays in order.
+ *
+ * The block magic may occur by chance within compressed data. A block that
+ * does not decompress is merged with its successors until it does.
+ */
+class ParallelBZ2Reader : boost::noncopyable {
+public:
+    explicit ParallelBZ2Reader(const char * filename) :
+        input_file(fopen(filename, "rb")),
+        decompressed_blocks(BZ2_DECOMPRESSED_QUEUE_SIZE, BZ2_DECOMPRESSED_QUEUE_MEMORY),
+        read_position(0),
+        finished(false)
+    {
+        if(NULL == input_file) {
+            throw OSRMException("Could not open bzip2 input file");
+        }
+        decompression_thread = boost::thread(
+            boost::bind(&ParallelBZ2Reader::DecompressFile, this)
+        );
+    }
+
+    ~ParallelBZ2Reader() {
+        decompression_thread.interrupt();
+        decompression_thread.join();
+        fclose(input_file);
+    }
+
+    //Reads up to length decompressed bytes, returns 0 at the end of the file
+    int Read(char * buffer, const int length) {
+        int copied = 0;
+        while(copied < length && !finished) {
+            if(!current_block || read_position == current_block->size()) {
+                decompressed_blocks.wait_and_pop(current_block);
+                read_position = 0;
+                if(!current_block) {
+                    finished = true;
+                    boost::mutex::scoped_lock lock(error_mutex);
+                    if(!error_message.empty()) {
+                        throw OSRMException(error_message);
+                    }
+                    break;
+                }
+                continue;
+            }
+            const int bytes = std::min(
+                length - copied,
+                int(current_block->size() - read_position)
+            );
+            memcpy(buffer + copied, current_block->data() + read_position, bytes);
+            read_position += bytes;
+            copied += bytes;
+        }
+        return copied;
+    }
+
+private:
+    typedef boost::shared_ptr<std::string> DecompressedBlock;
+
+    //Bit range of a compressed block or of the trailer of a stream, i.e.
+    //its end of stream magic, CRC and the header of the next stream
+    struct BlockRange {
+        BlockRange(const boost::uint64_t begin, const boost::uint64_t end, const bool is_block) :
+            begin(begin), end(end), is_block(is_block)
+        { }
+        boost::uint64_t begin;
+        boost::uint64_t end;
+        bool is_block;
+    };
+
+    void DecompressFile() {
+        try {
+            std::vector<unsigned char> buffer;
+            std::vector<BlockRange> blocks;
+            const boost::uint64_t no_block = boost::uint64_t(-1);
+            boost::uint64_t segment_begin = no_block;
+            bool segment_is_block = false;
+            boost::uint64_t window = 0;
+            unsigned scan_position = 0;
+            const unsigned blocks_per_batch = 4*omp_get_max_threads();
+            bool end_of_file = false;
+
+            while(!end_of_file || !blocks.empty()) {
+                boost::this_thread::interruption_point();
+                if(!end_of_file) {
+                    const unsigned old_size = buffer.size();
+                    buffer.resize(old_size + BZ2_READ_CHUNK_SIZE);
+                    const size_t bytes_read = fread(&buffer[old_size], 1, BZ2_READ_CHUNK_SIZE, input_file);
+                    buffer.resize(old_size + bytes_read);
+                    end_of_file = (0 == bytes_read);
+                }
+
+                //look for magic numbers ending within each new byte
+                for( ; scan_position < buffer.size(); ++scan_position) {
+                    window = (window << 8) | buffer[scan_position];
+                    for(int shift = 7; shift >= 0; --shift) {
+                        const boost::uint64_t candidate = (window >> shift) & BZ2_MAGIC_MASK;
+                        const boost::uint64_t magic_end = boost::uint64_t(scan_position+1)*8 - shift;
+                        if(magic_end < 48) {
+                            continue;
+                        }
+                        if(BZ2_BLOCK_MAGIC != candidate && BZ2_END_OF_STREAM_MAGIC != candidate) {
+                            continue;
+                        }
+                        const boost::uint64_t magic_begin = magic_end - 48;
+                        if(no_block != segment_begin) {
+                            blocks.push_back(BlockRange(segment_begin, magic_begin, segment_is_block));
+                        }
+                        segment_begin = magic_begin;
+                        segment_is_block = (BZ2_BLOCK_MAGIC == candidate);
+                    }
+                }
+
+                if(end_of_file && no_block != segment_begin) {
+                    if(segment_is_block) {
+                        throw OSRMException("bzip2 input is truncated");
+                    }
+                    blocks.push_back(BlockRange(segment_begin, boost::uint64_t(buffer.size())*8, false));
+                    segment_begin = no_block;
+                }
+                if(blocks.size() < blocks_per_batch && !end_of_file) {
+                    continue;
+                }
+                const unsigned decompressed = DecompressBatch(buffer, blocks, end_of_file);
+                blocks.erase(blocks.begin(), blocks.begin() + decompressed);
+
+                //drop the compressed bytes that are done with
+                boost::uint64_t first_needed_bit = boost::uint64_t(scan_position)*8;
+                if(!blocks.empty()) {
+                    first_needed_bit = blocks.front().begin;
+                } else if(no_block != segment_begin) {
+                    first_needed_bit = segment_begin;
+                }
+                //a magic number may span the end of the buffer
+                const unsigned first_needed_byte = std::min(
+                    unsigned(first_needed_bit/8),
+                    scan_position - std::min(scan_position, 8u)
+                );
+                buffer.erase(buffer.begin(), buffer.begin() + first_needed_byte);
+                scan_position -= first_needed_byte;
+                const boost::uint64_t dropped_bits = boost::uint64_t(first_needed_byte)*8;
+                if(no_block != segment_begin) {
+                    segment_begin -= dropped_bits;
+                }
+                for(unsigned i = 0; i < blocks.size(); ++i) {
+                    blocks[i].begin -= dropped_bits;
+                    blocks[i].end -= dropped_bits;
+                }
+            }
+        } catch(const boost::thread_interrupted &) {
+            return;
+        } catch(const std::exception & e) {
+            boost::mutex::scoped_lock lock(error_mutex);
+            error_message = e.what();
+        }
+        //empty block marks the end
+        decompressed_blocks.push(DecompressedBlock());
+    }
+
+    //Returns the number of blocks that were decompressed and queued
+    unsigned DecompressBatch(
+        const std::vector<unsigned char> & buffer,
+        const std::vector<BlockRange> & blocks,
+        const bool is_last_batch
+    ) {
+        const int number_of_blocks = blocks.size();
+        std::vector<DecompressedBlock> output(number_of_blocks);
+        std::vector<char> is_valid(number_of_blocks, 1);
+#pragma omp parallel for schedule(dynamic)
+        for(int i = 0; i < number_of_blocks; ++i) {
+            output[i].reset(new std::string());
+            if(blocks[i].is_block) {
+                is_valid[i] = DecompressBlock(buffer, blocks[i].begin, blocks[i].end, *output[i]);
+            }
+        }
+
+        std::vector<DecompressedBlock> finished_blocks;
+        std::vector<size_t> finished_sizes;
+        int i = 0;
+        while(i < number_of_blocks) {
+            int last = i;
+            if(!is_valid[i]) {
+                //a magic number within the compressed data split the block,
+                //merge it with what follows
+                for(last = i+1; last < number_of_blocks; ++last) {
+                    if(DecompressBlock(buffer, blocks[i].begin, blocks[last].end, *output[i])) {
+                        break;
+                    }
+                }
+                if(last == number_of_blocks) {
+                    if(is_last_batch) {
+                        throw OSRMException("bzip2 input is corrupt");
+                    }
+                    //the rest of the block may still be unread
+                    break;
+                }
+            }
+            if(!output[i]->empty()) {
+                finished_blocks.push_back(output[i]);
+                finished_sizes.push_back(output[i]->size());
+            }
+            i = last+1;
+        }
+        if(!finished_blocks.empty()) {
+            decompressed_blocks.push(&finished_blocks[0], finished_blocks.size(), &finished_sizes[0]);
+        }
+        return i;
+    }
+
+    static inline boost::uint64_t GetBits(
+        const std::vector<unsigned char> & buffer,
+        const boost::uint64_t bit_position,
+        const unsigned number_of_bits
+    ) {
+        boost::uint64_t value = 0;
+        for(unsigned i = 0; i < number_of_bits; ++i) {
+            const boost::uint64_t bit = bit_position + i;
+            value = (value << 1) | ((buffer[bit/8] >> (7 - bit%8)) & 1);
+        }
+        return value;
+    }
+
+    //Wraps the bits [begin, end) of a block into a stream and decompresses it
+    static bool DecompressBlock(
+        const std::vector<unsigned char> & buffer,
+        const boost::uint64_t begin,
+        const boost::uint64_t end,
+        std::string & output
+    ) {
+        output.clear();
+        const boost::uint64_t number_of_bits = end - begin;
+        const unsigned shift = begin % 8;
+        const unsigned char * source = &buffer[begin/8];
+
+        std::vector<unsigned char> stream;
+        stream.reserve(number_of_bits/8 + 16);
+        stream.push_back('B'); stream.push_back('Z'); stream.push_back('h'); stream.push_back('9');
+        const boost::uint64_t whole_bytes = number_of_bits/8;
+        for(boost::uint64_t i = 0; i < whole_bytes; ++i) {
+            stream.push_back(
+                0 == shift ? source[i] : ((source[i] << shift) | (source[i+1] >> (8-shift)))
+            );
+        }
+        //remaining bits of the block, end of stream magic and the combined
+        //CRC, which equals the block CRC for a single block
+        boost::uint64_t pending = 0;
+        unsigned pending_bits = 0;
+        const unsigned remaining_bits = number_of_bits % 8;
+        const boost::uint64_t block_crc = GetBits(buffer, begin + 48, 32);
+        const boost::uint64_t tail[3] = {
+            GetBits(buffer, begin + whole_bytes*8, remaining_bits),
+            BZ2_END_OF_STREAM_MAGIC,
+            block_crc
+        };
+        const unsigned tail_bits[3] = { remaining_bits, 48, 32 };
+        for(unsigned part = 0; part < 3; ++part) {
+            for(int bit = int(tail_bits[part])-1; bit >= 0; --bit) {
+                pending = (pending << 1) | ((tail[part] >> bit) & 1);
+                if(8 == ++pending_bits) {
+                    stream.push_back(pending);
+                    pending = pending_bits = 0;
+                }
+            }
+        }
+        if(0 < pending_bits) {
+            stream.push_back(pending << (8 - pending_bits));
+        }
+
+        bz_stream bz;
+        memset(&bz, 0, sizeof(bz));
+        if(BZ_OK != BZ2_bzDecompressInit(&bz, 0, 0)) {
+            return false;
+        }
+        bz.next_in = reinterpret_cast<char *>(&stream[0]);
+        bz.avail_in = stream.size();
+        char decompressed[64*1024];
+        int status = BZ_OK;
+        while(BZ_OK == status) {
+            bz.next_out = decompressed;
+            bz.avail_out = sizeof(decompressed);
+            status = BZ2_bzDecompress(&bz);
+            output.append(decompressed, sizeof(decompressed) - bz.avail_out);
+            if(BZ_OK == status && 0 == bz.avail_in && 0 < bz.avail_out) {
+                //input exhausted before the end of stream
+                break;
+            }
+        }
+        BZ2_bzDecompressEnd(&bz);
+        return BZ_STREAM_END == status;
+    }
+
+    FILE * input_file;
+    ConcurrentQueue<DecompressedBlock> decompressed_blocks;
+    boost::thread decompression_thread;
+    DecompressedBlock current_block;
+    size_t read_position;
+    bool finished;
+    boost::mutex error_mutex;
+    std::string error_message;
+};
+
+#endif /* PARALLELBZ2READER_H_ */
@@ -0,0 +1,127 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef PHANTOMNODECACHE_H_
+#define PHANTOMNODECACHE_H_
+
+#include "Coordinate.h"
+#include "LRUCache.h"
+#include "PhantomNodes.h"
+
+#include <boost/functional/hash.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <cstddef>
+
+//Each shard has its own lock and evicts the least recently used entries
+static const unsigned PHANTOM_NODE_CACHE_SHARDS = 16;
+static const unsigned PHANTOM_NODE_CACHE_SHARD_SIZE = 4096;
+//Snapping ignores tiny components up to this zoom level
+static const unsigned PHANTOM_NODE_CACHE_SMALL_ZOOM = 14;
+
+/*
+ * Remembers the phantom nodes of coordinates that were snapped before. Keys
+ * are the fixed point coordinates, i.e. quantized to 1e-6 degrees, and
+ * whether the zoom level hides tiny components, which is all the snapping
+ * depends on. The cache belongs to the dataset it snaps on and goes away
+ * together with it, so entries never outlive the data they were computed on.
+ */
+class PhantomNodeCache : boost::noncopyable {
+public:
+    bool Find(
+        const FixedPointCoordinate & coordinate,
+        const unsigned zoom_level,
+        PhantomNode & result
+    ) {
+        const CacheKey key(coordinate, zoom_level);
+        Shard & shard = GetShard(key);
+        boost::mutex::scoped_lock lock(shard.mutex);
+        if(shard.entries.Fetch(key, result)) {
+            ++shard.hits;
+            return true;
+        }
+        ++shard.misses;
+        return false;
+    }
+
+    void Insert(
+        const FixedPointCoordinate & coordinate,
+        const unsigned zoom_level,
+        const PhantomNode & phantom_node
+    ) {
+        const CacheKey key(coordinate, zoom_level);
+        Shard & shard = GetShard(key);
+        boost::mutex::scoped_lock lock(shard.mutex);
+        shard.entries.Insert(key, phantom_node);
+    }
+
+    void GetStatistics(uint64_t & hits, uint64_t & misses, unsigned & size) {
+        hits = misses = size = 0;
+        for(unsigned i = 0; i < PHANTOM_NODE_CACHE_SHARDS; ++i) {
+            boost::mutex::scoped_lock lock(shards[i].mutex);
+            hits += shards[i].hits;
+            misses += shards[i].misses;
+            size += shards[i].entries.Size();
+        }
+    }
+
+private:
+    struct CacheKey {
+        CacheKey(const FixedPointCoordinate & coordinate, const unsigned zoom_level) :
+            lat(coordinate.lat),
+            lon(coordinate.lon),
+            small_zoom(zoom_level <= PHANTOM_NODE_CACHE_SMALL_ZOOM)
+        { }
+        int lat;
+        int lon;
+        bool small_zoom;
+
+        bool operator==(const CacheKey & other) const {
+            return lat == other.lat && lon == other.lon && small_zoom == other.small_zoom;
+        }
+
+        friend std::size_t hash_value(const CacheKey & key) {
+            std::size_t seed = 0;
+            boost::hash_combine(seed, key.lat);
+            boost::hash_combine(seed, key.lon);
+            boost::hash_combine(seed, key.small_zoom);
+            return seed;
+        }
+    };
+
+    struct Shard {
+        Shard() : entries(PHANTOM_NODE_CACHE_SHARD_SIZE), hits(0), misses(0) { }
+        boost::mutex mutex;
+        LRUCache<CacheKey, PhantomNode> entries;
+        uint64_t hits;
+        uint64_t misses;
+    };
+
+    inline Shard & GetShard(const CacheKey & key) {
+        //the buckets use the low bits of the hash, spread the shards by the high ones
+        const uint32_t hash = uint32_t(hash_value(key))*2654435769u;
+        return shards[(hash >> 16) % PHANTOM_NODE_CACHE_SHARDS];
+    }
+
+    Shard shards[PHANTOM_NODE_CACHE_SHARDS];
+};
+
+#endif /* PHANTOMNODECACHE_H_ */
@@ -29,6 +29,7 @@ struct PhantomNode {
         nodeBasedEdgeNameID(UINT_MAX),
         weight1(INT_MAX),
         weight2(INT_MAX),
+        segmentPosition(0),
         ratio(0.)
     { }
 
@@ -36,6 +37,9 @@ struct PhantomNode {
     unsigned nodeBasedEdgeNameID;
     int weight1;
     int weight2;
+    //segment of edgeBasedNode the location is on, counted in its direction
+    unsigned segmentPosition;
+    //position on that segment
     double ratio;
     FixedPointCoordinate location;
     void Reset() {
@@ -43,6 +47,7 @@ struct PhantomNode {
         nodeBasedEdgeNameID = UINT_MAX;
         weight1 = INT_MAX;
         weight2 = INT_MAX;
+        segmentPosition = 0;
         ratio = 0.;
         location.Reset();
     }
@@ -28,8 +28,10 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include <vector>
 
 struct _PathData {
-    _PathData(NodeID no, unsigned na, unsigned tu, unsigned dur) : node(no), nameID(na), durationOfSegment(dur), turnInstruction(tu) { }
+    _PathData(NodeID no, unsigned na, unsigned tu, unsigned dur, NodeID ebn = UINT_MAX) : node(no), edgeBasedNode(ebn), nameID(na), durationOfSegment(dur), turnInstruction(tu) { }
     NodeID node;
+    //edge-based node the turn at node leaves
+    NodeID edgeBasedNode;
     unsigned nameID;
     unsigned durationOfSegment;
     short turnInstruction;
@@ -43,7 +45,8 @@ struct RawRouteData {
     unsigned checkSum;
     int lengthOfShortestPath;
     int lengthOfAlternativePath;
-    RawRouteData() : checkSum(UINT_MAX), lengthOfShortestPath(INT_MAX), lengthOfAlternativePath(INT_MAX) {}
+    bool searchWasAborted;
+    RawRouteData() : checkSum(UINT_MAX), lengthOfShortestPath(INT_MAX), lengthOfAlternativePath(INT_MAX), searchWasAborted(false) {}
 };
 
 #endif /* RAWROUTEDATA_H_ */
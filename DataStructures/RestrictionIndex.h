@@ -0,0 +1,175 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef RESTRICTIONINDEX_H_
+#define RESTRICTIONINDEX_H_
+
+#include "Restriction.h"
+#include "../typedefs.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+/*
+ * Immutable index of turn restrictions. Restrictions are sorted by their
+ * (from, via) pair, the targets of each pair are stored contiguously. A bit
+ * per node rejects the vast majority of lookups, i.e. those from nodes that
+ * do not start any restriction, before the sorted array is searched. Being
+ * read-only after construction it can be queried from any number of threads.
+ */
+class RestrictionIndex : boost::noncopyable {
+public:
+    RestrictionIndex(
+        const unsigned number_of_nodes,
+        const std::vector<TurnRestriction> & input_restrictions_list
+    ) : is_restriction_start(number_of_nodes, false) {
+        std::vector<InputRestriction> restrictions;
+        restrictions.reserve(input_restrictions_list.size());
+        for(unsigned i = 0; i < input_restrictions_list.size(); ++i) {
+            const TurnRestriction & restriction = input_restrictions_list[i];
+            //restrictions of nodes that are not in the graph can never apply
+            if(
+                restriction.fromNode >= number_of_nodes ||
+                restriction.viaNode >= number_of_nodes
+            ) {
+                continue;
+            }
+            restrictions.push_back(InputRestriction(restriction));
+        }
+        //input order decides which only_-restriction wins
+        std::stable_sort(restrictions.begin(), restrictions.end());
+
+        std::vector<InputRestriction>::const_iterator group = restrictions.begin();
+        while(group != restrictions.end()) {
+            std::vector<InputRestriction>::const_iterator group_end = group;
+            std::vector<InputRestriction>::const_iterator only_restriction = restrictions.end();
+            while(group_end != restrictions.end() && !(*group < *group_end)) {
+                if(group_end->is_only && restrictions.end() == only_restriction) {
+                    only_restriction = group_end;
+                }
+                ++group_end;
+            }
+
+            sources.push_back(Source(group->from, group->via, targets.size(), restrictions.end() != only_restriction));
+            is_restriction_start[group->from] = true;
+            if(restrictions.end() != only_restriction) {
+                //there can be only one
+                targets.push_back(only_restriction->to);
+            } else {
+                for( ; group != group_end; ++group) {
+                    targets.push_back(group->to);
+                }
+            }
+            group = group_end;
+        }
+        //sentinel, closes the target range of the last source
+        sources.push_back(Source(UINT_MAX, UINT_MAX, targets.size(), false));
+    }
+
+    //Target of the only_-restriction starting with (from, via), if any
+    inline NodeID GetOnlyTarget(const NodeID from, const NodeID via) const {
+        const Source * source = FindSource(from, via);
+        if(NULL == source || !source->is_only) {
+            return UINT_MAX;
+        }
+        return targets[source->first_target];
+    }
+
+    inline bool IsRestricted(const NodeID from, const NodeID via, const NodeID to) const {
+        const Source * source = FindSource(from, via);
+        if(NULL == source) {
+            return false;
+        }
+        const std::vector<NodeID>::const_iterator begin = targets.begin() + source->first_target;
+        const std::vector<NodeID>::const_iterator end = targets.begin() + (source+1)->first_target;
+        return end != std::find(begin, end, to);
+    }
+
+    //All nodes that take part in a restriction
+    inline void GetRestrictedNodes(std::vector<NodeID> & nodes) const {
+        for(unsigned i = 0; i+1 < sources.size(); ++i) {
+            nodes.push_back(sources[i].from);
+            nodes.push_back(sources[i].via);
+        }
+        nodes.insert(nodes.end(), targets.begin(), targets.end());
+    }
+
+    inline unsigned GetNumberOfRestrictions() const {
+        return targets.size();
+    }
+
+private:
+    struct InputRestriction {
+        explicit InputRestriction(const TurnRestriction & restriction) :
+            from(restriction.fromNode),
+            via(restriction.viaNode),
+            to(restriction.toNode),
+            is_only(restriction.flags.isOnly)
+        { }
+        NodeID from;
+        NodeID via;
+        NodeID to;
+        bool is_only;
+
+        bool operator<(const InputRestriction & other) const {
+            return (from < other.from) || (from == other.from && via < other.via);
+        }
+    };
+
+    struct Source {
+        Source(const NodeID from, const NodeID via, const unsigned first_target, const bool is_only) :
+            from(from), via(via), first_target(first_target), is_only(is_only)
+        { }
+        NodeID from;
+        NodeID via;
+        unsigned first_target;
+        bool is_only;
+
+        bool operator<(const Source & other) const {
+            return (from < other.from) || (from == other.from && via < other.via);
+        }
+    };
+
+    inline const Source * FindSource(const NodeID from, const NodeID via) const {
+        if(from >= is_restriction_start.size() || !is_restriction_start[from]) {
+            return NULL;
+        }
+        const Source key(from, via, 0, false);
+        //the sentinel is not part of the search range
+        const std::vector<Source>::const_iterator source = std::lower_bound(
+            sources.begin(),
+            sources.end()-1,
+            key
+        );
+        if(sources.end()-1 == source || source->from != from || source->via != via) {
+            return NULL;
+        }
+        return &(*source);
+    }
+
+    std::vector<bool> is_restriction_start;
+    std::vector<Source> sources;
+    std::vector<NodeID> targets;
+};
+
+#endif /* RESTRICTIONINDEX_H_ */
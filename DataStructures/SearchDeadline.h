@@ -0,0 +1,130 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef SEARCHDEADLINE_H_
+#define SEARCHDEADLINE_H_
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <poll.h>
+
+//Search loops poll the deadline only every so many settled nodes
+static const unsigned SEARCH_DEADLINE_CHECK_INTERVAL = 1024;
+
+//Shared between the connection that owns a request and the search that
+//serves it. The connection may cancel it from another thread at any time.
+class SearchDeadline : boost::noncopyable {
+public:
+    SearchDeadline() :
+        has_expiry(false),
+        is_cancelled(false),
+        peer_socket(-1)
+    { }
+
+    //While a socket is watched, every check of the deadline also looks
+    //whether its peer has hung up. A client that only shut down its
+    //sending side still waits for the reply and is not taken as gone.
+    //Pass -1 before the socket is closed.
+    void WatchPeer(const int socket_descriptor) {
+        boost::mutex::scoped_lock lock(m_peer_mutex);
+        peer_socket = socket_descriptor;
+    }
+
+    //A timeout of zero milliseconds leaves the deadline unbounded
+    void ExpireAfter(const unsigned milliseconds) {
+        if(0 == milliseconds) {
+            return;
+        }
+        boost::mutex::scoped_lock lock(m_mutex);
+        expiry = boost::posix_time::microsec_clock::universal_time() +
+            boost::posix_time::milliseconds(milliseconds);
+        has_expiry = true;
+    }
+
+    void Cancel() {
+        boost::mutex::scoped_lock lock(m_mutex);
+        is_cancelled = true;
+    }
+
+    bool IsCancelled() const {
+        boost::mutex::scoped_lock lock(m_mutex);
+        return is_cancelled;
+    }
+
+    bool HasExpired() const {
+        //the socket is polled without holding the lock Cancel() takes
+        if(PeerHasHungUp()) {
+            boost::mutex::scoped_lock lock(m_mutex);
+            is_cancelled = true;
+            return true;
+        }
+        boost::mutex::scoped_lock lock(m_mutex);
+        if(is_cancelled) {
+            return true;
+        }
+        return has_expiry &&
+            (boost::posix_time::microsec_clock::universal_time() > expiry);
+    }
+
+    //Counts settled nodes and polls the clock once per check interval.
+    inline bool HasExpiredAfterSettling(unsigned & settled_nodes) const {
+        ++settled_nodes;
+        if(0 != (settled_nodes % SEARCH_DEADLINE_CHECK_INTERVAL)) {
+            return false;
+        }
+        return HasExpired();
+    }
+
+    //Used by callers that do not carry a deadline of their own
+    static const SearchDeadline & Unbounded() {
+        static const SearchDeadline unbounded_deadline;
+        return unbounded_deadline;
+    }
+
+private:
+    //A reset or a connection closed in both directions. Nothing is read,
+    //pending request bytes stay where they are. The peer lock keeps the
+    //socket from being closed while it is polled.
+    inline bool PeerHasHungUp() const {
+        boost::mutex::scoped_lock lock(m_peer_mutex);
+        if(-1 == peer_socket) {
+            return false;
+        }
+        struct pollfd peer;
+        peer.fd = peer_socket;
+        peer.events = 0;
+        peer.revents = 0;
+        if(0 >= poll(&peer, 1, 0)) {
+            return false;
+        }
+        return (0 != (peer.revents & (POLLHUP | POLLERR)));
+    }
+
+    mutable boost::mutex m_mutex;
+    mutable boost::mutex m_peer_mutex;
+    boost::posix_time::ptime expiry;
+    bool has_expiry;
+    mutable bool is_cancelled;
+    int peer_socket;
+};
+
+#endif /* SEARCHDEADLINE_H_ */
@@ -27,7 +27,8 @@ SearchEngine::SearchEngine(
     ) :
         _queryData(g, nh, n),
         shortestPath(_queryData),
-        alternativePaths(_queryData)
+        alternativePaths(_queryData),
+        distanceTable(_queryData)
     {}
     SearchEngine::~SearchEngine() {}
 
@@ -39,6 +40,113 @@ void SearchEngine::GetCoordinatesForNodeID(
     result.lon = _queryData.nodeHelpDesk->getLongitudeOfNode(id);
 }
 
+//Segment of a phantom node counted in direction of the given edge-based node
+static inline unsigned GetSegmentPosition(
+    const PhantomNode & phantomNode,
+    const NodeID edgeBasedNode,
+    const unsigned numberOfSegments
+) {
+    if(edgeBasedNode == phantomNode.edgeBasedNode) {
+        return phantomNode.segmentPosition;
+    }
+    return numberOfSegments - 1 - std::min(phantomNode.segmentPosition, numberOfSegments - 1);
+}
+
+//Via point of a later leg that lies on the road of the edge-based node
+static inline const PhantomNode * FindViaOnRoad(
+    const std::vector<PhantomNodes> & legs,
+    const NodeID edgeBasedNode
+) {
+    for(unsigned i = 1; i < legs.size(); ++i) {
+        const PhantomNode & via = legs[i].startPhantom;
+        if(via.isBidirected() && (edgeBasedNode == via.edgeBasedNode || edgeBasedNode == via.edgeBasedNode+1)) {
+            return &via;
+        }
+    }
+    return NULL;
+}
+
+//Coordinates of compressed road segments that lie before the node of path
+//entry index, or before the target if index is the length of the path.
+//legs are the phantom nodes of the single legs of a route through via
+//points, a route may turn around at them.
+void SearchEngine::GetIntermediateGeometry(
+    const std::vector<_PathData> & path,
+    const unsigned index,
+    const PhantomNodes & phantomNodes,
+    const std::vector<PhantomNodes> & legs,
+    std::vector<FixedPointCoordinate> & result
+    ) const {
+    result.clear();
+    const PhantomNode & startPhantom = phantomNodes.startPhantom;
+    const PhantomNode & targetPhantom = phantomNodes.targetPhantom;
+    std::vector<FixedPointCoordinate> geometry;
+    NodeID edgeBasedNode = UINT_MAX;
+    unsigned first = 1, last = 1;
+    if(index < path.size()) {
+        //all of the road up to the turn, from the start on for the first
+        edgeBasedNode = path[index].edgeBasedNode;
+        _queryData.nodeHelpDesk->GetCompressedGeometry(edgeBasedNode, geometry);
+        if(geometry.empty()) {
+            return;
+        }
+        last = geometry.size() - 1;
+        if(0 == index && (edgeBasedNode == startPhantom.edgeBasedNode || edgeBasedNode == startPhantom.edgeBasedNode+1)) {
+            first = 1 + GetSegmentPosition(startPhantom, edgeBasedNode, geometry.size() - 1);
+        }
+        //a road that does not begin at the previous turn was entered in the
+        //opposite direction, up to the via point the route turns around at
+        FixedPointCoordinate lastTurn;
+        const PhantomNode * via = FindViaOnRoad(legs, edgeBasedNode);
+        if(0 < index && NULL != via) {
+            GetCoordinatesForNodeID(path[index-1].node, lastTurn);
+        }
+        if(0 < index && NULL != via && !(geometry.front() == lastTurn)) {
+            const NodeID oppositeNode = (edgeBasedNode == via->edgeBasedNode ? edgeBasedNode+1 : edgeBasedNode-1);
+            std::vector<FixedPointCoordinate> oppositeGeometry;
+            _queryData.nodeHelpDesk->GetCompressedGeometry(oppositeNode, oppositeGeometry);
+            const unsigned turnAround = 1 + GetSegmentPosition(*via, oppositeNode, oppositeGeometry.size() - 1);
+            for(unsigned i = 1; i < turnAround; ++i) {
+                result.push_back(oppositeGeometry[i]);
+            }
+            result.push_back(via->location);
+            first = 1 + GetSegmentPosition(*via, edgeBasedNode, geometry.size() - 1);
+        }
+    } else if(path.empty()) {
+        //start and target are on the same road
+        if(startPhantom.edgeBasedNode != targetPhantom.edgeBasedNode) {
+            return;
+        }
+        edgeBasedNode = targetPhantom.edgeBasedNode;
+        if(startPhantom.segmentPosition > targetPhantom.segmentPosition && targetPhantom.isBidirected()) {
+            ++edgeBasedNode;
+        }
+        _queryData.nodeHelpDesk->GetCompressedGeometry(edgeBasedNode, geometry);
+        if(geometry.empty()) {
+            return;
+        }
+        first = 1 + GetSegmentPosition(startPhantom, edgeBasedNode, geometry.size() - 1);
+        last = 1 + GetSegmentPosition(targetPhantom, edgeBasedNode, geometry.size() - 1);
+    } else {
+        //the road of the target begins at the last turn
+        FixedPointCoordinate lastTurn;
+        GetCoordinatesForNodeID(path.back().node, lastTurn);
+        edgeBasedNode = targetPhantom.edgeBasedNode;
+        _queryData.nodeHelpDesk->GetCompressedGeometry(edgeBasedNode, geometry);
+        if(!geometry.empty() && !(geometry.front() == lastTurn) && targetPhantom.isBidirected()) {
+            ++edgeBasedNode;
+            _queryData.nodeHelpDesk->GetCompressedGeometry(edgeBasedNode, geometry);
+        }
+        if(geometry.empty()) {
+            return;
+        }
+        last = 1 + GetSegmentPosition(targetPhantom, edgeBasedNode, geometry.size() - 1);
+    }
+    for(unsigned i = first; i < last; ++i) {
+        result.push_back(geometry[i]);
+    }
+}
+
 void SearchEngine::FindPhantomNodeForCoordinate(
     const FixedPointCoordinate & location,
     PhantomNode & result,
@@ -50,6 +158,22 @@ void SearchEngine::FindPhantomNodeForCoordinate(
     );
 }
 
+void SearchEngine::FindKNearestPhantomNodesForCoordinate(
+    const FixedPointCoordinate & location,
+    const unsigned zoomLevel,
+    const unsigned candidateCount,
+    const double maxDistance,
+    std::vector<std::pair<PhantomNode, double> > & result
+    ) const {
+    _queryData.nodeHelpDesk->FindKNearestPhantomNodesForCoordinate(
+        location,
+        zoomLevel,
+        candidateCount,
+        maxDistance,
+        result
+    );
+}
+
 NodeID SearchEngine::GetNameIDForOriginDestinationNodeID(
     const NodeID s,
     const NodeID t
@@ -27,6 +27,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include "QueryEdge.h"
 #include "SearchEngineData.h"
 #include "../RoutingAlgorithms/AlternativePathRouting.h"
+#include "../RoutingAlgorithms/ManyToManyRouting.h"
 #include "../RoutingAlgorithms/ShortestPathRouting.h"
 
 #include "../Util/StringUtil.h"
@@ -43,6 +44,7 @@ private:
 public:
     ShortestPathRouting<SearchEngineData> shortestPath;
     AlternativeRouting<SearchEngineData> alternativePaths;
+    ManyToManyRouting<SearchEngineData> distanceTable;
 
     SearchEngine(
         QueryGraph * g,
@@ -53,12 +55,28 @@ public:
 
 	void GetCoordinatesForNodeID(NodeID id, FixedPointCoordinate& result) const;
 
+    void GetIntermediateGeometry(
+        const std::vector<_PathData> & path,
+        const unsigned index,
+        const PhantomNodes & phantomNodes,
+        const std::vector<PhantomNodes> & legs,
+        std::vector<FixedPointCoordinate> & result
+    ) const;
+
     void FindPhantomNodeForCoordinate(
         const FixedPointCoordinate & location,
         PhantomNode & result,
         unsigned zoomLevel
     ) const;
 
+    void FindKNearestPhantomNodesForCoordinate(
+        const FixedPointCoordinate & location,
+        const unsigned zoomLevel,
+        const unsigned candidateCount,
+        const double maxDistance,
+        std::vector<std::pair<PhantomNode, double> > & result
+    ) const;
+
     NodeID GetNameIDForOriginDestinationNodeID(
         const NodeID s, const NodeID t) const;
 
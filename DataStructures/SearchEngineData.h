@@ -18,6 +18,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 or see http://www.gnu.org/licenses/agpl.txt.
  */
 
+#ifndef SEARCHENGINEDATA_H_
+#define SEARCHENGINEDATA_H_
+
 #include "BinaryHeap.h"
 #include "QueryEdge.h"
 #include "NodeInformationHelpDesk.h"
@@ -58,3 +61,5 @@ struct SearchEngineData {
 
     void InitializeOrClearThirdThreadLocalStorage();
 };
+
+#endif /* SEARCHENGINEDATA_H_ */
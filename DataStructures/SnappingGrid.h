@@ -0,0 +1,360 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef SNAPPINGGRID_H_
+#define SNAPPINGGRID_H_
+
+#include "Coordinate.h"
+#include "../Util/OSRMException.h"
+#include "../Util/SimpleLogger.h"
+#include "../typedefs.h"
+
+#include <boost/assert.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+//coarse cells of 0.01 degrees, dense ones are split into 8x8 fine cells
+static const int SNAPPING_GRID_COARSE_CELL_SIZE = 10000;
+static const int SNAPPING_GRID_FINE_CELLS = 8;
+static const int SNAPPING_GRID_FINE_CELL_SIZE = SNAPPING_GRID_COARSE_CELL_SIZE/SNAPPING_GRID_FINE_CELLS;
+//a fine cell lists all segments that come this close to it
+static const int SNAPPING_GRID_MARGIN = SNAPPING_GRID_FINE_CELL_SIZE;
+//coarse cells with fewer segments are left to the r-tree
+static const unsigned SNAPPING_GRID_MIN_SEGMENTS = 256;
+
+/*
+ * Two-level uniform grid over the segments of dense areas. Coarse cells are
+ * kept sparsely, only those touched by many segments are split into fine
+ * cells. Each fine cell lists every segment that comes within
+ * SNAPPING_GRID_MARGIN of it. If the nearest listed segment is at most that
+ * far from a coordinate in the cell, no other segment can be closer and the
+ * cell answers the query on its own. Otherwise the caller falls back to the
+ * r-tree. Distances are planar in fixed point units, like the ones of the
+ * nearest neighbor search in StaticRTree.
+ *
+ * File layout (all values in host byte order):
+ *   unsigned  number of dense coarse cells, followed by their sorted keys
+ *   unsigned  number of segment references, followed by the offsets of the
+ *             fine cells into them and the references themselves
+ *   unsigned  number of segments, followed by the segments
+ */
+template<class DataT>
+class SnappingGrid : boost::noncopyable {
+public:
+    explicit SnappingGrid(const std::vector<DataT> & input_data_vector) {
+        //count the segments per coarse cell
+        std::vector<uint32_t> touched_cells;
+        for(unsigned i = 0; i < input_data_vector.size(); ++i) {
+            int row_begin, row_end, column_begin, column_end;
+            GetCellRange(input_data_vector[i], SNAPPING_GRID_COARSE_CELL_SIZE, row_begin, row_end, column_begin, column_end);
+            for(int row = row_begin; row <= row_end; ++row) {
+                for(int column = column_begin; column <= column_end; ++column) {
+                    if(IsNearCell(input_data_vector[i], SNAPPING_GRID_COARSE_CELL_SIZE, row, column)) {
+                        touched_cells.push_back(GetCoarseKey(row, column));
+                    }
+                }
+            }
+        }
+        std::sort(touched_cells.begin(), touched_cells.end());
+        for(unsigned i = 0; i < touched_cells.size(); ) {
+            unsigned j = i;
+            while(j < touched_cells.size() && touched_cells[j] == touched_cells[i]) {
+                ++j;
+            }
+            if(SNAPPING_GRID_MIN_SEGMENTS <= j - i) {
+                dense_cells.push_back(touched_cells[i]);
+            }
+            i = j;
+        }
+        std::vector<uint32_t>().swap(touched_cells);
+
+        //list the segments of each fine cell
+        std::vector<std::pair<uint32_t, uint32_t> > cell_segment_pairs;
+        for(unsigned i = 0; i < input_data_vector.size(); ++i) {
+            int row_begin, row_end, column_begin, column_end;
+            GetCellRange(input_data_vector[i], SNAPPING_GRID_FINE_CELL_SIZE, row_begin, row_end, column_begin, column_end);
+            for(int row = row_begin; row <= row_end; ++row) {
+                for(int column = column_begin; column <= column_end; ++column) {
+                    uint32_t fine_cell = 0;
+                    if(
+                        GetFineCell(row, column, fine_cell) &&
+                        IsNearCell(input_data_vector[i], SNAPPING_GRID_FINE_CELL_SIZE, row, column)
+                    ) {
+                        cell_segment_pairs.push_back(std::make_pair(fine_cell, i));
+                    }
+                }
+            }
+        }
+        std::sort(cell_segment_pairs.begin(), cell_segment_pairs.end());
+
+        //only keep the segments that are listed somewhere
+        std::vector<uint32_t> segment_ids(cell_segment_pairs.size());
+        for(unsigned i = 0; i < cell_segment_pairs.size(); ++i) {
+            segment_ids[i] = cell_segment_pairs[i].second;
+        }
+        std::sort(segment_ids.begin(), segment_ids.end());
+        segment_ids.erase(std::unique(segment_ids.begin(), segment_ids.end()), segment_ids.end());
+        segments.reserve(segment_ids.size());
+        for(unsigned i = 0; i < segment_ids.size(); ++i) {
+            segments.push_back(input_data_vector[segment_ids[i]]);
+        }
+
+        const unsigned number_of_fine_cells = dense_cells.size()*SNAPPING_GRID_FINE_CELLS*SNAPPING_GRID_FINE_CELLS;
+        cell_offsets.resize(number_of_fine_cells+1, 0);
+        segment_references.resize(cell_segment_pairs.size());
+        for(unsigned i = 0; i < cell_segment_pairs.size(); ++i) {
+            ++cell_offsets[cell_segment_pairs[i].first+1];
+            segment_references[i] = std::lower_bound(
+                segment_ids.begin(),
+                segment_ids.end(),
+                cell_segment_pairs[i].second
+            ) - segment_ids.begin();
+        }
+        for(unsigned i = 0; i < number_of_fine_cells; ++i) {
+            cell_offsets[i+1] += cell_offsets[i];
+        }
+        SimpleLogger().Write() << "snapping grid has " << dense_cells.size() << " dense cells with " <<
+            segments.size() << " segments";
+    }
+
+    explicit SnappingGrid(const std::string & grid_filename) {
+        boost::filesystem::path grid_file(grid_filename);
+        if ( !boost::filesystem::exists( grid_file ) ) {
+            throw OSRMException("grid index file does not exist");
+        }
+        boost::filesystem::ifstream input(grid_file, std::ios::binary);
+        ReadVector(input, dense_cells);
+        ReadVector(input, segment_references);
+        cell_offsets.resize(dense_cells.size()*SNAPPING_GRID_FINE_CELLS*SNAPPING_GRID_FINE_CELLS+1);
+        input.read((char *)&cell_offsets[0], cell_offsets.size()*sizeof(uint32_t));
+        ReadVector(input, segments);
+        if(!input || cell_offsets.back() != segment_references.size()) {
+            throw OSRMException("grid index file is corrupt");
+        }
+        SimpleLogger().Write() << "loaded snapping grid of " << dense_cells.size() << " dense cells";
+    }
+
+    void Write(const std::string & grid_filename) const {
+        boost::filesystem::ofstream output(boost::filesystem::path(grid_filename), std::ios::binary);
+        WriteVector(output, dense_cells);
+        WriteVector(output, segment_references);
+        output.write((char *)&cell_offsets[0], cell_offsets.size()*sizeof(uint32_t));
+        WriteVector(output, segments);
+    }
+
+    //Returns false if the coordinate is not in a dense cell
+    inline bool GetCellSegments(
+        const FixedPointCoordinate & coordinate,
+        const uint32_t * & begin,
+        const uint32_t * & end
+    ) const {
+        const int64_t lat = ShiftLatitude(coordinate.lat);
+        const int64_t lon = ShiftLongitude(coordinate.lon);
+        if(0 > lat || 0 > lon) {
+            return false;
+        }
+        uint32_t fine_cell = 0;
+        if(!GetFineCell(lat/SNAPPING_GRID_FINE_CELL_SIZE, lon/SNAPPING_GRID_FINE_CELL_SIZE, fine_cell)) {
+            return false;
+        }
+        begin = &segment_references[0] + cell_offsets[fine_cell];
+        end = &segment_references[0] + cell_offsets[fine_cell+1];
+        return true;
+    }
+
+    inline const DataT & GetSegment(const uint32_t segment_reference) const {
+        return segments[segment_reference];
+    }
+
+    //Squared distance up to which the segments of a cell are complete, with
+    //some slack for rounding in the distance computation
+    static inline double GetSquaredMargin() {
+        return double(SNAPPING_GRID_MARGIN-1)*double(SNAPPING_GRID_MARGIN-1);
+    }
+
+private:
+    static inline int64_t ShiftLatitude(const int lat) {
+        return int64_t(lat) + int64_t(90*COORDINATE_PRECISION);
+    }
+
+    static inline int64_t ShiftLongitude(const int lon) {
+        return int64_t(lon) + int64_t(180*COORDINATE_PRECISION);
+    }
+
+    static inline uint32_t GetCoarseKey(const int row, const int column) {
+        return (uint32_t(row) << 16) | uint32_t(column);
+    }
+
+    //Cells of the given size touched by the bounding box grown by the
+    //margin, a superset of the cells the segment comes near to
+    static void GetCellRange(
+        const DataT & segment,
+        const int cell_size,
+        int & row_begin,
+        int & row_end,
+        int & column_begin,
+        int & column_end
+    ) {
+        const int64_t min_lat = ShiftLatitude(std::min(segment.lat1, segment.lat2)) - SNAPPING_GRID_MARGIN - 1;
+        const int64_t max_lat = ShiftLatitude(std::max(segment.lat1, segment.lat2)) + SNAPPING_GRID_MARGIN;
+        const int64_t min_lon = ShiftLongitude(std::min(segment.lon1, segment.lon2)) - SNAPPING_GRID_MARGIN - 1;
+        const int64_t max_lon = ShiftLongitude(std::max(segment.lon1, segment.lon2)) + SNAPPING_GRID_MARGIN;
+        row_begin = std::max(int64_t(0), min_lat)/cell_size;
+        row_end = std::max(int64_t(0), max_lat)/cell_size;
+        column_begin = std::max(int64_t(0), min_lon)/cell_size;
+        column_end = std::max(int64_t(0), max_lon)/cell_size;
+    }
+
+    //Whether the segment comes within the margin of the cell, i.e. it crosses
+    //the cell or one of its endpoints or corners is close enough
+    static bool IsNearCell(const DataT & segment, const int cell_size, const int row, const int column) {
+        const double min_lat = double(row)*cell_size;
+        const double max_lat = min_lat + cell_size;
+        const double min_lon = double(column)*cell_size;
+        const double max_lon = min_lon + cell_size;
+        const double lat1 = double(ShiftLatitude(segment.lat1));
+        const double lon1 = double(ShiftLongitude(segment.lon1));
+        const double lat2 = double(ShiftLatitude(segment.lat2));
+        const double lon2 = double(ShiftLongitude(segment.lon2));
+        if(CrossesRectangle(lat1, lon1, lat2, lon2, min_lat, min_lon, max_lat, max_lon)) {
+            return true;
+        }
+        const double squared_margin = double(SNAPPING_GRID_MARGIN)*double(SNAPPING_GRID_MARGIN);
+        const double corners[4][2] = {
+            { min_lat, min_lon }, { min_lat, max_lon }, { max_lat, min_lon }, { max_lat, max_lon }
+        };
+        for(unsigned i = 0; i < 4; ++i) {
+            if(GetSquaredDistanceToSegment(corners[i][0], corners[i][1], lat1, lon1, lat2, lon2) <= squared_margin) {
+                return true;
+            }
+        }
+        return
+            GetSquaredDistanceToRectangle(lat1, lon1, min_lat, min_lon, max_lat, max_lon) <= squared_margin ||
+            GetSquaredDistanceToRectangle(lat2, lon2, min_lat, min_lon, max_lat, max_lon) <= squared_margin;
+    }
+
+    //Clips the segment against the rectangle like Liang-Barsky
+    static bool CrossesRectangle(
+        const double lat1, const double lon1,
+        const double lat2, const double lon2,
+        const double min_lat, const double min_lon,
+        const double max_lat, const double max_lon
+    ) {
+        double enter = 0.;
+        double leave = 1.;
+        return
+            ClipToSlab(lat1, lat2 - lat1, min_lat, max_lat, enter, leave) &&
+            ClipToSlab(lon1, lon2 - lon1, min_lon, max_lon, enter, leave);
+    }
+
+    static bool ClipToSlab(
+        const double start,
+        const double delta,
+        const double min,
+        const double max,
+        double & enter,
+        double & leave
+    ) {
+        if(0. == delta) {
+            return min <= start && start <= max;
+        }
+        const double first = (min - start)/delta;
+        const double second = (max - start)/delta;
+        enter = std::max(enter, std::min(first, second));
+        leave = std::min(leave, std::max(first, second));
+        return enter <= leave;
+    }
+
+    static double GetSquaredDistanceToSegment(
+        const double lat, const double lon,
+        const double lat1, const double lon1,
+        const double lat2, const double lon2
+    ) {
+        const double delta_lat = lat2 - lat1;
+        const double delta_lon = lon2 - lon1;
+        const double squared_length = delta_lat*delta_lat + delta_lon*delta_lon;
+        double ratio = 0.;
+        if(0. < squared_length) {
+            ratio = std::max(0., std::min(1., ((lat - lat1)*delta_lat + (lon - lon1)*delta_lon)/squared_length));
+        }
+        const double nearest_lat = lat1 + ratio*delta_lat - lat;
+        const double nearest_lon = lon1 + ratio*delta_lon - lon;
+        return nearest_lat*nearest_lat + nearest_lon*nearest_lon;
+    }
+
+    static double GetSquaredDistanceToRectangle(
+        const double lat, const double lon,
+        const double min_lat, const double min_lon,
+        const double max_lat, const double max_lon
+    ) {
+        const double lat_distance = std::max(0., std::max(min_lat - lat, lat - max_lat));
+        const double lon_distance = std::max(0., std::max(min_lon - lon, lon - max_lon));
+        return lat_distance*lat_distance + lon_distance*lon_distance;
+    }
+
+    //Index of a fine cell, given in rows and columns of fine cells
+    inline bool GetFineCell(const int row, const int column, uint32_t & fine_cell) const {
+        const uint32_t key = GetCoarseKey(row/SNAPPING_GRID_FINE_CELLS, column/SNAPPING_GRID_FINE_CELLS);
+        const std::vector<uint32_t>::const_iterator cell = std::lower_bound(
+            dense_cells.begin(),
+            dense_cells.end(),
+            key
+        );
+        if(cell == dense_cells.end() || *cell != key) {
+            return false;
+        }
+        fine_cell = (cell - dense_cells.begin())*SNAPPING_GRID_FINE_CELLS*SNAPPING_GRID_FINE_CELLS +
+            (row%SNAPPING_GRID_FINE_CELLS)*SNAPPING_GRID_FINE_CELLS + column%SNAPPING_GRID_FINE_CELLS;
+        return true;
+    }
+
+    template<class T>
+    static void ReadVector(boost::filesystem::ifstream & input, std::vector<T> & vector) {
+        unsigned size = 0;
+        input.read((char *)&size, sizeof(unsigned));
+        vector.resize(size);
+        if(0 < size) {
+            input.read((char *)&vector[0], size*sizeof(T));
+        }
+    }
+
+    template<class T>
+    static void WriteVector(boost::filesystem::ofstream & output, const std::vector<T> & vector) {
+        const unsigned size = vector.size();
+        output.write((char *)&size, sizeof(unsigned));
+        if(0 < size) {
+            output.write((char *)&vector[0], size*sizeof(T));
+        }
+    }
+
+    //sorted keys of the coarse cells that are split into fine cells
+    std::vector<uint32_t> dense_cells;
+    std::vector<uint32_t> cell_offsets;
+    std::vector<uint32_t> segment_references;
+    std::vector<DataT> segments;
+};
+
+#endif /* SNAPPINGGRID_H_ */
@@ -26,6 +26,8 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include "PhantomNodes.h"
 #include "DeallocatingVector.h"
 #include "HilbertValue.h"
+#include "SnappingGrid.h"
+#include "../Util/OpenMPWrapper.h"
 #include "../Util/OSRMException.h"
 #include "../Util/SimpleLogger.h"
 #include "../Util/TimingUtil.h"
@@ -40,6 +42,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include <boost/algorithm/minmax_element.hpp>
 #include <boost/range/algorithm_ext/erase.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 #include <cassert>
@@ -47,6 +50,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include <climits>
 
 #include <algorithm>
+#include <functional>
 #include <queue>
 #include <string>
 #include <vector>
@@ -54,6 +58,18 @@ or see http://www.gnu.org/licenses/agpl.txt.
 //tuning parameters
 const static uint32_t RTREE_BRANCHING_FACTOR = 50;
 const static uint32_t RTREE_LEAF_NODE_SIZE = 1170;
+//number of leaves that are packed in parallel and written at once
+const static uint32_t RTREE_LEAF_WRITE_BATCH = 64;
+//inputs below this size are sorted by a single thread
+const static uint64_t RTREE_PARALLEL_SORT_THRESHOLD = 1 << 16;
+//larger inputs are sorted in runs of this many elements on disk
+const static uint64_t RTREE_IN_MEMORY_SORT_LIMIT = 1 << 27;
+//hilbert values are computed in blocks of this many centroids
+const static uint32_t RTREE_HILBERT_BATCH_SIZE = 256;
+//elements of each run kept in RAM while merging
+const static uint32_t RTREE_MERGE_BUFFER_SIZE = 1 << 16;
+//child rectangles are stored in steps of 1/255 of their parent rectangle
+const static int64_t RTREE_QUANTIZATION_STEPS = UCHAR_MAX;
 
 // Implements a static, i.e. packed, R-tree
 
@@ -249,6 +265,13 @@ private:
         }
     };
 
+    //sort runs on disk carry the elements themselves, so that the input
+    //does not have to be kept in RAM while the runs are merged
+    struct SortedRunElement {
+        uint64_t m_hilbert_value;
+        DataT m_element;
+    };
+
     struct LeafNode {
         LeafNode() : object_count(0) {}
         uint32_t object_count;
@@ -263,25 +286,269 @@ private:
         uint32_t children[RTREE_BRANCHING_FACTOR];
     };
 
+    //In RAM the children of a node are numbered consecutively. Their
+    //rectangles are quantized relative to the rectangle of the parent and
+    //stored in one array per side, indexed by node id.
+    struct CompactTreeNode {
+        CompactTreeNode() : first_child(UINT_MAX), child_count(0), child_is_on_disk(false) {}
+        //id of the leaf if the child is on disk
+        uint32_t first_child;
+        uint32_t child_count:31;
+        bool child_is_on_disk:1;
+    };
+
     struct QueryCandidate {
         explicit QueryCandidate(
             const uint32_t n_id,
-            const double dist
-        ) : node_id(n_id), min_dist(dist) {}
+            const double dist,
+            const RectangleT & rect
+        ) : node_id(n_id), min_dist(dist), rectangle(rect) {}
         QueryCandidate() : node_id(UINT_MAX), min_dist(DBL_MAX) {}
         uint32_t node_id;
         double min_dist;
+        //decoded rectangle, contains the exact one
+        RectangleT rectangle;
         inline bool operator<(const QueryCandidate & other) const {
             return min_dist < other.min_dist;
         }
     };
 
+    struct QueryCandidateIsFurther {
+        inline bool operator()(const QueryCandidate & a, const QueryCandidate & b) const {
+            return a.min_dist > b.min_dist;
+        }
+    };
+
+    struct NearestSegment {
+        PhantomNode phantom_node;
+        FixedPointCoordinate start;
+        FixedPointCoordinate end;
+        double distance;
+        //weight of the segments before this one, per direction
+        int offset1;
+        int offset2;
+        inline bool operator<(const NearestSegment & other) const {
+            return distance < other.distance;
+        }
+    };
+
     std::vector<TreeNode> m_search_tree;
     uint64_t m_element_count;
 
+    std::vector<CompactTreeNode> m_compact_tree;
+    RectangleT m_root_rectangle;
+    std::vector<uint8_t> m_quantized_min_lat;
+    std::vector<uint8_t> m_quantized_max_lat;
+    std::vector<uint8_t> m_quantized_min_lon;
+    std::vector<uint8_t> m_quantized_max_lon;
+
+    //optional, answers most queries in dense areas without the tree
+    boost::scoped_ptr<SnappingGrid<DataT> > m_snapping_grid;
+
     const std::string m_leaf_node_filename;
+
+    //Get Hilbert-Values for centroids in mercartor projection
+    static void ComputeHilbertValues(
+        const std::vector<DataT> & input_data_vector,
+        const uint64_t begin,
+        const uint64_t end,
+        std::vector<WrappedInputElement> & output
+    ) {
+        output.resize(end - begin);
+#pragma omp parallel for schedule(guided)
+        for(uint64_t block_begin = begin; block_begin < end; block_begin += RTREE_HILBERT_BATCH_SIZE) {
+            const uint64_t block_size = std::min(uint64_t(RTREE_HILBERT_BATCH_SIZE), end - block_begin);
+            FixedPointCoordinate centroids[RTREE_HILBERT_BATCH_SIZE];
+            uint64_t hilbert_values[RTREE_HILBERT_BATCH_SIZE];
+            for(uint64_t i = 0; i < block_size; ++i) {
+                centroids[i] = input_data_vector[block_begin + i].Centroid();
+                centroids[i].lat = COORDINATE_PRECISION*lat2y(centroids[i].lat/COORDINATE_PRECISION);
+            }
+            HilbertCode::GetHilbertNumbersForCoordinates(centroids, block_size, hilbert_values);
+            for(uint64_t i = 0; i < block_size; ++i) {
+                WrappedInputElement & wrapped_element = output[block_begin - begin + i];
+                wrapped_element.m_array_index = block_begin + i;
+                wrapped_element.m_hilbert_value = hilbert_values[i];
+            }
+        }
+    }
+
+    //Sorts one chunk per thread and merges the chunks pairwise
+    static void ParallelSort(std::vector<WrappedInputElement> & input_wrapper_vector) {
+        const int number_of_chunks = omp_get_max_threads();
+        if(1 >= number_of_chunks || RTREE_PARALLEL_SORT_THRESHOLD > input_wrapper_vector.size()) {
+            std::sort(input_wrapper_vector.begin(), input_wrapper_vector.end());
+            return;
+        }
+        typedef typename std::vector<WrappedInputElement>::iterator WrappedIterator;
+        const WrappedIterator first = input_wrapper_vector.begin();
+        std::vector<uint64_t> chunk_bounds(number_of_chunks+1);
+        for(int i = 0; i <= number_of_chunks; ++i) {
+            chunk_bounds[i] = input_wrapper_vector.size()*i/number_of_chunks;
+        }
+#pragma omp parallel for schedule(static)
+        for(int i = 0; i < number_of_chunks; ++i) {
+            std::sort(first + chunk_bounds[i], first + chunk_bounds[i+1]);
+        }
+        for(int width = 1; width < number_of_chunks; width *= 2) {
+#pragma omp parallel for schedule(static)
+            for(int i = 0; i < number_of_chunks; i += 2*width) {
+                if(i + width < number_of_chunks) {
+                    std::inplace_merge(
+                        first + chunk_bounds[i],
+                        first + chunk_bounds[i + width],
+                        first + chunk_bounds[std::min(i + 2*width, number_of_chunks)]
+                    );
+                }
+            }
+        }
+    }
+
+    //Fills leaves from consecutive sorted elements in parallel and writes
+    //them with a single sequential write
+    static void PackLeaves(
+        const DataT * sorted_elements,
+        const uint64_t element_count,
+        std::vector<LeafNode> & leaf_buffer,
+        boost::filesystem::ofstream & leaf_node_file,
+        std::vector<TreeNode> & tree_nodes_in_level
+    ) {
+        const uint32_t leaf_count = (element_count + RTREE_LEAF_NODE_SIZE - 1)/RTREE_LEAF_NODE_SIZE;
+        BOOST_ASSERT_MSG(leaf_count <= leaf_buffer.size(), "leaf buffer too small");
+        std::vector<TreeNode> leaf_tree_nodes(leaf_count);
+#pragma omp parallel for schedule(guided)
+        for(uint32_t leaf_index = 0; leaf_index < leaf_count; ++leaf_index) {
+            LeafNode & current_leaf = leaf_buffer[leaf_index];
+            const uint64_t first_element = uint64_t(leaf_index)*RTREE_LEAF_NODE_SIZE;
+            current_leaf.object_count = std::min(uint64_t(RTREE_LEAF_NODE_SIZE), element_count - first_element);
+            for(uint32_t i = 0; i < current_leaf.object_count; ++i) {
+                current_leaf.objects[i] = sorted_elements[first_element + i];
+            }
+            //keep unused slots of the last leaf deterministic
+            std::fill(current_leaf.objects + current_leaf.object_count, current_leaf.objects + RTREE_LEAF_NODE_SIZE, DataT());
+
+            //generate tree node that resemble the objects in leaf and store it for next level
+            TreeNode & current_node = leaf_tree_nodes[leaf_index];
+            current_node.minimum_bounding_rectangle.InitializeMBRectangle(current_leaf.objects, current_leaf.object_count);
+            current_node.child_is_on_disk = true;
+        }
+        for(uint32_t leaf_index = 0; leaf_index < leaf_count; ++leaf_index) {
+            leaf_tree_nodes[leaf_index].children[0] = tree_nodes_in_level.size();
+            tree_nodes_in_level.push_back(leaf_tree_nodes[leaf_index]);
+        }
+        leaf_node_file.write((char*)&leaf_buffer[0], leaf_count*sizeof(LeafNode));
+    }
+
+    //Inputs that do not fit into RAM are sorted in runs that are merged
+    //from disk while the leaves are packed. The input is released as soon
+    //as all runs are written.
+    static void ExternalSortAndPack(
+        std::vector<DataT> & input_data_vector,
+        const std::string & run_filename,
+        std::vector<LeafNode> & leaf_buffer,
+        boost::filesystem::ofstream & leaf_node_file,
+        std::vector<TreeNode> & tree_nodes_in_level
+    ) {
+        const uint64_t element_count = input_data_vector.size();
+        double sort_start = get_timestamp();
+        std::vector<uint64_t> run_bounds(1, 0);
+        {
+            boost::filesystem::ofstream run_file(run_filename, std::ios::binary);
+            std::vector<WrappedInputElement> run_buffer;
+            std::vector<SortedRunElement> run_elements;
+            while(run_bounds.back() < element_count) {
+                const uint64_t run_end = std::min(element_count, run_bounds.back() + RTREE_IN_MEMORY_SORT_LIMIT);
+                ComputeHilbertValues(input_data_vector, run_bounds.back(), run_end, run_buffer);
+                ParallelSort(run_buffer);
+                run_elements.resize(run_buffer.size());
+#pragma omp parallel for schedule(guided)
+                for(uint64_t i = 0; i < run_buffer.size(); ++i) {
+                    run_elements[i].m_hilbert_value = run_buffer[i].m_hilbert_value;
+                    run_elements[i].m_element = input_data_vector[run_buffer[i].m_array_index];
+                }
+                run_file.write((char*)&run_elements[0], run_elements.size()*sizeof(SortedRunElement));
+                run_bounds.push_back(run_end);
+            }
+            if(!run_file) {
+                throw OSRMException("could not write r-tree sort runs");
+            }
+        }
+        std::vector<DataT>().swap(input_data_vector);
+        const uint32_t number_of_runs = run_bounds.size() - 1;
+        LogThroughput("sorted hilbert values into runs", element_count, get_timestamp() - sort_start);
+        SimpleLogger().Write(logDEBUG) << "merging " << number_of_runs << " sorted runs";
+
+        double pack_start = get_timestamp();
+        boost::filesystem::ifstream run_file(run_filename, std::ios::binary);
+        std::vector<std::vector<SortedRunElement> > run_heads(number_of_runs);
+        std::vector<uint64_t> run_positions(run_bounds.begin(), run_bounds.end() - 1);
+        std::vector<uint32_t> head_positions(number_of_runs, 0);
+        std::priority_queue<
+            std::pair<uint64_t, uint32_t>,
+            std::vector<std::pair<uint64_t, uint32_t> >,
+            std::greater<std::pair<uint64_t, uint32_t> >
+        > merge_queue;
+        for(uint32_t run = 0; run < number_of_runs; ++run) {
+            RefillRunHead(run_file, run_positions[run], run_bounds[run+1], run_heads[run]);
+            merge_queue.push(std::make_pair(run_heads[run][0].m_hilbert_value, run));
+        }
+
+        const uint64_t elements_per_batch = RTREE_LEAF_WRITE_BATCH*RTREE_LEAF_NODE_SIZE;
+        std::vector<DataT> merged_elements;
+        merged_elements.reserve(elements_per_batch);
+        while(!merge_queue.empty()) {
+            const uint32_t run = merge_queue.top().second;
+            merge_queue.pop();
+            merged_elements.push_back(run_heads[run][head_positions[run]].m_element);
+            if(++head_positions[run] == run_heads[run].size()) {
+                head_positions[run] = 0;
+                RefillRunHead(run_file, run_positions[run], run_bounds[run+1], run_heads[run]);
+            }
+            if(!run_heads[run].empty()) {
+                merge_queue.push(std::make_pair(run_heads[run][head_positions[run]].m_hilbert_value, run));
+            }
+            if(merged_elements.size() == elements_per_batch || merge_queue.empty()) {
+                PackLeaves(
+                    &merged_elements[0],
+                    merged_elements.size(),
+                    leaf_buffer,
+                    leaf_node_file,
+                    tree_nodes_in_level
+                );
+                merged_elements.clear();
+            }
+        }
+        run_file.close();
+        boost::filesystem::remove(run_filename);
+        LogThroughput("merged runs and packed leaves", element_count, get_timestamp() - pack_start);
+    }
+
+    static void RefillRunHead(
+        boost::filesystem::ifstream & run_file,
+        uint64_t & run_position,
+        const uint64_t run_end,
+        std::vector<SortedRunElement> & run_head
+    ) {
+        run_head.resize(std::min(uint64_t(RTREE_MERGE_BUFFER_SIZE), run_end - run_position));
+        if(run_head.empty()) {
+            return;
+        }
+        run_file.seekg(run_position*sizeof(SortedRunElement));
+        run_file.read((char*)&run_head[0], run_head.size()*sizeof(SortedRunElement));
+        if(!run_file) {
+            throw OSRMException("could not read r-tree sort runs");
+        }
+        run_position += run_head.size();
+    }
+
+    static void LogThroughput(const char * step, const uint64_t element_count, const double seconds) {
+        SimpleLogger().Write() << step << ": " << element_count << " elements in " << seconds <<
+            " seconds, " << (0. < seconds ? element_count/seconds : 0.) << " elements/s";
+    }
+
 public:
-    //Construct a packed Hilbert-R-Tree with Kamel-Faloutsos algorithm [1]
+    //Construct a packed Hilbert-R-Tree with Kamel-Faloutsos algorithm [1].
+    //Consumes the input, which is empty once all leaves are on disk.
     explicit StaticRTree(
         std::vector<DataT> & input_data_vector,
         const std::string tree_node_filename,
@@ -295,53 +562,52 @@ public:
             " elements";
 
         double time1 = get_timestamp();
-        std::vector<WrappedInputElement> input_wrapper_vector(m_element_count);
-
-        //generate auxiliary vector of hilbert-values
-#pragma omp parallel for schedule(guided)
-        for(uint64_t element_counter = 0; element_counter < m_element_count; ++element_counter) {
-            input_wrapper_vector[element_counter].m_array_index = element_counter;
-            //Get Hilbert-Value for centroid in mercartor projection
-            DataT & current_element = input_data_vector[element_counter];
-            FixedPointCoordinate current_centroid = current_element.Centroid();
-            current_centroid.lat = COORDINATE_PRECISION*lat2y(current_centroid.lat/COORDINATE_PRECISION);
 
-            uint64_t current_hilbert_value = HilbertCode::GetHilbertNumberForCoordinate(current_centroid);
-            input_wrapper_vector[element_counter].m_hilbert_value = current_hilbert_value;
-
-        }
         //open leaf file
         boost::filesystem::ofstream leaf_node_file(leaf_node_filename, std::ios::binary);
         leaf_node_file.write((char*) &m_element_count, sizeof(uint64_t));
 
-        //sort the hilbert-value representatives
-        std::sort(input_wrapper_vector.begin(), input_wrapper_vector.end());
         std::vector<TreeNode> tree_nodes_in_level;
-
-        //pack M elements into leaf node and write to leaf file
-        uint64_t processed_objects_count = 0;
-        while(processed_objects_count < m_element_count) {
-
-            LeafNode current_leaf;
-            TreeNode current_node;
-            for(uint32_t current_element_index = 0; RTREE_LEAF_NODE_SIZE > current_element_index; ++current_element_index) {
-                if(m_element_count > (processed_objects_count + current_element_index)) {
-                    uint32_t index_of_next_object = input_wrapper_vector[processed_objects_count + current_element_index].m_array_index;
-                    current_leaf.objects[current_element_index] = input_data_vector[index_of_next_object];
-                    ++current_leaf.object_count;
+        std::vector<LeafNode> leaf_buffer(RTREE_LEAF_WRITE_BATCH);
+        if(m_element_count <= RTREE_IN_MEMORY_SORT_LIMIT) {
+            std::vector<WrappedInputElement> input_wrapper_vector(m_element_count);
+            ComputeHilbertValues(input_data_vector, 0, m_element_count, input_wrapper_vector);
+
+            //sort the hilbert-value representatives
+            double sort_start = get_timestamp();
+            ParallelSort(input_wrapper_vector);
+            LogThroughput("sorted hilbert values", m_element_count, get_timestamp() - sort_start);
+
+            //pack M elements into leaf node and write to leaf file
+            double pack_start = get_timestamp();
+            const uint64_t elements_per_batch = RTREE_LEAF_WRITE_BATCH*RTREE_LEAF_NODE_SIZE;
+            std::vector<DataT> sorted_elements;
+            for(uint64_t offset = 0; offset < m_element_count; offset += elements_per_batch) {
+                sorted_elements.resize(std::min(elements_per_batch, m_element_count - offset));
+#pragma omp parallel for schedule(guided)
+                for(uint64_t i = 0; i < sorted_elements.size(); ++i) {
+                    sorted_elements[i] = input_data_vector[input_wrapper_vector[offset + i].m_array_index];
                 }
+                PackLeaves(
+                    &sorted_elements[0],
+                    sorted_elements.size(),
+                    leaf_buffer,
+                    leaf_node_file,
+                    tree_nodes_in_level
+                );
             }
-
-            //generate tree node that resemble the objects in leaf and store it for next level
-            current_node.minimum_bounding_rectangle.InitializeMBRectangle(current_leaf.objects, current_leaf.object_count);
-            current_node.child_is_on_disk = true;
-            current_node.children[0] = tree_nodes_in_level.size();
-            tree_nodes_in_level.push_back(current_node);
-
-            //write leaf_node to leaf node file
-            leaf_node_file.write((char*)&current_leaf, sizeof(current_leaf));
-            processed_objects_count += current_leaf.object_count;
+            LogThroughput("packed leaves", m_element_count, get_timestamp() - pack_start);
+            std::vector<DataT>().swap(input_data_vector);
+        } else {
+            ExternalSortAndPack(
+                input_data_vector,
+                leaf_node_filename + ".runs",
+                leaf_buffer,
+                leaf_node_file,
+                tree_nodes_in_level
+            );
         }
+        std::vector<LeafNode>().swap(leaf_buffer);
 
         //close leaf file
         leaf_node_file.close();
@@ -406,12 +672,14 @@ public:
         double time2 = get_timestamp();
         SimpleLogger().Write() <<
             "finished r-tree construction in " << (time2-time1) << " seconds";
+        LogThroughput("built r-tree", m_element_count, time2-time1);
     }
 
     //Read-only operation for queries
     explicit StaticRTree(
             const std::string & node_filename,
-            const std::string & leaf_filename
+            const std::string & leaf_filename,
+            const std::string & grid_filename = std::string()
     ) : m_leaf_node_filename(leaf_filename) {
         //open tree node file and load into RAM.
         boost::filesystem::path node_file(node_filename);
@@ -430,6 +698,8 @@ public:
         m_search_tree.resize(tree_size);
         tree_node_file.read((char*)&m_search_tree[0], sizeof(TreeNode)*tree_size);
         tree_node_file.close();
+        CompactSearchTree();
+        std::vector<TreeNode>().swap(m_search_tree);
 
         //open leaf node file and store thread specific pointer
         boost::filesystem::path leaf_file(leaf_filename);
@@ -444,157 +714,109 @@ public:
         leaf_node_file.read((char*)&m_element_count, sizeof(uint64_t));
         leaf_node_file.close();
 
+        if(!grid_filename.empty()) {
+            m_snapping_grid.reset(new SnappingGrid<DataT>(grid_filename));
+        }
+
         //SimpleLogger().Write() << tree_size << " nodes in search tree";
         //SimpleLogger().Write() << m_element_count << " elements in leafs";
     }
-/*
-    inline void FindKNearestPhantomNodesForCoordinate(
-        const FixedPointCoordinate & location,
+    //Returns up to candidate_count phantom nodes on distinct road segments,
+    //ordered by their distance in meters to the input coordinate. Segments
+    //further away than max_distance meters are not considered.
+    void FindKNearestPhantomNodesForCoordinate(
+        const FixedPointCoordinate & input_coordinate,
         const unsigned zoom_level,
         const unsigned candidate_count,
+        const double max_distance,
         std::vector<std::pair<PhantomNode, double> > & result_vector
-    ) const {
-
-        bool ignore_tiny_components = (zoom_level <= 14);
-        DataT nearest_edge;
-
-        uint32_t io_count = 0;
-        uint32_t explored_tree_nodes_count = 0;
-        SimpleLogger().Write() << "searching for coordinate " << input_coordinate;
-        double min_dist = DBL_MAX;
-        double min_max_dist = DBL_MAX;
-        bool found_a_nearest_edge = false;
-
-        FixedPointCoordinate nearest, current_start_coordinate, current_end_coordinate;
+    ) {
+        result_vector.clear();
+        if(0 == candidate_count) {
+            return;
+        }
+        const bool ignore_tiny_components = (zoom_level <= 14);
+        std::vector<NearestSegment> candidates;
+        double max_candidate_distance = max_distance;
 
-        //initialize queue with root element
-        std::priority_queue<QueryCandidate> traversal_queue;
-        traversal_queue.push(QueryCandidate(0, m_search_tree[0].minimum_bounding_rectangle.GetMinDist(input_coordinate)));
-        BOOST_ASSERT_MSG(FLT_EPSILON > (0. - traversal_queue.top().min_dist), "Root element in NN Search has min dist != 0.");
+        //best first, closest bounding rectangle on top
+        std::priority_queue<QueryCandidate, std::vector<QueryCandidate>, QueryCandidateIsFurther> traversal_queue;
+        traversal_queue.push(QueryCandidate(0, 0., m_root_rectangle));
 
         while(!traversal_queue.empty()) {
             const QueryCandidate current_query_node = traversal_queue.top(); traversal_queue.pop();
-
-            ++explored_tree_nodes_count;
-            bool prune_downward = (current_query_node.min_dist >= min_max_dist);
-            bool prune_upward    = (current_query_node.min_dist >= min_dist);
-            if( !prune_downward && !prune_upward ) { //downward pruning
-                TreeNode & current_tree_node = m_search_tree[current_query_node.node_id];
-                if (current_tree_node.child_is_on_disk) {
-                    LeafNode current_leaf_node;
-                    LoadLeafFromDisk(current_tree_node.children[0], current_leaf_node);
-                    ++io_count;
-                    for(uint32_t i = 0; i < current_leaf_node.object_count; ++i) {
-                        DataT & current_edge = current_leaf_node.objects[i];
-                        if(ignore_tiny_components && current_edge.belongsToTinyComponent) {
-                            continue;
-                        }
-
-                        double current_ratio = 0.;
-                        double current_perpendicular_distance = ComputePerpendicularDistance(
-                                                                                             input_coordinate,
-                                                                                             FixedPointCoordinate(current_edge.lat1, current_edge.lon1),
-                                                                                             FixedPointCoordinate(current_edge.lat2, current_edge.lon2),
-                                                                                             nearest,
-                                                                                             &current_ratio
-                                                                                             );
-
-                        if(
-                           current_perpendicular_distance < min_dist
-                           && !DoubleEpsilonCompare(
-                                                    current_perpendicular_distance,
-                                                    min_dist
-                                                    )
-                           ) { //found a new minimum
-                            min_dist = current_perpendicular_distance;
-                            result_phantom_node.edgeBasedNode = current_edge.id;
-                            result_phantom_node.nodeBasedEdgeNameID = current_edge.nameID;
-                            result_phantom_node.weight1 = current_edge.weight;
-                            result_phantom_node.weight2 = INT_MAX;
-                            result_phantom_node.location = nearest;
-                            current_start_coordinate.lat = current_edge.lat1;
-                            current_start_coordinate.lon = current_edge.lon1;
-                            current_end_coordinate.lat = current_edge.lat2;
-                            current_end_coordinate.lon = current_edge.lon2;
-                            nearest_edge = current_edge;
-                            found_a_nearest_edge = true;
-                        } else if(
-                                  DoubleEpsilonCompare(current_perpendicular_distance, min_dist) &&
-                                  1 == abs(current_edge.id - result_phantom_node.edgeBasedNode )
-                                  && CoordinatesAreEquivalent(
-                                                              current_start_coordinate,
-                                                              FixedPointCoordinate(
-                                                                          current_edge.lat1,
-                                                                          current_edge.lon1
-                                                                          ),
-                                                              FixedPointCoordinate(
-                                                                          current_edge.lat2,
-                                                                          current_edge.lon2
-                                                                          ),
-                                                              current_end_coordinate
-                                                              )
-                                  ) {
-                            result_phantom_node.edgeBasedNode = std::min(current_edge.id, result_phantom_node.edgeBasedNode);
-                            result_phantom_node.weight2 = current_edge.weight;
-                        }
-                    }
-                } else {
-                    //traverse children, prune if global mindist is smaller than local one
-                    for (uint32_t i = 0; i < current_tree_node.child_count; ++i) {
-                        const int32_t child_id = current_tree_node.children[i];
-                        TreeNode & child_tree_node = m_search_tree[child_id];
-                        RectangleT & child_rectangle = child_tree_node.minimum_bounding_rectangle;
-                        const double current_min_dist = child_rectangle.GetMinDist(input_coordinate);
-                        const double current_min_max_dist = child_rectangle.GetMinMaxDist(input_coordinate);
-                        if( current_min_max_dist < min_max_dist ) {
-                            min_max_dist = current_min_max_dist;
-                        }
-                        if (current_min_dist > min_max_dist) {
-                            continue;
-                        }
-                        if (current_min_dist > min_dist) { //upward pruning
-                            continue;
-                        }
-                        traversal_queue.push(QueryCandidate(child_id, current_min_dist));
+            if(current_query_node.min_dist > max_candidate_distance) {
+                break;
+            }
+            const CompactTreeNode & current_tree_node = m_compact_tree[current_query_node.node_id];
+            if(!current_tree_node.child_is_on_disk) {
+                RectangleT child_rectangles[RTREE_BRANCHING_FACTOR];
+                DecodeChildRectangles(current_tree_node, current_query_node.rectangle, child_rectangles);
+                for (uint32_t i = 0; i < current_tree_node.child_count; ++i) {
+                    const double child_min_dist = GetDistanceToRectangle(
+                        input_coordinate,
+                        child_rectangles[i]
+                    );
+                    if(child_min_dist <= max_candidate_distance) {
+                        traversal_queue.push(QueryCandidate(current_tree_node.first_child + i, child_min_dist, child_rectangles[i]));
                     }
                 }
+                continue;
             }
-        }
 
-        const double distance_to_edge =
-        ApproximateDistance (
-            FixedPointCoordinate(nearest_edge.lat1, nearest_edge.lon1),
-            result_phantom_node.location
-        );
-
-        const double length_of_edge =
-        ApproximateDistance(
-            FixedPointCoordinate(nearest_edge.lat1, nearest_edge.lon1),
-            FixedPointCoordinate(nearest_edge.lat2, nearest_edge.lon2)
-        );
-
-        const double ratio = (found_a_nearest_edge ?
-          std::min(1., distance_to_edge/ length_of_edge ) : 0 );
-        result_phantom_node.weight1 *= ratio;
-        if(INT_MAX != result_phantom_node.weight2) {
-            result_phantom_node.weight2 *= (1.-ratio);
+            LeafNode current_leaf_node;
+            LoadLeafFromDisk(current_tree_node.first_child, current_leaf_node);
+            for(uint32_t i = 0; i < current_leaf_node.object_count; ++i) {
+                const DataT & current_edge = current_leaf_node.objects[i];
+                if(ignore_tiny_components && current_edge.belongsToTinyComponent) {
+                    continue;
+                }
+                if(current_edge.isIgnored()) {
+                    continue;
+                }
+                double current_ratio = 0.;
+                FixedPointCoordinate nearest;
+                const FixedPointCoordinate start(current_edge.lat1, current_edge.lon1);
+                const FixedPointCoordinate end(current_edge.lat2, current_edge.lon2);
+                ComputePerpendicularDistance(input_coordinate, start, end, nearest, &current_ratio);
+                const double current_distance = ApproximateDistance(input_coordinate, nearest);
+                if(current_distance > max_candidate_distance) {
+                    continue;
+                }
+                if(MergeIntoBidirectedSegment(candidates, current_edge, start, end)) {
+                    continue;
+                }
+                NearestSegment segment;
+                segment.phantom_node.edgeBasedNode = current_edge.id;
+                segment.phantom_node.nodeBasedEdgeNameID = current_edge.nameID;
+                segment.phantom_node.weight1 = current_edge.weight;
+                segment.phantom_node.weight2 = INT_MAX;
+                segment.phantom_node.segmentPosition = current_edge.segmentPosition;
+                segment.phantom_node.location = nearest;
+                segment.start = start;
+                segment.end = end;
+                segment.distance = current_distance;
+                segment.offset1 = current_edge.offset;
+                segment.offset2 = 0;
+                candidates.push_back(segment);
+            }
+            //keep the closest ones, which also tightens the search radius
+            std::stable_sort(candidates.begin(), candidates.end());
+            RemoveFurtherSegmentsOfSameNode(candidates);
+            if(candidates.size() >= candidate_count) {
+                candidates.resize(candidate_count);
+                max_candidate_distance = candidates.back().distance;
+            }
         }
-        result_phantom_node.ratio = ratio;
 
-        //Hack to fix rounding errors and wandering via nodes.
-        if(std::abs(input_coordinate.lon - result_phantom_node.location.lon) == 1) {
-            result_phantom_node.location.lon = input_coordinate.lon;
-        }
-        if(std::abs(input_coordinate.lat - result_phantom_node.location.lat) == 1) {
-            result_phantom_node.location.lat = input_coordinate.lat;
+        BOOST_FOREACH(NearestSegment & segment, candidates) {
+            PhantomNode & phantom_node = segment.phantom_node;
+            const double ratio = GetRatioAlongSegment(segment.start, segment.end, phantom_node.location);
+            SetPhantomNodeWeights(input_coordinate, ratio, segment.offset1, segment.offset2, phantom_node);
+            result_vector.push_back(std::make_pair(phantom_node, segment.distance));
         }
-
-        SimpleLogger().Write() << "mindist: " << min_distphantom_node.isBidirected() ? "yes" : "no");
-        return found_a_nearest_edge;
-
     }
 
-  */
     bool FindPhantomNodeForCoordinate(
             const FixedPointCoordinate & input_coordinate,
             PhantomNode & result_phantom_node,
@@ -602,138 +824,207 @@ public:
     ) {
 
         bool ignore_tiny_components = (zoom_level <= 14);
-        DataT nearest_edge;
+        NearestEdgeSearch search;
+
+        //dense areas are answered from a single grid cell if possible
+        const PhantomNode original_phantom_node = result_phantom_node;
+        const uint32_t * cell_begin = NULL;
+        const uint32_t * cell_end = NULL;
+        if(m_snapping_grid && m_snapping_grid->GetCellSegments(input_coordinate, cell_begin, cell_end)) {
+            for(const uint32_t * i = cell_begin; i != cell_end; ++i) {
+                ExamineEdge(
+                    m_snapping_grid->GetSegment(*i),
+                    input_coordinate,
+                    ignore_tiny_components,
+                    search,
+                    result_phantom_node
+                );
+            }
+            if(search.found_a_nearest_edge && search.min_dist <= SnappingGrid<DataT>::GetSquaredMargin()) {
+                return FinishPhantomNode(input_coordinate, search, result_phantom_node);
+            }
+            search = NearestEdgeSearch();
+            result_phantom_node = original_phantom_node;
+        }
 
         uint32_t io_count = 0;
         uint32_t explored_tree_nodes_count = 0;
         //SimpleLogger().Write() << "searching for coordinate " << input_coordinate;
-        double min_dist = DBL_MAX;
-        double min_max_dist = DBL_MAX;
-        bool found_a_nearest_edge = false;
-
-        FixedPointCoordinate nearest, current_start_coordinate, current_end_coordinate;
 
-        //initialize queue with root element
-        std::priority_queue<QueryCandidate> traversal_queue;
-        double current_min_dist = m_search_tree[0].minimum_bounding_rectangle.GetMinDist(input_coordinate);
+        //initialize queue with root element, closest bounding rectangle on top
+        std::priority_queue<QueryCandidate, std::vector<QueryCandidate>, QueryCandidateIsFurther> traversal_queue;
+        double current_min_dist = GetSquaredDistanceToRectangle(input_coordinate, m_root_rectangle);
         traversal_queue.push(
-                             QueryCandidate(0, current_min_dist)
-        );
-
-        BOOST_ASSERT_MSG(
-                         FLT_EPSILON > (0. - traversal_queue.top().min_dist),
-                         "Root element in NN Search has min dist != 0."
+                             QueryCandidate(0, current_min_dist, m_root_rectangle)
         );
 
         while(!traversal_queue.empty()) {
             const QueryCandidate current_query_node = traversal_queue.top(); traversal_queue.pop();
 
             ++explored_tree_nodes_count;
-            bool prune_downward = (current_query_node.min_dist >= min_max_dist);
-            bool prune_upward    = (current_query_node.min_dist >= min_dist);
-            if( !prune_downward && !prune_upward ) { //downward pruning
-                TreeNode & current_tree_node = m_search_tree[current_query_node.node_id];
-                if (current_tree_node.child_is_on_disk) {
-                    LeafNode current_leaf_node;
-                    LoadLeafFromDisk(current_tree_node.children[0], current_leaf_node);
-                    ++io_count;
-                    //SimpleLogger().Write() << "checking " << current_leaf_node.object_count << " elements";
-                    for(uint32_t i = 0; i < current_leaf_node.object_count; ++i) {
-                        DataT & current_edge = current_leaf_node.objects[i];
-                        if(ignore_tiny_components && current_edge.belongsToTinyComponent) {
-                            continue;
-                        }
-                        if(current_edge.isIgnored()) {
-                            continue;
-                        }
-
-                       double current_ratio = 0.;
-                       double current_perpendicular_distance = ComputePerpendicularDistance(
-                                input_coordinate,
-                                FixedPointCoordinate(current_edge.lat1, current_edge.lon1),
-                                FixedPointCoordinate(current_edge.lat2, current_edge.lon2),
-                                nearest,
-                                &current_ratio
-                        );
-
-                        if(
-                                current_perpendicular_distance < min_dist
-                                && !DoubleEpsilonCompare(
-                                        current_perpendicular_distance,
-                                        min_dist
-                                )
-                        ) { //found a new minimum
-                            min_dist = current_perpendicular_distance;
-                            result_phantom_node.edgeBasedNode = current_edge.id;
-                            result_phantom_node.nodeBasedEdgeNameID = current_edge.nameID;
-                            result_phantom_node.weight1 = current_edge.weight;
-                            result_phantom_node.weight2 = INT_MAX;
-                            result_phantom_node.location = nearest;
-                            current_start_coordinate.lat = current_edge.lat1;
-                            current_start_coordinate.lon = current_edge.lon1;
-                            current_end_coordinate.lat = current_edge.lat2;
-                            current_end_coordinate.lon = current_edge.lon2;
-                            nearest_edge = current_edge;
-                            found_a_nearest_edge = true;
-                        } else if(
-                                DoubleEpsilonCompare(current_perpendicular_distance, min_dist) &&
-                                1 == abs(current_edge.id - result_phantom_node.edgeBasedNode )
-                        && CoordinatesAreEquivalent(
-                                current_start_coordinate,
-                                FixedPointCoordinate(
-                                        current_edge.lat1,
-                                        current_edge.lon1
-                                ),
-                                FixedPointCoordinate(
-                                        current_edge.lat2,
-                                        current_edge.lon2
-                                ),
-                                current_end_coordinate
-                            )
-                        ) {
-                            BOOST_ASSERT_MSG(current_edge.id != result_phantom_node.edgeBasedNode, "IDs not different");
-                            //SimpleLogger().Write() << "found bidirected edge on nodes " << current_edge.id << " and " << result_phantom_node.edgeBasedNode;
-                            result_phantom_node.weight2 = current_edge.weight;
-                            if(current_edge.id < result_phantom_node.edgeBasedNode) {
-                                result_phantom_node.edgeBasedNode = current_edge.id;
-                                std::swap(result_phantom_node.weight1, result_phantom_node.weight2);
-                                std::swap(current_end_coordinate, current_start_coordinate);
-                            //    SimpleLogger().Write() <<"case 2";
-                            }
-                            //SimpleLogger().Write() << "w1: " << result_phantom_node.weight1 << ", w2: " << result_phantom_node.weight2;
-                        }
-                    }
-                } else {
-                    //traverse children, prune if global mindist is smaller than local one
-                    for (uint32_t i = 0; i < current_tree_node.child_count; ++i) {
-                        const int32_t child_id = current_tree_node.children[i];
-                        TreeNode & child_tree_node = m_search_tree[child_id];
-                        RectangleT & child_rectangle = child_tree_node.minimum_bounding_rectangle;
-                        const double current_min_dist = child_rectangle.GetMinDist(input_coordinate);
-                        const double current_min_max_dist = child_rectangle.GetMinMaxDist(input_coordinate);
-                        if( current_min_max_dist < min_max_dist ) {
-                            min_max_dist = current_min_max_dist;
-                        }
-                        if (current_min_dist > min_max_dist) {
-                            continue;
-                        }
-                        if (current_min_dist > min_dist) { //upward pruning
-                            continue;
-                        }
-                        traversal_queue.push(QueryCandidate(child_id, current_min_dist));
+            //ties are still explored, they may hold the other direction
+            if(IsFurther(current_query_node.min_dist, search.min_dist)) {
+                break;
+            }
+            const CompactTreeNode & current_tree_node = m_compact_tree[current_query_node.node_id];
+            if (current_tree_node.child_is_on_disk) {
+                LeafNode current_leaf_node;
+                LoadLeafFromDisk(current_tree_node.first_child, current_leaf_node);
+                ++io_count;
+                //SimpleLogger().Write() << "checking " << current_leaf_node.object_count << " elements";
+                for(uint32_t i = 0; i < current_leaf_node.object_count; ++i) {
+                    ExamineEdge(
+                        current_leaf_node.objects[i],
+                        input_coordinate,
+                        ignore_tiny_components,
+                        search,
+                        result_phantom_node
+                    );
+                }
+            } else {
+                //traverse children, prune if global mindist is smaller than local one
+                RectangleT child_rectangles[RTREE_BRANCHING_FACTOR];
+                DecodeChildRectangles(current_tree_node, current_query_node.rectangle, child_rectangles);
+                for (uint32_t i = 0; i < current_tree_node.child_count; ++i) {
+                    //decoded rectangles are too large, so only the true
+                    //minimum distance is a safe bound, neither the corner
+                    //distance nor the minmax distance is
+                    const double current_min_dist = GetSquaredDistanceToRectangle(input_coordinate, child_rectangles[i]);
+                    if (IsFurther(current_min_dist, search.min_dist)) { //upward pruning
+                        continue;
                     }
+                    traversal_queue.push(QueryCandidate(current_tree_node.first_child + i, current_min_dist, child_rectangles[i]));
                 }
             }
         }
+        return FinishPhantomNode(input_coordinate, search, result_phantom_node);
+    }
 
-        const double ratio = (found_a_nearest_edge ?
-            std::min(1., ApproximateDistance(current_start_coordinate,
-                result_phantom_node.location)/ApproximateDistance(current_start_coordinate, current_end_coordinate)
-                ) : 0
-            );
-        result_phantom_node.weight1 *= ratio;
+private:
+    //State of the search in FindPhantomNodeForCoordinate
+    struct NearestEdgeSearch {
+        NearestEdgeSearch() : min_dist(DBL_MAX), found_a_nearest_edge(false), offset1(0), offset2(0) {}
+        double min_dist;
+        bool found_a_nearest_edge;
+        FixedPointCoordinate current_start_coordinate;
+        FixedPointCoordinate current_end_coordinate;
+        //weight of the segments before the nearest one, per direction
+        int offset1;
+        int offset2;
+    };
+
+    inline void ExamineEdge(
+        const DataT & current_edge,
+        const FixedPointCoordinate & input_coordinate,
+        const bool ignore_tiny_components,
+        NearestEdgeSearch & search,
+        PhantomNode & result_phantom_node
+    ) const {
+        if(ignore_tiny_components && current_edge.belongsToTinyComponent) {
+            return;
+        }
+        if(current_edge.isIgnored()) {
+            return;
+        }
+
+        double current_ratio = 0.;
+        FixedPointCoordinate nearest;
+        double current_perpendicular_distance = ComputePerpendicularDistance(
+                input_coordinate,
+                FixedPointCoordinate(current_edge.lat1, current_edge.lon1),
+                FixedPointCoordinate(current_edge.lat2, current_edge.lon2),
+                nearest,
+                &current_ratio
+        );
+
+        if(
+                current_perpendicular_distance < search.min_dist
+                && !DoubleEpsilonCompare(
+                        current_perpendicular_distance,
+                        search.min_dist
+                )
+        ) { //found a new minimum
+            search.min_dist = current_perpendicular_distance;
+            result_phantom_node.edgeBasedNode = current_edge.id;
+            result_phantom_node.nodeBasedEdgeNameID = current_edge.nameID;
+            result_phantom_node.weight1 = current_edge.weight;
+            result_phantom_node.weight2 = INT_MAX;
+            result_phantom_node.segmentPosition = current_edge.segmentPosition;
+            result_phantom_node.location = nearest;
+            search.offset1 = current_edge.offset;
+            search.offset2 = 0;
+            search.current_start_coordinate.lat = current_edge.lat1;
+            search.current_start_coordinate.lon = current_edge.lon1;
+            search.current_end_coordinate.lat = current_edge.lat2;
+            search.current_end_coordinate.lon = current_edge.lon2;
+            search.found_a_nearest_edge = true;
+        } else if(
+                DoubleEpsilonCompare(current_perpendicular_distance, search.min_dist) &&
+                1 == abs(current_edge.id - result_phantom_node.edgeBasedNode )
+        && CoordinatesAreEquivalent(
+                search.current_start_coordinate,
+                FixedPointCoordinate(
+                        current_edge.lat1,
+                        current_edge.lon1
+                ),
+                FixedPointCoordinate(
+                        current_edge.lat2,
+                        current_edge.lon2
+                ),
+                search.current_end_coordinate
+            )
+        ) {
+            BOOST_ASSERT_MSG(current_edge.id != result_phantom_node.edgeBasedNode, "IDs not different");
+            //SimpleLogger().Write() << "found bidirected edge on nodes " << current_edge.id << " and " << result_phantom_node.edgeBasedNode;
+            result_phantom_node.weight2 = current_edge.weight;
+            search.offset2 = current_edge.offset;
+            if(current_edge.id < result_phantom_node.edgeBasedNode) {
+                result_phantom_node.edgeBasedNode = current_edge.id;
+                result_phantom_node.segmentPosition = current_edge.segmentPosition;
+                std::swap(result_phantom_node.weight1, result_phantom_node.weight2);
+                std::swap(search.offset1, search.offset2);
+                std::swap(search.current_end_coordinate, search.current_start_coordinate);
+            }
+        }
+    }
+
+    inline bool FinishPhantomNode(
+        const FixedPointCoordinate & input_coordinate,
+        const NearestEdgeSearch & search,
+        PhantomNode & result_phantom_node
+    ) const {
+        const double ratio = (search.found_a_nearest_edge ?
+            GetRatioAlongSegment(
+                search.current_start_coordinate,
+                search.current_end_coordinate,
+                result_phantom_node.location
+            ) : 0
+        );
+        SetPhantomNodeWeights(input_coordinate, ratio, search.offset1, search.offset2, result_phantom_node);
+        return search.found_a_nearest_edge;
+    }
+
+    static inline double GetRatioAlongSegment(
+        const FixedPointCoordinate & start,
+        const FixedPointCoordinate & end,
+        const FixedPointCoordinate & location
+    ) {
+        return std::min(1., ApproximateDistance(start, location)/
+            std::max(DBL_EPSILON, ApproximateDistance(start, end)));
+    }
+
+    //Shared by the single and the k nearest queries, so that both return
+    //the same phantom node for the same segment
+    static inline void SetPhantomNodeWeights(
+        const FixedPointCoordinate & input_coordinate,
+        const double ratio,
+        const int offset1,
+        const int offset2,
+        PhantomNode & result_phantom_node
+    ) {
+        result_phantom_node.weight1 = offset1 + result_phantom_node.weight1*ratio;
         if(INT_MAX != result_phantom_node.weight2) {
-            result_phantom_node.weight2 *= (1.-ratio);
+            result_phantom_node.weight2 = offset2 + result_phantom_node.weight2*(1.-ratio);
         }
         result_phantom_node.ratio = ratio;
 
@@ -744,11 +1035,183 @@ public:
         if(std::abs(input_coordinate.lat - result_phantom_node.location.lat) == 1) {
             result_phantom_node.location.lat = input_coordinate.lat;
         }
+    }
 
-        return found_a_nearest_edge;
+    //Both directions of a segment are consecutive edge-based nodes on the same
+    //coordinates. They are one candidate, as in FindPhantomNodeForCoordinate.
+    inline bool MergeIntoBidirectedSegment(
+        std::vector<NearestSegment> & candidates,
+        const DataT & edge,
+        const FixedPointCoordinate & start,
+        const FixedPointCoordinate & end
+    ) const {
+        BOOST_FOREACH(NearestSegment & segment, candidates) {
+            PhantomNode & phantom_node = segment.phantom_node;
+            if(phantom_node.isBidirected()) {
+                continue;
+            }
+            const bool ids_are_adjacent =
+                (edge.id == phantom_node.edgeBasedNode+1) ||
+                (edge.id+1 == phantom_node.edgeBasedNode);
+            if(!ids_are_adjacent || !CoordinatesAreEquivalent(segment.start, start, end, segment.end)) {
+                continue;
+            }
+            phantom_node.weight2 = edge.weight;
+            segment.offset2 = edge.offset;
+            if(edge.id < phantom_node.edgeBasedNode) {
+                phantom_node.edgeBasedNode = edge.id;
+                phantom_node.segmentPosition = edge.segmentPosition;
+                std::swap(phantom_node.weight1, phantom_node.weight2);
+                std::swap(segment.offset1, segment.offset2);
+                std::swap(segment.start, segment.end);
+            }
+            return true;
+        }
+        return false;
+    }
 
+    //Compressed edge-based nodes have several segments, only the closest
+    //one of each is a candidate. Expects the candidates sorted by distance.
+    static inline void RemoveFurtherSegmentsOfSameNode(std::vector<NearestSegment> & candidates) {
+        unsigned kept_candidates = 0;
+        for(unsigned i = 0; i < candidates.size(); ++i) {
+            bool is_further_segment = false;
+            for(unsigned j = 0; j < kept_candidates && !is_further_segment; ++j) {
+                is_further_segment =
+                    (candidates[i].phantom_node.edgeBasedNode == candidates[j].phantom_node.edgeBasedNode);
+            }
+            if(!is_further_segment) {
+                candidates[kept_candidates++] = candidates[i];
+            }
+        }
+        candidates.resize(kept_candidates);
     }
-private:
+
+    //Renumbers the tree breadth first, so that the children of a node have
+    //consecutive ids, and quantizes each rectangle relative to the decoded
+    //rectangle of its parent. Rounding is outwards, the decoded rectangle
+    //always contains the exact one.
+    void CompactSearchTree() {
+        const uint32_t tree_size = m_search_tree.size();
+        if(0 == tree_size) {
+            throw OSRMException("ram index file contains no nodes");
+        }
+        m_root_rectangle = m_search_tree[0].minimum_bounding_rectangle;
+        m_compact_tree.resize(tree_size);
+        m_quantized_min_lat.resize(tree_size, 0);
+        m_quantized_max_lat.resize(tree_size, RTREE_QUANTIZATION_STEPS);
+        m_quantized_min_lon.resize(tree_size, 0);
+        m_quantized_max_lon.resize(tree_size, RTREE_QUANTIZATION_STEPS);
+
+        std::vector<uint32_t> original_ids(1, 0);
+        std::vector<RectangleT> decoded_rectangles(1, m_root_rectangle);
+        original_ids.reserve(tree_size);
+        decoded_rectangles.reserve(tree_size);
+        for(uint32_t node_id = 0; node_id < original_ids.size(); ++node_id) {
+            const TreeNode & tree_node = m_search_tree[original_ids[node_id]];
+            CompactTreeNode & compact_node = m_compact_tree[node_id];
+            compact_node.child_count = tree_node.child_count;
+            compact_node.child_is_on_disk = tree_node.child_is_on_disk;
+            if(tree_node.child_is_on_disk) {
+                compact_node.first_child = tree_node.children[0];
+                continue;
+            }
+            compact_node.first_child = original_ids.size();
+            const RectangleT parent_rectangle = decoded_rectangles[node_id];
+            for(uint32_t i = 0; i < tree_node.child_count; ++i) {
+                const uint32_t child_id = original_ids.size();
+                if(tree_size <= child_id || tree_size <= tree_node.children[i]) {
+                    throw OSRMException("ram index file is corrupt");
+                }
+                const RectangleT & child_rectangle = m_search_tree[tree_node.children[i]].minimum_bounding_rectangle;
+                m_quantized_min_lat[child_id] = QuantizeLower(child_rectangle.min_lat, parent_rectangle.min_lat, parent_rectangle.max_lat);
+                m_quantized_max_lat[child_id] = QuantizeUpper(child_rectangle.max_lat, parent_rectangle.min_lat, parent_rectangle.max_lat);
+                m_quantized_min_lon[child_id] = QuantizeLower(child_rectangle.min_lon, parent_rectangle.min_lon, parent_rectangle.max_lon);
+                m_quantized_max_lon[child_id] = QuantizeUpper(child_rectangle.max_lon, parent_rectangle.min_lon, parent_rectangle.max_lon);
+                original_ids.push_back(tree_node.children[i]);
+            }
+            decoded_rectangles.resize(original_ids.size());
+            DecodeChildRectangles(compact_node, parent_rectangle, &decoded_rectangles[compact_node.first_child]);
+        }
+        if(original_ids.size() != tree_size) {
+            throw OSRMException("ram index file is corrupt");
+        }
+        SimpleLogger().Write(logDEBUG) << "compacted " << tree_size << " tree nodes from " <<
+            tree_size*sizeof(TreeNode) << " to " << tree_size*(sizeof(CompactTreeNode)+4) << " bytes";
+    }
+
+    static inline uint8_t QuantizeLower(const int32_t value, const int32_t parent_min, const int32_t parent_max) {
+        const int64_t extent = int64_t(parent_max) - parent_min;
+        if(0 >= extent) {
+            return 0;
+        }
+        return ((int64_t(value) - parent_min)*RTREE_QUANTIZATION_STEPS)/extent;
+    }
+
+    static inline uint8_t QuantizeUpper(const int32_t value, const int32_t parent_min, const int32_t parent_max) {
+        const int64_t extent = int64_t(parent_max) - parent_min;
+        if(0 >= extent) {
+            return 0;
+        }
+        return ((int64_t(value) - parent_min)*RTREE_QUANTIZATION_STEPS + extent - 1)/extent;
+    }
+
+    //Decodes the rectangles of all children in one pass over the quantized
+    //arrays
+    inline void DecodeChildRectangles(
+        const CompactTreeNode & tree_node,
+        const RectangleT & parent_rectangle,
+        RectangleT * child_rectangles
+    ) const {
+        const int64_t lat_extent = std::max(int64_t(0), int64_t(parent_rectangle.max_lat) - parent_rectangle.min_lat);
+        const int64_t lon_extent = std::max(int64_t(0), int64_t(parent_rectangle.max_lon) - parent_rectangle.min_lon);
+        const uint8_t * min_lat = &m_quantized_min_lat[tree_node.first_child];
+        const uint8_t * max_lat = &m_quantized_max_lat[tree_node.first_child];
+        const uint8_t * min_lon = &m_quantized_min_lon[tree_node.first_child];
+        const uint8_t * max_lon = &m_quantized_max_lon[tree_node.first_child];
+        const uint32_t child_count = tree_node.child_count;
+        for(uint32_t i = 0; i < child_count; ++i) {
+            RectangleT & child_rectangle = child_rectangles[i];
+            child_rectangle.min_lat = parent_rectangle.min_lat + (min_lat[i]*lat_extent)/RTREE_QUANTIZATION_STEPS;
+            child_rectangle.max_lat = parent_rectangle.min_lat + (max_lat[i]*lat_extent + RTREE_QUANTIZATION_STEPS - 1)/RTREE_QUANTIZATION_STEPS;
+            child_rectangle.min_lon = parent_rectangle.min_lon + (min_lon[i]*lon_extent)/RTREE_QUANTIZATION_STEPS;
+            child_rectangle.max_lon = parent_rectangle.min_lon + (max_lon[i]*lon_extent + RTREE_QUANTIZATION_STEPS - 1)/RTREE_QUANTIZATION_STEPS;
+        }
+    }
+
+    //Distance in meters to the closest point of the rectangle
+    inline double GetDistanceToRectangle(
+        const FixedPointCoordinate & location,
+        const RectangleT & rectangle
+    ) const {
+        const FixedPointCoordinate closest(
+            std::max(rectangle.min_lat, std::min(rectangle.max_lat, location.lat)),
+            std::max(rectangle.min_lon, std::min(rectangle.max_lon, location.lon))
+        );
+        return ApproximateDistance(location, closest);
+    }
+
+    //Squared planar distance in fixed point units, the same metric as the
+    //one of ComputePerpendicularDistance
+    inline double GetSquaredDistanceToRectangle(
+        const FixedPointCoordinate & location,
+        const RectangleT & rectangle
+    ) const {
+        const double lat_distance = std::max(0., std::max(
+            double(rectangle.min_lat) - location.lat,
+            double(location.lat) - rectangle.max_lat
+        ));
+        const double lon_distance = std::max(0., std::max(
+            double(rectangle.min_lon) - location.lon,
+            double(location.lon) - rectangle.max_lon
+        ));
+        return lat_distance*lat_distance + lon_distance*lon_distance;
+    }
+
+    inline bool IsFurther(const double distance, const double min_dist) const {
+        return distance > min_dist && !DoubleEpsilonCompare(distance, min_dist);
+    }
+
     inline void LoadLeafFromDisk(const uint32_t leaf_id, LeafNode& result_node) {
         if(!thread_local_rtree_stream.get() || !thread_local_rtree_stream->is_open()) {
             thread_local_rtree_stream.reset(
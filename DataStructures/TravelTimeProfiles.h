@@ -0,0 +1,200 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef TRAVELTIMEPROFILES_H_
+#define TRAVELTIMEPROFILES_H_
+
+#include "../Util/OSRMException.h"
+#include "../Util/SimpleLogger.h"
+#include "../typedefs.h"
+
+#include <boost/assert.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <ctime>
+#include <string>
+#include <vector>
+
+//One sample per hour of the week, starting on monday 00:00 UTC
+static const unsigned TRAVEL_TIME_PROFILE_SAMPLES = 7*24;
+//Times are handled in tenths of a second, like edge weights
+static const unsigned TRAVEL_TIME_SAMPLE_INTERVAL = 36000;
+static const unsigned TRAVEL_TIME_WEEK_LENGTH = TRAVEL_TIME_PROFILE_SAMPLES*TRAVEL_TIME_SAMPLE_INTERVAL;
+//Factors are given in percent of the free flow travel time
+static const unsigned short TRAVEL_TIME_FREE_FLOW_FACTOR = 100;
+static const unsigned short TRAVEL_TIME_NO_PROFILE = USHRT_MAX;
+
+/*
+ * Weekly travel time profiles of road segments. Every profile has one factor
+ * per hour of the week, the travel time in between is interpolated linearly.
+ * The profile of an edge-based node scales the weight of all edges leaving
+ * it, i.e. the time it takes to pass the segment and to turn at its end.
+ *
+ * File layout (all values in host byte order):
+ *   unsigned       number of profiles
+ *   unsigned short factors, TRAVEL_TIME_PROFILE_SAMPLES per profile
+ *   unsigned       number of edge-based nodes
+ *   unsigned short profile index per node, TRAVEL_TIME_NO_PROFILE for none
+ */
+class TravelTimeProfiles : boost::noncopyable {
+public:
+    TravelTimeProfiles() :
+        minimum_factor(TRAVEL_TIME_FREE_FLOW_FACTOR),
+        maximum_factor(TRAVEL_TIME_FREE_FLOW_FACTOR)
+    { }
+
+    explicit TravelTimeProfiles(const std::string & filename) :
+        minimum_factor(TRAVEL_TIME_FREE_FLOW_FACTOR),
+        maximum_factor(TRAVEL_TIME_FREE_FLOW_FACTOR)
+    {
+        boost::filesystem::path profiles_file(filename);
+        if(!boost::filesystem::exists(profiles_file)) {
+            throw OSRMException("travel time profiles file does not exist");
+        }
+        boost::filesystem::ifstream input(profiles_file, std::ios::binary);
+        unsigned number_of_profiles = 0;
+        input.read((char *)&number_of_profiles, sizeof(unsigned));
+        profile_factors.resize(number_of_profiles*TRAVEL_TIME_PROFILE_SAMPLES);
+        if(!profile_factors.empty()) {
+            input.read((char *)&profile_factors[0], profile_factors.size()*sizeof(unsigned short));
+        }
+        unsigned number_of_nodes = 0;
+        input.read((char *)&number_of_nodes, sizeof(unsigned));
+        node_profiles.resize(number_of_nodes, TRAVEL_TIME_NO_PROFILE);
+        if(!node_profiles.empty()) {
+            input.read((char *)&node_profiles[0], node_profiles.size()*sizeof(unsigned short));
+        }
+        if(!input) {
+            throw OSRMException("travel time profiles file is truncated");
+        }
+        for(unsigned i = 0; i < node_profiles.size(); ++i) {
+            if(TRAVEL_TIME_NO_PROFILE != node_profiles[i] && number_of_profiles <= node_profiles[i]) {
+                throw OSRMException("travel time profiles file references unknown profile");
+            }
+        }
+        ComputeFactorRange();
+        SimpleLogger().Write() << "loaded " << number_of_profiles << " travel time profiles for " << number_of_nodes << " nodes";
+    }
+
+    void Write(const std::string & filename) const {
+        boost::filesystem::ofstream output(boost::filesystem::path(filename), std::ios::binary);
+        const unsigned number_of_profiles = GetNumberOfProfiles();
+        output.write((char *)&number_of_profiles, sizeof(unsigned));
+        if(!profile_factors.empty()) {
+            output.write((char *)&profile_factors[0], profile_factors.size()*sizeof(unsigned short));
+        }
+        const unsigned number_of_nodes = node_profiles.size();
+        output.write((char *)&number_of_nodes, sizeof(unsigned));
+        if(!node_profiles.empty()) {
+            output.write((char *)&node_profiles[0], node_profiles.size()*sizeof(unsigned short));
+        }
+    }
+
+    //Returns the index of the new profile, factors are clamped to at least 1%
+    unsigned AddProfile(const std::vector<unsigned short> & factors) {
+        BOOST_ASSERT_MSG(TRAVEL_TIME_PROFILE_SAMPLES == factors.size(), "profile has wrong number of samples");
+        BOOST_ASSERT_MSG(GetNumberOfProfiles() < TRAVEL_TIME_NO_PROFILE, "too many profiles");
+        for(unsigned i = 0; i < factors.size(); ++i) {
+            profile_factors.push_back(std::max((unsigned short)1, factors[i]));
+        }
+        ComputeFactorRange();
+        return GetNumberOfProfiles() - 1;
+    }
+
+    void SetNumberOfNodes(const unsigned number_of_nodes) {
+        node_profiles.resize(number_of_nodes, TRAVEL_TIME_NO_PROFILE);
+        ComputeFactorRange();
+    }
+
+    void AssignProfile(const NodeID node, const unsigned profile) {
+        BOOST_ASSERT_MSG(node < node_profiles.size(), "node out of range");
+        BOOST_ASSERT_MSG(profile < GetNumberOfProfiles(), "profile out of range");
+        node_profiles[node] = profile;
+    }
+
+    inline unsigned GetNumberOfProfiles() const {
+        return profile_factors.size()/TRAVEL_TIME_PROFILE_SAMPLES;
+    }
+
+    inline unsigned GetNumberOfNodes() const {
+        return node_profiles.size();
+    }
+
+    //No travel time is ever smaller than the free flow weight scaled by this
+    inline unsigned GetMinimumFactor() const {
+        return minimum_factor;
+    }
+
+    //No travel time is ever larger than the free flow weight scaled by this
+    inline unsigned GetMaximumFactor() const {
+        return maximum_factor;
+    }
+
+    //Travel time of weight at the given node when starting at time_of_week
+    inline int GetTravelTime(const NodeID node, const int weight, const unsigned time_of_week) const {
+        if(node >= node_profiles.size() || TRAVEL_TIME_NO_PROFILE == node_profiles[node]) {
+            return weight;
+        }
+        const unsigned short * factors = &profile_factors[node_profiles[node]*TRAVEL_TIME_PROFILE_SAMPLES];
+        const unsigned time = time_of_week % TRAVEL_TIME_WEEK_LENGTH;
+        const unsigned sample = time/TRAVEL_TIME_SAMPLE_INTERVAL;
+        const unsigned long long offset = time%TRAVEL_TIME_SAMPLE_INTERVAL;
+        const unsigned long long interpolated =
+            factors[sample]*(TRAVEL_TIME_SAMPLE_INTERVAL - offset) +
+            factors[(sample+1)%TRAVEL_TIME_PROFILE_SAMPLES]*offset;
+        const unsigned long long divisor = TRAVEL_TIME_FREE_FLOW_FACTOR*TRAVEL_TIME_SAMPLE_INTERVAL;
+        const unsigned long long scaled = ((unsigned long long)std::max(0, weight)*interpolated + divisor/2)/divisor;
+        return (int)std::min(scaled, (unsigned long long)(INT_MAX/2));
+    }
+
+    //Tenths of a second since monday 00:00 UTC
+    static unsigned GetTimeOfWeek(const time_t timestamp) {
+        //the epoch was a thursday
+        const long long seconds_since_monday = (long long)timestamp + 3*24*3600;
+        const long long week = TRAVEL_TIME_WEEK_LENGTH/10;
+        return 10*(unsigned)(((seconds_since_monday % week) + week) % week);
+    }
+
+private:
+    void ComputeFactorRange() {
+        minimum_factor = maximum_factor = TRAVEL_TIME_FREE_FLOW_FACTOR;
+        if(!profile_factors.empty()) {
+            minimum_factor = std::min(
+                minimum_factor,
+                (unsigned)*std::min_element(profile_factors.begin(), profile_factors.end())
+            );
+            maximum_factor = std::max(
+                maximum_factor,
+                (unsigned)*std::max_element(profile_factors.begin(), profile_factors.end())
+            );
+        }
+    }
+
+    std::vector<unsigned short> profile_factors;
+    std::vector<unsigned short> node_profiles;
+    unsigned minimum_factor;
+    unsigned maximum_factor;
+};
+
+#endif /* TRAVELTIMEPROFILES_H_ */
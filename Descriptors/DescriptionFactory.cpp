@@ -70,6 +70,11 @@ void DescriptionFactory::AppendSegment(const FixedPointCoordinate & coordinate,
     }
 }
 
+//Shape of the road between two turns, which continues the current segment
+void DescriptionFactory::AppendGeometry(const FixedPointCoordinate & coordinate) {
+    pathDescription.push_back(SegmentInformation(coordinate, pathDescription.back().nameID, 0, 0, TurnInstructions.NoTurn) );
+}
+
 void DescriptionFactory::AppendEncodedPolylineString(std::string & output, bool isEncoded) {
     if(isEncoded)
         pc.printEncodedString(pathDescription, output);
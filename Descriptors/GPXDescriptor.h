@@ -29,17 +29,28 @@ class GPXDescriptor : public BaseDescriptor{
 private:
     _DescriptorConfig config;
     FixedPointCoordinate current;
+    std::vector<FixedPointCoordinate> routePoints;
 
     std::string tmp;
 public:
     void SetConfig(const _DescriptorConfig& c) { config = c; }
     void Run(http::Reply & reply, const RawRouteData &rawRoute, PhantomNodes &phantomNodes, SearchEngine &sEngine) {
+        AppendHeader(reply);
+        AppendRoute(reply, rawRoute, phantomNodes, sEngine);
+        AppendFooter(reply);
+    }
+
+    void AppendHeader(http::Reply & reply) const {
         reply.content += ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>");
         reply.content += "<gpx creator=\"OSRM Routing Engine\" version=\"1.1\" xmlns=\"http://www.topografix.com/GPX/1/1\" "
                 "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
                 "xsi:schemaLocation=\"http://www.topografix.com/GPX/1/1 gpx.xsd"
                 "\">";
         reply.content += "<metadata><copyright author=\"Project OSRM\"><license>Data (c) OpenStreetMap contributors (ODbL)</license></copyright></metadata>";
+    }
+
+    //A document may hold several routes, each in a <rte> of its own
+    void AppendRoute(http::Reply & reply, const RawRouteData &rawRoute, PhantomNodes &phantomNodes, SearchEngine &sEngine) {
         reply.content += "<rte>";
         if(rawRoute.lengthOfShortestPath != INT_MAX && rawRoute.computedShortestPath.size()) {
             convertInternalLatLonToString(phantomNodes.startPhantom.location.lat, tmp);
@@ -47,20 +58,31 @@ public:
             convertInternalLatLonToString(phantomNodes.startPhantom.location.lon, tmp);
             reply.content += "lon=\"" + tmp + "\"></rtept>";
 
-            BOOST_FOREACH(const _PathData & pathData, rawRoute.computedShortestPath) {
-                sEngine.GetCoordinatesForNodeID(pathData.node, current);
-
-                convertInternalLatLonToString(current.lat, tmp);
-                reply.content += "<rtept lat=\"" + tmp + "\" ";
-                convertInternalLatLonToString(current.lon, tmp);
-                reply.content += "lon=\"" + tmp + "\"></rtept>";
+            const std::vector<_PathData> & path = rawRoute.computedShortestPath;
+            for(unsigned i = 0; i <= path.size(); ++i) {
+                sEngine.GetIntermediateGeometry(path, i, phantomNodes, rawRoute.segmentEndCoordinates, routePoints);
+                if(i < path.size()) {
+                    sEngine.GetCoordinatesForNodeID(path[i].node, current);
+                    routePoints.push_back(current);
+                }
+                BOOST_FOREACH(const FixedPointCoordinate & routePoint, routePoints) {
+                    convertInternalLatLonToString(routePoint.lat, tmp);
+                    reply.content += "<rtept lat=\"" + tmp + "\" ";
+                    convertInternalLatLonToString(routePoint.lon, tmp);
+                    reply.content += "lon=\"" + tmp + "\"></rtept>";
+                }
+                reply.Flush();
             }
             convertInternalLatLonToString(phantomNodes.targetPhantom.location.lat, tmp);
             reply.content += "<rtept lat=\"" + tmp + "\" ";
             convertInternalLatLonToString(phantomNodes.targetPhantom.location.lon, tmp);
             reply.content += "lon=\"" + tmp + "\"></rtept>";
         }
-        reply.content += "</rte></gpx>";
+        reply.content += "</rte>";
+    }
+
+    void AppendFooter(http::Reply & reply) const {
+        reply.content += "</gpx>";
     }
 };
 #endif /* GPX_DESCRIPTOR_H_ */
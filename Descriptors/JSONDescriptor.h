@@ -40,7 +40,9 @@ private:
     DescriptionFactory descriptionFactory;
     DescriptionFactory alternateDescriptionFactory;
     FixedPointCoordinate current;
+    std::vector<FixedPointCoordinate> intermediateGeometry;
     unsigned numberOfEnteredRestrictedAreas;
+    std::vector<unsigned> tripOrder;
     struct RoundAbout{
         RoundAbout() :
             startIndex(INT_MAX),
@@ -71,6 +73,8 @@ private:
 public:
     JSONDescriptor() : numberOfEnteredRestrictedAreas(0) {}
     void SetConfig(const _DescriptorConfig & c) { config = c; }
+    //Order in which a round trip visits the input locations, listed if set
+    void SetTripOrder(const std::vector<unsigned> & order) { tripOrder = order; }
 
     void Run(http::Reply & reply, const RawRouteData &rawRoute, PhantomNodes &phantomNodes, SearchEngine &sEngine) {
 
@@ -82,11 +86,11 @@ public:
                     "\"status_message\": \"Found route between points\",";
 
             //Get all the coordinates for the computed route
-            BOOST_FOREACH(const _PathData & pathData, rawRoute.computedShortestPath) {
-                sEngine.GetCoordinatesForNodeID(pathData.node, current);
-                descriptionFactory.AppendSegment(current, pathData );
-            }
+            AppendPath(rawRoute.computedShortestPath, phantomNodes, rawRoute.segmentEndCoordinates, sEngine, descriptionFactory);
             descriptionFactory.SetEndSegment(phantomNodes.targetPhantom);
+        } else if(rawRoute.searchWasAborted) {
+            reply.content += "208,"
+                    "\"status_message\": \"Search aborted, deadline exceeded\",";
         } else {
             //We do not need to do much, if there is no route ;-)
             reply.content += "207,"
@@ -100,6 +104,7 @@ public:
         } else {
             reply.content += "[]";
         }
+        reply.Flush();
 
         reply.content += ","
                 "\"route_instructions\": [";
@@ -137,10 +142,7 @@ public:
         if(rawRoute.lengthOfAlternativePath != INT_MAX) {
             alternateDescriptionFactory.SetStartSegment(phantomNodes.startPhantom);
             //Get all the coordinates for the computed route
-            BOOST_FOREACH(const _PathData & pathData, rawRoute.computedAlternativePath) {
-                sEngine.GetCoordinatesForNodeID(pathData.node, current);
-                alternateDescriptionFactory.AppendSegment(current, pathData );
-            }
+            AppendPath(rawRoute.computedAlternativePath, phantomNodes, rawRoute.segmentEndCoordinates, sEngine, alternateDescriptionFactory);
             alternateDescriptionFactory.SetEndSegment(phantomNodes.targetPhantom);
         }
         alternateDescriptionFactory.Run(sEngine, config.z);
@@ -152,6 +154,7 @@ public:
             alternateDescriptionFactory.AppendEncodedPolylineString(reply.content, config.encodeGeometry);
         }
         reply.content += "],";
+        reply.Flush();
         reply.content += "\"alternative_instructions\":[";
         numberOfEnteredRestrictedAreas = 0;
         if(INT_MAX != rawRoute.lengthOfAlternativePath) {
@@ -246,6 +249,17 @@ public:
         reply.content += hint;
         reply.content += "\"]";
         reply.content += "},";
+        if(!tripOrder.empty()) {
+            reply.content += "\"trip_order\":[";
+            for(unsigned i = 0; i < tripOrder.size(); ++i) {
+                if(0 != i) {
+                    reply.content += ",";
+                }
+                intToString(tripOrder[i], tmp);
+                reply.content += tmp;
+            }
+            reply.content += "],";
+        }
         reply.content += "\"transactionId\": \"OSRM Routing Engine JSON Descriptor (v0.3)\"";
         reply.content += "}";
     }
@@ -302,6 +316,26 @@ public:
         }
     }
 
+    //Turns of the path together with the shape of the roads in between
+    inline void AppendPath(
+        const std::vector<_PathData> & path,
+        const PhantomNodes & phantomNodes,
+        const std::vector<PhantomNodes> & legs,
+        const SearchEngine & sEngine,
+        DescriptionFactory & factory
+    ) {
+        for(unsigned i = 0; i <= path.size(); ++i) {
+            sEngine.GetIntermediateGeometry(path, i, phantomNodes, legs, intermediateGeometry);
+            BOOST_FOREACH(const FixedPointCoordinate & coordinate, intermediateGeometry) {
+                factory.AppendGeometry(coordinate);
+            }
+            if(i < path.size()) {
+                sEngine.GetCoordinatesForNodeID(path[i].node, current);
+                factory.AppendSegment(current, path[i]);
+            }
+        }
+    }
+
     inline void WriteHeaderToOutput(std::string & output) {
         output += "{"
                 "\"version\": 0.3,"
@@ -365,6 +399,7 @@ public:
                     reply.content += "]";
 
                     segmentVector.push_back( Segment(segment.nameID, segment.length, segmentVector.size() ));
+                    reply.Flush();
                 }
             } else if(TurnInstructions.StayOnRoundAbout == currentInstruction) {
                 ++roundAbout.leaveAtExit;
@@ -25,6 +25,19 @@ extractor_callbacks(ec), scriptingEnvironment(se), luaState(NULL), use_turn_rest
     luaState = se.getLuaStateForThreadID(0);
     ReadUseRestrictionsSetting();
     ReadRestrictionExceptions();
+    ReadPureProfileSetting();
+}
+
+BaseParser::~BaseParser() {
+    uint64_t hits = 0, misses = 0;
+    BOOST_FOREACH(const boost::shared_ptr<TagFunctionCache> & cache, tag_function_caches) {
+        hits += cache->GetNumberOfHits();
+        misses += cache->GetNumberOfMisses();
+    }
+    if( 0 < hits + misses ) {
+        SimpleLogger().Write() << "Profile functions skipped for " << hits <<
+            " of " << (hits + misses) << " nodes and ways";
+    }
 }
 
 void BaseParser::ReadUseRestrictionsSetting() {
@@ -43,6 +56,21 @@ void BaseParser::ReadUseRestrictionsSetting() {
     }
 }
 
+//Results of pure profiles only depend on the tags and are reused
+void BaseParser::ReadPureProfileSetting() {
+    if( 0 != luaL_dostring( luaState, "return pure_profile\n") ) {
+        throw OSRMException(
+            "ERROR occured in scripting block"
+        );
+    }
+    if( lua_isboolean( luaState, -1) && lua_toboolean(luaState, -1) ) {
+        SimpleLogger().Write() << "Profile is pure, reusing results for equal tags";
+        for(int i = 0; i < omp_get_max_threads(); ++i) {
+            tag_function_caches.push_back(boost::shared_ptr<TagFunctionCache>(new TagFunctionCache()));
+        }
+    }
+}
+
 void BaseParser::ReadRestrictionExceptions() {
     if(lua_function_exists(luaState, "get_exceptions" )) {
         //get list of turn restriction exceptions
@@ -68,14 +96,30 @@ void BaseParser::report_errors(lua_State *L, const int status) const {
 }
 
 void BaseParser::ParseNodeInLua(ImportNode& n, lua_State* localLuaState) {
-    luabind::call_function<void>( localLuaState, "node_function", boost::ref(n) );
+    if( tag_function_caches.empty() ) {
+        luabind::call_function<void>( localLuaState, "node_function", boost::ref(n) );
+        return;
+    }
+    TagFunctionCache & cache = *tag_function_caches[omp_get_thread_num()];
+    if( !cache.FindNode(n) ) {
+        luabind::call_function<void>( localLuaState, "node_function", boost::ref(n) );
+        cache.InsertNode(n);
+    }
 }
 
 void BaseParser::ParseWayInLua(ExtractionWay& w, lua_State* localLuaState) {
     if(2 > w.path.size()) {
         return;
     }
-    luabind::call_function<void>( localLuaState, "way_function", boost::ref(w) );
+    if( tag_function_caches.empty() ) {
+        luabind::call_function<void>( localLuaState, "way_function", boost::ref(w) );
+        return;
+    }
+    TagFunctionCache & cache = *tag_function_caches[omp_get_thread_num()];
+    if( !cache.FindWay(w) ) {
+        luabind::call_function<void>( localLuaState, "way_function", boost::ref(w) );
+        cache.InsertWay(w);
+    }
 }
 
 bool BaseParser::ShouldIgnoreRestriction(const std::string& except_tag_string) const {
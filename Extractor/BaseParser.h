@@ -23,6 +23,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 #include "ExtractorCallbacks.h"
 #include "ScriptingEnvironment.h"
+#include "TagFunctionCache.h"
 #include "../Util/OSRMException.h"
 #include "../Util/SimpleLogger.h"
 
@@ -33,11 +34,14 @@ extern "C" {
 }
 
 #include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
 
 class BaseParser : boost::noncopyable {
 public:
     BaseParser(ExtractorCallbacks* ec, ScriptingEnvironment& se);
-    virtual ~BaseParser() {}
+    virtual ~BaseParser();
     virtual bool ReadHeader() = 0;
     virtual bool Parse() = 0;
 
@@ -47,6 +51,7 @@ public:
 
 protected:
     virtual void ReadUseRestrictionsSetting();
+    virtual void ReadPureProfileSetting();
     virtual void ReadRestrictionExceptions();
     virtual bool ShouldIgnoreRestriction(const std::string& except_tag_string) const;
 
@@ -55,6 +60,8 @@ protected:
     lua_State* luaState;
     std::vector<std::string> restriction_exceptions;
     bool use_turn_restrictions;
+    //one per thread, empty unless the profile is pure
+    std::vector<boost::shared_ptr<TagFunctionCache> > tag_function_caches;
 
 };
 
@@ -20,6 +20,33 @@
 
 #include "ExtractionContainers.h"
 
+template<class ShardVectorT, class VectorT>
+static void AppendShardVector(ShardVectorT & shard_vector, VectorT & output) {
+    for(typename ShardVectorT::const_iterator it = shard_vector.begin(); it != shard_vector.end(); ++it) {
+        output.push_back(*it);
+    }
+    shard_vector.clear();
+}
+
+//Shards are appended in order of their threads, one kind of data per thread
+void ExtractionContainers::AppendShards() {
+#pragma omp parallel sections
+    {
+#pragma omp section
+        for(unsigned i = 0; i < shards.size(); ++i) {
+            AppendShardVector(shards[i]->nodes, allNodes);
+        }
+#pragma omp section
+        for(unsigned i = 0; i < shards.size(); ++i) {
+            AppendShardVector(shards[i]->edges, allEdges);
+        }
+#pragma omp section
+        for(unsigned i = 0; i < shards.size(); ++i) {
+            AppendShardVector(shards[i]->wayStartEndEdges, wayStartEndVector);
+        }
+    }
+}
+
 void ExtractionContainers::PrepareData(const std::string & output_file_name, const std::string restrictionsFileName, const unsigned amountOfRAM) {
     try {
         unsigned usedNodeCounter = 0;
@@ -27,14 +54,8 @@ void ExtractionContainers::PrepareData(const std::string & output_file_name, con
         double time = get_timestamp();
         boost::uint64_t memory_to_use = static_cast<boost::uint64_t>(amountOfRAM) * 1024 * 1024 * 1024;
 
-        std::cout << "[extractor] Sorting used nodes        ... " << std::flush;
-        stxxl::sort(usedNodeIDs.begin(), usedNodeIDs.end(), Cmp(), memory_to_use);
-        std::cout << "ok, after " << get_timestamp() - time << "s" << std::endl;
-
-        time = get_timestamp();
-        std::cout << "[extractor] Erasing duplicate nodes   ... " << std::flush;
-        stxxl::vector<NodeID>::iterator NewEnd = std::unique ( usedNodeIDs.begin(),usedNodeIDs.end() ) ;
-        usedNodeIDs.resize ( NewEnd - usedNodeIDs.begin() );
+        std::cout << "[extractor] Appending thread shards   ... " << std::flush;
+        AppendShards();
         std::cout << "ok, after " << get_timestamp() - time << "s" << std::endl;
         time = get_timestamp();
 
@@ -137,24 +158,18 @@ void ExtractionContainers::PrepareData(const std::string & output_file_name, con
         time = get_timestamp();
         std::cout << "[extractor] Confirming/Writing used nodes     ... " << std::flush;
 
-        STXXLNodeVector::iterator nodesIT = allNodes.begin();
-        STXXLNodeIDVector::iterator usedNodeIDsIT = usedNodeIDs.begin();
-        while(usedNodeIDsIT != usedNodeIDs.end() && nodesIT != allNodes.end()) {
-            if(*usedNodeIDsIT < nodesIT->id){
-                ++usedNodeIDsIT;
-                continue;
-            }
-            if(*usedNodeIDsIT > nodesIT->id) {
-                ++nodesIT;
+        NodeID previousNodeID = UINT_MAX;
+        STXXLNodeVector::iterator nodesIT;
+        for(nodesIT = allNodes.begin(); nodesIT != allNodes.end(); ++nodesIT) {
+            //nodes are sorted by id, a duplicate id is written only once
+            if(previousNodeID == nodesIT->id || !usedNodes.IsSet(nodesIT->id)) {
                 continue;
             }
-            if(*usedNodeIDsIT == nodesIT->id) {
-                fout.write((char*)&(*nodesIT), sizeof(_Node));
-                ++usedNodeCounter;
-                ++usedNodeIDsIT;
-                ++nodesIT;
-            }
+            fout.write((char*)&(*nodesIT), sizeof(_Node));
+            ++usedNodeCounter;
+            previousNodeID = nodesIT->id;
         }
+        usedNodes.Clear();
 
         std::cout << "ok, after " << get_timestamp() - time << "s" << std::endl;
 
@@ -22,16 +22,34 @@
 #define EXTRACTIONCONTAINERS_H_
 
 #include "ExtractorStructs.h"
+#include "../DataStructures/ConcurrentBitmap.h"
+#include "../Util/OpenMPWrapper.h"
 #include "../Util/SimpleLogger.h"
 #include "../Util/TimingUtil.h"
 #include "../Util/UUID.h"
 
 #include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
 #include <stxxl.h>
 
+#include <vector>
+
+//What one thread extracted from its parts of all batches of nodes or ways.
+//Each vector caches a single block, so the shards of all threads together
+//take little memory.
+struct ExtractionShard {
+    typedef stxxl::VECTOR_GENERATOR<_Node, 1, 1>::result NodeVector;
+    typedef stxxl::VECTOR_GENERATOR<InternalExtractorEdge, 1, 1>::result EdgeVector;
+    typedef stxxl::VECTOR_GENERATOR<_WayIDStartAndEndEdge, 1, 1>::result WayIDStartEndVector;
+
+    NodeVector nodes;
+    EdgeVector edges;
+    WayIDStartEndVector wayStartEndEdges;
+};
+
 class ExtractionContainers {
 public:
-    typedef stxxl::vector<NodeID> STXXLNodeIDVector;
     typedef stxxl::vector<_Node> STXXLNodeVector;
     typedef stxxl::vector<InternalExtractorEdge> STXXLEdgeVector;
     typedef stxxl::vector<std::string> STXXLStringVector;
@@ -42,10 +60,14 @@ public:
         //Check if another instance of stxxl is already running or if there is a general problem
         stxxl::vector<unsigned> testForRunningInstance;
         nameVector.push_back("");
+        for(int i = 0; i < omp_get_max_threads(); ++i) {
+            shards.push_back(boost::make_shared<ExtractionShard>());
+        }
     }
 
     virtual ~ExtractionContainers() {
-        usedNodeIDs.clear();
+        usedNodes.Clear();
+        shards.clear();
         allNodes.clear();
         allEdges.clear();
         nameVector.clear();
@@ -55,13 +77,24 @@ public:
 
     void PrepareData( const std::string & output_file_name, const std::string restrictionsFileName, const unsigned amountOfRAM);
 
-    STXXLNodeIDVector           usedNodeIDs;
+    //There is one shard per thread, they are appended once in PrepareData
+    inline ExtractionShard & GetShard(const unsigned thread_id) {
+        return *shards[thread_id];
+    }
+
+    //set concurrently while parsing ways
+    ConcurrentBitmap            usedNodes;
     STXXLNodeVector             allNodes;
     STXXLEdgeVector             allEdges;
     STXXLStringVector           nameVector;
     STXXLRestrictionsVector     restrictionsVector;
     STXXLWayIDStartEndVector    wayStartEndVector;
     const UUID uuid;
+
+private:
+    void AppendShards();
+
+    std::vector<boost::shared_ptr<ExtractionShard> > shards;
 };
 
 #endif /* EXTRACTIONCONTAINERS_H_ */
@@ -0,0 +1,259 @@
+/*
+ open source routing machine
+ Copyright (C) Dennis Luxen, others 2010
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU AFFERO General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#include "ExtractionState.h"
+
+#include "ExtractorCallbacks.h"
+#include "../Util/OSRMException.h"
+#include "../Util/SimpleLogger.h"
+
+#include <cstdio>
+
+//Identifies the file format, changes whenever the records do
+static const unsigned EXTRACTION_STATE_VERSION = 0x4F535301;
+
+static inline void ReplayRecord(const unsigned, const _Node & node, ExtractorCallbacks & callbacks) {
+    callbacks.nodeFunction(node);
+}
+
+static inline void ReplayRecord(const unsigned, const ExtractionWay & way, ExtractorCallbacks & callbacks) {
+    //the callbacks modify the way
+    ExtractionWay way_copy(way);
+    callbacks.wayFunction(way_copy);
+}
+
+static inline void ReplayRecord(const unsigned relation_id, const _RawRestrictionContainer & restriction, ExtractorCallbacks & callbacks) {
+    callbacks.restrictionFunction(restriction, relation_id);
+}
+
+ExtractionStateWriter::ExtractionStateWriter(const std::string & file_name) :
+    file_name(file_name),
+    state_stream(file_name.c_str(), std::ios::binary),
+    last_type(0),
+    last_id(0),
+    is_sorted(true)
+{
+    if(!state_stream.good()) {
+        throw OSRMException("Could not open extraction state for writing");
+    }
+    Write(EXTRACTION_STATE_VERSION);
+}
+
+void ExtractionStateWriter::WriteRecordType(const char type, const unsigned id) {
+    //merging needs records sorted by type and id like in planet files
+    if(type < last_type || (type == last_type && id <= last_id)) {
+        is_sorted = false;
+    }
+    last_type = type;
+    last_id = id;
+    Write(type);
+}
+
+void ExtractionStateWriter::WriteNode(const _Node & node) {
+    WriteRecordType(STATE_NODE, node.id);
+    Write(node);
+}
+
+void ExtractionStateWriter::WriteWay(const ExtractionWay & way) {
+    WriteRecordType(STATE_WAY, way.id);
+    Write(way.id);
+    Write(way.direction);
+    Write(way.speed);
+    Write(way.backward_speed);
+    Write(way.duration);
+    Write(way.type);
+    Write(way.access);
+    Write(way.roundabout);
+    Write(way.isAccessRestricted);
+    Write(way.ignoreInGrid);
+    const unsigned name_length = way.name.size();
+    Write(name_length);
+    state_stream.write(way.name.c_str(), name_length);
+    const unsigned path_length = way.path.size();
+    Write(path_length);
+    if(0 < path_length) {
+        state_stream.write((const char *)&way.path[0], path_length*sizeof(NodeID));
+    }
+}
+
+void ExtractionStateWriter::WriteRestriction(const unsigned relation_id, const _RawRestrictionContainer & restriction) {
+    WriteRecordType(STATE_RESTRICTION, relation_id);
+    Write(relation_id);
+    Write(restriction);
+}
+
+bool ExtractionStateWriter::Close() {
+    Write(char(STATE_END));
+    state_stream.close();
+    if(!is_sorted) {
+        SimpleLogger().Write(logWARNING) <<
+            "input is not sorted by type and id, no extraction state written";
+        std::remove(file_name.c_str());
+    }
+    return is_sorted;
+}
+
+ExtractionStateReader::ExtractionStateReader(const std::string & file_name) :
+    state_stream(file_name.c_str(), std::ios::binary),
+    type(STATE_END),
+    id(UINT_MAX)
+{
+    unsigned version = 0;
+    Read(version);
+    if(!state_stream.good() || EXTRACTION_STATE_VERSION != version) {
+        throw OSRMException(
+            "No extraction state found, extract with IncrementalUpdates = 1 first"
+        );
+    }
+    Next();
+}
+
+void ExtractionStateReader::Next() {
+    Read(type);
+    if(!state_stream.good()) {
+        throw OSRMException("extraction state is truncated");
+    }
+    switch(type) {
+    case STATE_NODE:
+        Read(node);
+        id = node.id;
+        break;
+    case STATE_WAY: {
+        Read(way.id);
+        Read(way.direction);
+        Read(way.speed);
+        Read(way.backward_speed);
+        Read(way.duration);
+        Read(way.type);
+        Read(way.access);
+        Read(way.roundabout);
+        Read(way.isAccessRestricted);
+        Read(way.ignoreInGrid);
+        unsigned name_length = 0;
+        Read(name_length);
+        way.name.resize(name_length);
+        if(0 < name_length) {
+            state_stream.read(&way.name[0], name_length);
+        }
+        unsigned path_length = 0;
+        Read(path_length);
+        way.path.resize(path_length);
+        if(0 < path_length) {
+            state_stream.read((char *)&way.path[0], path_length*sizeof(NodeID));
+        }
+        id = way.id;
+        break;
+    }
+    case STATE_RESTRICTION:
+        Read(id);
+        Read(restriction);
+        break;
+    case STATE_END:
+        id = UINT_MAX;
+        break;
+    default:
+        throw OSRMException("extraction state is corrupt");
+    }
+}
+
+void ExtractionStateReader::Replay(ExtractorCallbacks & callbacks) {
+    switch(type) {
+    case STATE_NODE:
+        ReplayRecord(id, node, callbacks);
+        break;
+    case STATE_WAY:
+        ReplayRecord(id, way, callbacks);
+        break;
+    case STATE_RESTRICTION:
+        ReplayRecord(id, restriction, callbacks);
+        break;
+    default:
+        return;
+    }
+    Next();
+}
+
+void ExtractionChangeSet::UpsertNode(const _Node & node) {
+    nodes[node.id].reset(new _Node(node));
+}
+
+void ExtractionChangeSet::DeleteNode(const NodeID id) {
+    nodes[id].reset();
+}
+
+void ExtractionChangeSet::UpsertWay(const ExtractionWay & way) {
+    boost::shared_ptr<ExtractionWay> & stored_way = ways[way.id];
+    stored_way.reset(new ExtractionWay(way));
+    //tags have been evaluated by the profile already
+    stored_way->keyVals.clear();
+}
+
+void ExtractionChangeSet::DeleteWay(const unsigned id) {
+    ways[id].reset();
+}
+
+void ExtractionChangeSet::UpsertRestriction(const unsigned relation_id, const _RawRestrictionContainer & restriction) {
+    restrictions[relation_id].reset(new _RawRestrictionContainer(restriction));
+}
+
+void ExtractionChangeSet::DeleteRestriction(const unsigned relation_id) {
+    restrictions[relation_id].reset();
+}
+
+unsigned ExtractionChangeSet::GetNumberOfChanges() const {
+    return nodes.size() + ways.size() + restrictions.size();
+}
+
+template<typename RecordT>
+void ExtractionChangeSet::ApplySection(
+    const char type,
+    const std::map<unsigned, boost::shared_ptr<RecordT> > & changes,
+    ExtractionStateReader & old_state,
+    ExtractorCallbacks & callbacks
+) const {
+    typename std::map<unsigned, boost::shared_ptr<RecordT> >::const_iterator change = changes.begin();
+    while(type == old_state.GetRecordType() || changes.end() != change) {
+        const bool is_old_record_next = (
+            type == old_state.GetRecordType() &&
+            (changes.end() == change || old_state.GetID() < change->first)
+        );
+        if(is_old_record_next) {
+            old_state.Replay(callbacks);
+            continue;
+        }
+        //the change replaces the old version, if there is one
+        if(type == old_state.GetRecordType() && old_state.GetID() == change->first) {
+            old_state.Next();
+        }
+        if(change->second) {
+            ReplayRecord(change->first, *change->second, callbacks);
+        }
+        ++change;
+    }
+}
+
+void ExtractionChangeSet::Apply(ExtractionStateReader & old_state, ExtractorCallbacks & callbacks) const {
+    ApplySection(STATE_NODE, nodes, old_state, callbacks);
+    ApplySection(STATE_WAY, ways, old_state, callbacks);
+    ApplySection(STATE_RESTRICTION, restrictions, old_state, callbacks);
+    if(STATE_END != old_state.GetRecordType()) {
+        throw OSRMException("extraction state is corrupt");
+    }
+}
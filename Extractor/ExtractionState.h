@@ -0,0 +1,136 @@
+/*
+ open source routing machine
+ Copyright (C) Dennis Luxen, others 2010
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU AFFERO General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef EXTRACTIONSTATE_H_
+#define EXTRACTIONSTATE_H_
+
+#include "ExtractorStructs.h"
+#include "../DataStructures/ImportNode.h"
+#include "../DataStructures/Restriction.h"
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <fstream>
+#include <map>
+#include <string>
+
+class ExtractorCallbacks;
+
+/*
+ * The extraction state is what the extractor callbacks were handed, i.e.
+ * every node, every way accepted by the profile and every restriction, after
+ * the profile has run. Records are sorted by type and id. A change file is
+ * applied by merging its entities into the state and replaying the result
+ * into the callbacks, so the profile only runs on what has changed.
+ */
+enum ExtractionStateRecordType {
+    STATE_NODE = 1,
+    STATE_WAY,
+    STATE_RESTRICTION,
+    STATE_END
+};
+
+class ExtractionStateWriter : boost::noncopyable {
+public:
+    explicit ExtractionStateWriter(const std::string & file_name);
+
+    void WriteNode(const _Node & node);
+    void WriteWay(const ExtractionWay & way);
+    void WriteRestriction(const unsigned relation_id, const _RawRestrictionContainer & restriction);
+
+    //Returns false and removes the file if the input was not sorted
+    bool Close();
+
+private:
+    void WriteRecordType(const char type, const unsigned id);
+
+    template<typename T>
+    void Write(const T & value) {
+        state_stream.write((const char *)&value, sizeof(T));
+    }
+
+    std::string file_name;
+    std::ofstream state_stream;
+    char last_type;
+    unsigned last_id;
+    bool is_sorted;
+};
+
+class ExtractionStateReader : boost::noncopyable {
+public:
+    explicit ExtractionStateReader(const std::string & file_name);
+
+    inline char GetRecordType() const {
+        return type;
+    }
+
+    inline unsigned GetID() const {
+        return id;
+    }
+
+    //Hands the current record to the callbacks and advances
+    void Replay(ExtractorCallbacks & callbacks);
+    void Next();
+
+private:
+    template<typename T>
+    void Read(T & value) {
+        state_stream.read((char *)&value, sizeof(T));
+    }
+
+    std::ifstream state_stream;
+    char type;
+    unsigned id;
+    _Node node;
+    ExtractionWay way;
+    _RawRestrictionContainer restriction;
+};
+
+//Entities of a change file, deletions are stored as empty pointers
+class ExtractionChangeSet : boost::noncopyable {
+public:
+    void UpsertNode(const _Node & node);
+    void DeleteNode(const NodeID id);
+    void UpsertWay(const ExtractionWay & way);
+    void DeleteWay(const unsigned id);
+    void UpsertRestriction(const unsigned relation_id, const _RawRestrictionContainer & restriction);
+    void DeleteRestriction(const unsigned relation_id);
+
+    //Replays old_state with the changes applied into the callbacks
+    void Apply(ExtractionStateReader & old_state, ExtractorCallbacks & callbacks) const;
+
+    unsigned GetNumberOfChanges() const;
+
+private:
+    template<typename RecordT>
+    void ApplySection(
+        const char type,
+        const std::map<unsigned, boost::shared_ptr<RecordT> > & changes,
+        ExtractionStateReader & old_state,
+        ExtractorCallbacks & callbacks
+    ) const;
+
+    std::map<unsigned, boost::shared_ptr<_Node> > nodes;
+    std::map<unsigned, boost::shared_ptr<ExtractionWay> > ways;
+    std::map<unsigned, boost::shared_ptr<_RawRestrictionContainer> > restrictions;
+};
+
+#endif /* EXTRACTIONSTATE_H_ */
@@ -20,105 +20,185 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 
 #include "ExtractorCallbacks.h"
+#include "ExtractionState.h"
+#include "../Util/OpenMPWrapper.h"
 
-ExtractorCallbacks::ExtractorCallbacks() {externalMemory = NULL; stringMap = NULL; }
-ExtractorCallbacks::ExtractorCallbacks(ExtractionContainers * ext, StringMap * strMap) {
+ExtractorCallbacks::ExtractorCallbacks() {externalMemory = NULL; nameTable = NULL; stateWriter = NULL; }
+ExtractorCallbacks::ExtractorCallbacks(ExtractionContainers * ext, ConcurrentStringTable * names) {
     externalMemory = ext;
-    stringMap = strMap;
+    nameTable = names;
+    stateWriter = NULL;
 }
 
 ExtractorCallbacks::~ExtractorCallbacks() { }
 
 /** warning: caller needs to take care of synchronization! */
 void ExtractorCallbacks::nodeFunction(const _Node &n) {
+    if(NULL != stateWriter) {
+        stateWriter->WriteNode(n);
+    }
     if(n.lat <= 85*COORDINATE_PRECISION && n.lat >= -85*COORDINATE_PRECISION) {
         externalMemory->allNodes.push_back(n);
     }
 }
 
-bool ExtractorCallbacks::restrictionFunction(const _RawRestrictionContainer &r) {
+void ExtractorCallbacks::nodeFunction(const std::vector<ImportNode> &nodes) {
+    if(NULL != stateWriter) {
+        BOOST_FOREACH(const ImportNode &n, nodes) {
+            stateWriter->WriteNode(n);
+        }
+    }
+    const int number_of_nodes = nodes.size();
+    //static scheduling hands each thread a contiguous range in input order
+#pragma omp parallel for schedule ( static )
+    for(int i = 0; i < number_of_nodes; ++i) {
+        const ImportNode &n = nodes[i];
+        if(n.lat <= 85*COORDINATE_PRECISION && n.lat >= -85*COORDINATE_PRECISION) {
+            externalMemory->GetShard(omp_get_thread_num()).nodes.push_back(n);
+        }
+    }
+}
+
+bool ExtractorCallbacks::restrictionFunction(const _RawRestrictionContainer &r, const unsigned relation_id) {
+    if(NULL != stateWriter) {
+        stateWriter->WriteRestriction(relation_id, r);
+    }
     externalMemory->restrictionsVector.push_back(r);
     return true;
 }
 
-/** warning: caller needs to take care of synchronization! */
-void ExtractorCallbacks::wayFunction(ExtractionWay &parsed_way) {
-    if((0 < parsed_way.speed) || (0 < parsed_way.duration)) { //Only true if the way is specified by the speed profile
-        if(UINT_MAX == parsed_way.id){
-            SimpleLogger().Write(logDEBUG) <<
-                "found bogus way with id: " << parsed_way.id <<
-                " of size " << parsed_way.path.size();
-            return;
-        }
+/** Checks the way and derives its speed, false if it is not routable */
+bool ExtractorCallbacks::PrepareWay(ExtractionWay &parsed_way) const {
+    if((0 >= parsed_way.speed) && (0 >= parsed_way.duration)) { //Only true if the way is not specified by the speed profile
+        return false;
+    }
+    if(UINT_MAX == parsed_way.id){
+        SimpleLogger().Write(logDEBUG) <<
+            "found bogus way with id: " << parsed_way.id <<
+            " of size " << parsed_way.path.size();
+        return false;
+    }
 
-        if(0 < parsed_way.duration) {
-         //TODO: iterate all way segments and set duration corresponding to the length of each segment
-            parsed_way.speed = parsed_way.duration/(parsed_way.path.size()-1);
-        }
+    if(0 < parsed_way.duration) {
+     //TODO: iterate all way segments and set duration corresponding to the length of each segment
+        parsed_way.speed = parsed_way.duration/(parsed_way.path.size()-1);
+    }
 
-        if(FLT_EPSILON >= fabs(-1. - parsed_way.speed)){
-            SimpleLogger().Write(logDEBUG) <<
-                "found way with bogus speed, id: " << parsed_way.id;
-            return;
-        }
+    if(FLT_EPSILON >= fabs(-1. - parsed_way.speed)){
+        SimpleLogger().Write(logDEBUG) <<
+            "found way with bogus speed, id: " << parsed_way.id;
+        return false;
+    }
+    return true;
+}
 
-        //Get the unique identifier for the street name
-        const StringMap::const_iterator string_map_iterator = stringMap->find(parsed_way.name);
-        if(stringMap->end() == string_map_iterator) {
-            parsed_way.nameID = externalMemory->nameVector.size();
-            externalMemory->nameVector.push_back(parsed_way.name);
-            stringMap->insert(std::make_pair(parsed_way.name, parsed_way.nameID));
-        } else {
-            parsed_way.nameID = string_map_iterator->second;
-        }
+/** warning: caller needs to take care of synchronization! */
+unsigned ExtractorCallbacks::InternName(const std::string &name) {
+    const unsigned name_id = nameTable->Insert(name);
+    if(externalMemory->nameVector.size() == name_id) {
+        externalMemory->nameVector.push_back(name);
+    }
+    return name_id;
+}
 
-        if(ExtractionWay::opposite == parsed_way.direction) {
-            std::reverse( parsed_way.path.begin(), parsed_way.path.end() );
-            parsed_way.direction = ExtractionWay::oneway;
-        }
+void ExtractorCallbacks::AppendWay(ExtractionWay &parsed_way, ExtractionShard &shard) const {
+    if(ExtractionWay::opposite == parsed_way.direction) {
+        std::reverse( parsed_way.path.begin(), parsed_way.path.end() );
+        parsed_way.direction = ExtractionWay::oneway;
+    }
+
+    const bool split_bidirectional_edge = (parsed_way.backward_speed > 0) && (parsed_way.speed != parsed_way.backward_speed);
+
+    for(std::vector< NodeID >::size_type n = 0; n < parsed_way.path.size()-1; ++n) {
+        shard.edges.push_back(
+                InternalExtractorEdge(parsed_way.path[n],
+                        parsed_way.path[n+1],
+                        parsed_way.type,
+                        (split_bidirectional_edge ? ExtractionWay::oneway : parsed_way.direction),
+                        parsed_way.speed,
+                        parsed_way.nameID,
+                        parsed_way.roundabout,
+                        parsed_way.ignoreInGrid,
+                        (0 < parsed_way.duration),
+                        parsed_way.isAccessRestricted
+                )
+        );
+        externalMemory->usedNodes.Set(parsed_way.path[n]);
+    }
+    externalMemory->usedNodes.Set(parsed_way.path.back());
 
-        const bool split_bidirectional_edge = (parsed_way.backward_speed > 0) && (parsed_way.speed != parsed_way.backward_speed);
+    //The following information is needed to identify start and end segments of restrictions
+    shard.wayStartEndEdges.push_back(_WayIDStartAndEndEdge(parsed_way.id, parsed_way.path[0], parsed_way.path[1], parsed_way.path[parsed_way.path.size()-2], parsed_way.path.back()));
 
+    if(split_bidirectional_edge) { //Only true if the way should be split
+        std::reverse( parsed_way.path.begin(), parsed_way.path.end() );
         for(std::vector< NodeID >::size_type n = 0; n < parsed_way.path.size()-1; ++n) {
-            externalMemory->allEdges.push_back(
+            shard.edges.push_back(
                     InternalExtractorEdge(parsed_way.path[n],
                             parsed_way.path[n+1],
                             parsed_way.type,
-                            (split_bidirectional_edge ? ExtractionWay::oneway : parsed_way.direction),
-                            parsed_way.speed,
+                            ExtractionWay::oneway,
+                            parsed_way.backward_speed,
                             parsed_way.nameID,
                             parsed_way.roundabout,
                             parsed_way.ignoreInGrid,
                             (0 < parsed_way.duration),
-                            parsed_way.isAccessRestricted
+                            parsed_way.isAccessRestricted,
+                            (ExtractionWay::oneway == parsed_way.direction)
                     )
             );
-            externalMemory->usedNodeIDs.push_back(parsed_way.path[n]);
         }
-        externalMemory->usedNodeIDs.push_back(parsed_way.path.back());
-
-        //The following information is needed to identify start and end segments of restrictions
-        externalMemory->wayStartEndVector.push_back(_WayIDStartAndEndEdge(parsed_way.id, parsed_way.path[0], parsed_way.path[1], parsed_way.path[parsed_way.path.size()-2], parsed_way.path.back()));
-
-        if(split_bidirectional_edge) { //Only true if the way should be split
-            std::reverse( parsed_way.path.begin(), parsed_way.path.end() );
-            for(std::vector< NodeID >::size_type n = 0; n < parsed_way.path.size()-1; ++n) {
-                externalMemory->allEdges.push_back(
-                        InternalExtractorEdge(parsed_way.path[n],
-                                parsed_way.path[n+1],
-                                parsed_way.type,
-                                ExtractionWay::oneway,
-                                parsed_way.backward_speed,
-                                parsed_way.nameID,
-                                parsed_way.roundabout,
-                                parsed_way.ignoreInGrid,
-                                (0 < parsed_way.duration),
-                                parsed_way.isAccessRestricted,
-                                (ExtractionWay::oneway == parsed_way.direction)
-                        )
-                );
-            }
-            externalMemory->wayStartEndVector.push_back(_WayIDStartAndEndEdge(parsed_way.id, parsed_way.path[0], parsed_way.path[1], parsed_way.path[parsed_way.path.size()-2], parsed_way.path.back()));
+        shard.wayStartEndEdges.push_back(_WayIDStartAndEndEdge(parsed_way.id, parsed_way.path[0], parsed_way.path[1], parsed_way.path[parsed_way.path.size()-2], parsed_way.path.back()));
+    }
+}
+
+/** warning: caller needs to take care of synchronization! */
+void ExtractorCallbacks::wayFunction(ExtractionWay &parsed_way) {
+    if(!PrepareWay(parsed_way)) {
+        return;
+    }
+    if(NULL != stateWriter) {
+        stateWriter->WriteWay(parsed_way);
+    }
+    parsed_way.nameID = InternName(parsed_way.name);
+    AppendWay(parsed_way, externalMemory->GetShard(0));
+}
+
+void ExtractorCallbacks::wayFunction(std::vector<ExtractionWay> &ways) {
+    const int number_of_ways = ways.size();
+    std::vector<char> is_routable(number_of_ways);
+
+    //known names are looked up concurrently
+#pragma omp parallel for schedule ( guided )
+    for(int i = 0; i < number_of_ways; ++i) {
+        ExtractionWay &w = ways[i];
+        is_routable[i] = PrepareWay(w);
+        if(is_routable[i] && !nameTable->Find(w.name, w.nameID)) {
+            w.nameID = UINT_MAX;
+        }
+    }
+
+    //new names get their ids in input order, so the name index is reproducible
+    for(int i = 0; i < number_of_ways; ++i) {
+        if(!is_routable[i]) {
+            continue;
+        }
+        if(NULL != stateWriter) {
+            stateWriter->WriteWay(ways[i]);
+        }
+        if(UINT_MAX == ways[i].nameID) {
+            ways[i].nameID = InternName(ways[i].name);
         }
     }
+
+#pragma omp parallel for schedule ( static )
+    for(int i = 0; i < number_of_ways; ++i) {
+        if(is_routable[i]) {
+            AppendWay(ways[i], externalMemory->GetShard(omp_get_thread_num()));
+        }
+    }
+}
+
+void ExtractorCallbacks::SetStateWriter(ExtractionStateWriter * writer) {
+    stateWriter = writer;
 }
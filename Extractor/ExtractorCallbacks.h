@@ -25,6 +25,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include "ExtractionHelperFunctions.h"
 #include "ExtractorStructs.h"
 
+#include "../DataStructures/ConcurrentStringTable.h"
 #include "../DataStructures/Coordinate.h"
 
 #include <cfloat>
@@ -36,25 +37,41 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include <string>
 #include <vector>
 
+class ExtractionStateWriter;
+
 class ExtractorCallbacks{
 private:
-    StringMap * stringMap;
+    ConcurrentStringTable * nameTable;
     ExtractionContainers * externalMemory;
+    ExtractionStateWriter * stateWriter;
 
     ExtractorCallbacks();
+
+    bool PrepareWay(ExtractionWay &w) const;
+    unsigned InternName(const std::string &name);
+    void AppendWay(ExtractionWay &w, ExtractionShard &shard) const;
 public:
-    explicit ExtractorCallbacks(ExtractionContainers * ext, StringMap * strMap);
+    explicit ExtractorCallbacks(ExtractionContainers * ext, ConcurrentStringTable * names);
 
     ~ExtractorCallbacks();
 
     /** warning: caller needs to take care of synchronization! */
     void nodeFunction(const _Node &n);
 
-    bool restrictionFunction(const _RawRestrictionContainer &r);
+    /** Uses all threads, the results are stored in the order of the input */
+    void nodeFunction(const std::vector<ImportNode> &nodes);
+
+    bool restrictionFunction(const _RawRestrictionContainer &r, const unsigned relation_id);
 
     /** warning: caller needs to take care of synchronization! */
     void wayFunction(ExtractionWay &w);
 
+    /** Uses all threads, the results are stored in the order of the input */
+    void wayFunction(std::vector<ExtractionWay> &ways);
+
+    //Records everything passed to the callbacks for incremental updates
+    void SetStateWriter(ExtractionStateWriter * writer);
+
 };
 
 #endif /* EXTRACTORCALLBACKS_H_ */
@@ -0,0 +1,115 @@
+/*
+ open source routing machine
+ Copyright (C) Dennis Luxen, others 2010
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU AFFERO General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#include "OSCParser.h"
+
+#include <boost/foreach.hpp>
+
+OSCParser::OSCParser(const char * filename, ScriptingEnvironment& se, ExtractionChangeSet& changes) :
+	XMLParser(filename, NULL, se),
+	change_set(changes)
+{ }
+
+bool OSCParser::ReadHeader() {
+	while ( tokenizer.ReadTag() ) {
+		if ( !tokenizer.IsEndTag() && "osmChange" == tokenizer.GetName() ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool OSCParser::Parse() {
+	bool is_deletion = false;
+	while ( tokenizer.ReadTag() ) {
+		const std::string & currentName = tokenizer.GetName();
+
+		//changes are applied in the order of the file
+		if ( "create" == currentName || "modify" == currentName || "delete" == currentName ) {
+			ParseNodeBatch();
+			ParseWayBatch();
+			is_deletion = ( !tokenizer.IsEndTag() && "delete" == currentName );
+			continue;
+		}
+		if ( tokenizer.IsEndTag() ) {
+			continue;
+		}
+
+		if ( "node" == currentName ) {
+			if ( !parsed_ways.empty() ) {
+				ParseWayBatch();
+			}
+			parsed_nodes.push_back( ImportNode() );
+			_ReadXMLNode( parsed_nodes.back() );
+			if ( is_deletion ) {
+				change_set.DeleteNode( parsed_nodes.back().id );
+				parsed_nodes.pop_back();
+			} else if ( XML_PARSER_BATCH_SIZE == parsed_nodes.size() ) {
+				ParseNodeBatch();
+			}
+		}
+
+		if ( "way" == currentName ) {
+			if ( !parsed_nodes.empty() ) {
+				ParseNodeBatch();
+			}
+			parsed_ways.push_back( ExtractionWay() );
+			_ReadXMLWay( parsed_ways.back() );
+			if ( is_deletion ) {
+				change_set.DeleteWay( parsed_ways.back().id );
+				parsed_ways.pop_back();
+			} else if ( XML_PARSER_BATCH_SIZE == parsed_ways.size() ) {
+				ParseWayBatch();
+			}
+		}
+
+		if( use_turn_restrictions ) {
+			if ( "relation" == currentName ) {
+				unsigned relation_id = UINT_MAX;
+				_RawRestrictionContainer r = _ReadXMLRestriction(relation_id);
+				//a relation that is no longer a restriction is removed as well
+				if ( is_deletion || r.fromWay == UINT_MAX ) {
+					change_set.DeleteRestriction( relation_id );
+				} else {
+					change_set.UpsertRestriction( relation_id, r );
+				}
+			}
+		}
+	}
+	ParseNodeBatch();
+	ParseWayBatch();
+	return true;
+}
+
+void OSCParser::ParseNodeBatch() {
+	ParseNodesInLua();
+	BOOST_FOREACH(const ImportNode &n, parsed_nodes) {
+	    change_set.UpsertNode(n);
+	}
+	parsed_nodes.clear();
+}
+
+void OSCParser::ParseWayBatch() {
+	ParseWaysInLua();
+	BOOST_FOREACH(const ExtractionWay & w, parsed_ways) {
+	    change_set.UpsertWay(w);
+	}
+	parsed_ways.clear();
+}
@@ -0,0 +1,45 @@
+/*
+ open source routing machine
+ Copyright (C) Dennis Luxen, others 2010
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU AFFERO General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef OSCPARSER_H_
+#define OSCPARSER_H_
+
+#include "ExtractionState.h"
+#include "XMLParser.h"
+
+/*
+ * Reads an OSM change file (.osc/.osc.bz2). Created and modified entities
+ * go through the profile, the results and all deletions are collected in
+ * a change set instead of being handed to the extractor callbacks.
+ */
+class OSCParser : public XMLParser {
+public:
+    OSCParser(const char* filename, ScriptingEnvironment& se, ExtractionChangeSet& changes);
+    bool ReadHeader();
+    bool Parse();
+
+private:
+    void ParseNodeBatch();
+    void ParseWayBatch();
+
+    ExtractionChangeSet & change_set;
+};
+
+#endif /* OSCPARSER_H_ */
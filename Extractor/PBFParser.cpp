@@ -24,7 +24,7 @@ PBFParser::PBFParser(const char * fileName, ExtractorCallbacks* ec, ScriptingEnv
 	GOOGLE_PROTOBUF_VERIFY_VERSION;
 	//TODO: What is the bottleneck here? Filling the queue or reading the stuff from disk?
 	//NOTE: With Lua scripting, it is parsing the stuff. I/O is virtually for free.
-	threadDataQueue = boost::make_shared<ConcurrentQueue<_ThreadData*> >( 2500 ); /* Max 2500 items in queue, hardcoded. */
+	threadDataQueue = boost::make_shared<ConcurrentQueue<_ThreadData*> >( PBF_MAX_QUEUED_BLOCKS, PBF_MAX_QUEUED_BYTES );
 	input.open(fileName, std::ios::in | std::ios::binary);
 
 	if (!input) {
@@ -98,7 +98,7 @@ inline void PBFParser::ReadData() {
 		keepRunning = readNextBlock(input, threadData);
 
 		if (keepRunning) {
-			threadDataQueue->push(threadData);
+			threadDataQueue->push(threadData, threadData->charBuffer.size());
 		} else {
 			threadDataQueue->push(NULL); // No more data to read, parse stops when NULL encountered
 			delete threadData;
@@ -191,9 +191,7 @@ inline void PBFParser::parseDenseNode(_ThreadData * threadData) {
 	    ParseNodeInLua( n, scriptingEnvironment.getLuaStateForThreadID(omp_get_thread_num()) );
 	}
 
-	BOOST_FOREACH(ImportNode &n, extracted_nodes_vector) {
-	    extractor_callbacks->nodeFunction(n);
-	}
+	extractor_callbacks->nodeFunction(extracted_nodes_vector);
 }
 
 inline void PBFParser::parseNode(_ThreadData * ) {
@@ -285,7 +283,7 @@ inline void PBFParser::parseRelation(_ThreadData * threadData) {
 					break;
 				}
 			}
-			if(!extractor_callbacks->restrictionFunction(currentRestrictionContainer)) {
+			if(!extractor_callbacks->restrictionFunction(currentRestrictionContainer, inputRelation.id())) {
 				std::cerr << "[PBFParser] relation not parsed" << std::endl;
 			}
 		}
@@ -319,9 +317,7 @@ inline void PBFParser::parseWay(_ThreadData * threadData) {
 	    ParseWayInLua( w, scriptingEnvironment.getLuaStateForThreadID(omp_get_thread_num()) );
 	}
 
-	BOOST_FOREACH(ExtractionWay & w, parsed_way_vector) {
-	    extractor_callbacks->wayFunction(w);
-	}
+	extractor_callbacks->wayFunction(parsed_way_vector);
 }
 
 inline void PBFParser::loadGroup(_ThreadData * threadData) {
@@ -41,6 +41,10 @@
 
 #include <zlib.h>
 
+//Bounds the unpacked blocks read ahead of the parser
+static const size_t PBF_MAX_QUEUED_BLOCKS = 4096;
+static const size_t PBF_MAX_QUEUED_BYTES = 512 * 1024 * 1024;
+
 class PBFParser : public BaseParser {
 
     enum EntityType {
@@ -0,0 +1,172 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef TAGFUNCTIONCACHE_H_
+#define TAGFUNCTIONCACHE_H_
+
+#include "ExtractorStructs.h"
+#include "../DataStructures/HashTable.h"
+#include "../DataStructures/ImportNode.h"
+#include "../DataStructures/LRUCache.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+//Distinct tag sets remembered per thread, for ways and nodes each
+static const unsigned TAG_FUNCTION_CACHE_SIZE = 65536;
+
+/*
+ * Remembers what way_function and node_function made of a set of tags. Only
+ * valid for profiles whose functions depend on nothing but the tags, which
+ * is what a profile declares by setting pure_profile. Not thread-safe, each
+ * parsing thread has its own.
+ */
+class TagFunctionCache : boost::noncopyable {
+public:
+    TagFunctionCache() :
+        ways(TAG_FUNCTION_CACHE_SIZE),
+        nodes(TAG_FUNCTION_CACHE_SIZE),
+        hits(0),
+        misses(0)
+    { }
+
+    //Looks up the tags of the way, a miss is followed by InsertWay()
+    bool FindWay(ExtractionWay & way) {
+        GetTagSetKey(way.keyVals, current_key);
+        WayAttributes attributes;
+        if(!ways.Fetch(current_key, attributes)) {
+            ++misses;
+            return false;
+        }
+        ++hits;
+        attributes.ApplyTo(way);
+        return true;
+    }
+
+    void InsertWay(const ExtractionWay & way) {
+        ways.Insert(current_key, WayAttributes(way));
+    }
+
+    //Looks up the tags of the node, a miss is followed by InsertNode()
+    bool FindNode(ImportNode & node) {
+        GetTagSetKey(node.keyVals, current_key);
+        NodeAttributes attributes;
+        if(!nodes.Fetch(current_key, attributes)) {
+            ++misses;
+            return false;
+        }
+        ++hits;
+        node.bollard = attributes.bollard;
+        node.trafficLight = attributes.traffic_light;
+        return true;
+    }
+
+    void InsertNode(const ImportNode & node) {
+        nodes.Insert(current_key, NodeAttributes(node.bollard, node.trafficLight));
+    }
+
+    uint64_t GetNumberOfHits() const {
+        return hits;
+    }
+
+    uint64_t GetNumberOfMisses() const {
+        return misses;
+    }
+
+private:
+    //The attributes a profile may set on a way, i.e. no ids and no geometry
+    struct WayAttributes {
+        WayAttributes() { }
+        explicit WayAttributes(const ExtractionWay & way) :
+            name(way.name),
+            direction(way.direction),
+            speed(way.speed),
+            backward_speed(way.backward_speed),
+            duration(way.duration),
+            type(way.type),
+            access(way.access),
+            roundabout(way.roundabout),
+            isAccessRestricted(way.isAccessRestricted),
+            ignoreInGrid(way.ignoreInGrid)
+        { }
+
+        void ApplyTo(ExtractionWay & way) const {
+            way.name = name;
+            way.direction = direction;
+            way.speed = speed;
+            way.backward_speed = backward_speed;
+            way.duration = duration;
+            way.type = type;
+            way.access = access;
+            way.roundabout = roundabout;
+            way.isAccessRestricted = isAccessRestricted;
+            way.ignoreInGrid = ignoreInGrid;
+        }
+
+        std::string name;
+        ExtractionWay::Directions direction;
+        double speed;
+        double backward_speed;
+        double duration;
+        short type;
+        bool access;
+        bool roundabout;
+        bool isAccessRestricted;
+        bool ignoreInGrid;
+    };
+
+    struct NodeAttributes {
+        NodeAttributes() : bollard(false), traffic_light(false) { }
+        NodeAttributes(const bool bollard, const bool traffic_light) :
+            bollard(bollard), traffic_light(traffic_light)
+        { }
+        bool bollard;
+        bool traffic_light;
+    };
+
+    //Tags sorted by key, separated by characters that tags do not contain
+    void GetTagSetKey(
+        const HashTable<std::string, std::string> & tags,
+        std::string & key
+    ) {
+        sorted_tags.assign(tags.begin(), tags.end());
+        std::sort(sorted_tags.begin(), sorted_tags.end());
+        key.clear();
+        for(unsigned i = 0; i < sorted_tags.size(); ++i) {
+            key += sorted_tags[i].first;
+            key += '\0';
+            key += sorted_tags[i].second;
+            key += '\0';
+        }
+    }
+
+    LRUCache<std::string, WayAttributes> ways;
+    LRUCache<std::string, NodeAttributes> nodes;
+    std::vector<std::pair<std::string, std::string> > sorted_tags;
+    std::string current_key;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+#endif /* TAGFUNCTIONCACHE_H_ */
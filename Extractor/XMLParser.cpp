@@ -22,136 +22,151 @@
 
 #include "ExtractorStructs.h"
 #include "../DataStructures/HashTable.h"
-#include "../DataStructures/InputReaderFactory.h"
+#include "../Util/OpenMPWrapper.h"
 
-#include <boost/ref.hpp>
 
-XMLParser::XMLParser(const char * filename, ExtractorCallbacks* ec, ScriptingEnvironment& se) : BaseParser(ec, se) {
+XMLParser::XMLParser(const char * filename, ExtractorCallbacks* ec, ScriptingEnvironment& se) :
+	BaseParser(ec, se),
+	inputReader(inputReaderFactory(filename)),
+	tokenizer(*inputReader)
+{ }
+
+bool XMLParser::ReadHeader() {
 	SimpleLogger().Write(logWARNING) <<
 		"Parsing plain .osm/.osm.bz2 is deprecated. Switch to .pbf";
-
-	inputReader = inputReaderFactory(filename);
+	while ( tokenizer.ReadTag() ) {
+		if ( !tokenizer.IsEndTag() && "osm" == tokenizer.GetName() ) {
+			return true;
+		}
+	}
+	return false;
 }
 
-bool XMLParser::ReadHeader() {
-	return (xmlTextReaderRead( inputReader ) == 1);
-}
 bool XMLParser::Parse() {
-	while ( xmlTextReaderRead( inputReader ) == 1 ) {
-		const int type = xmlTextReaderNodeType( inputReader );
-
-		//1 is Element
-		if ( type != 1 ) {
+	while ( tokenizer.ReadTag() ) {
+		if ( tokenizer.IsEndTag() ) {
 			continue;
 		}
+		const std::string & currentName = tokenizer.GetName();
 
-		xmlChar* currentName = xmlTextReaderName( inputReader );
-		if ( currentName == NULL ) {
-			continue;
-		}
-
-		if ( xmlStrEqual( currentName, ( const xmlChar* ) "node" ) == 1 ) {
-			ImportNode n = _ReadXMLNode();
-			ParseNodeInLua( n, luaState );
-			extractor_callbacks->nodeFunction(n);
-//			if(!extractor_callbacks->nodeFunction(n))
-//				std::cerr << "[XMLParser] dense node not parsed" << std::endl;
+		//keep the order of the input, all nodes before the ways
+		if ( "node" == currentName ) {
+			if ( !parsed_ways.empty() ) {
+				ParseWayBatch();
+			}
+			parsed_nodes.push_back( ImportNode() );
+			_ReadXMLNode( parsed_nodes.back() );
+			if ( XML_PARSER_BATCH_SIZE == parsed_nodes.size() ) {
+				ParseNodeBatch();
+			}
 		}
 
-		if ( xmlStrEqual( currentName, ( const xmlChar* ) "way" ) == 1 ) {
-			ExtractionWay way = _ReadXMLWay( );
-			ParseWayInLua( way, luaState );
-			extractor_callbacks->wayFunction(way);
-//			if(!extractor_callbacks->wayFunction(way))
-//				std::cerr << "[PBFParser] way not parsed" << std::endl;
+		if ( "way" == currentName ) {
+			if ( !parsed_nodes.empty() ) {
+				ParseNodeBatch();
+			}
+			parsed_ways.push_back( ExtractionWay() );
+			_ReadXMLWay( parsed_ways.back() );
+			if ( XML_PARSER_BATCH_SIZE == parsed_ways.size() ) {
+				ParseWayBatch();
+			}
 		}
 		if( use_turn_restrictions ) {
-			if ( xmlStrEqual( currentName, ( const xmlChar* ) "relation" ) == 1 ) {
-				_RawRestrictionContainer r = _ReadXMLRestriction();
+			if ( "relation" == currentName ) {
+				ParseNodeBatch();
+				ParseWayBatch();
+				unsigned relation_id = UINT_MAX;
+				_RawRestrictionContainer r = _ReadXMLRestriction(relation_id);
 				if(r.fromWay != UINT_MAX) {
-					if(!extractor_callbacks->restrictionFunction(r)) {
+					if(!extractor_callbacks->restrictionFunction(r, relation_id)) {
 						std::cerr << "[XMLParser] restriction not parsed" << std::endl;
 					}
 				}
 			}
 		}
-		xmlFree( currentName );
 	}
+	ParseNodeBatch();
+	ParseWayBatch();
 	return true;
 }
 
-_RawRestrictionContainer XMLParser::_ReadXMLRestriction() {
-    _RawRestrictionContainer restriction;
-    std::string except_tag_string;
+void XMLParser::ParseNodesInLua() {
+	const int number_of_nodes = parsed_nodes.size();
+#pragma omp parallel for schedule ( guided )
+	for(int i = 0; i < number_of_nodes; ++i) {
+	    ImportNode &n = parsed_nodes[i];
+	    ParseNodeInLua( n, scriptingEnvironment.getLuaStateForThreadID(omp_get_thread_num()) );
+	}
+}
 
-	if ( xmlTextReaderIsEmptyElement( inputReader ) != 1 ) {
-		const int depth = xmlTextReaderDepth( inputReader );while ( xmlTextReaderRead( inputReader ) == 1 ) {
-			const int childType = xmlTextReaderNodeType( inputReader );
-			if ( childType != 1 && childType != 15 ) {
-				continue;
-			}
-			const int childDepth = xmlTextReaderDepth( inputReader );
-			xmlChar* childName = xmlTextReaderName( inputReader );
-			if ( childName == NULL ) {
-				continue;
-			}
-			if ( depth == childDepth && childType == 15 && xmlStrEqual( childName, ( const xmlChar* ) "relation" ) == 1 ) {
-				xmlFree( childName );
-				break;
-			}
-			if ( childType != 1 ) {
-				xmlFree( childName );
+void XMLParser::ParseWaysInLua() {
+	const int number_of_ways = parsed_ways.size();
+#pragma omp parallel for schedule ( guided )
+	for(int i = 0; i < number_of_ways; ++i) {
+	    ExtractionWay & w = parsed_ways[i];
+	    ParseWayInLua( w, scriptingEnvironment.getLuaStateForThreadID(omp_get_thread_num()) );
+	}
+}
+
+void XMLParser::ParseNodeBatch() {
+	ParseNodesInLua();
+	extractor_callbacks->nodeFunction(parsed_nodes);
+	parsed_nodes.clear();
+}
+
+void XMLParser::ParseWayBatch() {
+	ParseWaysInLua();
+	extractor_callbacks->wayFunction(parsed_ways);
+	parsed_ways.clear();
+}
+
+_RawRestrictionContainer XMLParser::_ReadXMLRestriction(unsigned & relation_id) {
+	_RawRestrictionContainer restriction;
+	std::string except_tag_string;
+
+	const char * id = tokenizer.GetAttribute( "id" );
+	if ( id != NULL ) {
+		relation_id = stringToUint( id );
+	}
+
+	if ( !tokenizer.IsEmptyElement() ) {
+		while ( tokenizer.ReadTag() ) {
+			if ( tokenizer.IsEndTag() ) {
+				if ( "relation" == tokenizer.GetName() ) {
+					break;
+				}
 				continue;
 			}
 
-			if ( xmlStrEqual( childName, ( const xmlChar* ) "tag" ) == 1 ) {
-				xmlChar* k = xmlTextReaderGetAttribute( inputReader, ( const xmlChar* ) "k" );
-				xmlChar* value = xmlTextReaderGetAttribute( inputReader, ( const xmlChar* ) "v" );
+			if ( "tag" == tokenizer.GetName() ) {
+				const char * k = tokenizer.GetAttribute( "k" );
+				const char * value = tokenizer.GetAttribute( "v" );
 				if ( k != NULL && value != NULL ) {
-					if(xmlStrEqual(k, ( const xmlChar* ) "restriction" )){
-						if(0 == std::string((const char *) value).find("only_")) {
+					if( 0 == strcmp(k, "restriction") ) {
+						if(0 == std::string(value).find("only_")) {
 							restriction.restriction.flags.isOnly = true;
 						}
 					}
-					if ( xmlStrEqual(k, (const xmlChar *) "except") ) {
-						except_tag_string = (const char*) value;
+					if ( 0 == strcmp(k, "except") ) {
+						except_tag_string = value;
 					}
 				}
-
-				if ( k != NULL ) {
-					xmlFree( k );
-				}
-				if ( value != NULL ) {
-					xmlFree( value );
-				}
-			} else if ( xmlStrEqual( childName, ( const xmlChar* ) "member" ) == 1 ) {
-				xmlChar* ref = xmlTextReaderGetAttribute( inputReader, ( const xmlChar* ) "ref" );
-				if ( ref != NULL ) {
-					xmlChar * role = xmlTextReaderGetAttribute( inputReader, ( const xmlChar* ) "role" );
-					xmlChar * type = xmlTextReaderGetAttribute( inputReader, ( const xmlChar* ) "type" );
-
-					if(xmlStrEqual(role, (const xmlChar *) "to") && xmlStrEqual(type, (const xmlChar *) "way")) {
-						restriction.toWay = stringToUint((const char*) ref);
+			} else if ( "member" == tokenizer.GetName() ) {
+				const char * ref = tokenizer.GetAttribute( "ref" );
+				const char * role = tokenizer.GetAttribute( "role" );
+				const char * type = tokenizer.GetAttribute( "type" );
+				if ( ref != NULL && role != NULL && type != NULL ) {
+					if( 0 == strcmp(role, "to") && 0 == strcmp(type, "way") ) {
+						restriction.toWay = stringToUint(ref);
 					}
-					if(xmlStrEqual(role, (const xmlChar *) "from") && xmlStrEqual(type, (const xmlChar *) "way")) {
-						restriction.fromWay = stringToUint((const char*) ref);
+					if( 0 == strcmp(role, "from") && 0 == strcmp(type, "way") ) {
+						restriction.fromWay = stringToUint(ref);
 					}
-					if(xmlStrEqual(role, (const xmlChar *) "via") && xmlStrEqual(type, (const xmlChar *) "node")) {
-						restriction.restriction.viaNode = stringToUint((const char*) ref);
-					}
-
-					if(NULL != type) {
-						xmlFree( type );
-					}
-					if(NULL != role) {
-						xmlFree( role );
-					}
-					if(NULL != ref) {
-						xmlFree( ref );
+					if( 0 == strcmp(role, "via") && 0 == strcmp(type, "node") ) {
+						restriction.restriction.viaNode = stringToUint(ref);
 					}
 				}
 			}
-			xmlFree( childName );
 		}
 	}
 
@@ -161,117 +176,68 @@ _RawRestrictionContainer XMLParser::_ReadXMLRestriction() {
 	return restriction;
 }
 
-ExtractionWay XMLParser::_ReadXMLWay() {
-	ExtractionWay way;
-	if ( xmlTextReaderIsEmptyElement( inputReader ) != 1 ) {
-		const int depth = xmlTextReaderDepth( inputReader );
-		while ( xmlTextReaderRead( inputReader ) == 1 ) {
-			const int childType = xmlTextReaderNodeType( inputReader );
-			if ( childType != 1 && childType != 15 ) {
-				continue;
-			}
-			const int childDepth = xmlTextReaderDepth( inputReader );
-			xmlChar* childName = xmlTextReaderName( inputReader );
-			if ( childName == NULL ) {
-				continue;
-			}
-
-			if ( depth == childDepth && childType == 15 && xmlStrEqual( childName, ( const xmlChar* ) "way" ) == 1 ) {
-				xmlChar* id = xmlTextReaderGetAttribute( inputReader, ( const xmlChar* ) "id" );
-				way.id = stringToUint((char*)id);
-				xmlFree(id);
-				xmlFree( childName );
+void XMLParser::_ReadXMLWay(ExtractionWay & way) {
+	const char * id = tokenizer.GetAttribute( "id" );
+	if ( id != NULL ) {
+		way.id = stringToUint( id );
+	}
+	if ( tokenizer.IsEmptyElement() ) {
+		return;
+	}
+	while ( tokenizer.ReadTag() ) {
+		if ( tokenizer.IsEndTag() ) {
+			if ( "way" == tokenizer.GetName() ) {
 				break;
 			}
-			if ( childType != 1 ) {
-				xmlFree( childName );
-				continue;
-			}
+			continue;
+		}
 
-			if ( xmlStrEqual( childName, ( const xmlChar* ) "tag" ) == 1 ) {
-				xmlChar* k = xmlTextReaderGetAttribute( inputReader, ( const xmlChar* ) "k" );
-				xmlChar* value = xmlTextReaderGetAttribute( inputReader, ( const xmlChar* ) "v" );
-				//				cout << "->k=" << k << ", v=" << value << endl;
-				if ( k != NULL && value != NULL ) {
-					way.keyVals.Add(std::string( (char *) k ), std::string( (char *) value));
-				}
-				if ( k != NULL ) {
-					xmlFree( k );
-				}
-				if ( value != NULL ) {
-					xmlFree( value );
-				}
-			} else if ( xmlStrEqual( childName, ( const xmlChar* ) "nd" ) == 1 ) {
-				xmlChar* ref = xmlTextReaderGetAttribute( inputReader, ( const xmlChar* ) "ref" );
-				if ( ref != NULL ) {
-					way.path.push_back( stringToUint(( const char* ) ref ) );
-					xmlFree( ref );
-				}
+		if ( "tag" == tokenizer.GetName() ) {
+			const char * k = tokenizer.GetAttribute( "k" );
+			const char * value = tokenizer.GetAttribute( "v" );
+			if ( k != NULL && value != NULL ) {
+				way.keyVals.Add(std::string( k ), std::string( value ));
+			}
+		} else if ( "nd" == tokenizer.GetName() ) {
+			const char * ref = tokenizer.GetAttribute( "ref" );
+			if ( ref != NULL ) {
+				way.path.push_back( stringToUint( ref ) );
 			}
-			xmlFree( childName );
 		}
 	}
-	return way;
 }
 
-ImportNode XMLParser::_ReadXMLNode() {
-	ImportNode node;
-
-	xmlChar* attribute = xmlTextReaderGetAttribute( inputReader, ( const xmlChar* ) "lat" );
+void XMLParser::_ReadXMLNode(ImportNode & node) {
+	const char * attribute = tokenizer.GetAttribute( "lat" );
 	if ( attribute != NULL ) {
-		node.lat =  static_cast<NodeID>(COORDINATE_PRECISION*atof(( const char* ) attribute ) );
-		xmlFree( attribute );
+		node.lat =  static_cast<NodeID>(COORDINATE_PRECISION*atof( attribute ) );
 	}
-	attribute = xmlTextReaderGetAttribute( inputReader, ( const xmlChar* ) "lon" );
+	attribute = tokenizer.GetAttribute( "lon" );
 	if ( attribute != NULL ) {
-		node.lon =  static_cast<NodeID>(COORDINATE_PRECISION*atof(( const char* ) attribute ));
-		xmlFree( attribute );
+		node.lon =  static_cast<NodeID>(COORDINATE_PRECISION*atof( attribute ));
 	}
-	attribute = xmlTextReaderGetAttribute( inputReader, ( const xmlChar* ) "id" );
+	attribute = tokenizer.GetAttribute( "id" );
 	if ( attribute != NULL ) {
-		node.id =  stringToUint(( const char* ) attribute );
-		xmlFree( attribute );
+		node.id =  stringToUint( attribute );
 	}
 
-	if ( xmlTextReaderIsEmptyElement( inputReader ) != 1 ) {
-		const int depth = xmlTextReaderDepth( inputReader );
-		while ( xmlTextReaderRead( inputReader ) == 1 ) {
-			const int childType = xmlTextReaderNodeType( inputReader );
-			// 1 = Element, 15 = EndElement
-			if ( childType != 1 && childType != 15 ) {
-				continue;
-			}
-			const int childDepth = xmlTextReaderDepth( inputReader );
-			xmlChar* childName = xmlTextReaderName( inputReader );
-			if ( childName == NULL ) {
-				continue;
-			}
-
-			if ( depth == childDepth && childType == 15 && xmlStrEqual( childName, ( const xmlChar* ) "node" ) == 1 ) {
-				xmlFree( childName );
+	if ( tokenizer.IsEmptyElement() ) {
+		return;
+	}
+	while ( tokenizer.ReadTag() ) {
+		if ( tokenizer.IsEndTag() ) {
+			if ( "node" == tokenizer.GetName() ) {
 				break;
 			}
-			if ( childType != 1 ) {
-				xmlFree( childName );
-				continue;
-			}
+			continue;
+		}
 
-			if ( xmlStrEqual( childName, ( const xmlChar* ) "tag" ) == 1 ) {
-				xmlChar* k = xmlTextReaderGetAttribute( inputReader, ( const xmlChar* ) "k" );
-				xmlChar* value = xmlTextReaderGetAttribute( inputReader, ( const xmlChar* ) "v" );
-				if ( k != NULL && value != NULL ) {
-					node.keyVals.Add(std::string( reinterpret_cast<char*>(k) ), std::string( reinterpret_cast<char*>(value)));
-				}
-				if ( k != NULL ) {
-					xmlFree( k );
-				}
-				if ( value != NULL ) {
-					xmlFree( value );
-				}
+		if ( "tag" == tokenizer.GetName() ) {
+			const char * k = tokenizer.GetAttribute( "k" );
+			const char * value = tokenizer.GetAttribute( "v" );
+			if ( k != NULL && value != NULL ) {
+				node.keyVals.Add(std::string( k ), std::string( value ));
 			}
-
-			xmlFree( childName );
 		}
 	}
-	return node;
 }
@@ -22,13 +22,19 @@
 #define XMLPARSER_H_
 
 #include "BaseParser.h"
+#include "XMLTokenizer.h"
 #include "../DataStructures/Coordinate.h"
+#include "../DataStructures/InputReaderFactory.h"
 #include "../Util/SimpleLogger.h"
 #include "../Util/StringUtil.h"
 #include "../typedefs.h"
 
-#include <libxml/xmlreader.h>
+#include <boost/scoped_ptr.hpp>
 
+#include <vector>
+
+//Nodes and ways handed to the profile at once
+static const unsigned XML_PARSER_BATCH_SIZE = 10000;
 
 class XMLParser : public BaseParser {
 public:
@@ -36,11 +42,19 @@ public:
     bool ReadHeader();
     bool Parse();
 
-private:
-    _RawRestrictionContainer _ReadXMLRestriction();
-    ExtractionWay _ReadXMLWay();
-    ImportNode _ReadXMLNode();
-    xmlTextReaderPtr inputReader;
+protected:
+    _RawRestrictionContainer _ReadXMLRestriction(unsigned & relation_id);
+    void _ReadXMLWay(ExtractionWay & way);
+    void _ReadXMLNode(ImportNode & node);
+    void ParseNodesInLua();
+    void ParseWaysInLua();
+    virtual void ParseNodeBatch();
+    virtual void ParseWayBatch();
+
+    boost::scoped_ptr<InputReader> inputReader;
+    XMLTokenizer tokenizer;
+    std::vector<ImportNode> parsed_nodes;
+    std::vector<ExtractionWay> parsed_ways;
 };
 
 #endif /* XMLPARSER_H_ */
@@ -0,0 +1,316 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef XMLTOKENIZER_H_
+#define XMLTOKENIZER_H_
+
+#include "../DataStructures/InputReaderFactory.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+static const unsigned XML_TOKENIZER_BUFFER_SIZE = 1024*1024;
+
+/*
+ * Pull tokenizer for the subset of XML that makes up OSM files. It only
+ * reports tags and their attributes; text, comments, processing
+ * instructions, CDATA and the DOCTYPE are skipped, nothing is validated.
+ * Entities in attribute values are decoded, which is all the parser needs
+ * and a lot cheaper than building a document with libxml.
+ */
+class XMLTokenizer : boost::noncopyable {
+public:
+    explicit XMLTokenizer(InputReader & input) :
+        input(input),
+        buffer(XML_TOKENIZER_BUFFER_SIZE),
+        position(0),
+        buffer_end(0),
+        is_end_tag(false),
+        is_empty_element(false),
+        number_of_attributes(0)
+    { }
+
+    //Advances to the next start, end or empty element tag
+    bool ReadTag() {
+        char c;
+        while(true) {
+            do {
+                if(!GetChar(c)) {
+                    return false;
+                }
+            } while('<' != c);
+            if(!GetChar(c)) {
+                return false;
+            }
+            switch(c) {
+            case '?':
+                SkipPast("?>");
+                break;
+            case '!':
+                SkipDeclaration();
+                break;
+            case '/':
+                return ReadEndTag();
+            default:
+                return ReadStartTag(c);
+            }
+        }
+    }
+
+    inline const std::string & GetName() const {
+        return name;
+    }
+
+    inline bool IsEndTag() const {
+        return is_end_tag;
+    }
+
+    //<tag/>, there is no matching end tag
+    inline bool IsEmptyElement() const {
+        return is_empty_element;
+    }
+
+    //Decoded value of the attribute of the current tag or NULL
+    const char * GetAttribute(const char * attribute_name) const {
+        for(unsigned i = 0; i < number_of_attributes; ++i) {
+            if(attributes[i].first == attribute_name) {
+                return attributes[i].second.c_str();
+            }
+        }
+        return NULL;
+    }
+
+private:
+    inline bool GetChar(char & c) {
+        if(position == buffer_end) {
+            buffer_end = input.Read(&buffer[0], buffer.size());
+            position = 0;
+            if(0 == buffer_end) {
+                return false;
+            }
+        }
+        c = buffer[position++];
+        return true;
+    }
+
+    static inline bool IsWhitespace(const char c) {
+        return ' ' == c || '\n' == c || '\t' == c || '\r' == c;
+    }
+
+    void SkipPast(const char * terminator) {
+        const unsigned length = strlen(terminator);
+        std::string last_characters;
+        char c;
+        while(GetChar(c)) {
+            last_characters += c;
+            if(last_characters.size() > length) {
+                last_characters.erase(0, 1);
+            }
+            if(last_characters == terminator) {
+                return;
+            }
+        }
+    }
+
+    //<!-- -->, <![CDATA[ ]]> or <!DOCTYPE [ ]>
+    void SkipDeclaration() {
+        char c;
+        if(!GetChar(c)) {
+            return;
+        }
+        if('-' == c) {
+            SkipPast("-->");
+            return;
+        }
+        if('[' == c) {
+            SkipPast("]]>");
+            return;
+        }
+        int depth = 0;
+        while(GetChar(c)) {
+            if('[' == c) {
+                ++depth;
+            } else if(']' == c) {
+                --depth;
+            } else if('>' == c && 0 >= depth) {
+                return;
+            }
+        }
+    }
+
+    bool ReadEndTag() {
+        is_end_tag = true;
+        is_empty_element = false;
+        number_of_attributes = 0;
+        name.clear();
+        char c;
+        while(GetChar(c)) {
+            if('>' == c) {
+                return true;
+            }
+            if(!IsWhitespace(c)) {
+                name += c;
+            }
+        }
+        return false;
+    }
+
+    bool ReadStartTag(char c) {
+        is_end_tag = false;
+        is_empty_element = false;
+        number_of_attributes = 0;
+        name.clear();
+        while(!IsWhitespace(c) && '/' != c && '>' != c) {
+            name += c;
+            if(!GetChar(c)) {
+                return false;
+            }
+        }
+        while(true) {
+            while(IsWhitespace(c)) {
+                if(!GetChar(c)) {
+                    return false;
+                }
+            }
+            if('>' == c) {
+                return true;
+            }
+            if('/' == c) {
+                is_empty_element = true;
+                if(!GetChar(c)) {
+                    return false;
+                }
+                continue;
+            }
+            if(!ReadAttribute(c)) {
+                return false;
+            }
+        }
+    }
+
+    //Reads name="value", c is the first character of the name and
+    //afterwards the first one after the value
+    bool ReadAttribute(char & c) {
+        if(number_of_attributes == attributes.size()) {
+            attributes.resize(number_of_attributes+1);
+        }
+        std::string & attribute_name = attributes[number_of_attributes].first;
+        std::string & value = attributes[number_of_attributes].second;
+        attribute_name.clear();
+        value.clear();
+        while('=' != c && !IsWhitespace(c)) {
+            attribute_name += c;
+            if(!GetChar(c)) {
+                return false;
+            }
+        }
+        do {
+            if(!GetChar(c)) {
+                return false;
+            }
+        } while('"' != c && '\'' != c);
+        const char quote = c;
+        while(GetChar(c)) {
+            if(quote == c) {
+                ++number_of_attributes;
+                return GetChar(c);
+            }
+            if('&' == c) {
+                if(!ReadEntity(value)) {
+                    return false;
+                }
+            } else {
+                value += c;
+            }
+        }
+        return false;
+    }
+
+    bool ReadEntity(std::string & value) {
+        std::string entity;
+        char c;
+        while(GetChar(c)) {
+            if(';' == c) {
+                AppendEntity(entity, value);
+                return true;
+            }
+            entity += c;
+        }
+        return false;
+    }
+
+    static void AppendEntity(const std::string & entity, std::string & value) {
+        if("amp" == entity) {
+            value += '&';
+        } else if("lt" == entity) {
+            value += '<';
+        } else if("gt" == entity) {
+            value += '>';
+        } else if("quot" == entity) {
+            value += '"';
+        } else if("apos" == entity) {
+            value += '\'';
+        } else if(1 < entity.size() && '#' == entity[0]) {
+            const bool is_hex = ('x' == entity[1] || 'X' == entity[1]);
+            AppendUTF8(strtoul(entity.c_str() + (is_hex ? 2 : 1), NULL, (is_hex ? 16 : 10)), value);
+        } else {
+            //unknown entities are kept as they are
+            value += '&';
+            value += entity;
+            value += ';';
+        }
+    }
+
+    static void AppendUTF8(const unsigned long code_point, std::string & value) {
+        if(code_point < 0x80) {
+            value += char(code_point);
+        } else if(code_point < 0x800) {
+            value += char(0xC0 | (code_point >> 6));
+            value += char(0x80 | (code_point & 0x3F));
+        } else if(code_point < 0x10000) {
+            value += char(0xE0 | (code_point >> 12));
+            value += char(0x80 | ((code_point >> 6) & 0x3F));
+            value += char(0x80 | (code_point & 0x3F));
+        } else {
+            value += char(0xF0 | (code_point >> 18));
+            value += char(0x80 | ((code_point >> 12) & 0x3F));
+            value += char(0x80 | ((code_point >> 6) & 0x3F));
+            value += char(0x80 | (code_point & 0x3F));
+        }
+    }
+
+    InputReader & input;
+    std::vector<char> buffer;
+    int position;
+    int buffer_end;
+    std::string name;
+    bool is_end_tag;
+    bool is_empty_element;
+    //attributes are reused from tag to tag, only the first ones are valid
+    std::vector<std::pair<std::string, std::string> > attributes;
+    unsigned number_of_attributes;
+};
+
+#endif /* XMLTOKENIZER_H_ */
@@ -20,7 +20,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 #include "OSRM.h"
 
-OSRM::OSRM(const char * server_ini_path) {
+OSRM::OSRM(const char * server_ini_path) : maxLoadedRegions(0), useCounter(0) {
     if( !testDataFile(server_ini_path) ){
         std::string error_message = std::string(server_ini_path) + " not found";
         throw OSRMException(error_message.c_str());
@@ -31,92 +31,343 @@ OSRM::OSRM(const char * server_ini_path) {
     boost::filesystem::path base_path =
                boost::filesystem::absolute(server_ini_path).parent_path();
 
-    if ( !serverConfig.Holds("hsgrData")) {
+    if ( serverConfig.Holds("MaxLoadedRegions") ) {
+        maxLoadedRegions = std::max(0, stringToInt(serverConfig.GetParameter("MaxLoadedRegions")));
+    }
+
+    //Profiles = car,bike,foot declares one dataset per profile, their
+    //files are given as car.hsgrData=... and so on. Without it there is a
+    //single dataset with unprefixed file names.
+    if ( !serverConfig.Holds("Profiles") ) {
+        AddProfile(serverConfig, base_path, "");
+        return;
+    }
+    std::vector<std::string> profiles;
+    stringSplit(serverConfig.GetParameter("Profiles"), ',', profiles);
+    BOOST_FOREACH(std::string & profile, profiles) {
+        boost::trim(profile);
+        if( profile.empty() ) {
+            continue;
+        }
+        if( profileMap.end() != profileMap.find(profile) ) {
+            throw OSRMException("profile declared twice in server ini");
+        }
+        AddProfile(serverConfig, base_path, profile);
+        //requests without a profile prefix go to the first one
+        if( defaultProfile.empty() ) {
+            defaultProfile = profile;
+        }
+    }
+    if( profileMap.empty() ) {
+        throw OSRMException("no profiles declared in server ini");
+    }
+}
+
+OSRM::~OSRM() { }
+
+//Regions = europe,asia splits the dataset of a profile into regions whose
+//files are given as europe.hsgrData=... (car.europe.hsgrData=... with
+//profiles). Only the bounding boxes of regions are computed at startup, a
+//dataset without regions is loaded right away.
+void OSRM::AddProfile(
+    IniFile & serverConfig,
+    const boost::filesystem::path & base_path,
+    const std::string & profile
+) {
+    const std::string prefix = (profile.empty() ? "" : profile + ".");
+    std::vector<RegionPtr> & regions = profileMap[profile];
+    if ( !serverConfig.Holds(prefix + "Regions") ) {
+        RegionPtr region(new Region());
+        region->name = profile;
+        region->lastUse = 0;
+        GetDatasetPaths(serverConfig, base_path, prefix, region->paths);
+        if( !profile.empty() ) {
+            SimpleLogger().Write() << "loading dataset of profile " << profile;
+        }
+        region->dataset.reset(new Dataset(region->paths, fileCache));
+        regions.push_back(region);
+        return;
+    }
+    std::vector<std::string> region_names;
+    stringSplit(serverConfig.GetParameter(prefix + "Regions"), ',', region_names);
+    BOOST_FOREACH(std::string & region_name, region_names) {
+        boost::trim(region_name);
+        if( region_name.empty() ) {
+            continue;
+        }
+        RegionPtr region(new Region());
+        region->name = region_name;
+        region->lastUse = 0;
+        GetDatasetPaths(serverConfig, base_path, prefix + region_name + ".", region->paths);
+        ComputeBoundingBox(*region);
+        regions.push_back(region);
+    }
+    if( regions.empty() ) {
+        throw OSRMException("no regions declared in server ini");
+    }
+}
+
+void OSRM::GetDatasetPaths(
+    IniFile & serverConfig,
+    const boost::filesystem::path & base_path,
+    const std::string & prefix,
+    DatasetPaths & paths
+) {
+    if ( !serverConfig.Holds(prefix + "hsgrData")) {
         throw OSRMException("no ram index file name in server ini");
     }
-    if ( !serverConfig.Holds("ramIndex") ) {
+    if ( !serverConfig.Holds(prefix + "ramIndex") ) {
         throw OSRMException("no mem index file name in server ini");
     }
-    if ( !serverConfig.Holds("fileIndex") ) {
+    if ( !serverConfig.Holds(prefix + "fileIndex") ) {
         throw OSRMException("no nodes file name in server ini");
     }
-    if ( !serverConfig.Holds("nodesData") ) {
+    if ( !serverConfig.Holds(prefix + "nodesData") ) {
         throw OSRMException("no nodes file name in server ini");
     }
-    if ( !serverConfig.Holds("edgesData") ) {
+    if ( !serverConfig.Holds(prefix + "edgesData") ) {
         throw OSRMException("no edges file name in server ini");
     }
 
-    boost::filesystem::path hsgr_path = boost::filesystem::absolute(
-            serverConfig.GetParameter("hsgrData"),
+    paths.hsgr = boost::filesystem::absolute(
+            serverConfig.GetParameter(prefix + "hsgrData"),
             base_path
-    );
-
-    boost::filesystem::path ram_index_path = boost::filesystem::absolute(
-            serverConfig.GetParameter("ramIndex"),
+    ).string();
+    paths.ramIndex = boost::filesystem::absolute(
+            serverConfig.GetParameter(prefix + "ramIndex"),
             base_path
-    );
-
-    boost::filesystem::path file_index_path = boost::filesystem::absolute(
-            serverConfig.GetParameter("fileIndex"),
+    ).string();
+    paths.fileIndex = boost::filesystem::absolute(
+            serverConfig.GetParameter(prefix + "fileIndex"),
             base_path
-    );
-
-    boost::filesystem::path node_data_path = boost::filesystem::absolute(
-            serverConfig.GetParameter("nodesData"),
+    ).string();
+    paths.nodes = boost::filesystem::absolute(
+            serverConfig.GetParameter(prefix + "nodesData"),
             base_path
-    );
-    boost::filesystem::path edge_data_path = boost::filesystem::absolute(
-            serverConfig.GetParameter("edgesData"),
+    ).string();
+    paths.edges = boost::filesystem::absolute(
+            serverConfig.GetParameter(prefix + "edgesData"),
             base_path
-    );
-    boost::filesystem::path name_data_path = boost::filesystem::absolute(
-            serverConfig.GetParameter("namesData"),
+    ).string();
+    paths.names = boost::filesystem::absolute(
+            serverConfig.GetParameter(prefix + "namesData"),
             base_path
-    );
-    boost::filesystem::path timestamp_path = boost::filesystem::absolute(
-            serverConfig.GetParameter("timestamp"),
+    ).string();
+    paths.timestamp = boost::filesystem::absolute(
+            serverConfig.GetParameter(prefix + "timestamp"),
             base_path
-    );
+    ).string();
+
+    //time dependent routing is optional
+    if ( serverConfig.Holds(prefix + "travelTimeProfiles") ) {
+        paths.travelTimeProfiles = boost::filesystem::absolute(
+                serverConfig.GetParameter(prefix + "travelTimeProfiles"),
+                base_path
+        ).string();
+    }
+
+    //so is the grid for snapping in dense areas
+    if ( serverConfig.Holds(prefix + "gridIndex") ) {
+        paths.gridIndex = boost::filesystem::absolute(
+                serverConfig.GetParameter(prefix + "gridIndex"),
+                base_path
+        ).string();
+    }
 
+    //the geometry of compressed road segments lies next to the graph unless
+    //given explicitly. osrm-prepare always writes it, a dataset without it
+    //is refused as its compressed roads could not be drawn.
+    if ( serverConfig.Holds(prefix + "geometry") ) {
+        paths.geometry = boost::filesystem::absolute(
+                serverConfig.GetParameter(prefix + "geometry"),
+                base_path
+        ).string();
+    } else {
+        paths.geometry = paths.hsgr;
+        if ( boost::algorithm::ends_with(paths.geometry, ".hsgr") ) {
+            paths.geometry.resize(paths.geometry.size() - 5);
+        }
+        paths.geometry += ".geometry";
+    }
+}
+
+//Streams the node file once, without keeping the coordinates
+void OSRM::ComputeBoundingBox(Region & region) {
+    boost::filesystem::path nodes_file(region.paths.nodes);
+    if ( !boost::filesystem::exists( nodes_file ) ) {
+        throw OSRMException("nodes file does not exist");
+    }
+    region.southWest = FixedPointCoordinate(INT_MAX, INT_MAX);
+    region.northEast = FixedPointCoordinate(INT_MIN, INT_MIN);
+    boost::filesystem::ifstream nodes_input_stream(nodes_file, std::ios::binary);
+    NodeInfo node;
+    while(nodes_input_stream.read((char *)&node, sizeof(NodeInfo))) {
+        region.southWest.lat = std::min(region.southWest.lat, node.lat);
+        region.southWest.lon = std::min(region.southWest.lon, node.lon);
+        region.northEast.lat = std::max(region.northEast.lat, node.lat);
+        region.northEast.lon = std::max(region.northEast.lon, node.lon);
+    }
+    if( region.southWest.lat > region.northEast.lat ) {
+        throw OSRMException("nodes file is empty");
+    }
+    SimpleLogger().Write() << "region " << region.name << " covers " << region.southWest << " to " << region.northEast;
+}
+
+//Picks the smallest region that contains all coordinates. Coordinates
+//outside of every region do not count, they snap to the closest road of
+//the region picked. Legs are never stitched across datasets, if the other
+//coordinates lie in different regions no region is returned.
+OSRM::RegionPtr OSRM::SelectRegion(
+    const std::vector<RegionPtr> & regions,
+    const std::vector<FixedPointCoordinate> & coordinates
+) const {
+    if( 1 == regions.size() ) {
+        return regions.front();
+    }
+    unsigned number_of_covered_coordinates = 0;
+    BOOST_FOREACH(const FixedPointCoordinate & coordinate, coordinates) {
+        BOOST_FOREACH(const RegionPtr & region, regions) {
+            if( region->Contains(coordinate) ) {
+                ++number_of_covered_coordinates;
+                break;
+            }
+        }
+    }
+    RegionPtr best_region;
+    double best_area = std::numeric_limits<double>::max();
+    BOOST_FOREACH(const RegionPtr & region, regions) {
+        unsigned count = 0;
+        BOOST_FOREACH(const FixedPointCoordinate & coordinate, coordinates) {
+            if( region->Contains(coordinate) ) {
+                ++count;
+            }
+        }
+        const double area =
+            ((double)region->northEast.lat - region->southWest.lat) *
+            ((double)region->northEast.lon - region->southWest.lon);
+        if( count == number_of_covered_coordinates && area < best_area ) {
+            best_region = region;
+            best_area = area;
+        }
+    }
+    return best_region;
+}
+
+//Requests for a loaded region only copy its dataset pointer. A region that
+//is not loaded is loaded by the first request, later ones wait for it.
+OSRM::DatasetPtr OSRM::GetDataset(Region & region) {
+    region.lastUse = __sync_add_and_fetch(&useCounter, 1);
+    DatasetPtr dataset = boost::atomic_load(&region.dataset);
+    if( dataset ) {
+        return dataset;
+    }
+    boost::mutex::scoped_lock load_lock(region.loadMutex);
+    dataset = boost::atomic_load(&region.dataset);
+    if( !dataset ) {
+        SimpleLogger().Write() << "loading dataset of region " << region.name;
+        dataset.reset(new Dataset(region.paths, fileCache));
+        boost::atomic_store(&region.dataset, dataset);
+        boost::mutex::scoped_lock lock(regionMutex);
+        UnloadLeastRecentlyUsedRegions();
+    }
+    return dataset;
+}
+
+//Requests still running on an unloaded region keep its dataset alive
+void OSRM::UnloadLeastRecentlyUsedRegions() {
+    if( 0 == maxLoadedRegions ) {
+        return;
+    }
+    while( true ) {
+        Region * least_recently_used = NULL;
+        unsigned number_of_loaded_regions = 0;
+        BOOST_FOREACH(ProfileMap::value_type & profile, profileMap) {
+            BOOST_FOREACH(RegionPtr & region, profile.second) {
+                if( !boost::atomic_load(&region->dataset) ) {
+                    continue;
+                }
+                ++number_of_loaded_regions;
+                if( NULL == least_recently_used || region->lastUse < least_recently_used->lastUse ) {
+                    least_recently_used = region.get();
+                }
+            }
+        }
+        if( number_of_loaded_regions <= maxLoadedRegions ) {
+            return;
+        }
+        SimpleLogger().Write() << "unloading dataset of region " << least_recently_used->name;
+        boost::atomic_store(&least_recently_used->dataset, DatasetPtr());
+    }
+}
+
+void OSRM::RunQuery(RouteParameters & route_parameters, http::Reply & reply) {
+    const std::string & profile =
+        (route_parameters.profile.empty() ? defaultProfile : route_parameters.profile);
+    const ProfileMap::const_iterator & profile_iter = profileMap.find(profile);
+    if(profileMap.end() == profile_iter) {
+        reply = http::Reply::stockReply(http::Reply::badRequest);
+        return;
+    }
+    const RegionPtr region = SelectRegion(profile_iter->second, route_parameters.coordinates);
+    if(!region) {
+        BasePlugin::WriteStatusReply(route_parameters, 207, "Coordinates lie in different regions", route_parameters.service, reply);
+        return;
+    }
+    const DatasetPtr dataset = GetDataset(*region);
+    BasePlugin * plugin = dataset->GetPlugin(route_parameters.service);
+    if(NULL != plugin) {
+        reply.status = http::Reply::ok;
+        plugin->HandleRequest(route_parameters, reply );
+    } else {
+        reply = http::Reply::stockReply(http::Reply::badRequest);
+    }
+}
+
+OSRM::Dataset::Dataset(const DatasetPaths & paths, DatasetFileCache & fileCache) {
     objects = new QueryObjectsStorage(
-        hsgr_path.string(),
-        ram_index_path.string(),
-        file_index_path.string(),
-        node_data_path.string(),
-        edge_data_path.string(),
-        name_data_path.string(),
-        timestamp_path.string()
+        paths.hsgr,
+        paths.ramIndex,
+        paths.fileIndex,
+        paths.gridIndex,
+        paths.geometry,
+        paths.nodes,
+        paths.edges,
+        paths.names,
+        paths.timestamp,
+        paths.travelTimeProfiles,
+        fileCache
     );
 
     RegisterPlugin(new HelloWorldPlugin());
+    RegisterPlugin(new IsochronePlugin(objects));
     RegisterPlugin(new LocatePlugin(objects));
+    RegisterPlugin(new MapMatchingPlugin(objects));
     RegisterPlugin(new NearestPlugin(objects));
+    RegisterPlugin(new StatisticsPlugin(objects));
     RegisterPlugin(new TimestampPlugin(objects));
+    RegisterPlugin(new TripPlugin(objects));
     RegisterPlugin(new ViaRoutePlugin(objects));
 }
 
-OSRM::~OSRM() {
+OSRM::Dataset::~Dataset() {
     BOOST_FOREACH(PluginMap::value_type & plugin_pointer, pluginMap) {
         delete plugin_pointer.second;
     }
     delete objects;
 }
 
-void OSRM::RegisterPlugin(BasePlugin * plugin) {
+BasePlugin * OSRM::Dataset::GetPlugin(const std::string & service) const {
+    const PluginMap::const_iterator & iter = pluginMap.find(service);
+    if(pluginMap.end() == iter) {
+        return NULL;
+    }
+    return iter->second;
+}
+
+void OSRM::Dataset::RegisterPlugin(BasePlugin * plugin) {
     SimpleLogger().Write()  << "loaded plugin: " << plugin->GetDescriptor();
     if( pluginMap.find(plugin->GetDescriptor()) != pluginMap.end() ) {
         delete pluginMap[plugin->GetDescriptor()];
     }
     pluginMap.insert(std::make_pair(plugin->GetDescriptor(), plugin));
 }
-
-void OSRM::RunQuery(RouteParameters & route_parameters, http::Reply & reply) {
-    const PluginMap::const_iterator & iter = pluginMap.find(route_parameters.service);
-    if(pluginMap.end() != iter) {
-        reply.status = http::Reply::ok;
-        iter->second->HandleRequest(route_parameters, reply );
-    } else {
-        reply = http::Reply::stockReply(http::Reply::badRequest);
-    }
-}
@@ -25,34 +25,116 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 #include "../Plugins/BasePlugin.h"
 #include "../Plugins/HelloWorldPlugin.h"
+#include "../Plugins/IsochronePlugin.h"
 #include "../Plugins/LocatePlugin.h"
+#include "../Plugins/MapMatchingPlugin.h"
 #include "../Plugins/NearestPlugin.h"
+#include "../Plugins/StatisticsPlugin.h"
 #include "../Plugins/TimestampPlugin.h"
+#include "../Plugins/TripPlugin.h"
 #include "../Plugins/ViaRoutePlugin.h"
+#include "../Server/DataStructures/DatasetFileCache.h"
 #include "../Server/DataStructures/RouteParameters.h"
 #include "../Util/IniFile.h"
 #include "../Util/InputFileUtil.h"
 #include "../Util/OSRMException.h"
 #include "../Util/SimpleLogger.h"
+#include "../Util/StringUtil.h"
 #include "../Server/BasicDatastructures.h"
 
+#include <boost/algorithm/string.hpp>
 #include <boost/assert.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
+#include <limits>
+#include <string>
 #include <vector>
 
 class OSRM : boost::noncopyable {
     typedef boost::unordered_map<std::string, BasePlugin *> PluginMap;
-    QueryObjectsStorage * objects;
+
+    struct DatasetPaths {
+        std::string hsgr;
+        std::string ramIndex;
+        std::string fileIndex;
+        std::string nodes;
+        std::string edges;
+        std::string names;
+        std::string timestamp;
+        std::string travelTimeProfiles;
+        std::string gridIndex;
+        std::string geometry;
+    };
+
+    //The query objects of one dataset and the plugins working on them
+    class Dataset : boost::noncopyable {
+    public:
+        Dataset(const DatasetPaths & paths, DatasetFileCache & fileCache);
+        ~Dataset();
+        BasePlugin * GetPlugin(const std::string & service) const;
+    private:
+        void RegisterPlugin(BasePlugin * plugin);
+        QueryObjectsStorage * objects;
+        PluginMap pluginMap;
+    };
+    typedef boost::shared_ptr<Dataset> DatasetPtr;
+
+    //A dataset that covers part of the world. It is loaded when the first
+    //request for it arrives and may be unloaded again when unused. The
+    //dataset pointer is only read and written with boost::atomic_load and
+    //boost::atomic_store, loadMutex serializes loads of the region.
+    struct Region : boost::noncopyable {
+        std::string name;
+        DatasetPaths paths;
+        FixedPointCoordinate southWest;
+        FixedPointCoordinate northEast;
+        DatasetPtr dataset;
+        unsigned lastUse;
+        boost::mutex loadMutex;
+
+        inline bool Contains(const FixedPointCoordinate & coordinate) const {
+            return
+                southWest.lat <= coordinate.lat && coordinate.lat <= northEast.lat &&
+                southWest.lon <= coordinate.lon && coordinate.lon <= northEast.lon;
+        }
+    };
+    typedef boost::shared_ptr<Region> RegionPtr;
+    typedef boost::unordered_map<std::string, std::vector<RegionPtr> > ProfileMap;
+
 public:
     OSRM(const char * server_ini_path);
     ~OSRM();
     void RunQuery(RouteParameters & route_parameters, http::Reply & reply);
 private:
-    void RegisterPlugin(BasePlugin * plugin);
-    PluginMap pluginMap;
+    void AddProfile(
+        IniFile & serverConfig,
+        const boost::filesystem::path & base_path,
+        const std::string & profile
+    );
+    static void GetDatasetPaths(
+        IniFile & serverConfig,
+        const boost::filesystem::path & base_path,
+        const std::string & prefix,
+        DatasetPaths & paths
+    );
+    static void ComputeBoundingBox(Region & region);
+    RegionPtr SelectRegion(const std::vector<RegionPtr> & regions, const std::vector<FixedPointCoordinate> & coordinates) const;
+    DatasetPtr GetDataset(Region & region);
+    void UnloadLeastRecentlyUsedRegions();
+
+    DatasetFileCache fileCache;
+    //regions by profile
+    ProfileMap profileMap;
+    std::string defaultProfile;
+    //upper bound on simultaneously loaded regions, 0 for no bound
+    unsigned maxLoadedRegions;
+    unsigned useCounter;
+    //guards unloading of regions
+    boost::mutex regionMutex;
 };
 
 #endif //OSRM_H
@@ -24,7 +24,9 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include "../DataStructures/Coordinate.h"
 #include "../Server/BasicDatastructures.h"
 #include "../Server/DataStructures/RouteParameters.h"
+#include "../Util/StringUtil.h"
 
+#include <cctype>
 #include <string>
 #include <vector>
 
@@ -47,6 +49,60 @@ public:
         }
         return true;
     }
+
+    //Complete JSON(P) reply that only carries a status
+    static void WriteStatusReply(
+        const RouteParameters & routeParameters,
+        const int status,
+        const std::string & message,
+        const std::string & name,
+        http::Reply & reply
+    ) {
+        std::string tmp;
+        reply.status = http::Reply::ok;
+        if("" != routeParameters.jsonpParameter) {
+            reply.content += routeParameters.jsonpParameter;
+            reply.content += "(";
+        }
+        reply.content += "{\"version\":0.3,\"status\":";
+        intToString(status, tmp);
+        reply.content += tmp;
+        reply.content += ",\"status_message\":\"";
+        reply.content += message;
+        reply.content += "\",\"transactionId\":\"OSRM Routing Engine JSON ";
+        //trip becomes Trip
+        reply.content += char(toupper(name[0]));
+        reply.content += name.substr(1);
+        reply.content += " (v0.3)\"}";
+        if("" != routeParameters.jsonpParameter) {
+            reply.content += ")";
+        }
+        SetJSONHeaders(routeParameters, name, reply);
+        reply.headers[0].name = "Content-Length";
+        intToString(reply.content.size(), tmp);
+        reply.headers[0].value = tmp;
+    }
+
+protected:
+    //Content type and file name of a JSON(P) reply named after the service
+    static void SetJSONHeaders(
+        const RouteParameters & routeParameters,
+        const std::string & name,
+        http::Reply & reply
+    ) {
+        reply.headers.resize(3);
+        if("" != routeParameters.jsonpParameter) {
+            reply.headers[1].name = "Content-Type";
+            reply.headers[1].value = "text/javascript";
+            reply.headers[2].name = "Content-Disposition";
+            reply.headers[2].value = "attachment; filename=\"" + name + ".js\"";
+        } else {
+            reply.headers[1].name = "Content-Type";
+            reply.headers[1].value = "application/x-javascript";
+            reply.headers[2].name = "Content-Disposition";
+            reply.headers[2].value = "attachment; filename=\"" + name + ".json\"";
+        }
+    }
 };
 
 #endif /* BASEPLUGIN_H_ */
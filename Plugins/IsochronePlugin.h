@@ -0,0 +1,273 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef ISOCHRONEPLUGIN_H_
+#define ISOCHRONEPLUGIN_H_
+
+#include "BasePlugin.h"
+
+#include "../Algorithms/ConcaveHull.h"
+#include "../Algorithms/ObjectToBase64.h"
+#include "../DataStructures/NodeInformationHelpDesk.h"
+#include "../DataStructures/PhantomNodes.h"
+#include "../DataStructures/SearchEngineData.h"
+#include "../RoutingAlgorithms/OneToAllRouting.h"
+#include "../Server/DataStructures/QueryObjectsStorage.h"
+#include "../Util/SimpleLogger.h"
+#include "../Util/StringUtil.h"
+
+#include <string>
+#include <vector>
+
+//Travel time limits in seconds
+static const unsigned ISOCHRONE_DEFAULT_DURATION = 600;
+static const unsigned ISOCHRONE_MAX_DURATION = 4*3600;
+//Upper bound on the number of origins in one request
+static const unsigned ISOCHRONE_MAX_SOURCES = 4*ONE_TO_ALL_SWEEP_WIDTH;
+
+/*
+ * This plugin computes the part of the road network that is reachable from
+ * one or more locations within a given travel time. It returns either the
+ * reachable nodes with their travel times or a concave hull around them.
+ */
+class IsochronePlugin : public BasePlugin {
+public:
+    IsochronePlugin(QueryObjectsStorage * objects) :
+        queryData(objects->graph, objects->nodeHelpDesk, objects->names),
+        descriptor_string("isochrone")
+    {
+        nodeHelpDesk = objects->nodeHelpDesk;
+        graph = objects->graph;
+        oneToAll = new OneToAllRouting<SearchEngineData>(queryData);
+        FindNodeCoordinates();
+    }
+
+    virtual ~IsochronePlugin() {
+        delete oneToAll;
+    }
+
+    const std::string & GetDescriptor() const { return descriptor_string; }
+
+    void HandleRequest(const RouteParameters & routeParameters, http::Reply& reply) {
+        if(
+            routeParameters.coordinates.empty() ||
+            ISOCHRONE_MAX_SOURCES < routeParameters.coordinates.size()
+        ) {
+            reply = http::Reply::stockReply(http::Reply::badRequest);
+            return;
+        }
+        const bool return_hull = ("hull" == routeParameters.outputFormat);
+        unsigned max_duration = routeParameters.maxDuration;
+        if(0 == max_duration) {
+            max_duration = ISOCHRONE_DEFAULT_DURATION;
+        }
+        max_duration = std::min(max_duration, ISOCHRONE_MAX_DURATION);
+        //edge weights are in tenths of a second
+        const int max_distance = 10*max_duration;
+
+        const bool checksumOK = (routeParameters.checkSum == nodeHelpDesk->GetCheckSum());
+        std::vector<PhantomNode> sources(routeParameters.coordinates.size());
+        bool all_sources_found = true;
+        for(unsigned i = 0; i < routeParameters.coordinates.size(); ++i) {
+            if(false == checkCoord(routeParameters.coordinates[i])) {
+                reply = http::Reply::stockReply(http::Reply::badRequest);
+                return;
+            }
+            if(checksumOK && i < routeParameters.hints.size() && "" != routeParameters.hints[i]) {
+                DecodeObjectFromBase64(routeParameters.hints[i], sources[i]);
+                if(sources[i].isValid(nodeHelpDesk->getNumberOfNodes())) {
+                    continue;
+                }
+            }
+            nodeHelpDesk->FindPhantomNodeForCoordinate(
+                routeParameters.coordinates[i],
+                sources[i],
+                routeParameters.zoomLevel
+            );
+            all_sources_found &= sources[i].isValid(nodeHelpDesk->getNumberOfNodes());
+        }
+
+        //headers have to be complete before the reply may be streamed
+        reply.status = http::Reply::ok;
+        SetJSONHeaders(routeParameters, descriptor_string, reply);
+        if("" != routeParameters.jsonpParameter) {
+            reply.content += routeParameters.jsonpParameter;
+            reply.content += "(";
+        }
+
+        std::string tmp;
+        bool search_was_aborted = false;
+        if(!all_sources_found) {
+            reply.content += "{\"version\":0.3,\"status\":207,\"status_message\":\"Cannot find source location\",\"isochrones\":[]";
+        } else {
+            //the status follows the isochrones, it is only known once the
+            //last of them is computed and the first may be streamed already
+            reply.content += "{\"version\":0.3,\"isochrones\":[";
+            search_was_aborted = !AppendIsochrones(sources, max_distance, return_hull, *routeParameters.deadline, reply);
+            reply.content += "]";
+            if(search_was_aborted) {
+                SimpleLogger().Write(logDEBUG) << "Isochrone search aborted, deadline exceeded or client gone";
+            }
+            if(search_was_aborted && reply.isStreamed) {
+                reply.content += ",\"status\":208,\"status_message\":\"Search aborted, deadline exceeded\"";
+            } else if(!search_was_aborted) {
+                reply.content += ",\"status\":0";
+            }
+        }
+        //an incomplete answer is only sent if parts of it are out already
+        if(search_was_aborted && !reply.isStreamed) {
+            reply.content.clear();
+            if("" != routeParameters.jsonpParameter) {
+                reply.content += routeParameters.jsonpParameter;
+                reply.content += "(";
+            }
+            reply.content += "{\"version\":0.3,\"status\":208,\"status_message\":\"Search aborted, deadline exceeded\",\"isochrones\":[]";
+        }
+        reply.content += ",\"transactionId\":\"OSRM Routing Engine JSON Isochrone (v0.3)\"}";
+        if("" != routeParameters.jsonpParameter) {
+            reply.content += ")";
+        }
+        reply.headers[0].name = "Content-Length";
+        intToString(reply.content.size(), tmp);
+        reply.headers[0].value = tmp;
+    }
+
+private:
+    //Returns false if the deadline expired before all isochrones were computed
+    bool AppendIsochrones(
+        const std::vector<PhantomNode> & sources,
+        const int max_distance,
+        const bool return_hull,
+        const SearchDeadline & deadline,
+        http::Reply & reply
+    ) const {
+        std::string tmp;
+        std::vector<FixedPointCoordinate> reachable_coordinates;
+        //sources are swept in batches, each source has its own lane of distances
+        for(unsigned batch = 0; batch < sources.size(); batch += ONE_TO_ALL_SWEEP_WIDTH) {
+            const std::vector<PhantomNode> batch_sources(
+                sources.begin() + batch,
+                sources.begin() + std::min((unsigned)sources.size(), batch + ONE_TO_ALL_SWEEP_WIDTH)
+            );
+            if(!(*oneToAll)(batch_sources, max_distance, deadline)) {
+                return false;
+            }
+            //only the nodes in range of some source of the batch are looked at
+            const std::vector<unsigned> & reached_positions = oneToAll->GetReachedPositions();
+            for(unsigned lane = 0; lane < batch_sources.size(); ++lane) {
+                if(0 != batch + lane) {
+                    reply.content += ",";
+                }
+                reply.content += "{\"source\":";
+                AppendCoordinate(batch_sources[lane].location, reply.content);
+                reply.content += return_hull ? ",\"hull\":[" : ",\"reachable\":[";
+                reachable_coordinates.clear();
+                bool is_first = true;
+                for(unsigned i = 0; i < reached_positions.size(); ++i) {
+                    const unsigned position = reached_positions[i];
+                    const int distance = oneToAll->GetDistance(position, lane);
+                    if(distance > max_distance) {
+                        continue;
+                    }
+                    const unsigned coordinate_edge = nodeCoordinateEdge[oneToAll->GetNodeAtPosition(position)];
+                    if(UINT_MAX == coordinate_edge) {
+                        continue;
+                    }
+                    const FixedPointCoordinate coordinate(
+                        nodeHelpDesk->getLatitudeOfNode(coordinate_edge),
+                        nodeHelpDesk->getLongitudeOfNode(coordinate_edge)
+                    );
+                    if(return_hull) {
+                        reachable_coordinates.push_back(coordinate);
+                        continue;
+                    }
+                    if(!is_first) {
+                        reply.content += ",";
+                    }
+                    is_first = false;
+                    reply.content += "[";
+                    convertInternalLatLonToString(coordinate.lat, tmp);
+                    reply.content += tmp;
+                    reply.content += ",";
+                    convertInternalLatLonToString(coordinate.lon, tmp);
+                    reply.content += tmp;
+                    reply.content += ",";
+                    intToString(std::max(0, distance)/10, tmp);
+                    reply.content += tmp;
+                    reply.content += "]";
+                    reply.Flush();
+                }
+                if(return_hull) {
+                    std::vector<FixedPointCoordinate> hull;
+                    ConcaveHull().Run(reachable_coordinates, hull);
+                    for(unsigned i = 0; i < hull.size(); ++i) {
+                        if(0 != i) {
+                            reply.content += ",";
+                        }
+                        AppendCoordinate(hull[i], reply.content);
+                    }
+                }
+                reply.content += "]}";
+            }
+        }
+        return true;
+    }
+
+    static void AppendCoordinate(const FixedPointCoordinate & coordinate, std::string & output) {
+        std::string tmp;
+        output += "[";
+        convertInternalLatLonToString(coordinate.lat, tmp);
+        output += tmp;
+        output += ",";
+        convertInternalLatLonToString(coordinate.lon, tmp);
+        output += tmp;
+        output += "]";
+    }
+
+    //Every original edge-based edge knows the intersection it passes. That
+    //is where the road segments of both of its end nodes meet.
+    void FindNodeCoordinates() {
+        nodeCoordinateEdge.resize(graph->GetNumberOfNodes(), UINT_MAX);
+        for(NodeID node = 0; node < graph->GetNumberOfNodes(); ++node) {
+            for(QueryGraph::EdgeIterator edge = graph->BeginEdges(node); edge < graph->EndEdges(node); ++edge) {
+                const QueryEdge::EdgeData & data = graph->GetEdgeData(edge);
+                if(data.shortcut) {
+                    continue;
+                }
+                if(UINT_MAX == nodeCoordinateEdge[node]) {
+                    nodeCoordinateEdge[node] = data.id;
+                }
+                const NodeID target = graph->GetTarget(edge);
+                if(UINT_MAX == nodeCoordinateEdge[target]) {
+                    nodeCoordinateEdge[target] = data.id;
+                }
+            }
+        }
+    }
+
+    SearchEngineData queryData;
+    OneToAllRouting<SearchEngineData> * oneToAll;
+    NodeInformationHelpDesk * nodeHelpDesk;
+    QueryGraph * graph;
+    std::vector<unsigned> nodeCoordinateEdge;
+    std::string descriptor_string;
+};
+
+#endif /* ISOCHRONEPLUGIN_H_ */
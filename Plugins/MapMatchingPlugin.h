@@ -0,0 +1,355 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef MAPMATCHINGPLUGIN_H_
+#define MAPMATCHINGPLUGIN_H_
+
+#include "BasePlugin.h"
+
+#include "../DataStructures/HashTable.h"
+#include "../DataStructures/PhantomNodes.h"
+#include "../DataStructures/QueryEdge.h"
+#include "../DataStructures/SearchEngine.h"
+#include "../DataStructures/StaticGraph.h"
+#include "../Descriptors/BaseDescriptor.h"
+#include "../Descriptors/GPXDescriptor.h"
+#include "../Descriptors/JSONDescriptor.h"
+#include "../Server/DataStructures/QueryObjectsStorage.h"
+#include "../Util/SimpleLogger.h"
+#include "../Util/StringUtil.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+#include <string>
+#include <vector>
+
+//Upper bound on the number of samples in one trace
+static const unsigned MATCHING_MAX_TRACE_SIZE = 512;
+//Candidate road segments per sample and how far away they may be (meters)
+static const unsigned MATCHING_CANDIDATE_COUNT = 5;
+static const double MATCHING_MAX_CANDIDATE_DISTANCE = 50.;
+//Standard deviation of the GPS error in meters
+static const double MATCHING_GPS_PRECISION = 5.;
+//Detour in tenths of a second that makes a transition e times less likely
+//than the fastest transition of the step
+static const double MATCHING_TRANSITION_BETA = 100.;
+
+/*
+ * This plugin matches a GPS trace to the road network with a hidden Markov
+ * model (Newson and Krumm, 2009). The hidden states of a sample are the road
+ * segments close to it, emissions are scored by the distance of the sample
+ * to the segment and transitions by how much longer the travel time between
+ * two candidates is than the fastest transition of the step. The transition
+ * times of a step come from one many-to-many search. The most likely
+ * sequence of candidates is routed and returned like a viaroute reply. A
+ * trace with breaks yields several such matchings.
+ */
+class MapMatchingPlugin : public BasePlugin {
+private:
+    typedef std::vector<std::pair<PhantomNode, double> > CandidateList;
+
+    NodeInformationHelpDesk * nodeHelpDesk;
+    std::vector<std::string> & names;
+    StaticGraph<QueryEdge::EdgeData> * graph;
+    HashTable<std::string, unsigned> descriptorTable;
+    SearchEngine * searchEnginePtr;
+public:
+
+    MapMatchingPlugin(QueryObjectsStorage * objects)
+     :
+        names(objects->names),
+        descriptor_string("match")
+    {
+        nodeHelpDesk = objects->nodeHelpDesk;
+        graph = objects->graph;
+
+        searchEnginePtr = new SearchEngine(graph, nodeHelpDesk, names);
+
+        descriptorTable.insert(std::make_pair(""    , 0));
+        descriptorTable.insert(std::make_pair("json", 0));
+        descriptorTable.insert(std::make_pair("gpx" , 1));
+    }
+
+    virtual ~MapMatchingPlugin() {
+        delete searchEnginePtr;
+    }
+
+    const std::string & GetDescriptor() const { return descriptor_string; }
+
+    void HandleRequest(const RouteParameters & routeParameters, http::Reply& reply) {
+        if(
+            2 > routeParameters.coordinates.size() ||
+            MATCHING_MAX_TRACE_SIZE < routeParameters.coordinates.size()
+        ) {
+            reply = http::Reply::stockReply(http::Reply::badRequest);
+            return;
+        }
+
+        std::vector<CandidateList> candidates(routeParameters.coordinates.size());
+        for(unsigned i = 0; i < routeParameters.coordinates.size(); ++i) {
+            if(false == checkCoord(routeParameters.coordinates[i])) {
+                reply = http::Reply::stockReply(http::Reply::badRequest);
+                return;
+            }
+            searchEnginePtr->FindKNearestPhantomNodesForCoordinate(
+                routeParameters.coordinates[i],
+                routeParameters.zoomLevel,
+                MATCHING_CANDIDATE_COUNT,
+                MATCHING_MAX_CANDIDATE_DISTANCE,
+                candidates[i]
+            );
+        }
+
+        std::vector<std::vector<PhantomNode> > matchings;
+        if(!FindMatchings(candidates, *routeParameters.deadline, matchings)) {
+            SimpleLogger().Write(logDEBUG) << "Matching aborted, deadline exceeded or client gone";
+            WriteStatusReply(routeParameters, 208, "Search aborted, deadline exceeded", descriptor_string, reply);
+            return;
+        }
+        if(matchings.empty()) {
+            WriteStatusReply(routeParameters, 207, "Cannot match trace", descriptor_string, reply);
+            return;
+        }
+
+        reply.status = http::Reply::ok;
+        if("" != routeParameters.jsonpParameter) {
+            reply.content += routeParameters.jsonpParameter;
+            reply.content += "(";
+        }
+
+        _DescriptorConfig descriptorConfig;
+        const unsigned descriptorType = descriptorTable[routeParameters.outputFormat];
+        descriptorConfig.z = routeParameters.zoomLevel;
+        descriptorConfig.instructions = routeParameters.printInstructions;
+        descriptorConfig.geometry = routeParameters.geometry;
+        descriptorConfig.encodeGeometry = routeParameters.compression;
+
+        //headers have to be complete before the descriptor may stream output
+        GPXDescriptor gpxDescriptor;
+        if(1 == descriptorType) {
+            reply.headers.resize(3);
+            reply.headers[1].name = "Content-Type";
+            reply.headers[1].value = "application/gpx+xml; charset=UTF-8";
+            reply.headers[2].name = "Content-Disposition";
+            reply.headers[2].value = "attachment; filename=\"match.gpx\"";
+            gpxDescriptor.SetConfig(descriptorConfig);
+            gpxDescriptor.AppendHeader(reply);
+        } else {
+            SetJSONHeaders(routeParameters, descriptor_string, reply);
+            reply.content += "{\"version\":0.3,\"status\":0,\"status_message\":\"Found matchings\",\"matchings\":[";
+        }
+
+        //a trace with breaks is matched piecewise, each piece is a route of its own
+        for(unsigned matching = 0; matching < matchings.size(); ++matching) {
+            const std::vector<PhantomNode> & matchedPhantomNodes = matchings[matching];
+            RawRouteData rawRoute;
+            rawRoute.checkSum = nodeHelpDesk->GetCheckSum();
+            for(unsigned i = 0; i < matchedPhantomNodes.size(); ++i) {
+                rawRoute.rawViaNodeCoordinates.push_back(matchedPhantomNodes[i].location);
+            }
+            for(unsigned i = 0; i < matchedPhantomNodes.size()-1; ++i) {
+                PhantomNodes segmentPhantomNodes;
+                segmentPhantomNodes.startPhantom = matchedPhantomNodes[i];
+                segmentPhantomNodes.targetPhantom = matchedPhantomNodes[i+1];
+                rawRoute.segmentEndCoordinates.push_back(segmentPhantomNodes);
+            }
+            searchEnginePtr->shortestPath(rawRoute.segmentEndCoordinates, rawRoute, *routeParameters.deadline);
+            if(rawRoute.searchWasAborted) {
+                SimpleLogger().Write(logDEBUG) << "Search aborted, deadline exceeded or client gone";
+            }
+
+            PhantomNodes phantomNodes;
+            phantomNodes.startPhantom = rawRoute.segmentEndCoordinates.front().startPhantom;
+            phantomNodes.targetPhantom = rawRoute.segmentEndCoordinates.back().targetPhantom;
+            if(1 == descriptorType) {
+                gpxDescriptor.AppendRoute(reply, rawRoute, phantomNodes, *searchEnginePtr);
+                continue;
+            }
+            if(0 != matching) {
+                reply.content += ",";
+            }
+            //every matching is described like a viaroute reply
+            JSONDescriptor jsonDescriptor;
+            jsonDescriptor.SetConfig(descriptorConfig);
+            jsonDescriptor.Run(reply, rawRoute, phantomNodes, *searchEnginePtr);
+        }
+
+        if(1 == descriptorType) {
+            gpxDescriptor.AppendFooter(reply);
+        } else {
+            reply.content += "],\"transactionId\":\"OSRM Routing Engine JSON Match (v0.3)\"}";
+        }
+        if("" != routeParameters.jsonpParameter) {
+            reply.content += ")\n";
+        }
+        reply.headers[0].name = "Content-Length";
+        std::string tmp;
+        intToString(reply.content.size(), tmp);
+        reply.headers[0].value = tmp;
+    }
+
+private:
+    //Negative log-likelihood of observing a sample this far from its segment
+    static double EmissionCost(const double distance) {
+        const double normalized_distance = distance/MATCHING_GPS_PRECISION;
+        return 0.5*normalized_distance*normalized_distance;
+    }
+
+    //Negative log-likelihood of a transition that takes this much longer
+    //than the fastest transition of the step
+    static double TransitionCost(const int duration, const int fastest_duration) {
+        return (duration - fastest_duration)/MATCHING_TRANSITION_BETA;
+    }
+
+    //Jitter of consecutive samples on one segment must not force a loop
+    static int GetTransitionDuration(const int table_entry, const PhantomNode & from, const PhantomNode & to) {
+        if(INT_MAX == table_entry && from.edgeBasedNode == to.edgeBasedNode) {
+            return 0;
+        }
+        return table_entry;
+    }
+
+    /*
+     * Viterbi over the candidates of all samples. Samples without candidates
+     * are skipped. A sample that cannot be reached from any candidate of the
+     * previous sample is a break in the trace, e.g. a bad fix or a gap in
+     * the recording: the chain up to it is matched on its own and a new one
+     * starts at its candidates. Matchings of less than two distinct nodes
+     * are dropped. Returns false if the deadline expired.
+     */
+    bool FindMatchings(
+        const std::vector<CandidateList> & candidates,
+        const SearchDeadline & deadline,
+        std::vector<std::vector<PhantomNode> > & matchings
+    ) const {
+        matchings.clear();
+        std::vector<unsigned> matchedSamples;
+        std::vector<std::vector<double> > costs;
+        std::vector<std::vector<unsigned> > parents;
+
+        std::vector<PhantomNode> previousPhantomNodes;
+        std::vector<PhantomNode> currentPhantomNodes;
+        std::vector<int> transitionTable;
+        for(unsigned sample = 0; sample < candidates.size(); ++sample) {
+            const CandidateList & sampleCandidates = candidates[sample];
+            if(sampleCandidates.empty()) {
+                continue;
+            }
+            currentPhantomNodes.clear();
+            for(unsigned j = 0; j < sampleCandidates.size(); ++j) {
+                currentPhantomNodes.push_back(sampleCandidates[j].first);
+            }
+
+            std::vector<double> sampleCosts(sampleCandidates.size(), DBL_MAX);
+            std::vector<unsigned> sampleParents(sampleCandidates.size(), UINT_MAX);
+            bool startsChain = matchedSamples.empty();
+            if(!startsChain) {
+                if(!searchEnginePtr->distanceTable(previousPhantomNodes, currentPhantomNodes, transitionTable, deadline)) {
+                    return false;
+                }
+                const std::vector<double> & previousCosts = costs.back();
+                int fastestDuration = INT_MAX;
+                for(unsigned i = 0; i < previousPhantomNodes.size(); ++i) {
+                    for(unsigned j = 0; j < currentPhantomNodes.size(); ++j) {
+                        const int duration = GetTransitionDuration(
+                            transitionTable[i*currentPhantomNodes.size() + j],
+                            previousPhantomNodes[i],
+                            currentPhantomNodes[j]
+                        );
+                        fastestDuration = std::min(fastestDuration, duration);
+                    }
+                }
+                if(INT_MAX == fastestDuration) {
+                    BacktrackChain(candidates, matchedSamples, costs, parents, matchings);
+                    matchedSamples.clear();
+                    costs.clear();
+                    parents.clear();
+                    startsChain = true;
+                }
+                for(unsigned i = 0; i < previousPhantomNodes.size() && !startsChain; ++i) {
+                    for(unsigned j = 0; j < currentPhantomNodes.size(); ++j) {
+                        const int duration = GetTransitionDuration(
+                            transitionTable[i*currentPhantomNodes.size() + j],
+                            previousPhantomNodes[i],
+                            currentPhantomNodes[j]
+                        );
+                        if(INT_MAX == duration) {
+                            continue;
+                        }
+                        const double cost =
+                            previousCosts[i] +
+                            TransitionCost(duration, fastestDuration) +
+                            EmissionCost(sampleCandidates[j].second);
+                        if(cost < sampleCosts[j]) {
+                            sampleCosts[j] = cost;
+                            sampleParents[j] = i;
+                        }
+                    }
+                }
+            }
+            if(startsChain) {
+                for(unsigned j = 0; j < sampleCandidates.size(); ++j) {
+                    sampleCosts[j] = EmissionCost(sampleCandidates[j].second);
+                }
+            }
+            matchedSamples.push_back(sample);
+            costs.push_back(sampleCosts);
+            parents.push_back(sampleParents);
+            previousPhantomNodes.swap(currentPhantomNodes);
+        }
+        BacktrackChain(candidates, matchedSamples, costs, parents, matchings);
+        return true;
+    }
+
+    //Appends the most likely sequence of candidates of a finished chain
+    static void BacktrackChain(
+        const std::vector<CandidateList> & candidates,
+        const std::vector<unsigned> & matchedSamples,
+        const std::vector<std::vector<double> > & costs,
+        const std::vector<std::vector<unsigned> > & parents,
+        std::vector<std::vector<PhantomNode> > & matchings
+    ) {
+        if(matchedSamples.empty()) {
+            return;
+        }
+        std::vector<PhantomNode> matchedPhantomNodes;
+        unsigned state = std::min_element(costs.back().begin(), costs.back().end()) - costs.back().begin();
+        for(int step = matchedSamples.size()-1; step >= 0 && UINT_MAX != state; --step) {
+            matchedPhantomNodes.push_back(candidates[matchedSamples[step]][state].first);
+            state = parents[step][state];
+        }
+        std::reverse(matchedPhantomNodes.begin(), matchedPhantomNodes.end());
+        //standing still does not make a via point
+        matchedPhantomNodes.erase(
+            std::unique(matchedPhantomNodes.begin(), matchedPhantomNodes.end()),
+            matchedPhantomNodes.end()
+        );
+        if(2 <= matchedPhantomNodes.size()) {
+            matchings.push_back(matchedPhantomNodes);
+        }
+    }
+
+    std::string descriptor_string;
+};
+
+#endif /* MAPMATCHINGPLUGIN_H_ */
@@ -0,0 +1,80 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+
+#ifndef STATISTICSPLUGIN_H_
+#define STATISTICSPLUGIN_H_
+
+#include "BasePlugin.h"
+#include "../DataStructures/NodeInformationHelpDesk.h"
+#include "../Server/DataStructures/QueryObjectsStorage.h"
+#include "../Util/StringUtil.h"
+
+/*
+ * Reports how often snapped coordinates were answered from the phantom node
+ * cache of the dataset.
+ */
+class StatisticsPlugin : public BasePlugin {
+public:
+    StatisticsPlugin(QueryObjectsStorage * o)
+     : objects(o), descriptor_string("statistics")
+    { }
+    const std::string & GetDescriptor() const { return descriptor_string; }
+    void HandleRequest(const RouteParameters & routeParameters, http::Reply& reply) {
+        std::string tmp;
+        uint64_t hits = 0, misses = 0;
+        unsigned entries = 0;
+        objects->nodeHelpDesk->GetPhantomNodeCache().GetStatistics(hits, misses, entries);
+
+        reply.status = http::Reply::ok;
+        if("" != routeParameters.jsonpParameter) {
+            reply.content += routeParameters.jsonpParameter;
+            reply.content += "(";
+        }
+        reply.content += "{\"version\":0.3,\"status\":0,";
+        reply.content += "\"phantom_node_cache\":{";
+        reply.content += "\"hits\":";
+        int64ToString(hits, tmp);
+        reply.content += tmp;
+        reply.content += ",\"misses\":";
+        int64ToString(misses, tmp);
+        reply.content += tmp;
+        reply.content += ",\"hit_rate\":";
+        doubleToString(0 == hits + misses ? 0. : double(hits)/double(hits + misses), tmp);
+        reply.content += tmp;
+        reply.content += ",\"entries\":";
+        intToString(entries, tmp);
+        reply.content += tmp;
+        reply.content += "}";
+        reply.content += ",\"transactionId\":\"OSRM Routing Engine JSON Statistics (v0.3)\"}";
+        if("" != routeParameters.jsonpParameter) {
+            reply.content += ")";
+        }
+        SetJSONHeaders(routeParameters, descriptor_string, reply);
+        reply.headers[0].name = "Content-Length";
+        intToString(reply.content.size(), tmp);
+        reply.headers[0].value = tmp;
+    }
+private:
+    QueryObjectsStorage * objects;
+    std::string descriptor_string;
+};
+
+#endif /* STATISTICSPLUGIN_H_ */
@@ -0,0 +1,197 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef TRIPPLUGIN_H_
+#define TRIPPLUGIN_H_
+
+#include "BasePlugin.h"
+
+#include "../Algorithms/ObjectToBase64.h"
+#include "../Algorithms/TravelingSalesmanSolver.h"
+#include "../DataStructures/HashTable.h"
+#include "../DataStructures/PhantomNodes.h"
+#include "../DataStructures/QueryEdge.h"
+#include "../DataStructures/SearchEngine.h"
+#include "../DataStructures/StaticGraph.h"
+#include "../Descriptors/BaseDescriptor.h"
+#include "../Descriptors/GPXDescriptor.h"
+#include "../Descriptors/JSONDescriptor.h"
+#include "../Server/DataStructures/QueryObjectsStorage.h"
+#include "../Util/SimpleLogger.h"
+#include "../Util/StringUtil.h"
+
+#include <algorithm>
+#include <climits>
+
+#include <string>
+#include <vector>
+
+//Upper bound on the number of stops in one trip
+static const unsigned TRIP_MAX_LOCATIONS = 100;
+
+/*
+ * This plugin computes a fast round trip through all given locations that
+ * starts and ends at the first one. The duration matrix comes from one
+ * many-to-many search, only the legs of the final trip are unpacked. The
+ * trip is returned like a viaroute reply with the stops as via points in
+ * visiting order, the JSON output also lists that order as trip_order.
+ */
+class TripPlugin : public BasePlugin {
+private:
+    NodeInformationHelpDesk * nodeHelpDesk;
+    std::vector<std::string> & names;
+    StaticGraph<QueryEdge::EdgeData> * graph;
+    HashTable<std::string, unsigned> descriptorTable;
+    SearchEngine * searchEnginePtr;
+public:
+
+    TripPlugin(QueryObjectsStorage * objects)
+     :
+        names(objects->names),
+        descriptor_string("trip")
+    {
+        nodeHelpDesk = objects->nodeHelpDesk;
+        graph = objects->graph;
+
+        searchEnginePtr = new SearchEngine(graph, nodeHelpDesk, names);
+
+        descriptorTable.insert(std::make_pair(""    , 0));
+        descriptorTable.insert(std::make_pair("json", 0));
+        descriptorTable.insert(std::make_pair("gpx" , 1));
+    }
+
+    virtual ~TripPlugin() {
+        delete searchEnginePtr;
+    }
+
+    const std::string & GetDescriptor() const { return descriptor_string; }
+
+    void HandleRequest(const RouteParameters & routeParameters, http::Reply& reply) {
+        if(
+            2 > routeParameters.coordinates.size() ||
+            TRIP_MAX_LOCATIONS < routeParameters.coordinates.size()
+        ) {
+            reply = http::Reply::stockReply(http::Reply::badRequest);
+            return;
+        }
+
+        RawRouteData rawRoute;
+        rawRoute.checkSum = nodeHelpDesk->GetCheckSum();
+        const bool checksumOK = (routeParameters.checkSum == rawRoute.checkSum);
+        std::vector<PhantomNode> phantomNodeVector(routeParameters.coordinates.size());
+        for(unsigned i = 0; i < routeParameters.coordinates.size(); ++i) {
+            if(false == checkCoord(routeParameters.coordinates[i])) {
+                reply = http::Reply::stockReply(http::Reply::badRequest);
+                return;
+            }
+            if(checksumOK && i < routeParameters.hints.size() && "" != routeParameters.hints[i]) {
+                DecodeObjectFromBase64(routeParameters.hints[i], phantomNodeVector[i]);
+                if(phantomNodeVector[i].isValid(nodeHelpDesk->getNumberOfNodes())) {
+                    continue;
+                }
+            }
+            searchEnginePtr->FindPhantomNodeForCoordinate(routeParameters.coordinates[i], phantomNodeVector[i], routeParameters.zoomLevel);
+            if(!phantomNodeVector[i].isValid(nodeHelpDesk->getNumberOfNodes())) {
+                WriteStatusReply(routeParameters, 207, "Cannot find route between points", descriptor_string, reply);
+                return;
+            }
+        }
+
+        std::vector<int> durationTable;
+        if(!searchEnginePtr->distanceTable(phantomNodeVector, phantomNodeVector, durationTable, *routeParameters.deadline)) {
+            SimpleLogger().Write(logDEBUG) << "Search aborted, deadline exceeded or client gone";
+            WriteStatusReply(routeParameters, 208, "Search aborted, deadline exceeded", descriptor_string, reply);
+            return;
+        }
+        const unsigned numberOfLocations = phantomNodeVector.size();
+        if(durationTable.end() != std::find(durationTable.begin(), durationTable.end(), INT_MAX)) {
+            WriteStatusReply(routeParameters, 207, "Cannot find route between points", descriptor_string, reply);
+            return;
+        }
+
+        std::vector<unsigned> trip;
+        TravelingSalesmanSolver(durationTable, numberOfLocations).Run(trip);
+        //back to the start
+        trip.push_back(trip.front());
+        for(unsigned i = 0; i < trip.size(); ++i) {
+            rawRoute.rawViaNodeCoordinates.push_back(routeParameters.coordinates[trip[i]]);
+        }
+        for(unsigned i = 0; i < trip.size()-1; ++i) {
+            PhantomNodes segmentPhantomNodes;
+            segmentPhantomNodes.startPhantom = phantomNodeVector[trip[i]];
+            segmentPhantomNodes.targetPhantom = phantomNodeVector[trip[i+1]];
+            rawRoute.segmentEndCoordinates.push_back(segmentPhantomNodes);
+        }
+        searchEnginePtr->shortestPath(rawRoute.segmentEndCoordinates, rawRoute, *routeParameters.deadline);
+        if(rawRoute.searchWasAborted) {
+            SimpleLogger().Write(logDEBUG) << "Search aborted, deadline exceeded or client gone";
+        }
+
+        reply.status = http::Reply::ok;
+        if("" != routeParameters.jsonpParameter) {
+            reply.content += routeParameters.jsonpParameter;
+            reply.content += "(";
+        }
+
+        _DescriptorConfig descriptorConfig;
+        const unsigned descriptorType = descriptorTable[routeParameters.outputFormat];
+        descriptorConfig.z = routeParameters.zoomLevel;
+        descriptorConfig.instructions = routeParameters.printInstructions;
+        descriptorConfig.geometry = routeParameters.geometry;
+        descriptorConfig.encodeGeometry = routeParameters.compression;
+
+        BaseDescriptor * desc;
+        //headers have to be complete before the descriptor may stream output
+        reply.headers.resize(3);
+        if(1 == descriptorType) {
+            desc = new GPXDescriptor();
+            reply.headers[1].name = "Content-Type";
+            reply.headers[1].value = "application/gpx+xml; charset=UTF-8";
+            reply.headers[2].name = "Content-Disposition";
+            reply.headers[2].value = "attachment; filename=\"trip.gpx\"";
+        } else {
+            JSONDescriptor * jsonDescriptor = new JSONDescriptor();
+            //the trip returns to its start, that last stop is not listed
+            jsonDescriptor->SetTripOrder(std::vector<unsigned>(trip.begin(), trip.end()-1));
+            desc = jsonDescriptor;
+            SetJSONHeaders(routeParameters, descriptor_string, reply);
+        }
+        desc->SetConfig(descriptorConfig);
+
+        PhantomNodes phantomNodes;
+        phantomNodes.startPhantom = rawRoute.segmentEndCoordinates.front().startPhantom;
+        phantomNodes.targetPhantom = rawRoute.segmentEndCoordinates.back().targetPhantom;
+        desc->Run(reply, rawRoute, phantomNodes, *searchEnginePtr);
+        if("" != routeParameters.jsonpParameter) {
+            reply.content += ")\n";
+        }
+        reply.headers[0].name = "Content-Length";
+        std::string tmp;
+        intToString(reply.content.size(), tmp);
+        reply.headers[0].value = tmp;
+
+        delete desc;
+    }
+
+private:
+    std::string descriptor_string;
+};
+
+#endif /* TRIPPLUGIN_H_ */
@@ -28,9 +28,12 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include "../DataStructures/QueryEdge.h"
 #include "../DataStructures/StaticGraph.h"
 #include "../DataStructures/SearchEngine.h"
+#include "../DataStructures/SearchEngineData.h"
+#include "../DataStructures/TravelTimeProfiles.h"
 #include "../Descriptors/BaseDescriptor.h"
 #include "../Descriptors/GPXDescriptor.h"
 #include "../Descriptors/JSONDescriptor.h"
+#include "../RoutingAlgorithms/TimeDependentRouting.h"
 #include "../Server/DataStructures/QueryObjectsStorage.h"
 #include "../Util/SimpleLogger.h"
 #include "../Util/StringUtil.h"
@@ -47,6 +50,8 @@ private:
     StaticGraph<QueryEdge::EdgeData> * graph;
     HashTable<std::string, unsigned> descriptorTable;
     SearchEngine * searchEnginePtr;
+    SearchEngineData * timeDependentQueryData;
+    TimeDependentRouting<SearchEngineData> * timeDependentPath;
 public:
 
     ViaRoutePlugin(QueryObjectsStorage * objects)
@@ -58,6 +63,15 @@ public:
         graph = objects->graph;
 
         searchEnginePtr = new SearchEngine(graph, nodeHelpDesk, names);
+        timeDependentQueryData = NULL;
+        timeDependentPath = NULL;
+        if(NULL != objects->travelTimeProfiles) {
+            timeDependentQueryData = new SearchEngineData(graph, nodeHelpDesk, names);
+            timeDependentPath = new TimeDependentRouting<SearchEngineData>(
+                *timeDependentQueryData,
+                *objects->travelTimeProfiles
+            );
+        }
 
         descriptorTable.insert(std::make_pair(""    , 0));
         descriptorTable.insert(std::make_pair("json", 0));
@@ -65,6 +79,8 @@ public:
     }
 
     virtual ~ViaRoutePlugin() {
+        delete timeDependentPath;
+        delete timeDependentQueryData;
         delete searchEnginePtr;
     }
 
@@ -77,6 +93,12 @@ public:
             return;
         }
 
+        //a departure time would be ignored without travel time profiles
+        if( (0 != routeParameters.departureTime) && (NULL == timeDependentPath) ) {
+            WriteStatusReply(routeParameters, 400, "Departure time given but no travel time profiles loaded", descriptor_string, reply);
+            return;
+        }
+
         RawRouteData rawRoute;
         rawRoute.checkSum = nodeHelpDesk->GetCheckSum();
         bool checksumOK = (routeParameters.checkSum == rawRoute.checkSum);
@@ -108,16 +130,25 @@ public:
             segmentPhantomNodes.targetPhantom = phantomNodeVector[i+1];
             rawRoute.segmentEndCoordinates.push_back(segmentPhantomNodes);
         }
-        if( ( routeParameters.alternateRoute ) && (1 == rawRoute.segmentEndCoordinates.size()) ) {
+        if( (0 != routeParameters.departureTime) && (NULL != timeDependentPath) ) {
+            //alternatives are not computed for a given departure time
+            (*timeDependentPath)(
+                rawRoute.segmentEndCoordinates,
+                TravelTimeProfiles::GetTimeOfWeek(routeParameters.departureTime),
+                rawRoute,
+                *routeParameters.deadline
+            );
+        } else if( ( routeParameters.alternateRoute ) && (1 == rawRoute.segmentEndCoordinates.size()) ) {
 //            SimpleLogger().Write() << "Checking for alternative paths";
-            searchEnginePtr->alternativePaths(rawRoute.segmentEndCoordinates[0],  rawRoute);
+            searchEnginePtr->alternativePaths(rawRoute.segmentEndCoordinates[0],  rawRoute, *routeParameters.deadline);
 
         } else {
-            searchEnginePtr->shortestPath(rawRoute.segmentEndCoordinates, rawRoute);
+            searchEnginePtr->shortestPath(rawRoute.segmentEndCoordinates, rawRoute, *routeParameters.deadline);
         }
 
-
-        if(INT_MAX == rawRoute.lengthOfShortestPath ) {
+        if(rawRoute.searchWasAborted) {
+            SimpleLogger().Write(logDEBUG) << "Search aborted, deadline exceeded or client gone";
+        } else if(INT_MAX == rawRoute.lengthOfShortestPath ) {
             SimpleLogger().Write(logDEBUG) << "Error occurred, single path not found";
         }
         reply.status = http::Reply::ok;
@@ -159,15 +190,8 @@ public:
 //        SimpleLogger().Write() << "Number of segments: " << rawRoute.segmentEndCoordinates.size();
         desc->SetConfig(descriptorConfig);
 
-        desc->Run(reply, rawRoute, phantomNodes, *searchEnginePtr);
-        if("" != routeParameters.jsonpParameter) {
-            reply.content += ")\n";
-        }
+        //headers have to be complete before the descriptor may stream output
         reply.headers.resize(3);
-        reply.headers[0].name = "Content-Length";
-        std::string tmp;
-        intToString(reply.content.size(), tmp);
-        reply.headers[0].value = tmp;
         switch(descriptorType){
         case 0:
             if("" != routeParameters.jsonpParameter){
@@ -205,6 +229,15 @@ public:
             break;
         }
 
+        desc->Run(reply, rawRoute, phantomNodes, *searchEnginePtr);
+        if("" != routeParameters.jsonpParameter) {
+            reply.content += ")\n";
+        }
+        reply.headers[0].name = "Content-Length";
+        std::string tmp;
+        intToString(reply.content.size(), tmp);
+        reply.headers[0].value = tmp;
+
         delete desc;
         return;
     }
@@ -22,6 +22,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #define ALTERNATIVEROUTES_H_
 
 #include "BasicRoutingInterface.h"
+#include "../DataStructures/SearchDeadline.h"
 #include <boost/unordered_map.hpp>
 #include <cmath>
 #include <vector>
@@ -56,6 +57,10 @@ public:
     ~AlternativeRouting() {}
 
     void operator()(const PhantomNodes & phantomNodePair, RawRouteData & rawRouteData) {
+        (*this)(phantomNodePair, rawRouteData, SearchDeadline::Unbounded());
+    }
+
+    void operator()(const PhantomNodes & phantomNodePair, RawRouteData & rawRouteData, const SearchDeadline & deadline) {
         if(!phantomNodePair.AtLeastOnePhantomNodeIsUINTMAX() || phantomNodePair.PhantomNodesHaveEqualLocation()) {
             rawRouteData.lengthOfShortestPath = rawRouteData.lengthOfAlternativePath = INT_MAX;
             return;
@@ -91,7 +96,13 @@ public:
         const int reverse_offset = phantomNodePair.targetPhantom.weight1 + (phantomNodePair.targetPhantom.isBidirected() ? phantomNodePair.targetPhantom.weight2 : 0);
 
         //exploration dijkstra from nodes s and t until deletemin/(1+epsilon) > _lengthOfShortestPath
+        unsigned settled_nodes = 0;
         while(0 < (forward_heap1.Size() + reverse_heap1.Size())){
+            if(deadline.HasExpiredAfterSettling(settled_nodes)) {
+                rawRouteData.lengthOfShortestPath = rawRouteData.lengthOfAlternativePath = INT_MAX;
+                rawRouteData.searchWasAborted = true;
+                return;
+            }
             if(0 < forward_heap1.Size()){
                 AlternativeRoutingStep<true >(forward_heap1, reverse_heap1, &middle_node, &upper_bound_to_shortest_path_distance, viaNodeCandidates, forward_search_space, forward_offset);
             }
@@ -157,8 +168,13 @@ public:
         packedShortestPath.insert(packedShortestPath.end(),packed_reverse_path.begin(), packed_reverse_path.end());
         std::vector<RankedCandidateNode > rankedCandidates;
 
-        //prioritizing via nodes for deep inspection
+        //prioritizing via nodes for deep inspection. Once the deadline has
+        //passed, the shortest path is still reported, but without alternative
         BOOST_FOREACH(const NodeID node, nodes_that_passed_preselection) {
+            if(deadline.HasExpired()) {
+                rankedCandidates.clear();
+                break;
+            }
             int lengthOfViaPath = 0, sharingOfViaPath = 0;
             computeLengthAndSharingOfViaPath(node, &lengthOfViaPath, &sharingOfViaPath, forward_offset+reverse_offset, packedShortestPath);
             if(sharingOfViaPath <= upper_bound_to_shortest_path_distance*VIAPATH_GAMMA) {
@@ -171,6 +187,9 @@ public:
         int lengthOfViaPath = INT_MAX;
         NodeID s_v_middle = UINT_MAX, v_t_middle = UINT_MAX;
         BOOST_FOREACH(const RankedCandidateNode & candidate, rankedCandidates){
+            if(deadline.HasExpired()) {
+                break;
+            }
             if(viaNodeCandidatePasses_T_Test(forward_heap1, reverse_heap1, forward_heap2, reverse_heap2, candidate, forward_offset+reverse_offset, upper_bound_to_shortest_path_distance, &lengthOfViaPath, &s_v_middle, &v_t_middle)) {
                 // select first admissable
                 selectedViaNode = candidate.node;
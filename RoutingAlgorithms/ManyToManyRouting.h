@@ -0,0 +1,183 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef MANYTOMANYROUTING_H_
+#define MANYTOMANYROUTING_H_
+
+#include "BasicRoutingInterface.h"
+#include "../DataStructures/PhantomNodes.h"
+#include "../DataStructures/SearchDeadline.h"
+
+#include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <climits>
+#include <vector>
+
+/*
+ * Distance tables between sets of phantom nodes with the bucket-based
+ * algorithm of Knopp et al.: one backward search per target leaves its
+ * distances in buckets at the settled nodes, one forward search per source
+ * then scans the buckets of the nodes it settles.
+ */
+template<class QueryDataT>
+class ManyToManyRouting : public BasicRoutingInterface<QueryDataT>{
+    typedef BasicRoutingInterface<QueryDataT> super;
+    typedef typename QueryDataT::QueryHeap QueryHeap;
+
+    struct NodeBucket {
+        NodeBucket(const unsigned t, const int d) : target_id(t), distance(d) { }
+        unsigned target_id;
+        int distance;
+    };
+    typedef boost::unordered_map<NodeID, std::vector<NodeBucket> > SearchSpaceWithBuckets;
+
+public:
+    ManyToManyRouting( QueryDataT & qd) : super(qd) {}
+
+    ~ManyToManyRouting() {}
+
+    /*
+     * Fills result_table row by row, the entry of source i and target j is
+     * result_table[i*targets.size() + j]. Pairs without a path get INT_MAX.
+     * Returns false if the deadline expired.
+     */
+    bool operator()(
+        const std::vector<PhantomNode> & sources,
+        const std::vector<PhantomNode> & targets,
+        std::vector<int> & result_table,
+        const SearchDeadline & deadline
+    ) const {
+        const unsigned number_of_targets = targets.size();
+        result_table.assign(sources.size()*number_of_targets, INT_MAX);
+
+        super::_queryData.InitializeOrClearFirstThreadLocalStorage();
+        QueryHeap & query_heap = *(super::_queryData.forwardHeap);
+        SearchSpaceWithBuckets search_space_with_buckets;
+        unsigned settled_nodes = 0;
+
+        for(unsigned target_id = 0; target_id < number_of_targets; ++target_id) {
+            query_heap.Clear();
+            const PhantomNode & target = targets[target_id];
+            query_heap.Insert(target.edgeBasedNode, target.weight1, target.edgeBasedNode);
+            if(target.isBidirected()) {
+                query_heap.Insert(target.edgeBasedNode+1, target.weight2, target.edgeBasedNode+1);
+            }
+            while(0 < query_heap.Size()) {
+                if(deadline.HasExpiredAfterSettling(settled_nodes)) {
+                    return false;
+                }
+                BackwardRoutingStep(target_id, query_heap, search_space_with_buckets);
+            }
+        }
+
+        for(unsigned source_id = 0; source_id < sources.size(); ++source_id) {
+            query_heap.Clear();
+            const PhantomNode & source = sources[source_id];
+            query_heap.Insert(source.edgeBasedNode, -source.weight1, source.edgeBasedNode);
+            if(source.isBidirected()) {
+                query_heap.Insert(source.edgeBasedNode+1, -source.weight2, source.edgeBasedNode+1);
+            }
+            int * result_row = &result_table[source_id*number_of_targets];
+            while(0 < query_heap.Size()) {
+                if(deadline.HasExpiredAfterSettling(settled_nodes)) {
+                    return false;
+                }
+                ForwardRoutingStep(result_row, query_heap, search_space_with_buckets);
+            }
+        }
+        return true;
+    }
+
+private:
+    inline void ForwardRoutingStep(
+        int * result_row,
+        QueryHeap & query_heap,
+        const SearchSpaceWithBuckets & search_space_with_buckets
+    ) const {
+        const NodeID node = query_heap.DeleteMin();
+        const int source_distance = query_heap.GetKey(node);
+
+        typename SearchSpaceWithBuckets::const_iterator bucket_iterator = search_space_with_buckets.find(node);
+        if(search_space_with_buckets.end() != bucket_iterator) {
+            BOOST_FOREACH(const NodeBucket & bucket, bucket_iterator->second) {
+                const int new_distance = source_distance + bucket.distance;
+                //negative sums belong to a target behind the source on the same segment
+                if(0 <= new_distance && new_distance < result_row[bucket.target_id]) {
+                    result_row[bucket.target_id] = new_distance;
+                }
+            }
+        }
+        if(StallAtNode(node, source_distance, query_heap, true)) {
+            return;
+        }
+        RelaxEdges(node, source_distance, query_heap, true);
+    }
+
+    inline void BackwardRoutingStep(
+        const unsigned target_id,
+        QueryHeap & query_heap,
+        SearchSpaceWithBuckets & search_space_with_buckets
+    ) const {
+        const NodeID node = query_heap.DeleteMin();
+        const int target_distance = query_heap.GetKey(node);
+        search_space_with_buckets[node].push_back(NodeBucket(target_id, target_distance));
+        if(StallAtNode(node, target_distance, query_heap, false)) {
+            return;
+        }
+        RelaxEdges(node, target_distance, query_heap, false);
+    }
+
+    inline void RelaxEdges(const NodeID node, const int distance, QueryHeap & query_heap, const bool forward_direction) const {
+        for ( typename QueryDataT::Graph::EdgeIterator edge = super::_queryData.graph->BeginEdges( node ); edge < super::_queryData.graph->EndEdges(node); ++edge ) {
+            const typename QueryDataT::Graph::EdgeData & data = super::_queryData.graph->GetEdgeData(edge);
+            const bool direction_flag = (forward_direction ? data.forward : data.backward );
+            if(!direction_flag) {
+                continue;
+            }
+            const NodeID to = super::_queryData.graph->GetTarget(edge);
+            const int to_distance = distance + data.distance;
+            if(!query_heap.WasInserted(to)) {
+                query_heap.Insert(to, to_distance, node);
+            } else if(to_distance < query_heap.GetKey(to)) {
+                query_heap.GetData(to).parent = node;
+                query_heap.DecreaseKey(to, to_distance);
+            }
+        }
+    }
+
+    //Stall-on-demand, as in BasicRoutingInterface::RoutingStep
+    inline bool StallAtNode(const NodeID node, const int distance, QueryHeap & query_heap, const bool forward_direction) const {
+        for ( typename QueryDataT::Graph::EdgeIterator edge = super::_queryData.graph->BeginEdges( node ); edge < super::_queryData.graph->EndEdges(node); ++edge ) {
+            const typename QueryDataT::Graph::EdgeData & data = super::_queryData.graph->GetEdgeData(edge);
+            const bool reverse_flag = (!forward_direction) ? data.forward : data.backward;
+            if(!reverse_flag) {
+                continue;
+            }
+            const NodeID to = super::_queryData.graph->GetTarget(edge);
+            if(query_heap.WasInserted(to) && query_heap.GetKey(to) + data.distance < distance) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif /* MANYTOMANYROUTING_H_ */
@@ -0,0 +1,395 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef ONETOALLROUTING_H_
+#define ONETOALLROUTING_H_
+
+#include "../DataStructures/PhantomNodes.h"
+#include "../DataStructures/SearchDeadline.h"
+#include "../Util/SimpleLogger.h"
+#include "../typedefs.h"
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <utility>
+#include <vector>
+
+//Number of sources that share one downward sweep
+static const unsigned ONE_TO_ALL_SWEEP_WIDTH = 4;
+//Distance of nodes that have not been reached. Small enough to add edge weights to.
+static const int ONE_TO_ALL_UNREACHED = INT_MAX/2;
+//Once more than this fraction of all nodes is reached, the sweep goes on linearly
+static const unsigned ONE_TO_ALL_DENSE_SWEEP_RATIO = 16;
+
+/*
+ * One-to-all shortest path distances by PHAST: an upward search in the
+ * hierarchy from each source, followed by a sweep over the nodes from the
+ * top of the hierarchy down that relaxes the downward edges. The downward
+ * edges are copied into the order of the sweep once, so that the sweep
+ * reads them front to back. The sweep only visits nodes that are within
+ * the distance bound, so that small bounds stay cheap, and turns into a
+ * linear pass over the remaining nodes once a large part of them is in range.
+ * In reverse direction the distances are those from all nodes to the sources.
+ */
+template<class QueryDataT>
+class OneToAllRouting : boost::noncopyable {
+    typedef typename QueryDataT::Graph Graph;
+    typedef typename QueryDataT::QueryHeap QueryHeap;
+
+    struct DownwardEdge {
+        DownwardEdge(const unsigned p, const int w) : target_position(p), weight(w) { }
+        //sweep position of the lower node the edge leads down to
+        unsigned target_position;
+        int weight;
+    };
+
+    //Labels of one thread, kept between sweeps. Only the touched entries
+    //differ from ONE_TO_ALL_UNREACHED and are reset before the next sweep.
+    struct SweepLabels {
+        explicit SweepLabels(const unsigned number_of_nodes) :
+            distances(number_of_nodes*ONE_TO_ALL_SWEEP_WIDTH, ONE_TO_ALL_UNREACHED),
+            is_touched(number_of_nodes, false),
+            all_touched(false)
+        { }
+
+        void Clear() {
+            if(all_touched) {
+                std::fill(distances.begin(), distances.end(), ONE_TO_ALL_UNREACHED);
+                std::fill(is_touched.begin(), is_touched.end(), false);
+            } else {
+                for(unsigned i = 0; i < touched_positions.size(); ++i) {
+                    const unsigned position = touched_positions[i];
+                    std::fill_n(distances.begin() + position*ONE_TO_ALL_SWEEP_WIDTH, ONE_TO_ALL_SWEEP_WIDTH, ONE_TO_ALL_UNREACHED);
+                    is_touched[position] = false;
+                }
+            }
+            touched_positions.clear();
+            reached_positions.clear();
+            pending_positions.clear();
+            all_touched = false;
+        }
+
+        //interleaved by source, see operator()
+        std::vector<int> distances;
+        std::vector<bool> is_touched;
+        std::vector<unsigned> touched_positions;
+        //in order of the sweep
+        std::vector<unsigned> reached_positions;
+        //min-heap of touched positions that the sweep has yet to visit
+        std::vector<unsigned> pending_positions;
+        //set by the linear pass, which may touch every entry
+        bool all_touched;
+    };
+
+    QueryDataT & _queryData;
+    const bool forward_direction;
+    std::vector<NodeID> sweep_order;
+    std::vector<unsigned> sweep_position;
+    std::vector<unsigned> first_downward_edge;
+    std::vector<DownwardEdge> downward_edges;
+    mutable boost::thread_specific_ptr<SweepLabels> thread_labels;
+
+public:
+    OneToAllRouting(QueryDataT & qd, const bool forward = true) : _queryData(qd), forward_direction(forward) {
+        ComputeSweepOrder();
+        CopyDownwardEdges();
+    }
+
+    inline unsigned GetNumberOfNodes() const {
+        return sweep_order.size();
+    }
+
+    //Node at the given position of the sweep
+    inline NodeID GetNodeAtPosition(const unsigned position) const {
+        return sweep_order[position];
+    }
+
+    inline unsigned GetPositionOfNode(const NodeID node) const {
+        return sweep_position[node];
+    }
+
+    //Distance from the source in the given lane to the node at the given
+    //position, as computed by the last sweep of the calling thread
+    inline int GetDistance(const unsigned position, const unsigned lane) const {
+        return thread_labels->distances[position*ONE_TO_ALL_SWEEP_WIDTH + lane];
+    }
+
+    //Positions within range of at least one source in the last sweep of
+    //the calling thread, in ascending order
+    inline const std::vector<unsigned> & GetReachedPositions() const {
+        return thread_labels->reached_positions;
+    }
+
+    /*
+     * Computes the distances from up to ONE_TO_ALL_SWEEP_WIDTH sources to all
+     * nodes within max_distance. Distances are stored by sweep position and
+     * interleaved by source, GetDistance(position, i) belongs to sources[i].
+     * Nodes further away than max_distance keep ONE_TO_ALL_UNREACHED.
+     * Forward sweeps start at the phantom nodes of the sources, reverse sweeps
+     * at the ends of their segments so that they stay lower bounds.
+     * The labels are kept per thread and are valid until its next sweep.
+     * Returns false if the deadline expired.
+     */
+    bool operator()(
+        const std::vector<PhantomNode> & sources,
+        const int max_distance,
+        const SearchDeadline & deadline
+    ) const {
+        if(!thread_labels.get()) {
+            thread_labels.reset(new SweepLabels(sweep_order.size()));
+        } else {
+            thread_labels->Clear();
+        }
+        SweepLabels & labels = *thread_labels;
+
+        unsigned settled_nodes = 0;
+        _queryData.InitializeOrClearFirstThreadLocalStorage();
+        QueryHeap & heap = *(_queryData.forwardHeap);
+        const unsigned number_of_sources = std::min(ONE_TO_ALL_SWEEP_WIDTH, (unsigned)sources.size());
+        for(unsigned lane = 0; lane < number_of_sources; ++lane) {
+            heap.Clear();
+            const PhantomNode & source = sources[lane];
+            heap.Insert(source.edgeBasedNode, (forward_direction ? -source.weight1 : 0), source.edgeBasedNode);
+            if(source.isBidirected()) {
+                heap.Insert(source.edgeBasedNode+1, (forward_direction ? -source.weight2 : 0), source.edgeBasedNode+1);
+            }
+            while(0 < heap.Size()) {
+                if(deadline.HasExpiredAfterSettling(settled_nodes)) {
+                    return false;
+                }
+                const NodeID node = heap.DeleteMin();
+                const int distance = heap.GetKey(node);
+                //the downward sweep only adds to this, nothing above can be in range
+                if(distance > max_distance) {
+                    break;
+                }
+                const unsigned position = sweep_position[node];
+                labels.distances[position*ONE_TO_ALL_SWEEP_WIDTH + lane] = distance;
+                Touch(labels, position);
+                RelaxUpwardEdges(heap, node, distance);
+            }
+        }
+
+        //downward edges lead to later positions, so every position is final
+        //once all touched positions before it have been visited
+        const unsigned dense_threshold = sweep_order.size()/ONE_TO_ALL_DENSE_SWEEP_RATIO;
+        while(!labels.pending_positions.empty()) {
+            if(deadline.HasExpiredAfterSettling(settled_nodes)) {
+                return false;
+            }
+            if(labels.touched_positions.size() > dense_threshold) {
+                return SweepLinearly(labels, labels.pending_positions.front(), max_distance, settled_nodes, deadline);
+            }
+            std::pop_heap(labels.pending_positions.begin(), labels.pending_positions.end(), std::greater<unsigned>());
+            const unsigned position = labels.pending_positions.back();
+            labels.pending_positions.pop_back();
+            labels.reached_positions.push_back(position);
+            RelaxDownwardEdges(labels, position, max_distance, true);
+        }
+        return true;
+    }
+
+private:
+    inline void Touch(SweepLabels & labels, const unsigned position) const {
+        if(labels.is_touched[position]) {
+            return;
+        }
+        labels.is_touched[position] = true;
+        labels.touched_positions.push_back(position);
+        labels.pending_positions.push_back(position);
+        std::push_heap(labels.pending_positions.begin(), labels.pending_positions.end(), std::greater<unsigned>());
+    }
+
+    //Visits every position from first_position on, in range or not
+    bool SweepLinearly(
+        SweepLabels & labels,
+        const unsigned first_position,
+        const int max_distance,
+        unsigned & settled_nodes,
+        const SearchDeadline & deadline
+    ) const {
+        labels.all_touched = true;
+        labels.pending_positions.clear();
+        for(unsigned position = first_position; position < sweep_order.size(); ++position) {
+            if(deadline.HasExpiredAfterSettling(settled_nodes)) {
+                return false;
+            }
+            const int * label = &labels.distances[position*ONE_TO_ALL_SWEEP_WIDTH];
+            if(*std::min_element(label, label + ONE_TO_ALL_SWEEP_WIDTH) > max_distance) {
+                continue;
+            }
+            labels.reached_positions.push_back(position);
+            RelaxDownwardEdges(labels, position, max_distance, false);
+        }
+        return true;
+    }
+
+    inline void RelaxDownwardEdges(
+        SweepLabels & labels,
+        const unsigned position,
+        const int max_distance,
+        const bool touch_targets
+    ) const {
+        const int * source_label = &labels.distances[position*ONE_TO_ALL_SWEEP_WIDTH];
+        for(
+            unsigned edge = first_downward_edge[position], end_edge = first_downward_edge[position+1];
+            edge < end_edge;
+            ++edge
+        ) {
+            const DownwardEdge & down = downward_edges[edge];
+            int * label = &labels.distances[down.target_position*ONE_TO_ALL_SWEEP_WIDTH];
+            bool is_improved = false;
+            for(unsigned lane = 0; lane < ONE_TO_ALL_SWEEP_WIDTH; ++lane) {
+                const int distance = source_label[lane] + down.weight;
+                if(distance <= max_distance && distance < label[lane]) {
+                    label[lane] = distance;
+                    is_improved = true;
+                }
+            }
+            if(is_improved && touch_targets) {
+                Touch(labels, down.target_position);
+            }
+        }
+    }
+
+    inline void RelaxUpwardEdges(QueryHeap & heap, const NodeID node, const int distance) const {
+        const Graph & graph = *(_queryData.graph);
+        for(typename Graph::EdgeIterator edge = graph.BeginEdges(node); edge < graph.EndEdges(node); ++edge) {
+            const typename Graph::EdgeData & data = graph.GetEdgeData(edge);
+            if(!(forward_direction ? data.forward : data.backward)) {
+                continue;
+            }
+            const NodeID to = graph.GetTarget(edge);
+            const int to_distance = distance + data.distance;
+            if(!heap.WasInserted(to)) {
+                heap.Insert(to, to_distance, node);
+            } else if(to_distance < heap.GetKey(to)) {
+                heap.GetData(to).parent = node;
+                heap.DecreaseKey(to, to_distance);
+            }
+        }
+    }
+
+    //The depth of a node is one more than the largest depth among the nodes
+    //its edges lead up to, the nodes at the top have depth zero. Nodes with
+    //equal depth are independent of each other.
+    void ComputeSweepOrder() {
+        const Graph & graph = *(_queryData.graph);
+        const unsigned number_of_nodes = graph.GetNumberOfNodes();
+        std::vector<unsigned> depth(number_of_nodes, UINT_MAX);
+        std::vector<std::pair<NodeID, unsigned> > dfs_stack;
+        unsigned max_depth = 0;
+        unsigned number_of_cyclic_edges = 0;
+
+        //UINT_MAX-1 marks nodes that are on the stack
+        for(NodeID root = 0; root < number_of_nodes; ++root) {
+            if(UINT_MAX != depth[root]) {
+                continue;
+            }
+            dfs_stack.push_back(std::make_pair(root, graph.BeginEdges(root)));
+            depth[root] = UINT_MAX-1;
+            while(!dfs_stack.empty()) {
+                const NodeID node = dfs_stack.back().first;
+                unsigned & edge = dfs_stack.back().second;
+                if(edge < graph.EndEdges(node)) {
+                    const NodeID target = graph.GetTarget(edge);
+                    ++edge;
+                    if(UINT_MAX == depth[target]) {
+                        depth[target] = UINT_MAX-1;
+                        dfs_stack.push_back(std::make_pair(target, graph.BeginEdges(target)));
+                    } else if(UINT_MAX-1 == depth[target]) {
+                        ++number_of_cyclic_edges;
+                    }
+                    continue;
+                }
+                unsigned node_depth = 0;
+                for(typename Graph::EdgeIterator e = graph.BeginEdges(node); e < graph.EndEdges(node); ++e) {
+                    const unsigned target_depth = depth[graph.GetTarget(e)];
+                    if(UINT_MAX-1 > target_depth) {
+                        node_depth = std::max(node_depth, target_depth+1);
+                    }
+                }
+                depth[node] = node_depth;
+                max_depth = std::max(max_depth, node_depth);
+                dfs_stack.pop_back();
+            }
+        }
+        if(0 < number_of_cyclic_edges) {
+            SimpleLogger().Write(logWARNING) <<
+                number_of_cyclic_edges << " edges do not lead upwards in the hierarchy, distances may be inexact";
+        }
+
+        //counting sort by depth
+        std::vector<unsigned> depth_begin(max_depth+2, 0);
+        for(NodeID node = 0; node < number_of_nodes; ++node) {
+            ++depth_begin[depth[node] + 1];
+        }
+        for(unsigned i = 1; i < depth_begin.size(); ++i) {
+            depth_begin[i] += depth_begin[i-1];
+        }
+        sweep_order.resize(number_of_nodes);
+        sweep_position.resize(number_of_nodes);
+        for(NodeID node = 0; node < number_of_nodes; ++node) {
+            const unsigned position = depth_begin[depth[node]]++;
+            sweep_order[position] = node;
+            sweep_position[node] = position;
+        }
+        SimpleLogger().Write(logDEBUG) << "one-to-all sweep over " << number_of_nodes << " nodes in " << max_depth+1 << " levels";
+    }
+
+    //An edge u->v stored at the lower node v with the backward flag can be
+    //traversed from the higher node u down to v. In reverse direction the
+    //edges with the forward flag lead from v up to u. The edges are grouped
+    //by the position of the node they come down from.
+    void CopyDownwardEdges() {
+        const Graph & graph = *(_queryData.graph);
+        const unsigned number_of_nodes = sweep_order.size();
+        std::vector<std::pair<unsigned, DownwardEdge> > edge_list;
+        for(unsigned position = 0; position < number_of_nodes; ++position) {
+            const NodeID node = sweep_order[position];
+            for(typename Graph::EdgeIterator edge = graph.BeginEdges(node); edge < graph.EndEdges(node); ++edge) {
+                const typename Graph::EdgeData & data = graph.GetEdgeData(edge);
+                const unsigned source_position = sweep_position[graph.GetTarget(edge)];
+                const bool direction_flag = (forward_direction ? data.backward : data.forward);
+                if(direction_flag && source_position < position) {
+                    edge_list.push_back(std::make_pair(source_position, DownwardEdge(position, data.distance)));
+                }
+            }
+        }
+        first_downward_edge.assign(number_of_nodes+1, 0);
+        for(unsigned i = 0; i < edge_list.size(); ++i) {
+            ++first_downward_edge[edge_list[i].first+1];
+        }
+        for(unsigned i = 1; i < first_downward_edge.size(); ++i) {
+            first_downward_edge[i] += first_downward_edge[i-1];
+        }
+        std::vector<unsigned> next_edge(first_downward_edge.begin(), first_downward_edge.end()-1);
+        downward_edges.resize(edge_list.size(), DownwardEdge(UINT_MAX, 0));
+        for(unsigned i = 0; i < edge_list.size(); ++i) {
+            downward_edges[next_edge[edge_list[i].first]++] = edge_list[i].second;
+        }
+    }
+};
+
+#endif /* ONETOALLROUTING_H_ */
@@ -24,6 +24,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #define SHORTESTPATHROUTING_H_
 
 #include "BasicRoutingInterface.h"
+#include "../DataStructures/SearchDeadline.h"
 
 template<class QueryDataT>
 class ShortestPathRouting : public BasicRoutingInterface<QueryDataT>{
@@ -35,6 +36,10 @@ public:
     ~ShortestPathRouting() {}
 
     void operator()(std::vector<PhantomNodes> & phantomNodesVector,  RawRouteData & rawRouteData) const {
+        (*this)(phantomNodesVector, rawRouteData, SearchDeadline::Unbounded());
+    }
+
+    void operator()(std::vector<PhantomNodes> & phantomNodesVector,  RawRouteData & rawRouteData, const SearchDeadline & deadline) const {
         BOOST_FOREACH(const PhantomNodes & phantomNodePair, phantomNodesVector) {
             if(!phantomNodePair.AtLeastOnePhantomNodeIsUINTMAX()) {
                 rawRouteData.lengthOfShortestPath = rawRouteData.lengthOfAlternativePath = INT_MAX;
@@ -50,6 +55,7 @@ public:
         NodeID middle2 = UINT_MAX;
         std::vector<NodeID> packedPath1;
         std::vector<NodeID> packedPath2;
+        unsigned settled_nodes = 0;
 
         super::_queryData.InitializeOrClearFirstThreadLocalStorage();
         super::_queryData.InitializeOrClearSecondThreadLocalStorage();
@@ -96,6 +102,10 @@ public:
 
             //run two-Target Dijkstra routing step.
             while(0 < (forward_heap1.Size() + reverse_heap1.Size() )){
+                if(deadline.HasExpiredAfterSettling(settled_nodes)) {
+                    AbortSearch(rawRouteData);
+                    return;
+                }
                 if(0 < forward_heap1.Size()){
                     super::RoutingStep(forward_heap1, reverse_heap1, &middle1, &_localUpperbound1, forward_offset, true);
                 }
@@ -105,6 +115,10 @@ public:
             }
             if(0 < reverse_heap2.Size()) {
                 while(0 < (forward_heap2.Size() + reverse_heap2.Size() )){
+                    if(deadline.HasExpiredAfterSettling(settled_nodes)) {
+                        AbortSearch(rawRouteData);
+                        return;
+                    }
                     if(0 < forward_heap2.Size()){
                         super::RoutingStep(forward_heap2, reverse_heap2, &middle2, &_localUpperbound2, forward_offset, true);
                     }
@@ -196,6 +210,12 @@ public:
         rawRouteData.lengthOfShortestPath = std::min(distance1, distance2);
         return;
     }
+
+private:
+    inline void AbortSearch(RawRouteData & rawRouteData) const {
+        rawRouteData.lengthOfShortestPath = rawRouteData.lengthOfAlternativePath = INT_MAX;
+        rawRouteData.searchWasAborted = true;
+    }
 };
 
 #endif /* SHORTESTPATHROUTING_H_ */
@@ -0,0 +1,440 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef TIMEDEPENDENTROUTING_H_
+#define TIMEDEPENDENTROUTING_H_
+
+#include "ManyToManyRouting.h"
+#include "OneToAllRouting.h"
+#include "../DataStructures/PhantomNodes.h"
+#include "../DataStructures/RawRouteData.h"
+#include "../DataStructures/SearchDeadline.h"
+#include "../DataStructures/TravelTimeProfiles.h"
+#include "../typedefs.h"
+
+#include <boost/foreach.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <utility>
+#include <vector>
+
+//Margin in percent on the sweep bound, covers rounding of profiled weights
+static const int TIME_DEPENDENT_SWEEP_SLACK = 110;
+
+/*
+ * Earliest arrival routing with travel time profiles. The hierarchy is
+ * contracted with free flow weights, so a reverse PHAST sweep from the
+ * target yields free flow distances to it. Scaled by the smallest profile
+ * factor they are lower bounds of the time dependent travel time and guide
+ * an A* search over the original edges of the hierarchy. Profiles are
+ * assumed to be FIFO, i.e. leaving later never means arriving earlier.
+ * No leg takes longer than its free flow distance scaled by the largest
+ * factor, so the sweep only has to reach that far, scaled back by the
+ * smallest one. A leg that does not fit is routed again after a full sweep.
+ */
+template<class QueryDataT>
+class TimeDependentRouting : boost::noncopyable {
+    typedef typename QueryDataT::Graph Graph;
+    typedef typename QueryDataT::QueryHeap QueryHeap;
+
+    struct OriginalEdge {
+        OriginalEdge(const NodeID t, const int w, const unsigned i) : target(t), weight(w), id(i) { }
+        NodeID target;
+        int weight;
+        //id of the original edge data, for names and turn instructions
+        unsigned id;
+    };
+
+    QueryDataT & _queryData;
+    const TravelTimeProfiles & profiles;
+    OneToAllRouting<QueryDataT> lowerBounds;
+    ManyToManyRouting<QueryDataT> freeFlowDistances;
+    std::vector<unsigned> first_edge;
+    std::vector<OriginalEdge> edges;
+
+public:
+    TimeDependentRouting(QueryDataT & qd, const TravelTimeProfiles & p) :
+        _queryData(qd),
+        profiles(p),
+        lowerBounds(qd, false),
+        freeFlowDistances(qd)
+    {
+        CopyOriginalEdges();
+    }
+
+    /*
+     * Routes through all legs, each leg departs when the previous one
+     * arrives. departure_time is in tenths of a second since the start of
+     * the week, see TravelTimeProfiles::GetTimeOfWeek.
+     */
+    void operator()(
+        std::vector<PhantomNodes> & phantomNodesVector,
+        const unsigned departure_time,
+        RawRouteData & rawRouteData,
+        const SearchDeadline & deadline
+    ) const {
+        BOOST_FOREACH(const PhantomNodes & phantomNodePair, phantomNodesVector) {
+            if(!phantomNodePair.AtLeastOnePhantomNodeIsUINTMAX()) {
+                rawRouteData.lengthOfShortestPath = rawRouteData.lengthOfAlternativePath = INT_MAX;
+                return;
+            }
+        }
+        unsigned settled_nodes = 0;
+        int duration = 0;
+        std::vector<NodeID> leg_path;
+        std::vector<PhantomNode> leg_sources;
+        std::vector<PhantomNode> leg_targets;
+        int sweep_bound = ONE_TO_ALL_UNREACHED-1;
+        for(unsigned leg = 0; leg < phantomNodesVector.size(); ++leg) {
+            //a reverse sweep computes the lower bounds for up to four legs at once
+            const unsigned lane = leg % ONE_TO_ALL_SWEEP_WIDTH;
+            if(0 == lane) {
+                leg_sources.clear();
+                leg_targets.clear();
+                for(unsigned i = leg; i < phantomNodesVector.size() && leg_targets.size() < ONE_TO_ALL_SWEEP_WIDTH; ++i) {
+                    leg_sources.push_back(phantomNodesVector[i].startPhantom);
+                    leg_targets.push_back(phantomNodesVector[i].targetPhantom);
+                }
+                if(
+                    !ComputeSweepBound(leg_sources, leg_targets, sweep_bound, deadline) ||
+                    !lowerBounds(leg_targets, sweep_bound, deadline)
+                ) {
+                    rawRouteData.lengthOfShortestPath = rawRouteData.lengthOfAlternativePath = INT_MAX;
+                    rawRouteData.searchWasAborted = true;
+                    return;
+                }
+            }
+            int leg_duration = INT_MAX;
+            int source_offset = 0;
+            const unsigned leg_departure = departure_time + duration;
+            if(!RouteLeg(phantomNodesVector[leg], lane, leg_departure, leg_path, source_offset, leg_duration, settled_nodes, deadline)) {
+                rawRouteData.lengthOfShortestPath = rawRouteData.lengthOfAlternativePath = INT_MAX;
+                rawRouteData.searchWasAborted = true;
+                return;
+            }
+            //a better route may have left the swept area if this one is longer
+            //than the lower bound at its border
+            if(ONE_TO_ALL_UNREACHED-1 > sweep_bound && (INT_MAX == leg_duration || leg_duration > ScaleToLowerBound(sweep_bound))) {
+                sweep_bound = ONE_TO_ALL_UNREACHED-1;
+                leg_duration = INT_MAX;
+                source_offset = 0;
+                if(
+                    !lowerBounds(leg_targets, sweep_bound, deadline) ||
+                    !RouteLeg(phantomNodesVector[leg], lane, leg_departure, leg_path, source_offset, leg_duration, settled_nodes, deadline)
+                ) {
+                    rawRouteData.lengthOfShortestPath = rawRouteData.lengthOfAlternativePath = INT_MAX;
+                    rawRouteData.searchWasAborted = true;
+                    return;
+                }
+            }
+            if(INT_MAX == leg_duration) {
+                rawRouteData.lengthOfShortestPath = rawRouteData.lengthOfAlternativePath = INT_MAX;
+                return;
+            }
+            UnpackLeg(leg_path, source_offset, leg_departure, rawRouteData.computedShortestPath);
+            duration += leg_duration;
+        }
+        rawRouteData.lengthOfShortestPath = duration;
+    }
+
+private:
+    //Free flow distance of the longest leg, scaled by the spread of the
+    //factors. Falls back to a full sweep if some leg has no free flow path.
+    //Returns false if the deadline expired.
+    bool ComputeSweepBound(
+        const std::vector<PhantomNode> & sources,
+        const std::vector<PhantomNode> & targets,
+        int & sweep_bound,
+        const SearchDeadline & deadline
+    ) const {
+        sweep_bound = ONE_TO_ALL_UNREACHED-1;
+        std::vector<int> distances;
+        if(!freeFlowDistances(sources, targets, distances, deadline)) {
+            return false;
+        }
+        long long longest_leg = 0;
+        for(unsigned i = 0; i < sources.size(); ++i) {
+            const int distance = distances[i*targets.size() + i];
+            if(INT_MAX == distance) {
+                return true;
+            }
+            longest_leg = std::max(longest_leg, (long long)std::max(0, distance));
+        }
+        const long long bound =
+            (longest_leg*profiles.GetMaximumFactor()*TIME_DEPENDENT_SWEEP_SLACK)/
+            ((long long)profiles.GetMinimumFactor()*100) + 1;
+        sweep_bound = (int)std::min(bound, (long long)(ONE_TO_ALL_UNREACHED-1));
+        return true;
+    }
+
+    //Returns false if the deadline expired. leg_duration stays INT_MAX if
+    //the target cannot be reached. The lower bounds to the target are in
+    //the given lane of the sweep. source_offset is the part of the first
+    //segment of the path that lies before the source.
+    bool RouteLeg(
+        const PhantomNodes & phantomNodePair,
+        const unsigned lane,
+        const unsigned departure,
+        std::vector<NodeID> & path,
+        int & source_offset,
+        int & leg_duration,
+        unsigned & settled_nodes,
+        const SearchDeadline & deadline
+    ) const {
+        const PhantomNode & source = phantomNodePair.startPhantom;
+        const PhantomNode & target = phantomNodePair.targetPhantom;
+        const NodeID source_nodes[2] = {
+            source.edgeBasedNode,
+            source.isBidirected() ? source.edgeBasedNode+1 : UINT_MAX
+        };
+        const int source_offsets[2] = { source.weight1, source.weight2 };
+        const NodeID target_nodes[2] = {
+            target.edgeBasedNode,
+            target.isBidirected() ? target.edgeBasedNode+1 : UINT_MAX
+        };
+        const int target_offsets[2] = { target.weight1, target.weight2 };
+
+        _queryData.InitializeOrClearSecondThreadLocalStorage();
+        QueryHeap & heap = *(_queryData.forwardHeap2);
+        NodeID best_target = UINT_MAX;
+        bool best_is_on_source_segment = false;
+        //nodes whose current label comes straight from a source segment,
+        //with that segment. The parent chain ends there, even if the route
+        //passes a source segment again later on.
+        std::vector<std::pair<NodeID, NodeID> > source_labels;
+
+        //the source segments are not inserted themselves, so that a route
+        //may come back to them for a target behind the source
+        for(unsigned i = 0; i < 2; ++i) {
+            const NodeID node = source_nodes[i];
+            if(UINT_MAX == node) {
+                continue;
+            }
+            for(unsigned j = 0; j < 2; ++j) {
+                if(node == target_nodes[j] && source_offsets[i] <= target_offsets[j]) {
+                    const int direct = profiles.GetTravelTime(node, target_offsets[j] - source_offsets[i], departure);
+                    if(direct < leg_duration) {
+                        leg_duration = direct;
+                        best_target = node;
+                        best_is_on_source_segment = true;
+                        source_offset = source_offsets[i];
+                    }
+                }
+            }
+            for(unsigned edge = first_edge[node]; edge < first_edge[node+1]; ++edge) {
+                const int weight = std::max(0, edges[edge].weight - source_offsets[i]);
+                const NodeID to = edges[edge].target;
+                if(RelaxEdge(heap, lane, node, to, profiles.GetTravelTime(node, weight, departure))) {
+                    SetSourceLabel(source_labels, to, node);
+                }
+            }
+        }
+
+        while(0 < heap.Size()) {
+            if(deadline.HasExpiredAfterSettling(settled_nodes)) {
+                return false;
+            }
+            const NodeID node = heap.DeleteMin();
+            const int key = heap.GetKey(node);
+            //keys never overestimate, nothing better can be found
+            if(key >= leg_duration) {
+                break;
+            }
+            const int arrival = key - GetLowerBound(lane, node);
+            for(unsigned j = 0; j < 2; ++j) {
+                if(node == target_nodes[j]) {
+                    const int candidate = arrival + profiles.GetTravelTime(node, target_offsets[j], departure + arrival);
+                    if(candidate < leg_duration) {
+                        leg_duration = candidate;
+                        best_target = node;
+                        best_is_on_source_segment = false;
+                    }
+                }
+            }
+            for(unsigned edge = first_edge[node]; edge < first_edge[node+1]; ++edge) {
+                const int edge_duration = profiles.GetTravelTime(node, edges[edge].weight, departure + arrival);
+                const NodeID to = edges[edge].target;
+                if(RelaxEdge(heap, lane, node, to, arrival + edge_duration) && !source_labels.empty()) {
+                    SetSourceLabel(source_labels, to, UINT_MAX);
+                }
+            }
+        }
+
+        path.clear();
+        if(UINT_MAX == best_target) {
+            return true;
+        }
+        path.push_back(best_target);
+        if(!best_is_on_source_segment) {
+            NodeID node = best_target;
+            NodeID source_node = GetSourceLabel(source_labels, node);
+            while(UINT_MAX == source_node) {
+                node = heap.GetData(node).parent;
+                path.push_back(node);
+                source_node = GetSourceLabel(source_labels, node);
+            }
+            path.push_back(source_node);
+            source_offset = (source_node == source_nodes[0] ? source_offsets[0] : source_offsets[1]);
+        }
+        std::reverse(path.begin(), path.end());
+        return true;
+    }
+
+    //UINT_MAX as source removes the node, its label is no longer from a source
+    static void SetSourceLabel(std::vector<std::pair<NodeID, NodeID> > & source_labels, const NodeID node, const NodeID source) {
+        for(unsigned i = 0; i < source_labels.size(); ++i) {
+            if(node == source_labels[i].first) {
+                if(UINT_MAX == source) {
+                    source_labels.erase(source_labels.begin() + i);
+                } else {
+                    source_labels[i].second = source;
+                }
+                return;
+            }
+        }
+        if(UINT_MAX != source) {
+            source_labels.push_back(std::make_pair(node, source));
+        }
+    }
+
+    static NodeID GetSourceLabel(const std::vector<std::pair<NodeID, NodeID> > & source_labels, const NodeID node) {
+        for(unsigned i = 0; i < source_labels.size(); ++i) {
+            if(node == source_labels[i].first) {
+                return source_labels[i].second;
+            }
+        }
+        return UINT_MAX;
+    }
+
+    //Returns true if the label of to has been set or improved
+    inline bool RelaxEdge(
+        QueryHeap & heap,
+        const unsigned lane,
+        const NodeID from,
+        const NodeID to,
+        const int arrival
+    ) const {
+        const int lower_bound = GetLowerBound(lane, to);
+        if(ONE_TO_ALL_UNREACHED <= lower_bound) {
+            return false;
+        }
+        const int key = arrival + lower_bound;
+        if(!heap.WasInserted(to)) {
+            heap.Insert(to, key, from);
+            return true;
+        }
+        if(!heap.WasRemoved(to) && key < heap.GetKey(to)) {
+            heap.GetData(to).parent = from;
+            heap.DecreaseKey(to, key);
+            return true;
+        }
+        return false;
+    }
+
+    //Free flow distance to the target, scaled down if some profile is faster
+    inline int GetLowerBound(const unsigned lane, const NodeID node) const {
+        const int distance = lowerBounds.GetDistance(lowerBounds.GetPositionOfNode(node), lane);
+        if(ONE_TO_ALL_UNREACHED <= distance) {
+            return distance;
+        }
+        return ScaleToLowerBound(distance);
+    }
+
+    inline int ScaleToLowerBound(const int distance) const {
+        if(TRAVEL_TIME_FREE_FLOW_FACTOR <= profiles.GetMinimumFactor()) {
+            return distance;
+        }
+        return (int)(((long long)distance*profiles.GetMinimumFactor())/TRAVEL_TIME_FREE_FLOW_FACTOR);
+    }
+
+    //The first edge only counts from the source on, like in RouteLeg
+    void UnpackLeg(const std::vector<NodeID> & path, const int source_offset, const unsigned departure, std::vector<_PathData> & unpackedPath) const {
+        int arrival = 0;
+        for(unsigned i = 1; i < path.size(); ++i) {
+            const NodeID from = path[i-1];
+            const NodeID to = path[i];
+            unsigned best_edge = UINT_MAX;
+            int best_duration = INT_MAX;
+            for(unsigned edge = first_edge[from]; edge < first_edge[from+1]; ++edge) {
+                if(to != edges[edge].target) {
+                    continue;
+                }
+                const int weight = (1 == i ? std::max(0, edges[edge].weight - source_offset) : edges[edge].weight);
+                const int edge_duration = profiles.GetTravelTime(from, weight, departure + arrival);
+                if(edge_duration < best_duration) {
+                    best_duration = edge_duration;
+                    best_edge = edge;
+                }
+            }
+            BOOST_ASSERT_MSG(UINT_MAX != best_edge, "path contains no original edge");
+            const unsigned id = edges[best_edge].id;
+            unpackedPath.push_back(
+                _PathData(
+                    id,
+                    _queryData.nodeHelpDesk->getNameIndexFromEdgeID(id),
+                    _queryData.nodeHelpDesk->getTurnInstructionFromEdgeID(id),
+                    best_duration,
+                    from
+                )
+            );
+            arrival += best_duration;
+        }
+    }
+
+    //Every edge of the hierarchy that is not a shortcut is an edge of the
+    //edge-based graph. It is stored at its lower node with direction flags.
+    void CopyOriginalEdges() {
+        const Graph & graph = *(_queryData.graph);
+        const unsigned number_of_nodes = graph.GetNumberOfNodes();
+        std::vector<std::pair<NodeID, OriginalEdge> > edge_list;
+        for(NodeID node = 0; node < number_of_nodes; ++node) {
+            for(typename Graph::EdgeIterator edge = graph.BeginEdges(node); edge < graph.EndEdges(node); ++edge) {
+                const typename Graph::EdgeData & data = graph.GetEdgeData(edge);
+                if(data.shortcut) {
+                    continue;
+                }
+                const NodeID target = graph.GetTarget(edge);
+                if(data.forward) {
+                    edge_list.push_back(std::make_pair(node, OriginalEdge(target, data.distance, data.id)));
+                }
+                if(data.backward) {
+                    edge_list.push_back(std::make_pair(target, OriginalEdge(node, data.distance, data.id)));
+                }
+            }
+        }
+        first_edge.assign(number_of_nodes+1, 0);
+        for(unsigned i = 0; i < edge_list.size(); ++i) {
+            ++first_edge[edge_list[i].first+1];
+        }
+        for(unsigned i = 1; i < first_edge.size(); ++i) {
+            first_edge[i] += first_edge[i-1];
+        }
+        std::vector<unsigned> position(first_edge.begin(), first_edge.end()-1);
+        edges.resize(edge_list.size(), OriginalEdge(UINT_MAX, 0, UINT_MAX));
+        for(unsigned i = 0; i < edge_list.size(); ++i) {
+            edges[position[edge_list[i].first]++] = edge_list[i].second;
+        }
+        SimpleLogger().Write(logDEBUG) << "time dependent routing over " << edges.size() << " original edges";
+    }
+};
+
+#endif /* TIMEDEPENDENTROUTING_H_ */
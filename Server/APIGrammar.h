@@ -32,8 +32,9 @@ namespace qi = boost::spirit::qi;
 template <typename Iterator, class HandlerT>
 struct APIGrammar : qi::grammar<Iterator> {
     APIGrammar(HandlerT * h) : APIGrammar::base_type(api_call), handler(h) {
-        api_call = qi::lit('/') >> string[boost::bind(&HandlerT::setService, handler, ::_1)] >> *(query);
-        query    = ('?') >> (+(zoom | output | jsonp | checksum | location | hint | cmp | language | instruction | geometry | alt_route | old_API) ) ;
+        api_call = qi::lit('/') >> string[boost::bind(&HandlerT::setService, handler, ::_1)] >>
+                   -(qi::lit('/') >> string[boost::bind(&HandlerT::setProfileService, handler, ::_1)]) >> *(query);
+        query    = ('?') >> (+(zoom | output | jsonp | checksum | location | hint | cmp | language | instruction | geometry | alt_route | old_API | max_time | departure) ) ;
 
         zoom        = (-qi::lit('&')) >> qi::lit('z')            >> '=' >> qi::short_[boost::bind(&HandlerT::setZoomLevel, handler, ::_1)];
         output      = (-qi::lit('&')) >> qi::lit("output")       >> '=' >> string[boost::bind(&HandlerT::setOutputFormat, handler, ::_1)];
@@ -47,6 +48,8 @@ struct APIGrammar : qi::grammar<Iterator> {
         language    = (-qi::lit('&')) >> qi::lit("hl")           >> '=' >> string[boost::bind(&HandlerT::setLanguage, handler, ::_1)];
         alt_route   = (-qi::lit('&')) >> qi::lit("alt")          >> '=' >> qi::bool_[boost::bind(&HandlerT::setAlternateRouteFlag, handler, ::_1)];
         old_API     = (-qi::lit('&')) >> qi::lit("geomformat")   >> '=' >> string[boost::bind(&HandlerT::setDeprecatedAPIFlag, handler, ::_1)];
+        max_time    = (-qi::lit('&')) >> qi::lit("time")         >> '=' >> qi::uint_[boost::bind(&HandlerT::setMaxDuration, handler, ::_1)];
+        departure   = (-qi::lit('&')) >> qi::lit("departure")    >> '=' >> qi::uint_[boost::bind(&HandlerT::setDepartureTime, handler, ::_1)];
 
         string        = +(qi::char_("a-zA-Z"));
         stringwithDot = +(qi::char_("a-zA-Z0-9_.-"));
@@ -54,7 +57,7 @@ struct APIGrammar : qi::grammar<Iterator> {
     qi::rule<Iterator> api_call, query;
     qi::rule<Iterator, std::string()> service, zoom, output, string, jsonp, checksum, location, hint,
                                       stringwithDot, language, instruction, geometry,
-                                      cmp, alt_route, old_API;
+                                      cmp, alt_route, old_API, max_time, departure;
 
     HandlerT * handler;
 };
@@ -21,10 +21,12 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #ifndef BASIC_DATASTRUCTURES_H
 #define BASIC_DATASTRUCTURES_H
 
+#include "../DataStructures/SearchDeadline.h"
 #include "../Util/StringUtil.h"
 
 #include <boost/asio.hpp>
 #include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <string>
 #include <sstream>
@@ -42,6 +44,10 @@ const char internalServerErrorHTML[] = "<html><head><title>Internal Server Error
 const char seperators[]  			 = { ':', ' ' };
 const char crlf[]		             = { '\r', '\n' };
 
+//Replies are streamed to capable clients in pieces of at least this size.
+//Anything shorter is sent in one piece, with a Content-Length header.
+const unsigned STREAMING_CHUNK_SIZE  = 64*1024;
+
 struct Header {
   std::string name;
   std::string value;
@@ -58,14 +64,20 @@ enum CompressionType {
 } Compression;
 
 struct Request {
+	Request() : httpVersionMajor(1), httpVersionMinor(0) { }
 	std::string uri;
 	std::string referrer;
 	std::string agent;
 	boost::asio::ip::address endpoint;
+	boost::shared_ptr<SearchDeadline> deadline;
+	unsigned httpVersionMajor;
+	unsigned httpVersionMinor;
 };
 
+class ReplyStream;
+
 struct Reply {
-    Reply() : status(ok) { content.reserve(2 << 20); }
+    Reply() : status(ok), stream(NULL), isStreamed(false) { content.reserve(2 << 20); }
 	enum status_type {
 		ok 					= 200,
 		badRequest 		    = 400,
@@ -76,7 +88,12 @@ struct Reply {
     std::vector<boost::asio::const_buffer> toBuffers();
     std::vector<boost::asio::const_buffer> HeaderstoBuffers();
 	std::string content;
+	//set by the connection if the client accepts chunked replies
+	ReplyStream * stream;
+	bool isStreamed;
 	static Reply stockReply(status_type status);
+	//hands the content produced so far to the stream, once there is enough of it
+	inline void Flush();
 	void setSize(const unsigned size) {
 		BOOST_FOREACH ( Header& h,  headers) {
 			if("Content-Length" == h.name) {
@@ -87,6 +104,20 @@ struct Reply {
 	}
 };
 
+/// Receives the content of a reply piecewise, while it is still being produced.
+/// Headers have to be complete before the first call to Write().
+class ReplyStream {
+public:
+	virtual ~ReplyStream() { }
+	virtual void Write(Reply & reply) = 0;
+};
+
+inline void Reply::Flush() {
+	if(NULL != stream && STREAMING_CHUNK_SIZE <= content.size()) {
+		stream->Write(*this);
+	}
+}
+
 boost::asio::const_buffer ToBuffer(Reply::status_type status) {
 	switch (status) {
 	case Reply::ok:
@@ -0,0 +1,251 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef CHUNKED_REPLY_WRITER_H
+#define CHUNKED_REPLY_WRITER_H
+
+#include "BasicDatastructures.h"
+#include "../DataStructures/SearchDeadline.h"
+
+#include <boost/asio.hpp>
+#include <boost/foreach.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <poll.h>
+#include <zlib.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+
+#include <string>
+#include <vector>
+
+namespace http {
+
+const std::string chunkedOkString = "HTTP/1.1 200 OK\r\n";
+
+/// A client that accepts no data for this long is dropped
+static const int CHUNKED_REPLY_SEND_TIMEOUT_MS = 10000;
+/// How often a blocked write checks whether the request was cancelled
+static const int CHUNKED_REPLY_POLL_INTERVAL_MS = 100;
+
+/// Sends a reply with Transfer-Encoding: chunked while the plugin is still
+/// producing it. Writes happen on the thread that computes the reply, which
+/// is blocked on the query anyway. They are bounded by a send timeout, so a
+/// stalled client cannot hold on to the thread.
+template<class SocketT>
+class ChunkedReplyWriter : public ReplyStream, private boost::noncopyable {
+public:
+	explicit ChunkedReplyWriter(SocketT & s) :
+		socket(s),
+		compressionType(noCompression),
+		hasStarted(false),
+		hasFailed(false)
+	{ }
+
+	~ChunkedReplyWriter() {
+		if(hasStarted && noCompression != compressionType) {
+			deflateEnd(&zlibStream);
+		}
+	}
+
+	void SetCompression(const CompressionType type) {
+		assert(!hasStarted);
+		compressionType = type;
+	}
+
+	/// The search is cancelled if the client stops accepting data
+	void SetDeadline(boost::shared_ptr<SearchDeadline> d) {
+		deadline = d;
+	}
+
+	bool HasStarted() const {
+		return hasStarted;
+	}
+
+	bool HasFailed() const {
+		return hasFailed;
+	}
+
+	void Write(Reply & reply) {
+		//error replies are never streamed, they are short anyway
+		if(Reply::ok != reply.status) {
+			return;
+		}
+		if(!hasStarted) {
+			WriteHeaders(reply);
+		}
+		SendContent(reply.content, Z_SYNC_FLUSH);
+		reply.content.clear();
+	}
+
+	/// Sends the remaining content and the terminating zero-length chunk
+	void Finish(Reply & reply) {
+		assert(hasStarted);
+		SendContent(reply.content, Z_FINISH);
+		reply.content.clear();
+		WriteToSocket(boost::asio::buffer("0\r\n\r\n", 5));
+	}
+
+private:
+	void WriteHeaders(Reply & reply) {
+		hasStarted = true;
+		reply.isStreamed = true;
+
+		std::string headerString(chunkedOkString);
+		BOOST_FOREACH(const Header & h, reply.headers) {
+			//the length is unknown, that is the point of streaming
+			if(h.name.empty() || "Content-Length" == h.name) {
+				continue;
+			}
+			headerString += h.name + ": " + h.value + "\r\n";
+		}
+		InitializeZlibStream();
+		switch(compressionType) {
+		case deflateRFC1951:
+			headerString += "Content-Encoding: deflate\r\n";
+			deflateInit(&zlibStream, Z_BEST_SPEED);
+			break;
+		case gzipRFC1952:
+			headerString += "Content-Encoding: gzip\r\n";
+			deflateInit2(&zlibStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, (15+16), 9, Z_DEFAULT_STRATEGY);
+			break;
+		default:
+			break;
+		}
+		headerString += "Transfer-Encoding: chunked\r\n"
+			"Connection: close\r\n\r\n";
+		WriteToSocket(boost::asio::buffer(headerString));
+	}
+
+	void InitializeZlibStream() {
+		zlibStream.zalloc = Z_NULL;
+		zlibStream.zfree = Z_NULL;
+		zlibStream.opaque = Z_NULL;
+		zlibStream.total_out = 0;
+		zlibStream.data_type = Z_ASCII;
+	}
+
+	void SendContent(const std::string & content, const int flush) {
+		if(noCompression == compressionType) {
+			SendChunk(content.c_str(), content.length());
+			return;
+		}
+		//every chunk is a complete sync-flushed deflate block
+		compressedBuffer.clear();
+		zlibStream.next_in = (unsigned char *)(content.c_str());
+		zlibStream.avail_in = content.length();
+		unsigned char temp_buffer[16*1024];
+		int deflate_res = Z_OK;
+		do {
+			zlibStream.next_out = temp_buffer;
+			zlibStream.avail_out = sizeof(temp_buffer);
+			deflate_res = deflate(&zlibStream, flush);
+			compressedBuffer.insert(compressedBuffer.end(), temp_buffer, temp_buffer + sizeof(temp_buffer) - zlibStream.avail_out);
+		} while (0 == zlibStream.avail_out && Z_STREAM_END != deflate_res);
+		SendChunk((const char *)(&compressedBuffer[0]), compressedBuffer.size());
+	}
+
+	void SendChunk(const char * data, const std::size_t length) {
+		if(0 == length) {
+			return;
+		}
+		char chunkHeader[20];
+		const int chunkHeaderLength = snprintf(chunkHeader, sizeof(chunkHeader), "%lx\r\n", (unsigned long)length);
+		std::vector<boost::asio::const_buffer> buffers;
+		buffers.push_back(boost::asio::buffer(chunkHeader, chunkHeaderLength));
+		buffers.push_back(boost::asio::buffer(data, length));
+		buffers.push_back(boost::asio::buffer(crlf));
+		WriteToSocket(buffers);
+	}
+
+	template<class BufferSequenceT>
+	void WriteToSocket(const BufferSequenceT & buffers) {
+		WriteToSocket(std::vector<boost::asio::const_buffer>(buffers.begin(), buffers.end()));
+	}
+
+	void WriteToSocket(std::vector<boost::asio::const_buffer> buffers) {
+		if(hasFailed) {
+			return;
+		}
+		boost::system::error_code ec;
+		socket.non_blocking(true, ec);
+		while(!ec && !buffers.empty()) {
+			std::size_t bytesWritten = socket.write_some(buffers, ec);
+			if(boost::asio::error::would_block == ec) {
+				ec = boost::system::error_code();
+				if(!WaitUntilWritable()) {
+					ec = boost::asio::error::timed_out;
+				}
+				continue;
+			}
+			//drop what has been sent from the front of the sequence
+			while(!buffers.empty() && bytesWritten >= boost::asio::buffer_size(buffers.front())) {
+				bytesWritten -= boost::asio::buffer_size(buffers.front());
+				buffers.erase(buffers.begin());
+			}
+			if(!buffers.empty()) {
+				buffers.front() = buffers.front() + bytesWritten;
+			}
+		}
+		if(ec) {
+			hasFailed = true;
+			if(deadline) {
+				deadline->Cancel();
+			}
+		}
+	}
+
+	/// False if the client did not take data within the send timeout or the
+	/// request has been cancelled meanwhile
+	bool WaitUntilWritable() {
+		pollfd descriptor;
+		descriptor.fd = socket.native_handle();
+		descriptor.events = POLLOUT;
+		for(int waited = 0; waited < CHUNKED_REPLY_SEND_TIMEOUT_MS; waited += CHUNKED_REPLY_POLL_INTERVAL_MS) {
+			if(deadline && deadline->IsCancelled()) {
+				return false;
+			}
+			descriptor.revents = 0;
+			const int result = ::poll(&descriptor, 1, CHUNKED_REPLY_POLL_INTERVAL_MS);
+			if(0 > result && EINTR != errno) {
+				return false;
+			}
+			if(0 < result) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	SocketT & socket;
+	CompressionType compressionType;
+	z_stream zlibStream;
+	std::vector<unsigned char> compressedBuffer;
+	boost::shared_ptr<SearchDeadline> deadline;
+	bool hasStarted;
+	bool hasFailed;
+};
+
+} // namespace http
+
+#endif // CHUNKED_REPLY_WRITER_H
@@ -22,8 +22,10 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #define CONNECTION_H
 
 #include "BasicDatastructures.h"
+#include "ChunkedReplyWriter.h"
 #include "RequestHandler.h"
 #include "RequestParser.h"
+#include "../DataStructures/SearchDeadline.h"
 
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
@@ -38,18 +40,29 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 namespace http {
 
-/// Represents a single connection from a client.
-class Connection : public boost::enable_shared_from_this<Connection>, private boost::noncopyable {
+inline void SetRemoteAddress(boost::asio::ip::tcp::socket & socket, Request & request) {
+	request.endpoint = socket.remote_endpoint().address();
+}
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+/// Peers on a unix domain socket have no IP address, endpoint stays unspecified
+inline void SetRemoteAddress(boost::asio::local::stream_protocol::socket &, Request &) { }
+#endif
+
+/// Represents a single connection from a client, over TCP or a unix domain socket.
+template<class ProtocolT>
+class Connection : public boost::enable_shared_from_this<Connection<ProtocolT> >, private boost::noncopyable {
+	typedef typename ProtocolT::socket SocketT;
 public:
-	explicit Connection(boost::asio::io_service& io_service, RequestHandler& handler) : strand(io_service), TCPsocket(io_service), requestHandler(handler) {}
+	explicit Connection(boost::asio::io_service& io_service, RequestHandler& handler) : strand(io_service), clientSocket(io_service), chunkedWriter(clientSocket), requestHandler(handler) {}
 
-	boost::asio::ip::tcp::socket& socket() {
-		return TCPsocket;
+	SocketT& socket() {
+		return clientSocket;
 	}
 
 	/// Start the first asynchronous operation for the connection.
 	void start() {
-	    TCPsocket.async_read_some(boost::asio::buffer(incomingDataBuffer), strand.wrap( boost::bind(&Connection::handleRead, this->shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+	    clientSocket.async_read_some(boost::asio::buffer(incomingDataBuffer), strand.wrap( boost::bind(&Connection::handleRead, this->shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
 	}
 
 private:
@@ -67,8 +80,28 @@ private:
 				//					std::cout << "[debug] using deflate" << std::endl;
 				//				if(compressionType == noCompression)
 				//					std::cout << "[debug] no compression" << std::endl;
-			    request.endpoint = TCPsocket.remote_endpoint().address();
+			    SetRemoteAddress(clientSocket, request);
+				request.deadline.reset(new SearchDeadline());
+				//checked by the search itself, a hang up is noticed even if all io threads are busy
+				request.deadline->WatchPeer(clientSocket.native_handle());
+				//HTTP/1.1 clients receive long replies while they are being produced
+				if(1 < request.httpVersionMajor || (1 == request.httpVersionMajor && 1 <= request.httpVersionMinor)) {
+					chunkedWriter.SetCompression(compressionType);
+					chunkedWriter.SetDeadline(request.deadline);
+					reply.stream = &chunkedWriter;
+				}
 				requestHandler.handle_request(request, reply);
+				//the deadline may outlive this connection in shared replies
+				request.deadline->WatchPeer(-1);
+
+				if(chunkedWriter.HasStarted()) {
+					//after the first chunk, errors can only be signalled by closing early
+					if(Reply::ok == reply.status) {
+						chunkedWriter.Finish(reply);
+					}
+					handleWrite(boost::system::error_code());
+					return;
+				}
 
 				Header compressionHeader;
 				std::vector<unsigned char> compressed;
@@ -82,7 +115,7 @@ private:
 					reply.setSize(compressed.size());
 					outputBuffer = reply.HeaderstoBuffers();
 					outputBuffer.push_back(boost::asio::buffer(compressed));
-					boost::asio::async_write(TCPsocket, outputBuffer, strand.wrap( boost::bind(&Connection::handleWrite, this->shared_from_this(), boost::asio::placeholders::error)));
+					boost::asio::async_write(clientSocket, outputBuffer, strand.wrap( boost::bind(&Connection::handleWrite, this->shared_from_this(), boost::asio::placeholders::error)));
 					break;
 				case gzipRFC1952:
 					compressionHeader.name = "Content-Encoding";
@@ -92,17 +125,17 @@ private:
 					reply.setSize(compressed.size());
 					outputBuffer = reply.HeaderstoBuffers();
 					outputBuffer.push_back(boost::asio::buffer(compressed));
-					boost::asio::async_write(TCPsocket, outputBuffer, strand.wrap( boost::bind(&Connection::handleWrite, this->shared_from_this(), boost::asio::placeholders::error)));break;
+					boost::asio::async_write(clientSocket, outputBuffer, strand.wrap( boost::bind(&Connection::handleWrite, this->shared_from_this(), boost::asio::placeholders::error)));break;
 				case noCompression:
-					boost::asio::async_write(TCPsocket, reply.toBuffers(), strand.wrap( boost::bind(&Connection::handleWrite, this->shared_from_this(), boost::asio::placeholders::error)));
+					boost::asio::async_write(clientSocket, reply.toBuffers(), strand.wrap( boost::bind(&Connection::handleWrite, this->shared_from_this(), boost::asio::placeholders::error)));
 					break;
 				}
 
 			} else if (!result) {
 				reply = Reply::stockReply(Reply::badRequest);
-				boost::asio::async_write(TCPsocket, reply.toBuffers(), strand.wrap( boost::bind(&Connection::handleWrite, this->shared_from_this(), boost::asio::placeholders::error)));
+				boost::asio::async_write(clientSocket, reply.toBuffers(), strand.wrap( boost::bind(&Connection::handleWrite, this->shared_from_this(), boost::asio::placeholders::error)));
 			} else {
-				TCPsocket.async_read_some(boost::asio::buffer(incomingDataBuffer), strand.wrap( boost::bind(&Connection::handleRead, this->shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+				clientSocket.async_read_some(boost::asio::buffer(incomingDataBuffer), strand.wrap( boost::bind(&Connection::handleRead, this->shared_from_this(), boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
 			}
 		}
 	}
@@ -112,7 +145,7 @@ private:
 		if (!e) {
 			// Initiate graceful connection closure.
 			boost::system::error_code ignoredEC;
-			TCPsocket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignoredEC);
+			clientSocket.shutdown(boost::asio::socket_base::shutdown_both, ignoredEC);
 		}
 		// No new asynchronous operations are started. This means that all shared_ptr
 		// references to the connection object will disappear and the object will be
@@ -168,7 +201,8 @@ private:
 	}
 
 	boost::asio::io_service::strand strand;
-	boost::asio::ip::tcp::socket TCPsocket;
+	SocketT clientSocket;
+	ChunkedReplyWriter<SocketT> chunkedWriter;
 	RequestHandler& requestHandler;
 	boost::array<char, 8192> incomingDataBuffer;
 	Request request;
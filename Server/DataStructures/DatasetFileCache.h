@@ -0,0 +1,142 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef DATASETFILECACHE_H_
+#define DATASETFILECACHE_H_
+
+#include "../../DataStructures/Coordinate.h"
+#include "../../DataStructures/QueryNode.h"
+#include "../../Util/OSRMException.h"
+#include "../../Util/SimpleLogger.h"
+
+#include <boost/assert.hpp>
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Loads the parts of a dataset that do not depend on the profile, i.e. the
+ * street names and the node coordinates. Datasets of several profiles that
+ * were built from the same extract often have byte-identical files. These
+ * are recognized by size and checksum and loaded only once. The cache does
+ * not keep them alive, they go away with the last dataset using them.
+ */
+class DatasetFileCache : boost::noncopyable {
+public:
+    typedef boost::shared_ptr<std::vector<std::string> > NamesPtr;
+    typedef boost::shared_ptr<const std::vector<FixedPointCoordinate> > CoordinatesPtr;
+
+    NamesPtr GetNames(const std::string & names_filename) {
+        const FileKey key = GetFileKey(names_filename, "names");
+        boost::mutex::scoped_lock lock(cache_mutex);
+        NamesPtr names = names_cache[key].lock();
+        if(names) {
+            SimpleLogger().Write() << "sharing names with a dataset loaded before";
+            return names;
+        }
+        names.reset(new std::vector<std::string>());
+        LoadNames(names_filename, *names);
+        names_cache[key] = names;
+        return names;
+    }
+
+    CoordinatesPtr GetCoordinates(const std::string & nodes_filename) {
+        const FileKey key = GetFileKey(nodes_filename, "nodes");
+        boost::mutex::scoped_lock lock(cache_mutex);
+        CoordinatesPtr cached_coordinates = coordinates_cache[key].lock();
+        if(cached_coordinates) {
+            SimpleLogger().Write() << "sharing node coordinates with a dataset loaded before";
+            return cached_coordinates;
+        }
+        boost::shared_ptr<std::vector<FixedPointCoordinate> > coordinates(new std::vector<FixedPointCoordinate>());
+        LoadCoordinates(nodes_filename, *coordinates);
+        coordinates_cache[key] = coordinates;
+        return coordinates;
+    }
+
+private:
+    //file size and CRC32 of the content
+    typedef std::pair<boost::uintmax_t, unsigned> FileKey;
+
+    static FileKey GetFileKey(const std::string & filename, const std::string & description) {
+        boost::filesystem::path file(filename);
+        if ( !boost::filesystem::exists( file ) ) {
+            throw OSRMException(description + " file does not exist");
+        }
+        if ( 0 == boost::filesystem::file_size( file ) ) {
+            throw OSRMException(description + " file is empty");
+        }
+        boost::filesystem::ifstream input_stream(file, std::ios::binary);
+        boost::crc_32_type crc;
+        std::vector<char> buffer(1 << 16);
+        while(input_stream) {
+            input_stream.read(&buffer[0], buffer.size());
+            crc.process_bytes(&buffer[0], input_stream.gcount());
+        }
+        return std::make_pair(boost::filesystem::file_size(file), crc.checksum());
+    }
+
+    static void LoadNames(const std::string & names_filename, std::vector<std::string> & names) {
+        SimpleLogger().Write() << "Loading names index";
+        boost::filesystem::ifstream name_stream(boost::filesystem::path(names_filename), std::ios::binary);
+        unsigned size = 0;
+        name_stream.read((char *)&size, sizeof(unsigned));
+        BOOST_ASSERT_MSG(0 != size, "name file empty");
+
+        char buf[1024];
+        for( unsigned i = 0; i < size; ++i ) {
+            unsigned size_of_string = 0;
+            name_stream.read((char *)&size_of_string, sizeof(unsigned));
+            buf[size_of_string] = '\0'; // instead of memset
+            name_stream.read(buf, size_of_string);
+            names.push_back(buf);
+        }
+        std::vector<std::string>(names).swap(names);
+        BOOST_ASSERT_MSG(0 != names.size(), "could not load any names");
+        name_stream.close();
+    }
+
+    static void LoadCoordinates(const std::string & nodes_filename, std::vector<FixedPointCoordinate> & coordinates) {
+        SimpleLogger().Write(logDEBUG) << "Loading node data";
+        boost::filesystem::ifstream nodes_input_stream(boost::filesystem::path(nodes_filename), std::ios::binary);
+        NodeInfo b;
+        while(!nodes_input_stream.eof()) {
+            nodes_input_stream.read((char *)&b, sizeof(NodeInfo));
+            coordinates.push_back(FixedPointCoordinate(b.lat, b.lon));
+        }
+        std::vector<FixedPointCoordinate>(coordinates).swap(coordinates);
+        nodes_input_stream.close();
+    }
+
+    std::map<FileKey, boost::weak_ptr<std::vector<std::string> > > names_cache;
+    std::map<FileKey, boost::weak_ptr<const std::vector<FixedPointCoordinate> > > coordinates_cache;
+    boost::mutex cache_mutex;
+};
+
+#endif /* DATASETFILECACHE_H_ */
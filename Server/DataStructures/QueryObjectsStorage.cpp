@@ -25,11 +25,19 @@ QueryObjectsStorage::QueryObjectsStorage(
 	const std::string & hsgrPath,
 	const std::string & ramIndexPath,
 	const std::string & fileIndexPath,
+	const std::string & gridIndexPath,
+	const std::string & geometryPath,
 	const std::string & nodesPath,
 	const std::string & edgesPath,
 	const std::string & namesPath,
-	const std::string & timestampPath
-) {
+	const std::string & timestampPath,
+	const std::string & travelTimeProfilesPath,
+	DatasetFileCache & fileCache
+) :
+	sharedNames(fileCache.GetNames(namesPath)),
+	names(*sharedNames),
+	travelTimeProfiles(NULL)
+{
 	if( hsgrPath.empty() ) {
 		throw OSRMException("no hsgr file given in ini file");
 	}
@@ -45,9 +53,6 @@ QueryObjectsStorage::QueryObjectsStorage(
 	if( edgesPath.empty() ) {
 		throw OSRMException("no edges file given in ini file");
 	}
-	if( namesPath.empty() ) {
-		throw OSRMException("no names file given in ini file");
-	}
 
 	SimpleLogger().Write() << "loading graph data";
 	//Deserialize road network graph
@@ -87,39 +92,23 @@ QueryObjectsStorage::QueryObjectsStorage(
 	nodeHelpDesk = new NodeInformationHelpDesk(
 		ramIndexPath,
 		fileIndexPath,
-		nodesPath,
+		gridIndexPath,
+		geometryPath,
+		fileCache.GetCoordinates(nodesPath),
 		edgesPath,
 		n,
 		checkSum
 	);
 
-	//deserialize street name list
-	SimpleLogger().Write() << "Loading names index";
-	boost::filesystem::path names_file(namesPath);
-
-    if ( !boost::filesystem::exists( names_file ) ) {
-        throw OSRMException("names file does not exist");
-    }
-    if ( 0 == boost::filesystem::file_size( names_file ) ) {
-        throw OSRMException("names file is empty");
-    }
-
-	boost::filesystem::ifstream name_stream(names_file, std::ios::binary);
-	unsigned size = 0;
-	name_stream.read((char *)&size, sizeof(unsigned));
-	BOOST_ASSERT_MSG(0 != size, "name file empty");
-
-	char buf[1024];
-	for( unsigned i = 0; i < size; ++i ) {
-		unsigned size_of_string = 0;
-		name_stream.read((char *)&size_of_string, sizeof(unsigned));
-		buf[size_of_string] = '\0'; // instead of memset
-		name_stream.read(buf, size_of_string);
-		names.push_back(buf);
+	if(!travelTimeProfilesPath.empty()) {
+		SimpleLogger().Write() << "Loading travel time profiles";
+		travelTimeProfiles = new TravelTimeProfiles(travelTimeProfilesPath);
+		if(travelTimeProfiles->GetNumberOfNodes() != graph->GetNumberOfNodes()) {
+			delete travelTimeProfiles;
+			travelTimeProfiles = NULL;
+			throw OSRMException("travel time profiles do not match the graph");
+		}
 	}
-	std::vector<std::string>(names).swap(names);
-	BOOST_ASSERT_MSG(0 != names.size(), "could not load any names");
-	name_stream.close();
 	SimpleLogger().Write() << "All query data structures loaded";
 }
 
@@ -127,4 +116,5 @@ QueryObjectsStorage::~QueryObjectsStorage() {
 	//        delete names;
 	delete graph;
 	delete nodeHelpDesk;
+	delete travelTimeProfiles;
 }
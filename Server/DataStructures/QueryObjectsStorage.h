@@ -22,12 +22,14 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #ifndef QUERYOBJECTSSTORAGE_H_
 #define QUERYOBJECTSSTORAGE_H_
 
+#include "DatasetFileCache.h"
 #include "../../Util/GraphLoader.h"
 #include "../../Util/OSRMException.h"
 #include "../../Util/SimpleLogger.h"
 #include "../../DataStructures/NodeInformationHelpDesk.h"
 #include "../../DataStructures/QueryEdge.h"
 #include "../../DataStructures/StaticGraph.h"
+#include "../../DataStructures/TravelTimeProfiles.h"
 
 #include <boost/assert.hpp>
 #include <boost/filesystem.hpp>
@@ -42,8 +44,12 @@ struct QueryObjectsStorage {
     typedef QueryGraph::InputEdge               InputEdge;
 
     NodeInformationHelpDesk * nodeHelpDesk;
-    std::vector<std::string> names;
+    //names may be shared with the datasets of other profiles
+    DatasetFileCache::NamesPtr sharedNames;
+    std::vector<std::string> & names;
     QueryGraph * graph;
+    //NULL unless travel time profiles are configured
+    TravelTimeProfiles * travelTimeProfiles;
     std::string timestamp;
     unsigned checkSum;
 
@@ -51,10 +57,14 @@ struct QueryObjectsStorage {
         const std::string & hsgrPath,
         const std::string & ramIndexPath,
         const std::string & fileIndexPath,
+        const std::string & gridIndexPath,
+        const std::string & geometryPath,
         const std::string & nodesPath,
         const std::string & edgesPath,
         const std::string & namesPath,
-        const std::string & timestampPath
+        const std::string & timestampPath,
+        const std::string & travelTimeProfilesPath,
+        DatasetFileCache & fileCache
     );
 
     ~QueryObjectsStorage();
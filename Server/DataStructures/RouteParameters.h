@@ -23,10 +23,12 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 #include "../../DataStructures/Coordinate.h"
 #include "../../DataStructures/HashTable.h"
+#include "../../DataStructures/SearchDeadline.h"
 
 #include <boost/fusion/container/vector.hpp>
 #include <boost/fusion/sequence/intrinsic.hpp>
 #include <boost/fusion/include/at_c.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <string>
 #include <vector>
@@ -39,7 +41,10 @@ struct RouteParameters {
         geometry(true),
         compression(true),
         deprecatedAPI(false),
-        checkSum(-1) {}
+        checkSum(-1),
+        maxDuration(0),
+        departureTime(0),
+        deadline(new SearchDeadline()) {}
     short zoomLevel;
     bool printInstructions;
     bool alternateRoute;
@@ -47,12 +52,17 @@ struct RouteParameters {
     bool compression;
     bool deprecatedAPI;
     unsigned checkSum;
+    unsigned maxDuration;
+    //UNIX timestamp, zero for routing without travel time profiles
+    unsigned departureTime;
     std::string service;
+    std::string profile;
     std::string outputFormat;
     std::string jsonpParameter;
     std::string language;
     std::vector<std::string> hints;
     std::vector<FixedPointCoordinate> coordinates;
+    boost::shared_ptr<SearchDeadline> deadline;
     typedef HashTable<std::string, std::string>::const_iterator OptionsIterator;
 
     void setZoomLevel(const short i) {
@@ -73,6 +83,14 @@ struct RouteParameters {
         checkSum = c;
     }
 
+    void setMaxDuration(const unsigned seconds) {
+        maxDuration = seconds;
+    }
+
+    void setDepartureTime(const unsigned timestamp) {
+        departureTime = timestamp;
+    }
+
     void setInstructionFlag(const bool b) {
         printInstructions = b;
     }
@@ -81,6 +99,12 @@ struct RouteParameters {
         service = s;
     }
 
+    //In /car/viaroute the first path segment names the profile
+    void setProfileService( const std::string & s) {
+        profile = service;
+        service = s;
+    }
+
     void setOutputFormat(const std::string & s) {
         outputFormat = s;
     }
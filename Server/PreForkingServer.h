@@ -0,0 +1,147 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef PRE_FORKING_SERVER_H
+#define PRE_FORKING_SERVER_H
+
+#ifndef _WIN32
+
+#include "Server.h"
+#include "../Util/OSRMException.h"
+#include "../Util/SimpleLogger.h"
+
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <ctime>
+#include <map>
+
+//Workers dying faster than this are restarted with a delay to avoid fork loops
+static const time_t MIN_WORKER_LIFETIME_SECONDS = 1;
+
+//Master process of the pre-fork mode. The routing data and the listening
+//sockets are set up once in the master; each worker is a fork() of it that
+//shares these pages copy-on-write and runs its own thread pool.
+class PreForkingServer : private boost::noncopyable {
+public:
+    PreForkingServer(
+        Server * s,
+        const unsigned workers,
+        const sigset_t & signal_mask
+    ) :
+        server(s),
+        number_of_workers(workers),
+        worker_signal_mask(signal_mask)
+    { }
+
+    //Forks the workers and supervises them until SIGINT, SIGQUIT or SIGTERM
+    void Run() {
+        sigset_t wait_mask;
+        sigemptyset(&wait_mask);
+        sigaddset(&wait_mask, SIGINT);
+        sigaddset(&wait_mask, SIGQUIT);
+        sigaddset(&wait_mask, SIGTERM);
+        sigaddset(&wait_mask, SIGCHLD);
+        pthread_sigmask(SIG_BLOCK, &wait_mask, 0);
+
+        for(unsigned i = 0; i < number_of_workers; ++i) {
+            ForkWorker();
+        }
+        SimpleLogger().Write() << "started " << number_of_workers << " worker processes";
+
+        int sig = 0;
+        while(true) {
+            sigwait(&wait_mask, &sig);
+            if(SIGCHLD != sig) {
+                break;
+            }
+            ReapAndRestartWorkers();
+        }
+
+        SimpleLogger().Write() << "stopping " << workers.size() << " worker processes";
+        for(WorkerMap::const_iterator it = workers.begin(); it != workers.end(); ++it) {
+            kill(it->first, SIGTERM);
+        }
+        for(WorkerMap::const_iterator it = workers.begin(); it != workers.end(); ++it) {
+            waitpid(it->first, 0, 0);
+        }
+        workers.clear();
+    }
+
+private:
+    typedef std::map<pid_t, time_t> WorkerMap;
+
+    void ForkWorker() {
+        server->NotifyFork(boost::asio::io_service::fork_prepare);
+        const pid_t pid = fork();
+        if(0 > pid) {
+            server->NotifyFork(boost::asio::io_service::fork_parent);
+            throw OSRMException("could not fork worker process");
+        }
+        if(0 == pid) {
+            server->NotifyFork(boost::asio::io_service::fork_child);
+            //workers terminate on the default signal action
+            pthread_sigmask(SIG_SETMASK, &worker_signal_mask, 0);
+            server->Run();
+            _exit(0);
+        }
+        server->NotifyFork(boost::asio::io_service::fork_parent);
+        workers.insert(std::make_pair(pid, time(0)));
+    }
+
+    void ReapAndRestartWorkers() {
+        int status = 0;
+        pid_t pid;
+        while(0 < (pid = waitpid(-1, &status, WNOHANG))) {
+            WorkerMap::iterator it = workers.find(pid);
+            if(workers.end() == it) {
+                continue;
+            }
+            const time_t lifetime = time(0) - it->second;
+            workers.erase(it);
+
+            if(WIFSIGNALED(status)) {
+                SimpleLogger().Write(logWARNING) <<
+                    "worker " << pid << " killed by signal " << WTERMSIG(status);
+            } else {
+                SimpleLogger().Write(logWARNING) <<
+                    "worker " << pid << " exited with status " << WEXITSTATUS(status);
+            }
+            if(lifetime < MIN_WORKER_LIFETIME_SECONDS) {
+                sleep(MIN_WORKER_LIFETIME_SECONDS);
+            }
+            ForkWorker();
+        }
+    }
+
+    Server * server;
+    const unsigned number_of_workers;
+    const sigset_t worker_signal_mask;
+    WorkerMap workers;
+};
+
+#endif // _WIN32
+
+#endif // PRE_FORKING_SERVER_H
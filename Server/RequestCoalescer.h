@@ -0,0 +1,315 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, others 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#ifndef REQUEST_COALESCER_H
+#define REQUEST_COALESCER_H
+
+#include "BasicDatastructures.h"
+#include "DataStructures/RouteParameters.h"
+#include "../DataStructures/SearchDeadline.h"
+#include "../Util/StringUtil.h"
+
+#include <boost/foreach.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+//Upper bound on distinct queries that are tracked at the same time
+static const unsigned MAX_COALESCED_QUERIES = 1024;
+//Replies larger than this are not handed on to waiting requests
+static const unsigned MAX_COALESCED_REPLY_SIZE = 16 << 20;
+//Waiting requests give up and compute on their own after this long
+static const unsigned MAX_COALESCING_WAIT_MS = 5000;
+//How often waiting requests check their own deadline
+static const unsigned COALESCING_POLL_INTERVAL_MS = 50;
+
+//Single-flight execution of identical queries. The first request for a
+//given key computes the reply, requests that arrive with the same key
+//while it is running wait for it and receive a copy of its reply.
+class RequestCoalescer : private boost::noncopyable {
+public:
+    typedef boost::function<void (http::Reply &)> QueryFunction;
+
+    RequestCoalescer() : max_wait_ms(MAX_COALESCING_WAIT_MS) { }
+
+    void SetMaximumWait(const unsigned milliseconds) {
+        if(0 < milliseconds) {
+            max_wait_ms = milliseconds;
+        }
+    }
+
+    //Everything that influences the reply, but nothing that identifies the client
+    static std::string GetNormalizedKey(const RouteParameters & parameters) {
+        std::string key(parameters.profile);
+        std::string tmp;
+        key += '/';
+        key += parameters.service;
+        key += '|';
+        key += parameters.outputFormat;
+        key += '|';
+        key += parameters.jsonpParameter;
+        key += '|';
+        key += parameters.language;
+        key += '|';
+        intToString(parameters.zoomLevel, tmp);
+        key += tmp;
+        key += (parameters.printInstructions ? 'i' : '-');
+        key += (parameters.alternateRoute    ? 'a' : '-');
+        key += (parameters.geometry          ? 'g' : '-');
+        key += (parameters.compression       ? 'c' : '-');
+        key += (parameters.deprecatedAPI     ? 'd' : '-');
+        key += '|';
+        intToString(parameters.checkSum, tmp);
+        key += tmp;
+        key += '|';
+        intToString(parameters.maxDuration, tmp);
+        key += tmp;
+        key += '|';
+        intToString(parameters.departureTime, tmp);
+        key += tmp;
+        BOOST_FOREACH(const FixedPointCoordinate & coordinate, parameters.coordinates) {
+            key += '|';
+            intToString(coordinate.lat, tmp);
+            key += tmp;
+            key += ',';
+            intToString(coordinate.lon, tmp);
+            key += tmp;
+        }
+        BOOST_FOREACH(const std::string & hint, parameters.hints) {
+            key += '|';
+            key += hint;
+        }
+        return key;
+    }
+
+    void Run(
+        const std::string & key,
+        const SearchDeadline & deadline,
+        QueryFunction query_function,
+        http::Reply & reply
+    ) {
+        InFlightQueryPtr query;
+        bool is_leader = false;
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            InFlightMap::iterator it = in_flight_queries.find(key);
+            if(in_flight_queries.end() != it) {
+                query = it->second;
+                ++query->number_of_waiters;
+            } else if(in_flight_queries.size() < MAX_COALESCED_QUERIES) {
+                query.reset(new InFlightQuery());
+                in_flight_queries.insert(std::make_pair(key, query));
+                is_leader = true;
+            }
+        }
+
+        if(!query) {
+            //too many distinct queries in flight, do not track this one
+            query_function(reply);
+            return;
+        }
+
+        if(is_leader) {
+            //streamed pieces are sent and dropped, keep a copy for the waiters
+            RecordingStream recording_stream(reply.stream);
+            if(NULL != reply.stream) {
+                reply.stream = &recording_stream;
+            }
+            try {
+                query_function(reply);
+            } catch(...) {
+                reply.stream = recording_stream.GetStream();
+                Publish(key, query, std::string(), reply, false);
+                throw;
+            }
+            reply.stream = recording_stream.GetStream();
+            //a reply to a client that has gone away may be incomplete, and one
+            //that ran out of time reports a timeout the waiters did not cause
+            Publish(
+                key,
+                query,
+                recording_stream.GetRecordedContent(),
+                reply,
+                !deadline.HasExpired() && !recording_stream.HasOverflown()
+            );
+            return;
+        }
+
+        bool reply_is_available = false;
+        bool is_cancelled = false;
+        {
+            //waiters only lock their own query, never the whole coalescer
+            boost::mutex::scoped_lock lock(query->mutex);
+            const boost::system_time timeout = boost::get_system_time() +
+                boost::posix_time::milliseconds(max_wait_ms);
+            while(!query->is_finished) {
+                //the deadline may poll the client's socket, check it unlocked
+                lock.unlock();
+                const bool has_expired = deadline.HasExpired();
+                lock.lock();
+                if(query->is_finished) {
+                    break;
+                }
+                //a waiter whose own time is up or whose client is gone stops waiting
+                if(has_expired) {
+                    is_cancelled = deadline.IsCancelled();
+                    break;
+                }
+                const boost::system_time poll_time = std::min(
+                    timeout,
+                    boost::get_system_time() + boost::posix_time::milliseconds(COALESCING_POLL_INTERVAL_MS)
+                );
+                if(!query->finished_condition.timed_wait(lock, poll_time) && timeout <= poll_time) {
+                    break;
+                }
+            }
+            reply_is_available = query->is_finished && query->is_shareable;
+        }
+
+        //the shared reply is immutable once finished, copy it without the lock
+        if(reply_is_available) {
+            reply.status = query->status;
+            reply.headers = query->headers;
+            reply.content = query->content;
+        } else if(is_cancelled) {
+            //nobody is left to receive a reply
+            reply = http::Reply::stockReply(http::Reply::internalServerError);
+        } else {
+            //an expired deadline makes the query report the timeout right away
+            query_function(reply);
+        }
+    }
+
+private:
+    struct InFlightQuery {
+        InFlightQuery() :
+            status(http::Reply::ok),
+            number_of_waiters(0),
+            is_finished(false),
+            is_shareable(false)
+        { }
+        //guards is_finished and is_shareable, the rest is set before them
+        boost::mutex mutex;
+        boost::condition finished_condition;
+        //not an http::Reply, which would preallocate its content buffer
+        http::Reply::status_type status;
+        std::vector<http::Header> headers;
+        std::string content;
+        unsigned number_of_waiters;
+        bool is_finished;
+        bool is_shareable;
+    };
+    typedef boost::shared_ptr<InFlightQuery> InFlightQueryPtr;
+    typedef boost::unordered_map<std::string, InFlightQueryPtr> InFlightMap;
+
+    //Forwards to the connection's stream and records what it has sent, as
+    //long as the reply stays small enough to be shared
+    class RecordingStream : public http::ReplyStream {
+    public:
+        explicit RecordingStream(http::ReplyStream * s) : stream(s), has_overflown(false) { }
+
+        void Write(http::Reply & reply) {
+            const std::string::size_type previous_size = recorded_content.size();
+            if(!has_overflown) {
+                if(previous_size + reply.content.size() > MAX_COALESCED_REPLY_SIZE) {
+                    has_overflown = true;
+                    std::string().swap(recorded_content);
+                } else {
+                    recorded_content += reply.content;
+                }
+            }
+            stream->Write(reply);
+            //content the stream did not take is still part of the reply
+            if(!has_overflown && !reply.content.empty()) {
+                recorded_content.resize(previous_size);
+            }
+        }
+
+        http::ReplyStream * GetStream() const {
+            return stream;
+        }
+
+        const std::string & GetRecordedContent() const {
+            return recorded_content;
+        }
+
+        bool HasOverflown() const {
+            return has_overflown;
+        }
+
+    private:
+        http::ReplyStream * stream;
+        std::string recorded_content;
+        bool has_overflown;
+    };
+
+    //streamed_content is what has been streamed before the rest of the reply
+    void Publish(
+        const std::string & key,
+        InFlightQueryPtr query,
+        const std::string & streamed_content,
+        const http::Reply & reply,
+        const bool reply_is_shareable
+    ) {
+        bool has_waiters = false;
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            //no request can join once the entry is gone from the map
+            in_flight_queries.erase(key);
+            has_waiters = (0 < query->number_of_waiters);
+        }
+        const bool is_shareable =
+            reply_is_shareable &&
+            has_waiters &&
+            (streamed_content.size() + reply.content.size() <= MAX_COALESCED_REPLY_SIZE);
+        if(is_shareable) {
+            query->status = reply.status;
+            query->headers = reply.headers;
+            query->content = streamed_content + reply.content;
+            //the plugin only counted what was left after streaming
+            std::string content_length;
+            intToString(query->content.size(), content_length);
+            BOOST_FOREACH(http::Header & header, query->headers) {
+                if("Content-Length" == header.name) {
+                    header.value = content_length;
+                }
+            }
+        }
+        boost::mutex::scoped_lock lock(query->mutex);
+        query->is_shareable = is_shareable;
+        query->is_finished = true;
+        query->finished_condition.notify_all();
+    }
+
+    //guards the map and the waiter counts
+    boost::mutex m_mutex;
+    InFlightMap in_flight_queries;
+    unsigned max_wait_ms;
+};
+
+#endif // REQUEST_COALESCER_H
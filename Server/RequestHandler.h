@@ -23,12 +23,14 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 #include "APIGrammar.h"
 #include "BasicDatastructures.h"
+#include "RequestCoalescer.h"
 #include "DataStructures/RouteParameters.h"
 #include "../Library/OSRM.h"
 #include "../Util/SimpleLogger.h"
 #include "../Util/StringUtil.h"
 #include "../typedefs.h"
 
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/noncopyable.hpp>
 
@@ -40,7 +42,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 class RequestHandler : private boost::noncopyable {
 public:
     typedef APIGrammar<std::string::iterator, RouteParameters> APIGrammarParser;
-    explicit RequestHandler() { }
+    explicit RequestHandler() : query_timeout(0) { }
 
     void handle_request(const http::Request& req, http::Reply& rep){
         //parse command
@@ -89,8 +91,19 @@ public:
                 }
                 rep.content += "^<br></pre>";
             } else {
-                //parsing done, lets call the right plugin to handle the request
-                routing_machine->RunQuery(routeParameters, rep);
+                //the search observes the connection's deadline, if it has one
+                if(req.deadline) {
+                    routeParameters.deadline = req.deadline;
+                }
+                routeParameters.deadline->ExpireAfter(query_timeout);
+                //parsing done, lets call the right plugin to handle the request.
+                //Identical queries that are already running are joined.
+                coalescer.Run(
+                    RequestCoalescer::GetNormalizedKey(routeParameters),
+                    *routeParameters.deadline,
+                    boost::bind(&OSRM::RunQuery, routing_machine, boost::ref(routeParameters), _1),
+                    rep
+                );
                 return;
             }
         } catch(std::exception& e) {
@@ -105,8 +118,16 @@ public:
         routing_machine = osrm;
     }
 
+    //Queries running longer than this are aborted, 0 disables the limit
+    void SetQueryTimeout(const unsigned milliseconds) {
+        query_timeout = milliseconds;
+        coalescer.SetMaximumWait(milliseconds);
+    }
+
 private:
     OSRM * routing_machine;
+    RequestCoalescer coalescer;
+    unsigned query_timeout;
 };
 
 #endif // REQUEST_HANDLER_H
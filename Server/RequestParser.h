@@ -118,6 +118,7 @@ private:
             }
         case http_version_major_start:
             if (isDigit(input)) {
+                req.httpVersionMajor = input - '0';
                 state_ = http_version_major;
                 return boost::indeterminate;
             } else {
@@ -128,12 +129,14 @@ private:
                 state_ = http_version_minor_start;
                 return boost::indeterminate;
             } else if (isDigit(input)) {
+                req.httpVersionMajor = 10*req.httpVersionMajor + (input - '0');
                 return boost::indeterminate;
             } else {
                 return false;
             }
         case http_version_minor_start:
             if (isDigit(input)) {
+                req.httpVersionMinor = input - '0';
                 state_ = http_version_minor;
                 return boost::indeterminate;
             } else {
@@ -144,6 +147,7 @@ private:
                 state_ = expecting_newline_1;
                 return boost::indeterminate;
             } else if (isDigit(input)) {
+                req.httpVersionMinor = 10*req.httpVersionMinor + (input - '0');
                 return boost::indeterminate;
             }
             else {
@@ -23,6 +23,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 #include "Connection.h"
 #include "RequestHandler.h"
+#include "../Util/OSRMException.h"
 
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
@@ -30,20 +31,43 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
+#include <string>
 #include <vector>
 
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
 class Server: private boost::noncopyable {
+	typedef http::Connection<boost::asio::ip::tcp> TCPConnection;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+	typedef http::Connection<boost::asio::local::stream_protocol> LocalConnection;
+#endif
 public:
-	explicit Server(
-		const std::string& address,
-		const std::string& port,
-		unsigned thread_pool_size
-	) :
+	explicit Server(unsigned thread_pool_size) :
 		threadPoolSize(thread_pool_size),
 		acceptor(ioService),
-		newConnection(new http::Connection(ioService, requestHandler)),
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+		localAcceptor(ioService),
+#endif
 		requestHandler()
-	{
+	{ }
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+	~Server() {
+		//forked workers share the socket, only the process that bound it removes it
+		if(!socketPath.empty() && getpid() == socketOwnerPid) {
+			::unlink(socketPath.c_str());
+		}
+	}
+#endif
+
+	void ListenOnTCP(
+		const std::string& address,
+		const std::string& port
+	) {
 		boost::asio::ip::tcp::resolver resolver(ioService);
 		boost::asio::ip::tcp::resolver::query query(address, port);
 		boost::asio::ip::tcp::endpoint endpoint = *resolver.resolve(query);
@@ -52,16 +76,22 @@ public:
 		acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
 		acceptor.bind(endpoint);
 		acceptor.listen();
-		acceptor.async_accept(
-			newConnection->socket(),
-			boost::bind(
-				&Server::handleAccept,
-				this,
-				boost::asio::placeholders::error
-			)
-		);
+		acceptNextTCPConnection();
 	}
 
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+	void ListenOnUnixSocket(const std::string& socket_path) {
+		boost::asio::local::stream_protocol::endpoint endpoint(socket_path);
+		RemoveStaleSocket(endpoint);
+		localAcceptor.open(endpoint.protocol());
+		localAcceptor.bind(endpoint);
+		localAcceptor.listen();
+		socketPath = socket_path;
+		socketOwnerPid = getpid();
+		acceptNextLocalConnection();
+	}
+#endif
+
 	void Run() {
 		std::vector<boost::shared_ptr<boost::thread> > threads;
 		for (unsigned i = 0; i < threadPoolSize; ++i) {
@@ -76,32 +106,90 @@ public:
 		ioService.stop();
 	}
 
+	/// Must be called around fork(), the io_service has to recreate its reactor in the child
+	void NotifyFork(boost::asio::io_service::fork_event event) {
+		ioService.notify_fork(event);
+	}
+
 	RequestHandler & GetRequestHandlerPtr() {
 		return requestHandler;
 	}
 
 private:
+	void acceptNextTCPConnection() {
+		newConnection.reset(
+			new TCPConnection(ioService, requestHandler)
+		);
+		acceptor.async_accept(
+			newConnection->socket(),
+			boost::bind(
+				&Server::handleAccept,
+				this,
+				boost::asio::placeholders::error
+			)
+		);
+	}
+
 	void handleAccept(const boost::system::error_code& e) {
 		if (!e) {
 			newConnection->start();
-			newConnection.reset(
-				new http::Connection(ioService, requestHandler)
-			);
-			acceptor.async_accept(
-				newConnection->socket(),
-				boost::bind(
-					&Server::handleAccept,
-					this,
-					boost::asio::placeholders::error
-				)
-			);
+			acceptNextTCPConnection();
+		}
+	}
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+	/// A socket file left behind by an earlier run would make bind() fail.
+	/// Nothing else is removed, and neither is a socket another server answers on.
+	void RemoveStaleSocket(const boost::asio::local::stream_protocol::endpoint & endpoint) {
+		const std::string socket_path = endpoint.path();
+		struct stat file_status;
+		if(0 != ::lstat(socket_path.c_str(), &file_status)) {
+			return;
+		}
+		if(!S_ISSOCK(file_status.st_mode)) {
+			throw OSRMException(socket_path + " exists and is not a socket");
+		}
+		boost::asio::local::stream_protocol::socket probe(ioService);
+		boost::system::error_code ec;
+		probe.connect(endpoint, ec);
+		if(!ec) {
+			throw OSRMException("another server is listening on " + socket_path);
+		}
+		::unlink(socket_path.c_str());
+	}
+
+	void acceptNextLocalConnection() {
+		newLocalConnection.reset(
+			new LocalConnection(ioService, requestHandler)
+		);
+		localAcceptor.async_accept(
+			newLocalConnection->socket(),
+			boost::bind(
+				&Server::handleLocalAccept,
+				this,
+				boost::asio::placeholders::error
+			)
+		);
+	}
+
+	void handleLocalAccept(const boost::system::error_code& e) {
+		if (!e) {
+			newLocalConnection->start();
+			acceptNextLocalConnection();
 		}
 	}
+#endif
 
 	unsigned threadPoolSize;
 	boost::asio::io_service ioService;
 	boost::asio::ip::tcp::acceptor acceptor;
-	boost::shared_ptr<http::Connection> newConnection;
+	boost::shared_ptr<TCPConnection> newConnection;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+	boost::asio::local::stream_protocol::acceptor localAcceptor;
+	boost::shared_ptr<LocalConnection> newLocalConnection;
+	std::string socketPath;
+	pid_t socketOwnerPid;
+#endif
 	RequestHandler requestHandler;
 };
 
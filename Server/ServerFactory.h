@@ -23,6 +23,7 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 #include "Server.h"
 #include "../Util/IniFile.h"
+#include "../Util/OSRMException.h"
 #include "../Util/SimpleLogger.h"
 #include "../Util/StringUtil.h"
 
@@ -30,9 +31,18 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 #include <boost/noncopyable.hpp>
 
+#include <string>
+
 struct ServerFactory : boost::noncopyable {
 	static Server * CreateServer( IniFile & serverConfig ) {
 		int threads = omp_get_num_procs();
+		//a unix socket alone replaces TCP, unless IP or Port are given as well
+		const std::string socket_path = serverConfig.GetParameter("Socket");
+		const bool listen_on_tcp =
+			socket_path.empty() ||
+			!serverConfig.GetParameter("IP").empty() ||
+			!serverConfig.GetParameter("Port").empty();
+
 		if( serverConfig.GetParameter("IP").empty() ) {
 			serverConfig.SetParameter("IP", "0.0.0.0");
 		}
@@ -51,11 +61,28 @@ struct ServerFactory : boost::noncopyable {
 		SimpleLogger().Write() <<
 			"http 1.1 compression handled by zlib version " << zlibVersion();
 
-		Server * server = new Server(
-			serverConfig.GetParameter("IP"),
-			serverConfig.GetParameter("Port"),
-			threads
-		);
+		Server * server = new Server(threads);
+		if( listen_on_tcp ) {
+			server->ListenOnTCP(
+				serverConfig.GetParameter("IP"),
+				serverConfig.GetParameter("Port")
+			);
+		}
+		if( !socket_path.empty() ) {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+			SimpleLogger().Write() << "listening on unix socket " << socket_path;
+			server->ListenOnUnixSocket(socket_path);
+#else
+			throw OSRMException("unix domain sockets are not supported on this platform");
+#endif
+		}
+
+		if( 0 < stringToInt(serverConfig.GetParameter("QueryTimeout")) ) {
+			const unsigned query_timeout = stringToInt(serverConfig.GetParameter("QueryTimeout"));
+			SimpleLogger().Write() <<
+				"aborting queries after " << query_timeout << " ms";
+			server->GetRequestHandlerPtr().SetQueryTimeout(query_timeout);
+		}
 		return server;
 	}
 
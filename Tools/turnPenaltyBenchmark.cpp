@@ -0,0 +1,108 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+
+#include "../Contractor/TurnPenaltyEvaluator.h"
+#include "../Util/LuaUtil.h"
+#include "../Util/OSRMException.h"
+#include "../Util/SimpleLogger.h"
+#include "../Util/TimingUtil.h"
+
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+//Compares the ways of evaluating turn_function of a profile on random turns
+int main (int argc, char * argv[]) {
+    LogPolicy::GetInstance().Unmute();
+    if(argc < 2) {
+        SimpleLogger().Write(logWARNING) <<
+            "usage:\n" << argv[0] << " <profile.lua> [number of turns]";
+        return -1;
+    }
+    try {
+        const unsigned number_of_turns = (
+            argc > 2 ? boost::lexical_cast<unsigned>(argv[2]) : 10000000
+        );
+
+        lua_State *myLuaState = luaL_newstate();
+        luabind::open(myLuaState);
+        luaL_openlibs(myLuaState);
+        luaAddScriptFolderToLoadPath( myLuaState, argv[1] );
+        if(0 != luaL_dofile(myLuaState, argv[1])) {
+            throw OSRMException(lua_tostring(myLuaState,-1));
+        }
+        if(!lua_function_exists(myLuaState, "turn_function")) {
+            throw OSRMException("profile has no turn_function");
+        }
+
+        //angles between three coordinates are not quantized, neither are these
+        std::vector<double> turn_angles(number_of_turns);
+        std::srand(1);
+        for(unsigned i = 0; i < number_of_turns; ++i) {
+            turn_angles[i] = 360.*std::rand()/RAND_MAX - 180.;
+        }
+
+        std::vector<int> exact_penalties(number_of_turns);
+        double time = get_timestamp();
+        TurnPenaltyEvaluator per_turn(myLuaState, TurnPenaltyEvaluator::PER_TURN);
+        for(unsigned i = 0; i < number_of_turns; ++i) {
+            exact_penalties[i] = per_turn.GetPenalty(turn_angles[i]);
+        }
+        SimpleLogger().Write() << "per turn: " << (get_timestamp() - time) << "s";
+
+        time = get_timestamp();
+        TurnPenaltyEvaluator batch(myLuaState, TurnPenaltyEvaluator::BATCH);
+        std::vector<double> batch_angles;
+        std::vector<int> batch_penalties;
+        unsigned batch_mismatches = 0;
+        for(unsigned begin = 0; begin < number_of_turns; begin += TURN_PENALTY_BATCH_SIZE) {
+            const unsigned end = std::min(number_of_turns, begin + TURN_PENALTY_BATCH_SIZE);
+            batch_angles.assign(turn_angles.begin()+begin, turn_angles.begin()+end);
+            batch.GetPenalties(batch_angles, batch_penalties);
+            for(unsigned i = begin; i < end; ++i) {
+                batch_mismatches += (batch_penalties[i-begin] != exact_penalties[i]);
+            }
+        }
+        SimpleLogger().Write() << "batch: " << (get_timestamp() - time) << "s, " <<
+            batch_mismatches << " penalties differ";
+
+        time = get_timestamp();
+        TurnPenaltyEvaluator table(myLuaState, TurnPenaltyEvaluator::TABLE);
+        int max_difference = 0;
+        double sum_of_differences = 0.;
+        for(unsigned i = 0; i < number_of_turns; ++i) {
+            const int difference = std::abs(table.GetPenalty(turn_angles[i]) - exact_penalties[i]);
+            max_difference = std::max(max_difference, difference);
+            sum_of_differences += difference;
+        }
+        SimpleLogger().Write() << "table: " << (get_timestamp() - time) << "s, " <<
+            "max. difference " << max_difference << ", mean difference " <<
+            sum_of_differences/std::max(1u, number_of_turns);
+
+        lua_close(myLuaState);
+    } catch (const std::exception & e) {
+        SimpleLogger().Write(logWARNING) << "[exception] " << e.what();
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#include "../../DataStructures/ConcurrentBitmap.h"
+#include "../../Util/OpenMPWrapper.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+static const int TEST_NUMBER_OF_IDS = 2000000;
+static const int TEST_NUMBER_OF_PROBES = 1000000;
+
+//Random ids, a third of them dense in a few pages, including the extremes
+static std::vector<unsigned> GenerateIds() {
+    std::vector<unsigned> ids;
+    unsigned random = 12345;
+    for(int i = 0; i < TEST_NUMBER_OF_IDS; ++i) {
+        random = random*1103515245 + 12345;
+        ids.push_back(0 == i%3 ? random%100000 : random);
+    }
+    ids.push_back(0);
+    ids.push_back(UINT_MAX);
+    return ids;
+}
+
+//Sets the ids from racing threads that share pages and words
+struct BitmapFixture {
+    BitmapFixture() : ids(GenerateIds()) {
+#pragma omp parallel for schedule ( guided )
+        for(int i = 0; i < (int)ids.size(); ++i) {
+            bitmap.Set(ids[i]);
+        }
+    }
+
+    std::vector<unsigned> ids;
+    ConcurrentBitmap bitmap;
+};
+
+BOOST_FIXTURE_TEST_SUITE(concurrent_bitmap, BitmapFixture)
+
+BOOST_AUTO_TEST_CASE(keeps_every_id) {
+    unsigned missing_ids = 0;
+    for(unsigned i = 0; i < ids.size(); ++i) {
+        missing_ids += !bitmap.IsSet(ids[i]);
+    }
+    BOOST_CHECK_EQUAL(0u, missing_ids);
+}
+
+BOOST_AUTO_TEST_CASE(probes_agree_with_ids) {
+    std::sort(ids.begin(), ids.end());
+    unsigned wrong_probes = 0;
+    unsigned random = 999;
+    for(int i = 0; i < TEST_NUMBER_OF_PROBES; ++i) {
+        random = random*69069 + 1;
+        const unsigned probe = (0 == i%2 ? random : random%100000);
+        wrong_probes += (bitmap.IsSet(probe) != std::binary_search(ids.begin(), ids.end(), probe));
+    }
+    BOOST_CHECK_EQUAL(0u, wrong_probes);
+}
+
+BOOST_AUTO_TEST_CASE(clear_unsets_every_id) {
+    bitmap.Clear();
+    unsigned ids_after_clear = 0;
+    for(unsigned i = 0; i < ids.size(); ++i) {
+        ids_after_clear += bitmap.IsSet(ids[i]);
+    }
+    BOOST_CHECK_EQUAL(0u, ids_after_clear);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,160 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#include "../../DataStructures/ConcurrentQueue.h"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+#include <climits>
+#include <vector>
+
+static const unsigned TEST_NUMBER_OF_PRODUCERS = 4;
+static const unsigned TEST_NUMBER_OF_CONSUMERS = 4;
+static const unsigned TEST_ITEMS_PER_PRODUCER = 200000;
+static const unsigned TEST_BATCH_SIZE = 37;
+//a small ring makes producers and consumers block often
+static const unsigned TEST_QUEUE_SIZE = 64;
+//items carry their producer in the upper bits and their number in the lower
+static const unsigned TEST_PRODUCER_SHIFT = 24;
+static const unsigned TEST_END_OF_INPUT = UINT_MAX;
+
+typedef ConcurrentQueue<unsigned> TestQueue;
+
+static volatile int finished_consumers = 0;
+
+//Every producer alternates between single and batched pushes
+static void Produce(TestQueue * queue, const unsigned producer) {
+    std::vector<unsigned> batch;
+    for(unsigned item = 0; item < TEST_ITEMS_PER_PRODUCER; ) {
+        const unsigned encoded_item = (producer << TEST_PRODUCER_SHIFT) | item;
+        if(0 == (item/TEST_BATCH_SIZE)%2) {
+            queue->push(encoded_item);
+            ++item;
+            continue;
+        }
+        batch.clear();
+        for(; item < TEST_ITEMS_PER_PRODUCER && batch.size() < TEST_BATCH_SIZE; ++item) {
+            batch.push_back((producer << TEST_PRODUCER_SHIFT) | item);
+        }
+        queue->push(&batch[0], batch.size());
+    }
+}
+
+//Counts the items of each producer and checks that they arrive in order
+static void Consume(
+    TestQueue * queue,
+    const unsigned consumer,
+    std::vector<unsigned> * received,
+    bool * in_order
+) {
+    std::vector<unsigned> next_item(TEST_NUMBER_OF_PRODUCERS, 0);
+    std::vector<unsigned> batch(TEST_BATCH_SIZE);
+    *in_order = true;
+    while(true) {
+        size_t count = 1;
+        if(0 == consumer%2) {
+            queue->wait_and_pop(batch[0]);
+        } else {
+            count = queue->wait_and_pop(&batch[0], batch.size());
+        }
+        for(size_t i = 0; i < count; ++i) {
+            if(TEST_END_OF_INPUT == batch[i]) {
+                //end markers come last, nothing else can follow in this batch
+                __sync_fetch_and_add(&finished_consumers, 1);
+                return;
+            }
+            const unsigned producer = batch[i] >> TEST_PRODUCER_SHIFT;
+            const unsigned item = batch[i] & ((1u << TEST_PRODUCER_SHIFT) - 1);
+            if(item < next_item[producer]) {
+                *in_order = false;
+            }
+            next_item[producer] = item + 1;
+            ++(*received)[producer*TEST_ITEMS_PER_PRODUCER + item];
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(concurrent_queue)
+
+BOOST_AUTO_TEST_CASE(size_bounds_queue) {
+    TestQueue queue(TEST_QUEUE_SIZE);
+    std::vector<unsigned> items(2*TEST_QUEUE_SIZE, 0);
+    BOOST_CHECK_EQUAL(TEST_QUEUE_SIZE, queue.try_push(&items[0], items.size()));
+    BOOST_CHECK_EQUAL(TEST_QUEUE_SIZE, queue.try_pop(&items[0], items.size()));
+    BOOST_CHECK(queue.empty());
+    unsigned item = 0;
+    BOOST_CHECK(!queue.try_pop(item));
+}
+
+BOOST_AUTO_TEST_CASE(weight_bounds_queue) {
+    TestQueue queue(TEST_QUEUE_SIZE, 10);
+    BOOST_CHECK(queue.try_push(1, 6));
+    BOOST_CHECK(queue.try_push(2, 6));
+    BOOST_CHECK(!queue.try_push(3, 1));
+    //popping releases the weight of an item
+    unsigned item = 0;
+    BOOST_CHECK(queue.try_pop(item));
+    BOOST_CHECK_EQUAL(1u, item);
+    BOOST_CHECK(queue.try_push(3, 1));
+}
+
+BOOST_AUTO_TEST_CASE(every_item_arrives_once_and_in_order) {
+    TestQueue queue(TEST_QUEUE_SIZE);
+    std::vector<std::vector<unsigned> > received(
+        TEST_NUMBER_OF_CONSUMERS,
+        std::vector<unsigned>(TEST_NUMBER_OF_PRODUCERS*TEST_ITEMS_PER_PRODUCER, 0)
+    );
+    bool in_order[TEST_NUMBER_OF_CONSUMERS];
+    finished_consumers = 0;
+
+    boost::thread_group consumers;
+    for(unsigned i = 0; i < TEST_NUMBER_OF_CONSUMERS; ++i) {
+        consumers.create_thread(boost::bind(Consume, &queue, i, &received[i], &in_order[i]));
+    }
+    boost::thread_group producers;
+    for(unsigned i = 0; i < TEST_NUMBER_OF_PRODUCERS; ++i) {
+        producers.create_thread(boost::bind(Produce, &queue, i));
+    }
+    producers.join_all();
+    //a batched pop may take several end markers at once, so keep offering
+    //them until every consumer has seen one
+    while(TEST_NUMBER_OF_CONSUMERS > (unsigned)finished_consumers) {
+        queue.try_push(TEST_END_OF_INPUT);
+        boost::this_thread::yield();
+    }
+    consumers.join_all();
+
+    for(unsigned i = 0; i < TEST_NUMBER_OF_CONSUMERS; ++i) {
+        BOOST_CHECK(in_order[i]);
+    }
+    unsigned wrong_counts = 0;
+    for(unsigned item = 0; item < TEST_NUMBER_OF_PRODUCERS*TEST_ITEMS_PER_PRODUCER; ++item) {
+        unsigned count = 0;
+        for(unsigned i = 0; i < TEST_NUMBER_OF_CONSUMERS; ++i) {
+            count += received[i][item];
+        }
+        wrong_counts += (1 != count);
+    }
+    BOOST_CHECK_EQUAL(0u, wrong_counts);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,77 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#include "../../DataStructures/ConcurrentStringTable.h"
+#include "../../Util/OpenMPWrapper.h"
+
+#include <boost/lexical_cast.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static const int TEST_NUMBER_OF_DISTINCT_STRINGS = 50000;
+static const int TEST_NUMBER_OF_INSERTIONS = 400000;
+
+BOOST_AUTO_TEST_SUITE(concurrent_string_table)
+
+BOOST_AUTO_TEST_CASE(unknown_string_is_not_found) {
+    ConcurrentStringTable table;
+    table.Insert("street");
+    unsigned id = 0;
+    BOOST_CHECK(!table.Find("no such street", id));
+    BOOST_CHECK(table.Find("street", id));
+    BOOST_CHECK_EQUAL(0u, id);
+}
+
+//every string is inserted several times by racing threads
+BOOST_AUTO_TEST_CASE(racing_insertions_get_one_id_per_string) {
+    ConcurrentStringTable table;
+    std::vector<std::string> strings(TEST_NUMBER_OF_DISTINCT_STRINGS);
+    for(int i = 0; i < TEST_NUMBER_OF_DISTINCT_STRINGS; ++i) {
+        strings[i] = "street " + boost::lexical_cast<std::string>(i);
+    }
+    std::vector<unsigned> ids(TEST_NUMBER_OF_INSERTIONS);
+#pragma omp parallel for schedule ( guided )
+    for(int i = 0; i < TEST_NUMBER_OF_INSERTIONS; ++i) {
+        ids[i] = table.Insert(strings[(i*7919u)%TEST_NUMBER_OF_DISTINCT_STRINGS]);
+    }
+    BOOST_REQUIRE_EQUAL((unsigned)TEST_NUMBER_OF_DISTINCT_STRINGS, table.GetNumberOfStrings());
+
+    unsigned inconsistent_ids = 0;
+    std::vector<int> owner(TEST_NUMBER_OF_DISTINCT_STRINGS, -1);
+    for(int i = 0; i < TEST_NUMBER_OF_INSERTIONS; ++i) {
+        const int string_index = (i*7919u)%TEST_NUMBER_OF_DISTINCT_STRINGS;
+        unsigned id = 0;
+        if(ids[i] >= (unsigned)TEST_NUMBER_OF_DISTINCT_STRINGS ||
+           !table.Find(strings[string_index], id) || id != ids[i] ||
+           (-1 != owner[id] && string_index != owner[id])) {
+            ++inconsistent_ids;
+            continue;
+        }
+        owner[id] = string_index;
+    }
+    BOOST_CHECK_EQUAL(0u, inconsistent_ids);
+    //ids are consecutive
+    BOOST_CHECK(owner.end() == std::find(owner.begin(), owner.end(), -1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,107 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#include "../../DataStructures/ParallelBZ2Reader.h"
+#include "../../Util/OSRMException.h"
+
+#include <bzlib.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+//bzip2 blocks of 100k, so that every test input spans many blocks
+static const int TEST_BZ2_BLOCK_SIZE = 1;
+
+//Text with short and long repetitions like OSM XML, but no two blocks alike
+static std::string GenerateInput(const unsigned number_of_lines) {
+    std::string input;
+    unsigned random = 12345;
+    for(unsigned i = 0; i < number_of_lines; ++i) {
+        random = random*1103515245 + 12345;
+        input += "  <node id=\"";
+        input += boost::lexical_cast<std::string>(random);
+        input += "\" lat=\"";
+        input += boost::lexical_cast<std::string>(random%180000);
+        input += "\">\n";
+        if(0 == random%97) {
+            //runs are encoded specially by bzip2
+            input.append(random%5000, 'x');
+        }
+    }
+    return input;
+}
+
+static std::string Compress(const std::string & input) {
+    //bzlib takes a non-const source buffer
+    std::vector<char> source(input.begin(), input.end());
+    source.push_back('\0');
+    std::vector<char> output(input.size() + input.size()/100 + 600);
+    unsigned output_size = output.size();
+    if(BZ_OK != BZ2_bzBuffToBuffCompress(&output[0], &output_size, &source[0], input.size(), TEST_BZ2_BLOCK_SIZE, 0, 0)) {
+        throw OSRMException("could not compress test input");
+    }
+    return std::string(&output[0], output_size);
+}
+
+//Decompresses a file with ParallelBZ2Reader in odd sized reads
+static std::string ReadBack(const std::string & compressed_input) {
+    const boost::filesystem::path filename = boost::filesystem::temp_directory_path() /
+        boost::filesystem::unique_path("osrm-bz2-test-%%%%-%%%%.bz2");
+    {
+        boost::filesystem::ofstream file(filename, std::ios::binary);
+        file.write(compressed_input.data(), compressed_input.size());
+    }
+    std::string output;
+    {
+        ParallelBZ2Reader reader(filename.string().c_str());
+        std::vector<char> buffer(4093);
+        int bytes_read;
+        while(0 < (bytes_read = reader.Read(&buffer[0], buffer.size()))) {
+            output.append(&buffer[0], bytes_read);
+        }
+    }
+    boost::filesystem::remove(filename);
+    return output;
+}
+
+BOOST_AUTO_TEST_SUITE(parallel_bz2_reader)
+
+BOOST_AUTO_TEST_CASE(reads_many_blocks) {
+    const std::string input = GenerateInput(60000);
+    BOOST_CHECK(input == ReadBack(Compress(input)));
+}
+
+//pbzip2 writes one stream per block
+BOOST_AUTO_TEST_CASE(reads_concatenated_streams) {
+    const std::string first_part = GenerateInput(60000);
+    const std::string second_part = GenerateInput(7);
+    BOOST_CHECK(first_part + second_part == ReadBack(Compress(first_part) + Compress(second_part)));
+}
+
+BOOST_AUTO_TEST_CASE(reads_empty_stream) {
+    BOOST_CHECK(ReadBack(Compress("")).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
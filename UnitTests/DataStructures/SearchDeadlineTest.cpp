@@ -0,0 +1,104 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#include "../../DataStructures/SearchDeadline.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+BOOST_AUTO_TEST_SUITE(search_deadline)
+
+BOOST_AUTO_TEST_CASE(expires_on_time) {
+    SearchDeadline unbounded;
+    unbounded.ExpireAfter(0);
+    BOOST_CHECK(!unbounded.HasExpired());
+    BOOST_CHECK(!SearchDeadline::Unbounded().HasExpired());
+
+    SearchDeadline deadline;
+    deadline.ExpireAfter(100);
+    BOOST_CHECK(!deadline.HasExpired());
+    boost::this_thread::sleep(boost::posix_time::milliseconds(150));
+    BOOST_CHECK(deadline.HasExpired());
+    BOOST_CHECK(!deadline.IsCancelled());
+}
+
+BOOST_AUTO_TEST_CASE(cancelled_deadline_expires) {
+    SearchDeadline deadline;
+    deadline.Cancel();
+    BOOST_CHECK(deadline.HasExpired());
+    BOOST_CHECK(deadline.IsCancelled());
+}
+
+BOOST_AUTO_TEST_CASE(checks_once_per_interval) {
+    SearchDeadline deadline;
+    deadline.Cancel();
+    unsigned settled_nodes = 0;
+    unsigned checks_until_expiry = 0;
+    while(!deadline.HasExpiredAfterSettling(settled_nodes)) {
+        ++checks_until_expiry;
+    }
+    BOOST_CHECK_EQUAL(SEARCH_DEADLINE_CHECK_INTERVAL - 1, checks_until_expiry);
+}
+
+BOOST_AUTO_TEST_CASE(notices_hung_up_peer) {
+    int sockets[2];
+    BOOST_REQUIRE_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+    SearchDeadline deadline;
+    deadline.WatchPeer(sockets[0]);
+    BOOST_CHECK(!deadline.HasExpired());
+    //pending bytes neither end the search nor get consumed
+    BOOST_CHECK_EQUAL(2, write(sockets[1], "xy", 2));
+    BOOST_CHECK(!deadline.HasExpired());
+    close(sockets[1]);
+    BOOST_CHECK(deadline.HasExpired());
+    BOOST_CHECK(deadline.IsCancelled());
+    char pending[4];
+    BOOST_CHECK_EQUAL(2, read(sockets[0], pending, sizeof(pending)));
+    close(sockets[0]);
+}
+
+//HTTP/1.0 clients may shut down their side once the request is sent
+BOOST_AUTO_TEST_CASE(half_closed_peer_is_served) {
+    int sockets[2];
+    BOOST_REQUIRE_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+    SearchDeadline deadline;
+    deadline.WatchPeer(sockets[0]);
+    BOOST_CHECK_EQUAL(0, shutdown(sockets[1], SHUT_WR));
+    BOOST_CHECK(!deadline.HasExpired());
+    BOOST_CHECK(!deadline.IsCancelled());
+    close(sockets[1]);
+    close(sockets[0]);
+}
+
+BOOST_AUTO_TEST_CASE(ends_watch_of_peer) {
+    int sockets[2];
+    BOOST_REQUIRE_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+    SearchDeadline deadline;
+    deadline.WatchPeer(sockets[0]);
+    deadline.WatchPeer(-1);
+    close(sockets[1]);
+    BOOST_CHECK(!deadline.HasExpired());
+    close(sockets[0]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,154 @@
+/*
+    open source routing machine
+    Copyright (C) Dennis Luxen, 2010
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU AFFERO General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+or see http://www.gnu.org/licenses/agpl.txt.
+ */
+
+#include "../../Server/RequestCoalescer.h"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+#include <string>
+#include <vector>
+
+//The leader runs this long, the second request arrives after the head start
+static const unsigned TEST_QUERY_DURATION_MS = 300;
+static const unsigned TEST_HEAD_START_MS = 50;
+
+static volatile int number_of_queries = 0;
+
+//Takes its time and streams the first half of its reply if it can
+static void SlowQuery(const unsigned duration_ms, http::Reply & reply) {
+    __sync_fetch_and_add(&number_of_queries, 1);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(duration_ms));
+    reply.content = "first half,";
+    if(NULL != reply.stream) {
+        reply.stream->Write(reply);
+    }
+    reply.content += "second half";
+}
+
+class SendingStream : public http::ReplyStream {
+public:
+    void Write(http::Reply & reply) {
+        reply.isStreamed = true;
+        sent_content += reply.content;
+        reply.content.clear();
+    }
+    std::string sent_content;
+};
+
+//Starts a slow query for "key" and gives it a head start
+struct CoalescerFixture {
+    CoalescerFixture() {
+        number_of_queries = 0;
+    }
+
+    void StartLeader() {
+        leader = boost::thread(boost::bind(&CoalescerFixture::RunLeader, this));
+        boost::this_thread::sleep(boost::posix_time::milliseconds(TEST_HEAD_START_MS));
+    }
+
+    void RunLeader() {
+        coalescer.Run("key", leader_deadline, boost::bind(SlowQuery, TEST_QUERY_DURATION_MS, _1), leader_reply);
+    }
+
+    void Run(const std::string & key, const SearchDeadline & deadline) {
+        coalescer.Run(key, deadline, boost::bind(SlowQuery, 0, _1), reply);
+        leader.join();
+    }
+
+    RequestCoalescer coalescer;
+    boost::thread leader;
+    SearchDeadline leader_deadline;
+    http::Reply leader_reply;
+    http::Reply reply;
+};
+
+BOOST_FIXTURE_TEST_SUITE(request_coalescer, CoalescerFixture)
+
+BOOST_AUTO_TEST_CASE(waiter_shares_streamed_reply) {
+    SendingStream stream;
+    leader_reply.stream = &stream;
+    StartLeader();
+    SearchDeadline deadline;
+    Run("key", deadline);
+
+    BOOST_CHECK_EQUAL(1, number_of_queries);
+    BOOST_CHECK(&stream == leader_reply.stream);
+    BOOST_CHECK_EQUAL("first half,", stream.sent_content);
+    BOOST_CHECK_EQUAL("first half,second half", reply.content);
+}
+
+BOOST_AUTO_TEST_CASE(many_waiters_share_one_reply) {
+    StartLeader();
+    const unsigned number_of_waiters = 8;
+    std::vector<http::Reply> replies(number_of_waiters);
+    std::vector<SearchDeadline *> deadlines;
+    boost::thread_group waiters;
+    for(unsigned i = 0; i < number_of_waiters; ++i) {
+        deadlines.push_back(new SearchDeadline());
+        waiters.create_thread(boost::bind(
+            &RequestCoalescer::Run,
+            &coalescer,
+            std::string("key"),
+            boost::cref(*deadlines.back()),
+            RequestCoalescer::QueryFunction(boost::bind(SlowQuery, 0, _1)),
+            boost::ref(replies[i])
+        ));
+    }
+    waiters.join_all();
+    leader.join();
+    BOOST_CHECK_EQUAL(1, number_of_queries);
+    for(unsigned i = 0; i < number_of_waiters; ++i) {
+        BOOST_CHECK_EQUAL("first half,second half", replies[i].content);
+        delete deadlines[i];
+    }
+}
+
+BOOST_AUTO_TEST_CASE(different_queries_run_on_their_own) {
+    StartLeader();
+    SearchDeadline deadline;
+    Run("other key", deadline);
+    BOOST_CHECK_EQUAL(2, number_of_queries);
+}
+
+BOOST_AUTO_TEST_CASE(expired_leader_is_not_shared) {
+    leader_deadline.ExpireAfter(TEST_HEAD_START_MS*2);
+    StartLeader();
+    SearchDeadline deadline;
+    Run("key", deadline);
+    BOOST_CHECK_EQUAL(2, number_of_queries);
+}
+
+BOOST_AUTO_TEST_CASE(cancelled_waiter_stops_waiting) {
+    StartLeader();
+    SearchDeadline deadline;
+    deadline.Cancel();
+    const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    coalescer.Run("key", deadline, boost::bind(SlowQuery, 0, _1), reply);
+    const long waited_ms = (boost::posix_time::microsec_clock::universal_time() - start).total_milliseconds();
+    leader.join();
+
+    BOOST_CHECK_LT(waited_ms, (long)TEST_QUERY_DURATION_MS/2);
+    BOOST_CHECK_EQUAL(http::Reply::internalServerError, reply.status);
+    BOOST_CHECK_EQUAL(1, number_of_queries);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -22,8 +22,10 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include "Contractor/Contractor.h"
 #include "Contractor/EdgeBasedGraphFactory.h"
 #include "DataStructures/BinaryHeap.h"
+#include "DataStructures/CompressedGeometry.h"
 #include "DataStructures/DeallocatingVector.h"
 #include "DataStructures/QueryEdge.h"
+#include "DataStructures/SnappingGrid.h"
 #include "DataStructures/StaticGraph.h"
 #include "DataStructures/StaticRTree.h"
 #include "Util/IniFile.h"
@@ -70,11 +72,23 @@ int main (int argc, char *argv[]) {
 
         double startupTime = get_timestamp();
         unsigned number_of_threads = omp_get_num_procs();
+        std::string travel_time_profiles_source;
+        bool build_snapping_grid = false;
+        bool compress_geometry = false;
         if(testDataFile("contractor.ini")) {
             ContractorConfiguration contractorConfig("contractor.ini");
             unsigned rawNumber = stringToInt(contractorConfig.GetParameter("Threads"));
             if(rawNumber != 0 && rawNumber <= number_of_threads)
                 number_of_threads = rawNumber;
+            if(contractorConfig.Holds("TravelTimeProfiles")) {
+                travel_time_profiles_source = contractorConfig.GetParameter("TravelTimeProfiles");
+            }
+            if(contractorConfig.Holds("SnappingGrid")) {
+                build_snapping_grid = ("yes" == contractorConfig.GetParameter("SnappingGrid"));
+            }
+            if(contractorConfig.Holds("CompressGeometry")) {
+                compress_geometry = ("yes" == contractorConfig.GetParameter("CompressGeometry"));
+            }
         }
         omp_set_num_threads(number_of_threads);
         LogPolicy::GetInstance().Unmute();
@@ -115,8 +129,11 @@ int main (int argc, char *argv[]) {
         std::string nodeOut(argv[1]);		nodeOut += ".nodes";
         std::string edgeOut(argv[1]);		edgeOut += ".edges";
         std::string graphOut(argv[1]);		graphOut += ".hsgr";
+        std::string profilesOut(argv[1]);	profilesOut += ".tdp";
         std::string rtree_nodes_path(argv[1]);  rtree_nodes_path += ".ramIndex";
         std::string rtree_leafs_path(argv[1]);  rtree_leafs_path += ".fileIndex";
+        std::string grid_path(argv[1]);         grid_path += ".gridIndex";
+        std::string geometryOut(argv[1]);	geometryOut += ".geometry";
 
         /*** Setup Scripting Environment ***/
         if(!testDataFile( (argc > 3 ? argv[3] : "profile.lua") )) {
@@ -157,6 +174,7 @@ int main (int argc, char *argv[]) {
                 return -1;
         }
         speedProfile.trafficSignalPenalty = 10*lua_tointeger(myLuaState, -1);
+        lua_pop(myLuaState, 1);
 
         if(0 != luaL_dostring( myLuaState, "return u_turn_penalty\n")) {
             std::cerr <<
@@ -166,9 +184,24 @@ int main (int argc, char *argv[]) {
             return -1;
         }
         speedProfile.uTurnPenalty = 10*lua_tointeger(myLuaState, -1);
+        lua_pop(myLuaState, 1);
 
         speedProfile.has_turn_penalty_function = lua_function_exists( myLuaState, "turn_function" );
 
+        if(0 != luaL_dostring( myLuaState, "return turn_penalty_evaluation\n")) {
+            std::cerr <<
+                lua_tostring(myLuaState,-1)   <<
+                " occured in scripting block" <<
+                std::endl;
+            return -1;
+        }
+        if(lua_isstring(myLuaState, -1)) {
+            speedProfile.turn_penalty_evaluation =
+                TurnPenaltyEvaluator::GetModeFromProfile(lua_tostring(myLuaState, -1));
+        }
+        //the evaluator calls into the same state, leave its stack empty
+        lua_pop(myLuaState, 1);
+
         std::vector<ImportEdge> edgeList;
         NodeID nodeBasedNodeNumber = readBinaryOSRMGraphFromStream(in, edgeList, bollardNodes, trafficLightNodes, &internalToExternalNodeMapping, inputRestrictions);
         in.close();
@@ -195,7 +228,23 @@ int main (int argc, char *argv[]) {
         SimpleLogger().Write() << "Generating edge-expanded graph representation";
         EdgeBasedGraphFactory * edgeBasedGraphFactory = new EdgeBasedGraphFactory (nodeBasedNodeNumber, edgeList, bollardNodes, trafficLightNodes, inputRestrictions, internalToExternalNodeMapping, speedProfile);
         std::vector<ImportEdge>().swap(edgeList);
+        if(compress_geometry) {
+            edgeBasedGraphFactory->CompressGeometry();
+        }
         edgeBasedGraphFactory->Run(edgeOut.c_str(), myLuaState);
+        //the server expects the geometry file in any case
+        if(compress_geometry) {
+            edgeBasedGraphFactory->WriteCompressedGeometry(geometryOut.c_str());
+        } else {
+            CompressedGeometry().Write(geometryOut);
+        }
+        if(!travel_time_profiles_source.empty()) {
+            SimpleLogger().Write() << "Reading travel time profiles from " << travel_time_profiles_source;
+            edgeBasedGraphFactory->WriteTravelTimeProfiles(
+                travel_time_profiles_source.c_str(),
+                profilesOut.c_str()
+            );
+        }
         std::vector<TurnRestriction>().swap(inputRestrictions);
         std::vector<NodeID>().swap(bollardNodes);
         std::vector<NodeID>().swap(trafficLightNodes);
@@ -222,6 +271,16 @@ int main (int argc, char *argv[]) {
          * Building grid-like nearest-neighbor data structure
          */
 
+        if(build_snapping_grid) {
+            SimpleLogger().Write() << "building snapping grid ...";
+            SnappingGrid<EdgeBasedGraphFactory::EdgeBasedNode> snapping_grid(nodeBasedEdgeList);
+            snapping_grid.Write(grid_path);
+        }
+        IteratorbasedCRC32<std::vector<EdgeBasedGraphFactory::EdgeBasedNode> > crc32;
+        unsigned crc32OfNodeBasedEdgeList = crc32(nodeBasedEdgeList.begin(), nodeBasedEdgeList.end() );
+        SimpleLogger().Write() << "CRC32: " << crc32OfNodeBasedEdgeList;
+
+        //the r-tree consumes the node list and frees it before the upper levels are built
         SimpleLogger().Write() << "building r-tree ...";
         StaticRTree<EdgeBasedGraphFactory::EdgeBasedNode> * rtree =
                 new StaticRTree<EdgeBasedGraphFactory::EdgeBasedNode>(
@@ -230,10 +289,7 @@ int main (int argc, char *argv[]) {
                         rtree_leafs_path.c_str()
                 );
         delete rtree;
-        IteratorbasedCRC32<std::vector<EdgeBasedGraphFactory::EdgeBasedNode> > crc32;
-        unsigned crc32OfNodeBasedEdgeList = crc32(nodeBasedEdgeList.begin(), nodeBasedEdgeList.end() );
-        nodeBasedEdgeList.clear();
-        SimpleLogger().Write() << "CRC32: " << crc32OfNodeBasedEdgeList;
+        BOOST_ASSERT(nodeBasedEdgeList.empty());
 
         /***
          * Contracting the edge-expanded graph
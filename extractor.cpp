@@ -18,9 +18,12 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 or see http://www.gnu.org/licenses/agpl.txt.
  */
 
+#include "DataStructures/ConcurrentStringTable.h"
 #include "Extractor/ExtractorCallbacks.h"
 #include "Extractor/ExtractionContainers.h"
+#include "Extractor/ExtractionState.h"
 #include "Extractor/ScriptingEnvironment.h"
+#include "Extractor/OSCParser.h"
 #include "Extractor/PBFParser.h"
 #include "Extractor/XMLParser.h"
 #include "Util/IniFile.h"
@@ -33,6 +36,9 @@ or see http://www.gnu.org/licenses/agpl.txt.
 #include "Util/UUID.h"
 #include "typedefs.h"
 
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+
 #include <cstdlib>
 
 #include <iostream>
@@ -46,18 +52,24 @@ int main (int argc, char *argv[]) {
     try {
         LogPolicy::GetInstance().Unmute();
         double startup_time = get_timestamp();
-        if(argc < 2) {
+        //a change file is applied to the state of an earlier extraction
+        if(argc < 2 || (std::string::npos != std::string(argv[1]).find(".osc") && argc < 3)) {
             SimpleLogger().Write(logWARNING) <<
                 "usage: \n" <<
                 argv[0] <<
-                " <file.osm/.osm.bz2/.osm.pbf> [<profile.lua>]";
+                " <file.osm/.osm.bz2/.osm.pbf> [<profile.lua>]\n" <<
+                argv[0] <<
+                " <changes.osc/.osc.bz2> <file.osrm> [<profile.lua>]";
             return -1;
         }
+        const bool file_is_change_set = (std::string::npos != std::string(argv[1]).find(".osc"));
+        const int profile_argument = (file_is_change_set ? 3 : 2);
 
         /*** Setup Scripting Environment ***/
-        ScriptingEnvironment scriptingEnvironment((argc > 2 ? argv[2] : "profile.lua"));
+        ScriptingEnvironment scriptingEnvironment((argc > profile_argument ? argv[profile_argument] : "profile.lua"));
 
         unsigned number_of_threads = omp_get_num_procs();
+        bool write_extraction_state = false;
 
         if(testDataFile("extractor.ini")) {
             IniFile extractorConfig("extractor.ini");
@@ -65,6 +77,7 @@ int main (int argc, char *argv[]) {
             if( rawNumber != 0 && rawNumber <= number_of_threads) {
                 number_of_threads = rawNumber;
             }
+            write_extraction_state = (0 != stringToInt(extractorConfig.GetParameter("IncrementalUpdates")));
         }
         omp_set_num_threads(number_of_threads);
 
@@ -98,6 +111,11 @@ int main (int argc, char *argv[]) {
                 restrictionsFileName.append(".osrm.restrictions");
             }
         }
+        if(file_is_change_set) {
+            output_file_name = argv[2];
+            restrictionsFileName = output_file_name + ".restrictions";
+        }
+        const std::string state_file_name = output_file_name + ".state";
 
         unsigned amountOfRAM = 1;
         unsigned installedRAM = GetPhysicalmemory();
@@ -105,13 +123,28 @@ int main (int argc, char *argv[]) {
             SimpleLogger().Write(logWARNING) << "Machine has less than 2GB RAM.";
         }
 
-        StringMap stringMap;
+        ConcurrentStringTable nameTable;
         ExtractionContainers externalMemory;
 
-        stringMap[""] = 0;
-        extractCallBacks = new ExtractorCallbacks(&externalMemory, &stringMap);
+        nameTable.Insert("");
+        extractCallBacks = new ExtractorCallbacks(&externalMemory, &nameTable);
+
+        boost::scoped_ptr<ExtractionStateReader> old_state;
+        boost::scoped_ptr<ExtractionStateWriter> new_state;
+        if(file_is_change_set) {
+            old_state.reset(new ExtractionStateReader(state_file_name));
+        }
+        if(file_is_change_set || write_extraction_state) {
+            //replaces the old state once it is complete
+            new_state.reset(new ExtractionStateWriter(state_file_name + ".tmp"));
+            extractCallBacks->SetStateWriter(new_state.get());
+        }
+
+        ExtractionChangeSet change_set;
         BaseParser* parser;
-        if(file_has_pbf_format) {
+        if(file_is_change_set) {
+            parser = new OSCParser(argv[1], scriptingEnvironment, change_set);
+        } else if(file_has_pbf_format) {
             parser = new PBFParser(argv[1], extractCallBacks, scriptingEnvironment);
         } else {
             parser = new XMLParser(argv[1], extractCallBacks, scriptingEnvironment);
@@ -127,6 +160,15 @@ int main (int argc, char *argv[]) {
             (get_timestamp() - parsing_start_time) <<
             " seconds";
 
+        if(file_is_change_set) {
+            SimpleLogger().Write() << "Applying " << change_set.GetNumberOfChanges() <<
+                " changed entities to " << state_file_name;
+            change_set.Apply(*old_state, *extractCallBacks);
+        }
+        if(new_state && new_state->Close()) {
+            boost::filesystem::rename(state_file_name + ".tmp", state_file_name);
+        }
+
         externalMemory.PrepareData(output_file_name, restrictionsFileName, amountOfRAM);
 
         delete parser;
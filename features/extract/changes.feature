@@ -0,0 +1,67 @@
+@extract @changes
+Feature: Incremental extraction - apply OSM change files to an earlier extraction
+
+	Background:
+		Given the profile "testbot"
+
+	Scenario: Changes - a deleted way is no longer routable
+		Given the node map
+		 | a | b | c |
+		 |   | d |   |
+
+		And the ways
+		 | nodes |
+		 | abc   |
+		 | bd    |
+
+		And the changes
+		 | action | nodes |
+		 | delete | bd    |
+
+		When I route I should get
+		 | from | to | route |
+		 | a    | c  | abc   |
+		 | a    | d  |       |
+		 | d    | c  |       |
+
+	Scenario: Changes - a created way is routable
+		Given the node map
+		 | a | b | c |
+		 |   | d |   |
+
+		And the ways
+		 | nodes |
+		 | abc   |
+
+		And the changes
+		 | action | nodes |
+		 | create | bd    |
+
+		When I route I should get
+		 | from | to | route  |
+		 | a    | c  | abc    |
+		 | a    | d  | abc,bd |
+		 | d    | c  | bd,abc |
+
+	Scenario: Changes - modified tags are evaluated by the profile
+		Given the node map
+		 | a | b |
+		 | c | d |
+
+		And the ways
+		 | nodes |
+		 | ab    |
+		 | ac    |
+		 | cd    |
+		 | db    |
+
+		And the changes
+		 | action | nodes | highway   | oneway |
+		 | modify | ab    | secondary |        |
+		 | modify | cd    | primary   | -1     |
+
+		When I route I should get
+		 | from | to | route    | time    |
+		 | a    | b  | ab       | 20s +-1 |
+		 | d    | c  | cd       | 10s +-1 |
+		 | c    | d  | ac,ab,db | 40s +-1 |
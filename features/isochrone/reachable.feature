@@ -0,0 +1,38 @@
+@isochrone
+Feature: Isochrones - locations reachable within a travel time
+
+	Background:
+		Given the profile "testbot"
+
+	Scenario: Isochrone - reachable intersections along a road
+		Given the node map
+		 |   | c |   |   |
+		 | a | x | b | e |
+		 |   | d |   |   |
+
+		And the ways
+		 | nodes |
+		 | axbe  |
+		 | cxd   |
+
+		When I request isochrones I should get
+		 | from | time | reachable | unreachable |
+		 | a    | 15   | x         | e           |
+		 | e    | 100  | x         |             |
+		 | e    | 15   |           | a,c,d       |
+		 | c    | 15   | x         | e           |
+
+	Scenario: Isochrone - oneways are only followed in their direction
+		Given the node map
+		 | a | b | c |
+		 |   | d |   |
+
+		And the ways
+		 | nodes | oneway |
+		 | abc   | no     |
+		 | bd    | yes    |
+
+		When I request isochrones I should get
+		 | from | time | reachable | unreachable |
+		 | a    | 100  | b         |             |
+		 | d    | 100  |           | a,c         |
@@ -0,0 +1,76 @@
+@match
+Feature: Map matching - snap GPS traces to the road network
+
+	Background:
+		Given the profile "testbot"
+		Given a grid size of 10 meters
+
+	Scenario: Match - samples follow the closest of two parallel roads
+		Given the node map
+		 | a | 1 | b | 2 | c | 3 | d |
+		 |   |   |   |   |   |   |   |
+		 |   |   |   |   |   |   |   |
+		 |   |   |   |   |   |   |   |
+		 |   |   |   |   |   |   |   |
+		 | e | 4 | f | 5 | g | 6 | h |
+
+		And the ways
+		 | nodes |
+		 | abcd  |
+		 | efgh  |
+
+		When I match I should get
+		 | trace | route |
+		 | 123   | abcd  |
+		 | 456   | efgh  |
+		 | 13    | abcd  |
+
+	Scenario: Match - trace turning onto a side road
+		Given the node map
+		 | a | 1 | b | 2 | c |
+		 |   |   | 3 |   |   |
+		 |   |   | d |   |   |
+
+		And the ways
+		 | nodes |
+		 | abc   |
+		 | bd    |
+
+		When I match I should get
+		 | trace | route  |
+		 | 12    | abc    |
+		 | 13    | abc,bd |
+
+	Scenario: Match - samples far away from any road are not matched
+		Given a grid size of 100 meters
+		Given the node map
+		 | a | b | c |
+		 |   |   |   |
+		 | 1 |   | 2 |
+
+		And the ways
+		 | nodes |
+		 | abc   |
+
+		When I match I should get
+		 | trace | route | status |
+		 | 12    |       | 207    |
+
+	Scenario: Match - a trace with a gap is matched piecewise
+		Given a grid size of 100 meters
+		Given the node map
+		 | a | 1 | b | 2 | c |
+		 |   |   |   |   |   |
+		 |   |   |   |   |   |
+		 | d | 3 | e | 4 | f |
+
+		And the ways
+		 | nodes |
+		 | abc   |
+		 | def   |
+
+		When I match I should get
+		 | trace | route   | status |
+		 | 12    | abc     | 0      |
+		 | 1234  | abc;def | 0      |
+		 | 4321  | def;abc | 0      |
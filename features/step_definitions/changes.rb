@@ -0,0 +1,29 @@
+Given /^the changes$/ do |table|
+  table.hashes.each do |row|
+    action = row.delete 'action'
+    raise "*** unknown change '#{action}', must be create, modify or delete" unless ['create','modify','delete'].include? action
+
+    nodes = row.delete 'nodes'
+    if action == 'create'
+      raise "*** duplicate way '#{nodes}'" if find_way_by_name nodes
+      id = make_osm_id
+    else
+      way = find_way_by_name nodes
+      raise "*** unknown way '#{nodes}'" unless way
+      id = way.id
+    end
+
+    way_nodes = []
+    tags = {}
+    unless action == 'delete'
+      nodes.each_char do |c|
+        node = find_node_by_name(c)
+        raise "*** unknown node '#{c}'" unless node
+        way_nodes << node
+      end
+      tags = { 'highway' => 'primary', 'name' => nodes }.merge(row)
+      tags.reject! { |k,v| v=='' || v=='(nil)' }
+    end
+    osm_changes << [action, id, way_nodes, tags]
+  end
+end
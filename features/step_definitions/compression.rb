@@ -0,0 +1,3 @@
+Given /^geometry compression$/ do
+  @compress_geometry = true
+end
@@ -0,0 +1,43 @@
+When /^I request isochrones I should get$/ do |table|
+  reprocess
+  actual = []
+  OSRMLauncher.new do
+    table.hashes.each_with_index do |row,ri|
+      from_node = find_node_by_name row['from']
+      raise "*** unknown from-node '#{row['from']}" unless from_node
+
+      response = request_isochrone from_node, row['time']
+      reached = []
+      if response.code == "200" && response.body.empty? == false
+        json = JSON.parse response.body
+        if json['status'] == 0
+          reached = json['isochrones'][0]['reachable']
+        end
+      end
+
+      got = {'from' => row['from'], 'time' => row['time'] }
+
+      # every reachable location carries its travel time as third value
+      late = reached.find { |r| r[2].to_i > row['time'].to_i }
+      got['time'] = "#{row['time']} (reached after #{late[2]}s)" if late
+
+      ['reachable','unreachable'].each do |key|
+        next unless table.headers.include? key
+        got[key] = row[key].split(',').map { |n| n.strip }.select do |name|
+          node = find_node_by_name name
+          raise "*** unknown node '#{name}'" unless node
+          was_reached = reached.any? { |r| FuzzyMatch.match_location r, node }
+          key == 'reachable' ? was_reached : !was_reached
+        end.join(',')
+      end
+
+      unless got == row
+        failed = { :attempt => 'isochrone', :query => @query, :response => response }
+        log_fail row,got,[failed]
+      end
+
+      actual << got
+    end
+  end
+  table.routing_diff! actual
+end
@@ -0,0 +1,48 @@
+When /^I match I should get$/ do |table|
+  reprocess
+  actual = []
+  OSRMLauncher.new do
+    table.hashes.each_with_index do |row,ri|
+      trace = []
+      row['trace'].each_char do |n|
+        node = find_node_by_name(n)
+        raise "*** unknown trace node '#{n}'" unless node
+        trace << node
+      end
+
+      response = request_match trace
+      if response.code == "200" && response.body.empty? == false
+        json = JSON.parse response.body
+        if json['status'] == 0
+          # a trace with breaks is matched piecewise
+          instructions = json['matchings'].map { |matching| way_list matching['route_instructions'] }.join ';'
+        end
+      end
+
+      got = {'trace' => row['trace'] }
+      if table.headers.include? 'route'
+        got['route'] = (instructions || '').strip
+      end
+      if table.headers.include? 'status'
+        got['status'] = json ? json['status'].to_s : "HTTP #{response.code}"
+      end
+
+      ok = true
+      row.keys.each do |key|
+        if FuzzyMatch.match got[key], row[key]
+          got[key] = row[key]
+        else
+          ok = false
+        end
+      end
+
+      unless ok
+        failed = { :attempt => 'match', :query => @query, :response => response }
+        log_fail row,got,[failed]
+      end
+
+      actual << got
+    end
+  end
+  table.routing_diff! actual
+end
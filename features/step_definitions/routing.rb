@@ -38,6 +38,7 @@ When /^I route I should get$/ do |table|
       end
             
       response = request_route(waypoints, params)
+      json = nil
       if response.code == "200" && response.body.empty? == false
         json = JSON.parse response.body
         if json['status'] == 0
@@ -49,6 +50,9 @@ When /^I route I should get$/ do |table|
         end
       end
       
+      if table.headers.include? 'status'
+        got['status'] = json ? json['status'].to_s : ''
+      end
       if table.headers.include? 'start'
         got['start'] = instructions ? json['route_summary']['start_point'] : nil
       end
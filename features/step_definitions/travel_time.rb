@@ -0,0 +1,23 @@
+Given /^the travel time profiles$/ do |table|
+  table.hashes.each do |row|
+    name = row['profile']
+    raise "*** duplicate travel time profile '#{name}'" if travel_time_profiles[name]
+    raise "*** hours must be given as a range of hours of the week, ex: 7-9" unless row['hours'] =~ /^(\d+)-(\d+)$/
+    first, last = $1.to_i, $2.to_i
+    # one factor per hour of the week, starting on monday 00:00 UTC
+    travel_time_profiles[name] = (0...7*24).map { |hour| (first..last).include?(hour) ? row['factor'].to_i : 100 }
+  end
+end
+
+Given /^the travel time profile segments$/ do |table|
+  table.hashes.each do |row|
+    name = row['profile']
+    raise "*** unknown travel time profile '#{name}'" unless travel_time_profiles[name]
+    nodes = row['nodes'].each_char.map do |c|
+      node = find_node_by_name(c)
+      raise "*** unknown node '#{c}'" unless node
+      node
+    end
+    nodes.each_cons(2) { |from,to| travel_time_segments << [from, to, name] }
+  end
+end
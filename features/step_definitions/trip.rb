@@ -0,0 +1,42 @@
+When /^I plan a trip I should get$/ do |table|
+  reprocess
+  actual = []
+  OSRMLauncher.new do
+    table.hashes.each_with_index do |row,ri|
+      names = row['waypoints'].split(',').map { |n| n.strip }
+      waypoints = names.map do |n|
+        node = find_node_by_name(n)
+        raise "*** unknown waypoint node '#{n}'" unless node
+        node
+      end
+
+      response = request_trip waypoints
+      if response.code == "200" && response.body.empty? == false
+        json = JSON.parse response.body
+        if json['status'] == 0
+          trip = json['trip_order'].map { |i| names[i] }.join
+        end
+      end
+
+      got = {'waypoints' => row['waypoints'] }
+      if table.headers.include? 'trip'
+        got['trip'] = trip || ''
+        # a round trip is just as short in the opposite direction
+        if trip && trip.size > 1 && trip[0] + trip[1..-1].reverse == row['trip']
+          got['trip'] = row['trip']
+        end
+      end
+      if table.headers.include? 'status'
+        got['status'] = json ? json['status'].to_s : "HTTP #{response.code}"
+      end
+
+      unless got == row
+        failed = { :attempt => 'trip', :query => @query, :response => response }
+        log_fail row,got,[failed]
+      end
+
+      actual << got
+    end
+  end
+  table.routing_diff! actual
+end
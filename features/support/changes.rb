@@ -0,0 +1,54 @@
+require 'fileutils'
+
+EXTRACTOR_CONFIG_FILE = 'extractor.ini'
+
+def osm_changes
+  @osm_changes ||= []
+end
+
+def osc_str
+  return @osc_str if @osc_str
+  @osc_str = ''
+  doc = Builder::XmlMarkup.new :indent => 2, :target => @osc_str
+  doc.instruct!
+  doc.osmChange :version => '0.6', :generator => OSM_GENERATOR do
+    osm_changes.each do |action,id,nodes,tags|
+      doc.tag! action do
+        doc.way :id => id, :version => 2, :uid => OSM_UID, :user => OSM_USER, :timestamp => OSM_TIMESTAMP do
+          nodes.each { |node| doc.nd :ref => node.id }
+          tags.each_pair { |k,v| doc.tag :k => k, :v => v }
+        end
+      end
+    end
+  end
+  @osc_str
+end
+
+#osrm-extract only keeps the state needed for updates if its config file asks for it
+def with_incremental_updates
+  return yield if osm_changes.empty?
+  config = File.read EXTRACTOR_CONFIG_FILE
+  begin
+    File.open(EXTRACTOR_CONFIG_FILE, 'w') {|f| f.write("#{config.chomp}\nIncrementalUpdates = 1\n") }
+    yield
+  ensure
+    File.open(EXTRACTOR_CONFIG_FILE, 'w') {|f| f.write(config) }
+  end
+end
+
+#the changes are applied to a copy of the extracted state, the result gets its own files
+def apply_osm_changes
+  base_file = @osm_file
+  @osm_file = "#{base_file}_#{Digest::SHA1.hexdigest osc_str}"
+  write_timestamp
+  return if extracted?
+  FileUtils.cp "#{base_file}.osrm.state", "#{@osm_file}.osrm.state"
+  File.open("#{@osm_file}.osc", 'w') {|f| f.write(osc_str) }
+  log_preprocess_info
+  log "== Applying #{@osm_file}.osc...", :preprocess
+  unless system "#{BIN_PATH}/osrm-extract #{@osm_file}.osc #{@osm_file}.osrm 1>>#{PREPROCESS_LOG_FILE} 2>>#{PREPROCESS_LOG_FILE} #{PROFILES_PATH}/#{@profile}.lua"
+    log "*** Exited with code #{$?.exitstatus}.", :preprocess
+    raise ExtractError.new $?.exitstatus, "osrm-extract exited with code #{$?.exitstatus}."
+  end
+  log '', :preprocess
+end
@@ -0,0 +1,19 @@
+def compress_geometry?
+  @compress_geometry == true
+end
+
+def compression_hash
+  compress_geometry? ? 'compressed' : ''
+end
+
+#osrm-prepare only compresses degree-2 chains when its config file says so
+def with_compressed_geometry
+  return yield unless compress_geometry?
+  config = File.read CONTRACTOR_CONFIG_FILE
+  begin
+    File.open(CONTRACTOR_CONFIG_FILE, 'w') {|f| f.write("#{config.chomp}\nCompressGeometry = yes\n") }
+    yield
+  ensure
+    File.open(CONTRACTOR_CONFIG_FILE, 'w') {|f| f.write(config) }
+  end
+end
@@ -25,6 +25,7 @@ fileIndex=#{@osm_file}.osrm.fileIndex
 namesData=#{@osm_file}.osrm.names
 timestamp=#{@osm_file}.osrm.timestamp
 EOF
+  s << "travelTimeProfiles=#{travel_time_profiles_file}\n" unless travel_time_profiles.empty?
   File.open( 'server.ini', 'w') {|f| f.write( s ) }
 end
 
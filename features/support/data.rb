@@ -169,6 +169,12 @@ def reset_osm
   name_node_hash.clear
   location_hash.clear
   name_way_hash.clear
+  travel_time_profiles.clear
+  travel_time_segments.clear
+  @travel_time_hash = nil
+  @compress_geometry = false
+  osm_changes.clear
+  @osc_str = nil
   @osm_str = nil
   @osm_hash = nil
   @osm_id = 0
@@ -230,11 +236,13 @@ end
 def extracted?
   File.exist?("#{@osm_file}.osrm") &&
   File.exist?("#{@osm_file}.osrm.names") &&
-  File.exist?("#{@osm_file}.osrm.restrictions")
+  File.exist?("#{@osm_file}.osrm.restrictions") &&
+  (osm_changes.empty? || File.exist?("#{@osm_file}.osrm.state"))
 end
 
 def prepared?
-  File.exist?("#{@osm_file}.osrm.hsgr")
+  File.exist?("#{@osm_file}.osrm.hsgr") &&
+  (travel_time_profiles.empty? || File.exist?(travel_time_profiles_file))
 end
 
 def write_timestamp
@@ -250,19 +258,26 @@ def reprocess
     unless extracted?
       log_preprocess_info
       log "== Extracting #{@osm_file}.osm...", :preprocess
-      unless system "#{BIN_PATH}/osrm-extract #{@osm_file}.osm#{'.pbf' if use_pbf} 1>>#{PREPROCESS_LOG_FILE} 2>>#{PREPROCESS_LOG_FILE} #{PROFILES_PATH}/#{@profile}.lua"
-        log "*** Exited with code #{$?.exitstatus}.", :preprocess
-        raise ExtractError.new $?.exitstatus, "osrm-extract exited with code #{$?.exitstatus}."
+      with_incremental_updates do
+        unless system "#{BIN_PATH}/osrm-extract #{@osm_file}.osm#{'.pbf' if use_pbf} 1>>#{PREPROCESS_LOG_FILE} 2>>#{PREPROCESS_LOG_FILE} #{PROFILES_PATH}/#{@profile}.lua"
+          log "*** Exited with code #{$?.exitstatus}.", :preprocess
+          raise ExtractError.new $?.exitstatus, "osrm-extract exited with code #{$?.exitstatus}."
+        end
       end
       log '', :preprocess
     end
+    apply_osm_changes unless osm_changes.empty?
     unless prepared?
       log_preprocess_info
       log "== Preparing #{@osm_file}.osm...", :preprocess
-      unless system "#{BIN_PATH}/osrm-prepare #{@osm_file}.osrm #{@osm_file}.osrm.restrictions 1>>#{PREPROCESS_LOG_FILE} 2>>#{PREPROCESS_LOG_FILE} #{PROFILES_PATH}/#{@profile}.lua"
-        log "*** Exited with code #{$?.exitstatus}.", :preprocess
-        raise PrepareError.new $?.exitstatus, "osrm-prepare exited with code #{$?.exitstatus}."
-      end 
+      with_compressed_geometry do
+        with_travel_time_profiles do
+          unless system "#{BIN_PATH}/osrm-prepare #{@osm_file}.osrm #{@osm_file}.osrm.restrictions 1>>#{PREPROCESS_LOG_FILE} 2>>#{PREPROCESS_LOG_FILE} #{PROFILES_PATH}/#{@profile}.lua"
+            log "*** Exited with code #{$?.exitstatus}.", :preprocess
+            raise PrepareError.new $?.exitstatus, "osrm-prepare exited with code #{$?.exitstatus}."
+          end
+        end
+      end
       log '', :preprocess
     end
     log_preprocess_done
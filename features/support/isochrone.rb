@@ -0,0 +1,5 @@
+require 'net/http'
+
+def request_isochrone node, seconds
+  request_path "isochrone", [node], { 'time' => seconds }
+end
@@ -0,0 +1,5 @@
+require 'net/http'
+
+def request_match trace
+  request_path "match", trace
+end
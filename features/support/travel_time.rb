@@ -0,0 +1,42 @@
+CONTRACTOR_CONFIG_FILE = 'contractor.ini'
+
+def travel_time_profiles
+  @travel_time_profiles ||= {}
+end
+
+def travel_time_segments
+  @travel_time_segments ||= []
+end
+
+def travel_time_profiles_str
+  return '' if travel_time_profiles.empty?
+  # profiles are numbered in the order they appear
+  names = travel_time_profiles.keys
+  lines = travel_time_profiles.values.map { |factors| "profile,#{factors.join(',')}" }
+  lines += travel_time_segments.map do |from,to,name|
+    "segment,#{from.id},#{to.id},#{names.index(name)}"
+  end
+  lines.join("\n") + "\n"
+end
+
+def travel_time_hash
+  @travel_time_hash ||= Digest::SHA1.hexdigest travel_time_profiles_str
+end
+
+def travel_time_profiles_file
+  "#{@osm_file}.osrm.tdp"
+end
+
+#osrm-prepare takes the profile source from its config file
+def with_travel_time_profiles
+  return yield if travel_time_profiles.empty?
+  source = "#{@osm_file}.profiles"
+  File.open(source, 'w') {|f| f.write(travel_time_profiles_str) }
+  config = File.read CONTRACTOR_CONFIG_FILE
+  begin
+    File.open(CONTRACTOR_CONFIG_FILE, 'w') {|f| f.write("#{config.chomp}\nTravelTimeProfiles = #{source}\n") }
+    yield
+  ensure
+    File.open(CONTRACTOR_CONFIG_FILE, 'w') {|f| f.write(config) }
+  end
+end
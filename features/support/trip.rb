@@ -0,0 +1,5 @@
+require 'net/http'
+
+def request_trip waypoints
+  request_path "trip", waypoints
+end
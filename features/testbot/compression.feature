@@ -0,0 +1,71 @@
+@routing @testbot @compression
+Feature: Routing on compressed geometry
+# osrm-prepare merges chains of degree-2 nodes into single edges,
+# the nodes inside a chain must still work as start, end and via points
+
+	Background:
+		Given the profile "testbot"
+		And geometry compression
+
+	Scenario: Compression - start and end inside a chain
+		Given the node map
+		 | a | b | c | d | e |
+
+		And the ways
+		 | nodes |
+		 | abcde |
+
+		When I route I should get
+		 | from | to | route | distance | time    |
+		 | b    | d  | abcde | 200m +-1 | 20s +-1 |
+		 | d    | b  | abcde | 200m +-1 | 20s +-1 |
+		 | a    | e  | abcde | 400m +-1 | 40s +-1 |
+		 | c    | a  | abcde | 200m +-1 | 20s +-1 |
+
+	Scenario: Compression - via points inside a chain
+		Given the node map
+		 | a | b | c | d | e |
+
+		And the ways
+		 | nodes |
+		 | abcde |
+
+		When I route I should get
+		 | waypoints | route       | distance |
+		 | a,c,e     | abcde,abcde | 400m +-1 |
+		 | e,b,a     | abcde,abcde | 400m +-1 |
+
+	Scenario: Compression - oneway chain
+		Given the node map
+		 | a | b | c | d | e |
+
+		And the ways
+		 | nodes | oneway |
+		 | abcde | yes    |
+
+		When I route I should get
+		 | from | to | route | distance |
+		 | b    | d  | abcde | 200m +-1 |
+		 | d    | b  |       |          |
+		 | e    | a  |       |          |
+
+	Scenario: Compression - chains meeting at a junction
+		Given the node map
+		 | a | b | c | d | e |
+		 |   |   | f |   |   |
+		 |   |   | g |   |   |
+
+		And the ways
+		 | nodes |
+		 | abcde |
+		 | cfg   |
+
+		When I route I should get
+		 | from | to | route     | distance |
+		 | b    | f  | abcde,cfg | 200m +-1 |
+		 | g    | a  | cfg,abcde | 400m +-1 |
+		 | d    | b  | abcde     | 200m +-1 |
+
+		When I route I should get
+		 | waypoints | route               |
+		 | a,g,e     | abcde,cfg,cfg,abcde |
@@ -0,0 +1,73 @@
+@routing @time_dependent
+Feature: Time-dependent routing with weekly travel time profiles
+# departure is a unix timestamp, hours are counted from monday 00:00 UTC
+# 1970-01-05 was a monday: 02:00 is 352800, 08:00 is 374400, saturday 08:00 is 806400
+
+	Background:
+		Given the profile "testbot"
+
+	Scenario: Time-dependent - a congested road is avoided during its peak hours
+		Given the node map
+		 | a | b | c |
+		 | d | e | f |
+
+		And the ways
+		 | nodes |
+		 | abc   |
+		 | ad    |
+		 | def   |
+		 | fc    |
+
+		And the travel time profiles
+		 | profile | factor | hours |
+		 | rush    | 1000   | 7-9   |
+
+		And the travel time profile segments
+		 | nodes | profile |
+		 | abc   | rush    |
+
+		When I route I should get
+		 | from | to | param:departure | route     |
+		 | a    | c  | 352800          | abc       |
+		 | a    | c  | 374400          | ad,def,fc |
+		 | c    | a  | 374400          | abc       |
+
+	Scenario: Time-dependent - profiles repeat every week
+		Given the node map
+		 | a | b | c |
+		 | d | e | f |
+
+		And the ways
+		 | nodes |
+		 | abc   |
+		 | ad    |
+		 | def   |
+		 | fc    |
+
+		And the travel time profiles
+		 | profile  | factor | hours   |
+		 | saturday | 1000   | 120-143 |
+
+		And the travel time profile segments
+		 | nodes | profile  |
+		 | abc   | saturday |
+
+		When I route I should get
+		 | from | to | param:departure | route     |
+		 | a    | c  | 352800          | abc       |
+		 | a    | c  | 806400          | ad,def,fc |
+		 | a    | c  | 979200          | abc       |
+		 | a    | c  | 1411200         | ad,def,fc |
+
+	Scenario: Time-dependent - a departure time without profiles is rejected
+		Given the node map
+		 | a | b | c |
+
+		And the ways
+		 | nodes |
+		 | abc   |
+
+		When I route I should get
+		 | from | to | param:departure | route | status |
+		 | a    | c  | 0               | abc   | 0      |
+		 | a    | c  | 352800          |       | 400    |
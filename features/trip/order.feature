@@ -0,0 +1,37 @@
+@trip
+Feature: Round trips - visit all stops and return to the first
+
+	Background:
+		Given the profile "testbot"
+
+	Scenario: Trip - stops around a block are visited in order
+		Given the node map
+		 | a |   | b |
+		 |   |   |   |
+		 | d |   | c |
+
+		And the ways
+		 | nodes |
+		 | ab    |
+		 | bc    |
+		 | cd    |
+		 | da    |
+
+		When I plan a trip I should get
+		 | waypoints | trip |
+		 | a,c,b,d   | abcd |
+		 | c,a,d,b   | cbad |
+		 | a,b       | ab   |
+
+	Scenario: Trip - no trip if a stop cannot be reached
+		Given the node map
+		 | a | b |   | c | d |
+
+		And the ways
+		 | nodes |
+		 | ab    |
+		 | cd    |
+
+		When I plan a trip I should get
+		 | waypoints | trip | status |
+		 | a,b,d     |      | 207    |
@@ -93,6 +93,8 @@ u_turn_penalty 			= 20
 use_turn_restrictions   = false
 turn_penalty 			= 60
 turn_bias               = 1.4
+-- "batch" hands many turns to turn_function at once, "table" samples it once
+turn_penalty_evaluation = "batch"
 -- End of globals
 
 function get_exceptions(vector)
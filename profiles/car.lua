@@ -39,6 +39,8 @@ use_restrictions 		    = true
 ignore_areas 			      = true -- future feature
 traffic_signal_penalty  = 2
 u_turn_penalty 			    = 20
+-- way_function and node_function only depend on the tags
+pure_profile            = true
 
 -- End of globals
 
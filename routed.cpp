@@ -21,12 +21,14 @@ or see http://www.gnu.org/licenses/agpl.txt.
 
 #include "Library/OSRM.h"
 
+#include "Server/PreForkingServer.h"
 #include "Server/ServerFactory.h"
 
 #include "Util/IniFile.h"
 #include "Util/InputFileUtil.h"
 #include "Util/OpenMPWrapper.h"
 #include "Util/SimpleLogger.h"
+#include "Util/StringUtil.h"
 #include "Util/UUID.h"
 
 #ifdef __linux__
@@ -100,6 +102,23 @@ int main (int argc, char * argv[]) {
         Server * s = ServerFactory::CreateServer(serverConfig);
         s->GetRequestHandlerPtr().RegisterRoutingMachine(&routing_machine);
 
+#ifndef _WIN32
+        const int number_of_processes = stringToInt(serverConfig.GetParameter("Processes"));
+        if( 1 < number_of_processes ) {
+            //data and listening sockets are shared with the forked workers
+            std::cout << "[server] running " << number_of_processes << " worker processes" << std::endl;
+            PreForkingServer master(s, number_of_processes, old_mask);
+            master.Run();
+            std::cout << "[server] freeing objects" << std::endl;
+            delete s;
+            std::cout << "[server] shutdown completed" << std::endl;
+#ifdef __linux__
+            munlockall();
+#endif
+            return 0;
+        }
+#endif
+
         boost::thread t(boost::bind(&Server::Run, s));
 
 #ifndef _WIN32